@@ -0,0 +1,20 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(set = 0, binding = 0) uniform CameraBufferObject {
+    mat4 view;
+    mat4 proj;
+} camera;
+
+layout(location = 0) in vec3 inPosition;
+
+layout(location = 3) in mat4 instanceModel;
+
+// Invariant with triangle.vert, the color pass tests depth for equality.
+out gl_PerVertex {
+    invariant vec4 gl_Position;
+};
+
+void main() {
+    gl_Position = camera.proj * camera.view * instanceModel * vec4(inPosition, 1.0);
+}
@@ -1,3 +1,30 @@
-version https://git-lfs.github.com/spec/v1
-oid sha256:6c9f83fadbe32388b3b6afef0d1aea8b92572d4612bf186c367fe845557b98ea
-size 516
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(set = 0, binding = 0) uniform CameraBufferObject {
+    mat4 view;
+    mat4 proj;
+} camera;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 3) in mat4 instanceModel;
+layout(location = 7) in uint instanceMaterial;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragMaterial;
+
+// Invariant with depth_prepass.vert, the color pass tests depth for equality after it.
+out gl_PerVertex {
+    invariant vec4 gl_Position;
+};
+
+void main() {
+    gl_Position = camera.proj * camera.view * instanceModel * vec4(inPosition, 1.0);
+    fragColor = inColor;
+    fragTexCoord = inTexCoord;
+    fragMaterial = instanceMaterial;
+}
@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <iomanip>
+#include <numeric>
+#include <sstream>
+
+#include "benchmark/benchmark.h"
+
+namespace Rake { namespace Benchmark {
+
+/**
+ * @brief
+ * @return 0 without samples
+ */
+double Samples::mean() const
+{
+  if (values.empty()) {
+    return 0.0;
+  }
+  return std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+}
+
+/**
+ * @brief
+ * @return 0 without samples
+ */
+double Samples::median() const
+{
+  if (values.empty()) {
+    return 0.0;
+  }
+  auto sorted = values;
+  std::sort(sorted.begin(), sorted.end());
+  size_t middle = sorted.size() / 2;
+  return sorted.size() % 2 ? sorted[middle] : (sorted[middle - 1] + sorted[middle]) / 2.0;
+}
+
+/**
+ * @brief
+ * @return 0 without samples
+ */
+double Samples::min() const
+{
+  return values.empty() ? 0.0 : *std::min_element(values.begin(), values.end());
+}
+
+/**
+ * @brief
+ * @return 0 without samples
+ */
+double Samples::max() const
+{
+  return values.empty() ? 0.0 : *std::max_element(values.begin(), values.end());
+}
+
+/**
+ * @brief
+ *
+ * @param columns
+ */
+Table::Table(std::vector<std::string> columns)
+    : header(std::move(columns))
+{
+}
+
+/**
+ * @brief Missing cells are left blank, extra cells are dropped
+ *
+ * @param cells
+ */
+void Table::row(std::vector<std::string> cells)
+{
+  cells.resize(header.size());
+  rows.push_back(std::move(cells));
+}
+
+/**
+ * @brief
+ *
+ * @param out
+ */
+void Table::print(std::ostream& out) const
+{
+  std::vector<size_t> widths(header.size());
+  for (size_t i = 0; i < header.size(); i++) {
+    widths[i] = header[i].size();
+    for (const auto& row : rows) {
+      widths[i] = std::max(widths[i], row[i].size());
+    }
+  }
+
+  auto print_row = [&](const std::vector<std::string>& cells) {
+    for (size_t i = 0; i < cells.size(); i++) {
+      out << (i ? "  " : "") << std::setw(static_cast<int>(widths[i])) << cells[i];
+    }
+    out << "\n";
+  };
+
+  print_row(header);
+  for (const auto& row : rows) {
+    print_row(row);
+  }
+  out.flush();
+}
+
+/**
+ * @brief
+ *
+ * @param value
+ * @param precision digits after the decimal point
+ * @return std::string
+ */
+std::string format(double value, int precision)
+{
+  std::ostringstream stream;
+  stream << std::fixed << std::setprecision(precision) << value;
+  return stream.str();
+}
+
+}}  // namespace Rake::Benchmark
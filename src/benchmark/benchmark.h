@@ -0,0 +1,59 @@
+#if !defined(BENCHMARK_H)
+#define BENCHMARK_H
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Rake { namespace Benchmark {
+
+/**
+ * @brief Collects repeated measurements and summarizes them
+ */
+class Samples {
+  public:
+  void add(double value) { values.push_back(value); }
+  void clear() { values.clear(); }
+
+  size_t count() const { return values.size(); }
+  double mean() const;
+  double median() const;
+  double min() const;
+  double max() const;
+
+  private:
+  std::vector<double> values;
+};
+
+/**
+ * @brief Plain text table with right aligned columns
+ */
+class Table {
+  public:
+  explicit Table(std::vector<std::string> columns);
+
+  void row(std::vector<std::string> cells);
+  void print(std::ostream& out) const;
+
+  private:
+  std::vector<std::string>              header;
+  std::vector<std::vector<std::string>> rows;
+};
+
+std::string format(double value, int precision = 3);
+
+/**
+ * @brief Wall clock milliseconds spent in body
+ */
+template <typename F>
+double time_ms(F&& body)
+{
+  auto start = std::chrono::steady_clock::now();
+  body();
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}}  // namespace Rake::Benchmark
+
+#endif  // BENCHMARK_H
@@ -0,0 +1,25 @@
+#if !defined(CPUBENCHMARKS_H)
+#define CPUBENCHMARKS_H
+
+#include <cstdint>
+
+namespace Rake { namespace Benchmark {
+
+/**
+ * @brief Benchmarks that run without a window or a Vulkan device. Each prints a table to
+ * std::cout and throws when its input can't be read. What they time is checked by the
+ * tests under test/.
+ */
+void cpu_culling();
+void scene_graph();
+void bvh();
+void lod(uint32_t levelCount, float pixelError);
+void meshlets(uint32_t levelCount);
+void render_graph();
+void mip_bake();
+void block_compress();
+void image_import();
+
+}}  // namespace Rake::Benchmark
+
+#endif  // CPUBENCHMARKS_H
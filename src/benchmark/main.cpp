@@ -0,0 +1,92 @@
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "benchmark/cpubenchmarks.h"
+#include "vulkan/VulkanSettings.h"
+
+namespace {
+void usage(const std::string& name)
+{
+  std::cout << "Usage: " << name << " [--lods <n>] [--lod-error <px>] <benchmark>...\n"
+            << " Run benchmarks that need no window or Vulkan device, from the directory holding data/.\n"
+            << " Benchmarks: cpu-culling, scene-graph, bvh, lod, meshlets, render-graph, mip-bake,\n"
+            << " block-compress, image-import. The GPU benchmarks are run with vktut --benchmark.\n"
+            << " --lods <n> \t\t detail levels the lod and meshlets benchmarks generate\n"
+            << " --lod-error <px> \t error in pixels the lod benchmark picks distances for\n";
+}
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  std::vector<std::string> params(argv, argv + argc);
+
+  Rake::Graphics::Settings settings;
+  std::vector<std::string> names;
+  try {
+    for (size_t i = 1; i < params.size(); i++) {
+      if (params[i] == "--lods" && i + 1 < params.size()) {
+        settings.lodCount = static_cast<uint32_t>(std::stoul(params[++i]));
+      } else if (params[i] == "--lod-error" && i + 1 < params.size()) {
+        settings.lodPixelError = std::stof(params[++i]);
+      } else if (params[i] == "-h" || params[i] == "--help") {
+        usage(params[0]);
+        return EXIT_SUCCESS;
+      } else {
+        names.push_back(params[i]);
+      }
+    }
+  } catch (const std::logic_error&) {
+    usage(params[0]);
+    return EXIT_FAILURE;
+  }
+  if (names.empty()) {
+    usage(params[0]);
+    return EXIT_FAILURE;
+  }
+
+  namespace Benchmark = Rake::Benchmark;
+  struct Entry {
+    const char*           name;
+    std::function<void()> run;
+  };
+  const std::vector<Entry> benchmarks = {
+      {"cpu-culling", Benchmark::cpu_culling},
+      {"scene-graph", Benchmark::scene_graph},
+      {"bvh", Benchmark::bvh},
+      {"lod", [&settings]() { Benchmark::lod(settings.lodCount, settings.lodPixelError); }},
+      {"meshlets", [&settings]() { Benchmark::meshlets(settings.lodCount); }},
+      {"render-graph", Benchmark::render_graph},
+      {"mip-bake", Benchmark::mip_bake},
+      {"block-compress", Benchmark::block_compress},
+      {"image-import", Benchmark::image_import},
+  };
+
+  // Every name is looked up before the first runs, a typo shouldn't surface after minutes of timing
+  std::vector<const Entry*> selected;
+  for (const auto& name : names) {
+    const Entry* entry = nullptr;
+    for (const auto& candidate : benchmarks) {
+      entry = name == candidate.name ? &candidate : entry;
+    }
+    if (entry == nullptr) {
+      std::cerr << "Unknown benchmark: " << name << std::endl;
+      return EXIT_FAILURE;
+    }
+    selected.push_back(entry);
+  }
+
+  try {
+    for (const auto* entry : selected) {
+      entry->run();
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
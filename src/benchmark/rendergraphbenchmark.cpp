@@ -0,0 +1,106 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "benchmark/cpubenchmarks.h"
+#include "vulkan/VulkanRenderGraph.h"
+
+namespace Rake { namespace Benchmark {
+
+/**
+ * @brief Frame graph compile time and what it saves on a deferred frame with a bloom
+ * chain of growing length. The tone map pass is declared first, so the order has to come
+ * from the dependencies, and an unused debug view is there to be culled.
+ */
+void render_graph()
+{
+  using Graphics::ImageUse;
+  using Graphics::PassType;
+
+  const std::vector<uint32_t> bloomLevels = {1, 4, 8};
+  const uint32_t              runs        = 1000;
+  const VkExtent2D            extent      = {1920, 1080};
+
+  Table table({"bloom levels", "passes", "culled", "barriers", "batches", "transient MB", "aliased MB", "compile us"});
+
+  for (auto levels : bloomLevels) {
+    Graphics::RenderGraph graph;
+    VkDeviceSize          transientBytes = 0;
+
+    auto target = [&](const std::string& name,
+                      uint32_t           divisor,
+                      VkDeviceSize       texelBytes,
+                      VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT) {
+      Graphics::ImageInfo info;
+      info.name                  = name;
+      info.aspect                = aspect;
+      info.memory.size           = (extent.width / divisor) * (extent.height / divisor) * texelBytes;
+      info.memory.alignment      = 65536;
+      info.memory.memoryTypeBits = 1;
+      transientBytes += name == "debug" ? 0 : info.memory.size;
+      return graph.add_image(info);
+    };
+
+    Graphics::ImageInfo swapchainInfo;
+    swapchainInfo.name        = "swapchain";
+    swapchainInfo.imported    = true;
+    swapchainInfo.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    Graphics::ResourceId swapchain = graph.add_image(swapchainInfo);
+
+    auto tonemap = graph.add_pass("tone map");
+
+    auto                 geometry    = graph.add_pass("geometry");
+    Graphics::ResourceId albedo      = geometry.write(target("albedo", 1, 4), ImageUse::ColorAttachment, true);
+    Graphics::ResourceId normal      = geometry.write(target("normal", 1, 8), ImageUse::ColorAttachment, true);
+    Graphics::ResourceId depthTarget = target("depth", 1, 4, VK_IMAGE_ASPECT_DEPTH_BIT);
+    Graphics::ResourceId depth       = geometry.write(depthTarget, ImageUse::DepthAttachment, true);
+
+    auto ssao = graph.add_pass("ambient occlusion", PassType::Compute);
+    ssao.read(depth, ImageUse::Sampled).read(normal, ImageUse::Sampled);
+    Graphics::ResourceId occlusion = ssao.write(target("occlusion", 2, 1), ImageUse::Storage);
+
+    auto lighting = graph.add_pass("lighting");
+    lighting.read(albedo, ImageUse::Sampled).read(normal, ImageUse::Sampled).read(occlusion, ImageUse::Sampled);
+    Graphics::ResourceId hdr = lighting.write(target("hdr", 1, 8), ImageUse::ColorAttachment);
+
+    Graphics::ResourceId bloom = hdr;
+    for (uint32_t level = 0; level < levels; level++) {
+      auto down = graph.add_pass("bloom " + std::to_string(level), PassType::Compute);
+      down.read(bloom, ImageUse::Sampled);
+      bloom = down.write(target("bloom " + std::to_string(level), 2u << level, 8), ImageUse::Storage);
+    }
+
+    tonemap.read(hdr, ImageUse::Sampled).read(bloom, ImageUse::Sampled);
+    tonemap.write(swapchain, ImageUse::ColorAttachment);
+
+    auto debug = graph.add_pass("debug view");
+    debug.read(normal, ImageUse::Sampled);
+    debug.write(target("debug", 1, 4), ImageUse::ColorAttachment, true);
+
+    Samples compile;
+    for (uint32_t run = 0; run < runs; run++) {
+      compile.add(time_ms([&]() { graph.compile(); }));
+    }
+
+    VkDeviceSize aliasedBytes = 0;
+    for (const auto& block : graph.memory_blocks()) {
+      aliasedBytes += block.size;
+    }
+    uint32_t passCount = levels + 5;
+
+    table.row({std::to_string(levels),
+               std::to_string(passCount),
+               std::to_string(passCount - graph.order().size()),
+               std::to_string(graph.barrier_count()),
+               std::to_string(graph.barrier_batches()),
+               format(transientBytes / 1048576.0, 1),
+               format(aliasedBytes / 1048576.0, 1),
+               format(compile.median() * 1000.0, 1)});
+  }
+
+  std::cout << "Render graph, " << runs << " compiles per graph, median\n";
+  table.print(std::cout);
+}
+
+}}  // namespace Rake::Benchmark
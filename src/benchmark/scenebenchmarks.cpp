@@ -0,0 +1,348 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "benchmark/benchmark.h"
+#include "benchmark/cpubenchmarks.h"
+#include "scene/bvh.h"
+#include "scene/frustumculler.h"
+#include "scene/meshlet.h"
+#include "scene/scenegraph.h"
+#include "skeleton/simd.h"
+#include "skeleton/threadpool.h"
+#include "vulkan/VulkanCulling.h"
+#include "vulkan/VulkanUtilities.h"
+
+namespace Rake { namespace Benchmark {
+
+namespace {
+Graphics::Object::Model load_chalet()
+{
+  Graphics::Object::Model chalet;
+  chalet.modelPath = "data/models/chalet.obj";
+  Graphics::Utility().load_model(chalet);
+  return chalet;
+}
+}  // namespace
+
+/**
+ * @brief Throughput of the SoA sphere culler on every instruction set this CPU has.
+ * Spheres are scattered through a box about half of which the camera sees.
+ */
+void cpu_culling()
+{
+  const std::vector<uint32_t> counts   = {10000, 100000, 1000000};
+  const uint32_t              runs     = 50;
+  const float                 halfSize = 100.0f;
+
+  glm::vec3 eye    = glm::vec3(0.0f, -2.0f * halfSize, 0.0f);
+  glm::mat4 view   = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+  glm::mat4 proj   = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 3.0f * halfSize);
+  auto      planes = Graphics::Frustum::from_view_projection(proj * view).planes;
+
+  std::vector<Base::SimdLevel> levels = Base::simd_levels();
+
+  Table table({"objects", "simd", "visible", "ms", "objects/us"});
+
+  for (auto count : counts) {
+    std::mt19937                          random(count);
+    std::uniform_real_distribution<float> position(-halfSize, halfSize);
+    std::uniform_real_distribution<float> size(0.5f, 2.0f);
+
+    std::vector<glm::vec4> spheres(count);
+    for (auto& sphere : spheres) {
+      sphere = glm::vec4(position(random), position(random), position(random), size(random));
+    }
+
+    for (auto level : levels) {
+      Scene::FrustumCuller culler(level);
+      culler.resize(count);
+      for (uint32_t i = 0; i < count; i++) {
+        culler.set_sphere(i, glm::vec3(spheres[i]), spheres[i].w);
+      }
+
+      Samples times;
+      size_t  visible = 0;
+      for (uint32_t run = 0; run < runs; run++) {
+        times.add(time_ms([&]() { visible = culler.cull(planes); }));
+      }
+
+      table.row({std::to_string(count),
+                 Base::to_string(level),
+                 std::to_string(visible),
+                 format(times.median()),
+                 format(count / (times.median() * 1000.0), 1)});
+    }
+  }
+
+  std::cout << "CPU frustum culling, " << runs << " runs per count, median\n";
+  table.print(std::cout);
+}
+
+/**
+ * @brief Scene graph update cost on an eight way tree, with the root moved so every
+ * world matrix changes, with one leaf in a hundred moved, and with nothing moved.
+ * Each case runs on the calling thread and level by level on a pool.
+ */
+void scene_graph()
+{
+  const std::vector<uint32_t> counts    = {10000, 100000, 1000000};
+  const uint32_t              branching = 8;
+  const uint32_t              runs      = 20;
+
+  Base::ThreadPool pool;
+  Table            table({"nodes", "moved", "threads", "updated", "ms"});
+
+  for (auto count : counts) {
+    Scene::SceneGraph graph;
+    graph.reserve(count);
+    graph.create_node();
+    for (uint32_t i = 1; i < count; i++) {
+      Scene::NodeId node = graph.create_node((i - 1) / branching);
+      graph.set_translation(node, glm::vec3(1.0f, 0.0f, 0.0f));
+    }
+    graph.update();
+
+    std::vector<Scene::NodeId> leaves;
+    for (uint32_t i = count - count / 100; i < count; i++) {
+      leaves.push_back(i);
+    }
+
+    struct Case {
+      const char*                name;
+      std::function<void(float)> move;
+    };
+    const std::vector<Case> cases = {
+        {"root", [&graph](float x) { graph.set_translation(0, glm::vec3(x, 0.0f, 0.0f)); }},
+        {"1% leaves",
+         [&graph, &leaves](float x) {
+           for (auto leaf : leaves) {
+             graph.set_translation(leaf, glm::vec3(x, 0.0f, 0.0f));
+           }
+         }},
+        {"none", [](float) {}},
+    };
+
+    for (const auto& test : cases) {
+      for (auto workers : {static_cast<Base::ThreadPool*>(nullptr), &pool}) {
+        Samples times;
+        size_t  updated = 0;
+        for (uint32_t run = 0; run < runs; run++) {
+          test.move(static_cast<float>(run));
+          times.add(time_ms([&]() { updated = graph.update(workers); }));
+        }
+
+        table.row({std::to_string(count),
+                   test.name,
+                   std::to_string(workers == nullptr ? 1 : pool.size()),
+                   std::to_string(updated),
+                   format(times.median())});
+      }
+    }
+  }
+
+  std::cout << "Scene graph update, " << runs << " runs per case, median\n";
+  table.print(std::cout);
+}
+
+/**
+ * @brief BVH build time and query throughput. Rays are cast at the chalet triangles,
+ * frustum queries and refits run over a grid of chalet instances.
+ */
+void bvh()
+{
+  const uint32_t rayCount      = 100000;
+  const uint32_t instanceCount = 1000000;
+  const uint32_t runs          = 10;
+
+  Graphics::Object::Model chalet = load_chalet();
+
+  const auto&              vertices      = chalet.verticies;
+  const auto&              indices       = chalet.indices;
+  uint32_t                 triangleCount = static_cast<uint32_t>(indices.size() / 3);
+  std::vector<Scene::Aabb> triangles(triangleCount);
+  for (uint32_t i = 0; i < triangleCount; i++) {
+    for (uint32_t corner = 0; corner < 3; corner++) {
+      triangles[i].grow(vertices[indices[3 * i + corner]].pos);
+    }
+  }
+
+  Base::ThreadPool pool;
+  Table            table({"test", "items", "ms", "items/us"});
+  auto             add_row = [&table](const std::string& test, uint32_t items, double ms) {
+    table.row({test, std::to_string(items), format(ms), format(items / (ms * 1000.0), 2)});
+  };
+
+  Scene::Bvh mesh;
+  Samples    serialBuild;
+  Samples    parallelBuild;
+  for (uint32_t run = 0; run < runs; run++) {
+    serialBuild.add(time_ms([&]() { mesh.build(triangles); }));
+    parallelBuild.add(time_ms([&]() { mesh.build(triangles, &pool); }));
+  }
+  add_row("mesh build", triangleCount, serialBuild.median());
+  add_row("mesh build, " + std::to_string(pool.size()) + " threads", triangleCount, parallelBuild.median());
+
+  // Rays from a sphere around the model towards random points inside its box.
+  std::mt19937                          random(1);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  const auto&                           box    = chalet.bounds;
+  glm::vec3                             center = glm::vec3(box.sphere);
+
+  std::vector<glm::vec3> origins(rayCount);
+  std::vector<glm::vec3> directions(rayCount);
+  for (uint32_t i = 0; i < rayCount; i++) {
+    glm::vec3 outward = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) - glm::vec3(0.5f));
+    glm::vec3 target  = box.minimum + glm::vec3(unit(random), unit(random), unit(random)) * (box.maximum - box.minimum);
+    origins[i]        = center + outward * (2.0f * box.sphere.w);
+    directions[i]     = target - origins[i];
+  }
+
+  auto intersect_ray = [&](uint32_t ray) {
+    return [&, ray](uint32_t triangle, float& distance) {
+      return Scene::Bvh::intersect_triangle(origins[ray],
+                                            directions[ray],
+                                            vertices[indices[3 * triangle]].pos,
+                                            vertices[indices[3 * triangle + 1]].pos,
+                                            vertices[indices[3 * triangle + 2]].pos,
+                                            distance);
+    };
+  };
+
+  double rayMs = time_ms([&]() {
+    for (uint32_t i = 0; i < rayCount; i++) {
+      mesh.raycast(origins[i], directions[i], std::numeric_limits<float>::max(), intersect_ray(i));
+    }
+  });
+  add_row("mesh raycast", rayCount, rayMs);
+
+  // Instances of the chalet on a grid, queried with a camera looking across it.
+  uint32_t                 side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(instanceCount))));
+  float                    spacing = 2.0f * box.sphere.w;
+  std::vector<Scene::Aabb> instances(instanceCount);
+  for (uint32_t i = 0; i < instanceCount; i++) {
+    glm::vec3 offset     = glm::vec3(spacing * (i % side), spacing * (i / side), 0.0f);
+    instances[i].minimum = box.minimum + offset;
+    instances[i].maximum = box.maximum + offset;
+  }
+
+  Scene::Bvh scene;
+  add_row("instance build, " + std::to_string(pool.size()) + " threads",
+          instanceCount,
+          time_ms([&]() { scene.build(instances, &pool); }));
+
+  float     extent = spacing * side;
+  glm::mat4 view   = glm::lookAt(glm::vec3(-0.1f * extent, -0.1f * extent, 0.1f * extent),
+                               glm::vec3(0.5f * extent, 0.5f * extent, 0.0f),
+                               glm::vec3(0.0f, 0.0f, 1.0f));
+  glm::mat4 proj   = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 2.0f * extent);
+  auto      planes = Graphics::Frustum::from_view_projection(proj * view).planes;
+
+  std::vector<uint32_t> visible;
+  Samples               query;
+  for (uint32_t run = 0; run < runs; run++) {
+    query.add(time_ms([&]() { scene.query_frustum(planes, visible); }));
+  }
+  add_row("frustum query, " + std::to_string(visible.size()) + " visible", instanceCount, query.median());
+
+  for (auto& instance : instances) {
+    instance.minimum.z += unit(random);
+    instance.maximum.z = instance.minimum.z + (box.maximum.z - box.minimum.z);
+  }
+  add_row("instance refit", instanceCount, time_ms([&]() { scene.refit(instances); }));
+
+  std::cout << "BVH over " << chalet.modelPath << ", SAH cost " << format(mesh.sah_cost(), 1) << " mesh, "
+            << format(scene.sah_cost(), 1) << " instances\n";
+  table.print(std::cout);
+}
+
+/**
+ * @brief Time the LOD chain generation for the chalet and list each level with the
+ * distance it is first drawn at on a 1080p screen.
+ *
+ * @param levelCount levels to generate, at least two
+ * @param pixelError largest error in pixels a level may be drawn with
+ */
+void lod(uint32_t levelCount, float pixelError)
+{
+  const float pixelScale = 1080.0f / (2.0f * std::tan(0.5f * glm::radians(45.0f)));
+
+  Graphics::Object::Model chalet = load_chalet();
+
+  double ms = time_ms([&]() { Graphics::Utility::build_lods(chalet, std::max(levelCount, 2u)); });
+
+  Table table({"lod", "triangles", "error", "from distance"});
+  for (size_t i = 0; i < chalet.lods.size(); i++) {
+    const auto& level = chalet.lods[i];
+    table.row({std::to_string(i),
+               std::to_string(level.indexCount / 3),
+               format(level.error, 5),
+               format(level.error * pixelScale / pixelError, 2)});
+  }
+
+  std::cout << "LOD chain for " << chalet.modelPath << ", " << chalet.verticies.size() << " vertices, built in "
+            << format(ms) << " ms\n";
+  table.print(std::cout);
+}
+
+/**
+ * @brief Meshlet generation for the chalet and its LODs, and how many meshlets the cone
+ * test rejects from cameras around the model
+ *
+ * @param levelCount LOD levels to build meshlets for
+ */
+void meshlets(uint32_t levelCount)
+{
+  const uint32_t cameraCount = 64;
+
+  Graphics::Object::Model chalet = load_chalet();
+  Graphics::Utility::build_lods(chalet, std::max(levelCount, 1u));
+
+  double ms = time_ms([&]() { Graphics::Utility::build_meshlets(chalet); });
+
+  // Cameras on a sphere twice the model's radius, spread with a golden angle spiral.
+  std::vector<glm::vec3> cameras(cameraCount);
+  glm::vec3              center = glm::vec3(chalet.bounds.sphere);
+  for (uint32_t i = 0; i < cameraCount; i++) {
+    float z    = 1.0f - 2.0f * (i + 0.5f) / cameraCount;
+    float ring = std::sqrt(1.0f - z * z);
+    float turn = 2.39996323f * i;
+    cameras[i] = center + 2.0f * chalet.bounds.sphere.w * glm::vec3(ring * std::cos(turn), ring * std::sin(turn), z);
+  }
+
+  Table table({"lod", "triangles", "meshlets", "vertices", "triangles/meshlet", "cone culled"});
+  for (size_t level = 0; level < chalet.lods.size(); level++) {
+    const auto& lod       = chalet.lods[level];
+    uint64_t    vertexSum = 0;
+    uint64_t    culled    = 0;
+    for (uint32_t m = lod.firstMeshlet; m < lod.firstMeshlet + lod.meshletCount; m++) {
+      const auto& meshlet = chalet.meshlets[m];
+      vertexSum += meshlet.vertexCount;
+      for (const auto& camera : cameras) {
+        culled += Scene::cone_culled(meshlet, camera) ? 1 : 0;
+      }
+    }
+
+    double meshletCount = std::max(lod.meshletCount, 1u);
+    table.row({std::to_string(level),
+               std::to_string(lod.indexCount / 3),
+               std::to_string(lod.meshletCount),
+               format(vertexSum / meshletCount, 1),
+               format(lod.indexCount / 3 / meshletCount, 1),
+               format(100.0 * culled / (meshletCount * cameraCount), 1) + "%"});
+  }
+
+  std::cout << "Meshlets for " << chalet.modelPath << " built in " << format(ms) << " ms, cone test from "
+            << cameraCount << " cameras\n";
+  table.print(std::cout);
+}
+
+}}  // namespace Rake::Benchmark
@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <stb_image.h>
+
+#include "benchmark/benchmark.h"
+#include "benchmark/cpubenchmarks.h"
+#include "skeleton/simd.h"
+#include "skeleton/threadpool.h"
+#include "texture/blockcompress.h"
+#include "texture/imageimport.h"
+#include "texture/mipchain.h"
+
+namespace Rake { namespace Benchmark {
+
+/**
+ * @brief CPU mip chain builds of sRGB noise on every instruction set this CPU has, on the
+ * calling thread and split over a pool
+ */
+void mip_bake()
+{
+  const std::vector<uint32_t> sizes = {1024, 2048, 4096};
+  const uint32_t              runs  = 10;
+
+  std::vector<Base::SimdLevel> levels = Base::simd_levels();
+
+  Base::ThreadPool pool;
+  Table            table({"size", "simd", "threads", "levels", "ms", "Mtexels/s"});
+
+  for (auto size : sizes) {
+    std::mt19937         random(size);
+    std::vector<uint8_t> texels(size_t(size) * size * 4);
+    for (auto& texel : texels) {
+      texel = static_cast<uint8_t>(random());
+    }
+
+    for (auto level : levels) {
+      for (auto workers : {static_cast<Base::ThreadPool*>(nullptr), &pool}) {
+        Texture::MipBuilder builder(level, workers);
+        Texture::MipChain   chain;
+
+        Samples times;
+        for (uint32_t run = 0; run < runs; run++) {
+          times.add(time_ms([&]() { chain = builder.build(texels.data(), size, size, Texture::ColorSpace::Srgb); }));
+        }
+
+        // Texels written below level 0, a third of level 0
+        double written = (chain.data.size() - chain.levels[0].size) / 4.0;
+        table.row({std::to_string(size),
+                   Base::to_string(level),
+                   std::to_string(workers != nullptr ? pool.size() : 1),
+                   std::to_string(chain.level_count()),
+                   format(times.median()),
+                   format(written / (times.median() * 1000.0), 1)});
+      }
+    }
+  }
+
+  std::cout << "CPU sRGB mip chain builds, " << runs << " runs per case, median\n";
+  table.print(std::cout);
+}
+
+/**
+ * @brief Block compression of a baked mip chain in every format, on every instruction
+ * set this CPU has, on the calling thread and split over a pool. The image is smooth
+ * gradients with noise on top.
+ */
+void block_compress()
+{
+  const std::vector<uint32_t>             sizes   = {1024, 2048};
+  const std::vector<Texture::BlockFormat> formats = {
+      Texture::BlockFormat::Bc1, Texture::BlockFormat::Bc3, Texture::BlockFormat::Bc7};
+  const uint32_t runs = 5;
+
+  std::vector<Base::SimdLevel> levels = Base::simd_levels();
+
+  Base::ThreadPool pool;
+  Table            table({"size", "format", "simd", "threads", "ms", "Mtexels/s", "ratio"});
+
+  for (auto size : sizes) {
+    std::mt19937         random(size);
+    std::vector<uint8_t> texels(size_t(size) * size * 4);
+    for (uint32_t y = 0; y < size; y++) {
+      for (uint32_t x = 0; x < size; x++) {
+        uint8_t* texel = &texels[(size_t(y) * size + x) * 4];
+        texel[0]       = static_cast<uint8_t>((x + random() % 32) * 255 / (size + 31));
+        texel[1]       = static_cast<uint8_t>((y + random() % 32) * 255 / (size + 31));
+        texel[2]       = static_cast<uint8_t>(((x + y) / 2 + random() % 32) * 255 / (size + 31));
+        texel[3]       = static_cast<uint8_t>(255 - texel[0] / 4);
+      }
+    }
+    Texture::MipChain chain = Texture::MipBuilder(Base::best_simd_level(), &pool)
+                                  .build(texels.data(), size, size, Texture::ColorSpace::Srgb);
+    double texelCount = chain.data.size() / 4.0;
+
+    for (auto blockFormat : formats) {
+      for (auto level : levels) {
+        for (auto workers : {static_cast<Base::ThreadPool*>(nullptr), &pool}) {
+          Texture::BlockEncoder encoder(level, workers);
+          Texture::MipChain     blocks;
+
+          Samples times;
+          for (uint32_t run = 0; run < runs; run++) {
+            times.add(time_ms([&]() { blocks = encoder.encode(chain, blockFormat); }));
+          }
+
+          table.row({std::to_string(size),
+                     Texture::to_string(blockFormat),
+                     Base::to_string(level),
+                     std::to_string(workers != nullptr ? pool.size() : 1),
+                     format(times.median()),
+                     format(texelCount / (times.median() * 1000.0), 1),
+                     format(double(chain.data.size()) / blocks.data.size(), 1) + ":1"});
+        }
+      }
+    }
+  }
+
+  std::cout << "Block compression of whole mip chains, " << runs << " runs per case, median\n";
+  table.print(std::cout);
+}
+
+/**
+ * @brief RGB to RGBA expansion on every instruction set this CPU has, then the textures in
+ * data/textures decoded many times over on pools of growing size, each image straight in
+ * to a staging ring that is released as images come out
+ */
+void image_import()
+{
+  const std::vector<std::string> paths  = {"data/textures/chalet.jpg", "data/textures/texture.jpg"};
+  const uint32_t                 copies = 4;  // Of each image per import
+  const uint32_t                 runs   = 3;
+  const double                   mb     = 1024.0 * 1024.0;
+
+  std::vector<Base::SimdLevel> levels = Base::simd_levels();
+
+  // Odd count so every path has a scalar tail
+  const size_t         texelCount = size_t(4096) * 4096 + 3;
+  std::mt19937         random(texelCount);
+  std::vector<uint8_t> rgb(texelCount * 3);
+  for (auto& channel : rgb) {
+    channel = static_cast<uint8_t>(random());
+  }
+
+  Table expandTable({"simd", "ms", "MB/s"});
+  for (auto level : levels) {
+    std::vector<uint8_t> rgba(texelCount * 4);
+    Samples              times;
+    for (uint32_t run = 0; run < runs; run++) {
+      times.add(time_ms([&]() { Texture::expand_rgb(rgb.data(), rgba.data(), texelCount, level); }));
+    }
+    expandTable.row(
+        {Base::to_string(level), format(times.median()), format(rgba.size() / mb / (times.median() / 1000.0), 0)});
+  }
+
+  std::cout << "RGB to RGBA expansion of " << texelCount << " texels, " << runs << " runs per case, median\n";
+  expandTable.print(std::cout);
+
+  size_t largest      = 0;
+  size_t decodedBytes = 0;
+  for (const auto& path : paths) {
+    uint32_t width, height;
+    if (!Texture::ImageImporter::image_size(path, width, height)) {
+      throw std::runtime_error("Failed to load texture image!");
+    }
+    largest = std::max(largest, size_t(width) * height * 4);
+    decodedBytes += size_t(width) * height * 4 * copies;
+  }
+
+  std::vector<size_t> threadCounts;
+  for (size_t threads = 1; threads < Base::ThreadPool::default_thread_count(); threads *= 2) {
+    threadCounts.push_back(threads);
+  }
+  threadCounts.push_back(Base::ThreadPool::default_thread_count());
+
+  // Room for an image per worker of the largest pool, the rest wait for space
+  std::vector<uint8_t> staging(largest * threadCounts.back());
+  Texture::StagingRing ring(staging.data(), staging.size());
+
+  // The serial loads the importer replaces
+  Table   importTable({"decoder", "threads", "images", "ms", "MB/s"});
+  Samples serialTimes;
+  for (uint32_t run = 0; run < runs; run++) {
+    serialTimes.add(time_ms([&]() {
+      for (uint32_t copy = 0; copy < copies; copy++) {
+        for (const auto& path : paths) {
+          int width, height, channels;
+          stbi_image_free(stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha));
+        }
+      }
+    }));
+  }
+  importTable.row({"stbi_load",
+                   "1",
+                   std::to_string(copies * paths.size()),
+                   format(serialTimes.median()),
+                   format(decodedBytes / mb / (serialTimes.median() / 1000.0), 0)});
+
+  for (auto threads : threadCounts) {
+    Base::ThreadPool       pool(threads);
+    Texture::ImageImporter importer(ring, &pool);
+
+    Samples times;
+    for (uint32_t run = 0; run < runs; run++) {
+      times.add(time_ms([&]() {
+        for (uint32_t copy = 0; copy < copies; copy++) {
+          for (const auto& path : paths) {
+            importer.submit(path);
+          }
+        }
+        while (importer.pending() > 0) {
+          ring.release(importer.next().texels);
+        }
+      }));
+    }
+    importTable.row({"importer",
+                     std::to_string(threads),
+                     std::to_string(copies * paths.size()),
+                     format(times.median()),
+                     format(decodedBytes / mb / (times.median() / 1000.0), 0)});
+  }
+
+  std::cout << "Parallel decodes of " << paths.size() << " images, " << copies << " copies each, " << runs
+            << " runs per case, median\n";
+  importTable.print(std::cout);
+}
+
+}}  // namespace Rake::Benchmark
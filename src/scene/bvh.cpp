@@ -0,0 +1,684 @@
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "scene/bvh.h"
+#include "skeleton/threadpool.h"
+
+namespace Rake { namespace Scene {
+
+namespace {
+constexpr uint32_t binCount         = 16;
+constexpr uint32_t maxLeafSize      = 8;
+constexpr uint32_t maxSahDepth      = 48;  // Deeper nodes split at the median, bounds the traversal stack
+constexpr uint32_t parallelBinCount = 65536;
+constexpr uint32_t parallelChunk    = 16384;
+constexpr uint32_t parallelSubtree  = 4096;  // Nodes up to this many primitives are built as one pool task
+constexpr uint32_t emptySlot        = UINT32_MAX;
+constexpr uint32_t insideBit        = 0x80000000u;  // Frustum query: the whole node is inside
+
+static_assert(parallelSubtree < parallelBinCount, "Subtree tasks bin on their own thread, not on the pool");
+
+struct Bins {
+  std::array<std::array<Aabb, binCount>, 3>     bounds;
+  std::array<std::array<uint32_t, binCount>, 3> counts = {};
+};
+
+uint32_t bin_of(float centroid, float minimum, float scale)
+{
+  return std::min(binCount - 1, static_cast<uint32_t>(std::max((centroid - minimum) * scale, 0.0f)));
+}
+}  // namespace
+
+/**
+ * @brief Half the surface area, all the SAH needs is the ratio between boxes
+ *
+ * @return 0 for an empty box
+ */
+float Aabb::half_area() const
+{
+  glm::vec3 extent = maximum - minimum;
+  if (extent.x < 0.0f || extent.y < 0.0f || extent.z < 0.0f) {
+    return 0.0f;
+  }
+  return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+}
+
+/**
+ * @brief Build over the boxes of the primitives, replacing the previous hierarchy
+ *
+ * @param primitives
+ * @param pool optional, bins large nodes in parallel and builds small subtrees as tasks,
+ * must not be called from a worker. The tree is the same with or without it.
+ */
+void Bvh::build(const std::vector<Aabb>& primitives, Base::ThreadPool* pool)
+{
+  if (primitives.size() >= insideBit) {
+    throw std::runtime_error("Too many primitives for a BVH!");
+  }
+
+  nodes.clear();
+  rootBounds = Aabb();
+  primitiveIndices.resize(primitives.size());
+  std::iota(primitiveIndices.begin(), primitiveIndices.end(), 0);
+  if (primitives.empty()) {
+    return;
+  }
+
+  BuildInput input = {primitives, std::vector<glm::vec3>(primitives.size()), pool};
+  for (size_t i = 0; i < primitives.size(); i++) {
+    input.centroids[i] = primitives[i].center();
+  }
+
+  std::vector<BuildNode> buildNodes;
+  buildNodes.reserve(2 * primitives.size() / maxLeafSize + 1);
+  std::vector<Subtree> subtrees;
+  uint32_t             root =
+      build_node(buildNodes, input, 0, static_cast<uint32_t>(primitives.size()), 0, pool ? &subtrees : nullptr);
+  build_subtrees(buildNodes, input, subtrees);
+  rootBounds = buildNodes[root].bounds;
+
+  nodes.reserve(buildNodes.size() / 3 + 1);
+  flatten(buildNodes, root);
+}
+
+/**
+ * @brief Recompute every box bottom up after the primitives moved, the tree keeps its
+ * shape so its quality drops as they move further from where they were built
+ *
+ * @param primitives same count and order as given to build()
+ */
+void Bvh::refit(const std::vector<Aabb>& primitives)
+{
+  if (primitives.size() != primitiveIndices.size()) {
+    throw std::runtime_error("Refit with a different primitive count!");
+  }
+
+  // Children come after their parent, so walking backwards sees them first.
+  for (size_t index = nodes.size(); index-- > 0;) {
+    Node& node = nodes[index];
+    for (int slot = 0; slot < 4; slot++) {
+      if (node.child[slot] == emptySlot) {
+        continue;
+      }
+
+      Aabb box;
+      if (node.count[slot] > 0) {
+        for (uint32_t i = 0; i < node.count[slot]; i++) {
+          box.grow(primitives[primitiveIndices[node.child[slot] + i]]);
+        }
+      } else {
+        box = node_bounds(node.child[slot]);
+      }
+
+      node.minX[slot] = box.minimum.x;
+      node.minY[slot] = box.minimum.y;
+      node.minZ[slot] = box.minimum.z;
+      node.maxX[slot] = box.maximum.x;
+      node.maxY[slot] = box.maximum.y;
+      node.maxZ[slot] = box.maximum.z;
+    }
+  }
+  rootBounds = nodes.empty() ? Aabb() : node_bounds(0);
+}
+
+/**
+ * @brief Closest primitive along a ray, children are visited nearest first
+ *
+ * @param origin
+ * @param direction need not be normalized, distances are in units of its length
+ * @param maxDistance
+ * @param intersect called for every primitive in a leaf the ray reaches
+ * @return RayHit
+ */
+RayHit Bvh::raycast(const glm::vec3& origin,
+                    const glm::vec3& direction,
+                    float            maxDistance,
+                    const Intersect& intersect) const
+{
+  RayHit hit;
+  hit.distance = maxDistance;
+  if (nodes.empty()) {
+    return hit;
+  }
+
+  glm::vec3 inverse = glm::vec3(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+  std::array<uint32_t, 256> stack;
+  size_t                    stackSize = 0;
+  stack[stackSize++]                  = 0;
+
+  while (stackSize > 0) {
+    const Node& node = nodes[stack[--stackSize]];
+
+    alignas(16) float near[4];
+    int               mask = 0;
+#if defined(__SSE2__)
+    __m128 ox   = _mm_set1_ps(origin.x);
+    __m128 oy   = _mm_set1_ps(origin.y);
+    __m128 oz   = _mm_set1_ps(origin.z);
+    __m128 ix   = _mm_set1_ps(inverse.x);
+    __m128 iy   = _mm_set1_ps(inverse.y);
+    __m128 iz   = _mm_set1_ps(inverse.z);
+    __m128 tx0  = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minX), ox), ix);
+    __m128 tx1  = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxX), ox), ix);
+    __m128 ty0  = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minY), oy), iy);
+    __m128 ty1  = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxY), oy), iy);
+    __m128 tz0  = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minZ), oz), iz);
+    __m128 tz1  = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxZ), oz), iz);
+    __m128 tmin = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx0, tx1), _mm_min_ps(ty0, ty1)),
+                             _mm_max_ps(_mm_min_ps(tz0, tz1), _mm_setzero_ps()));
+    __m128 tmax = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx0, tx1), _mm_max_ps(ty0, ty1)),
+                             _mm_min_ps(_mm_max_ps(tz0, tz1), _mm_set1_ps(hit.distance)));
+    _mm_store_ps(near, tmin);
+    mask = _mm_movemask_ps(_mm_cmple_ps(tmin, tmax));
+#else
+    for (int slot = 0; slot < 4; slot++) {
+      float tx0  = (node.minX[slot] - origin.x) * inverse.x;
+      float tx1  = (node.maxX[slot] - origin.x) * inverse.x;
+      float ty0  = (node.minY[slot] - origin.y) * inverse.y;
+      float ty1  = (node.maxY[slot] - origin.y) * inverse.y;
+      float tz0  = (node.minZ[slot] - origin.z) * inverse.z;
+      float tz1  = (node.maxZ[slot] - origin.z) * inverse.z;
+      float tmin = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::max(std::min(tz0, tz1), 0.0f));
+      float tmax =
+          std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::min(std::max(tz0, tz1), hit.distance));
+      near[slot] = tmin;
+      mask |= tmin <= tmax ? 1 << slot : 0;
+    }
+#endif
+
+    // Inner children go on the stack farthest first, so the nearest is popped next.
+    std::array<int, 4> order;
+    int                innerCount = 0;
+    for (int slot = 0; slot < 4; slot++) {
+      if ((mask & (1 << slot)) == 0 || node.child[slot] == emptySlot) {
+        continue;
+      }
+      if (node.count[slot] == 0) {
+        order[innerCount++] = slot;
+        continue;
+      }
+      for (uint32_t i = 0; i < node.count[slot]; i++) {
+        uint32_t primitive = primitiveIndices[node.child[slot] + i];
+        if (intersect(primitive, hit.distance)) {
+          hit.primitive = primitive;
+        }
+      }
+    }
+
+    for (int i = 1; i < innerCount; i++) {
+      for (int j = i; j > 0 && near[order[j - 1]] < near[order[j]]; j--) {
+        std::swap(order[j - 1], order[j]);
+      }
+    }
+    for (int i = 0; i < innerCount; i++) {
+      if (near[order[i]] <= hit.distance) {
+        stack[stackSize++] = node.child[order[i]];
+      }
+    }
+  }
+  return hit;
+}
+
+/**
+ * @brief Primitives in leaves whose boxes are not fully outside one of the planes, so a
+ * primitive outside the frustum may still be returned with its leaf neighbours. Subtrees
+ * fully inside every plane are gathered without further tests.
+ *
+ * @param planes xyz inward normal and w distance, as in Graphics::Frustum
+ * @param visible cleared, then filled with primitive indices in no particular order
+ */
+void Bvh::query_frustum(const std::array<glm::vec4, 6>& planes, std::vector<uint32_t>& visible) const
+{
+  visible.clear();
+  if (nodes.empty()) {
+    return;
+  }
+
+  std::array<uint32_t, 256> stack;
+  size_t                    stackSize = 0;
+  stack[stackSize++]                  = 0;
+
+  while (stackSize > 0) {
+    uint32_t    entry  = stack[--stackSize];
+    const Node& node   = nodes[entry & ~insideBit];
+    int         inside = (entry & insideBit) != 0 ? 0xf : 0;
+    int         mask   = inside;
+
+    if (inside == 0) {
+      // The corner farthest along the normal decides outside, the nearest one inside.
+#if defined(__SSE2__)
+      __m128 outsideMask = _mm_setzero_ps();
+      __m128 insideMask  = _mm_castsi128_ps(_mm_set1_epi32(-1));
+      __m128 minX        = _mm_loadu_ps(node.minX);
+      __m128 minY        = _mm_loadu_ps(node.minY);
+      __m128 minZ        = _mm_loadu_ps(node.minZ);
+      __m128 maxX        = _mm_loadu_ps(node.maxX);
+      __m128 maxY        = _mm_loadu_ps(node.maxY);
+      __m128 maxZ        = _mm_loadu_ps(node.maxZ);
+      for (const auto& plane : planes) {
+        __m128 nx = _mm_set1_ps(plane.x);
+        __m128 ny = _mm_set1_ps(plane.y);
+        __m128 nz = _mm_set1_ps(plane.z);
+        __m128 w  = _mm_set1_ps(plane.w);
+
+        __m128 farthest = _mm_mul_ps(nx, plane.x >= 0.0f ? maxX : minX);
+        farthest        = _mm_add_ps(farthest, _mm_mul_ps(ny, plane.y >= 0.0f ? maxY : minY));
+        farthest        = _mm_add_ps(farthest, _mm_mul_ps(nz, plane.z >= 0.0f ? maxZ : minZ));
+        __m128 nearest  = _mm_mul_ps(nx, plane.x >= 0.0f ? minX : maxX);
+        nearest         = _mm_add_ps(nearest, _mm_mul_ps(ny, plane.y >= 0.0f ? minY : maxY));
+        nearest         = _mm_add_ps(nearest, _mm_mul_ps(nz, plane.z >= 0.0f ? minZ : maxZ));
+
+        outsideMask = _mm_or_ps(outsideMask, _mm_cmplt_ps(_mm_add_ps(farthest, w), _mm_setzero_ps()));
+        insideMask  = _mm_and_ps(insideMask, _mm_cmpge_ps(_mm_add_ps(nearest, w), _mm_setzero_ps()));
+      }
+      mask   = ~_mm_movemask_ps(outsideMask) & 0xf;
+      inside = _mm_movemask_ps(insideMask);
+#else
+      inside = 0xf;
+      mask   = 0xf;
+      for (int slot = 0; slot < 4; slot++) {
+        for (const auto& plane : planes) {
+          float farthest = plane.x * (plane.x >= 0.0f ? node.maxX[slot] : node.minX[slot]) +
+                           plane.y * (plane.y >= 0.0f ? node.maxY[slot] : node.minY[slot]) +
+                           plane.z * (plane.z >= 0.0f ? node.maxZ[slot] : node.minZ[slot]);
+          float nearest  = plane.x * (plane.x >= 0.0f ? node.minX[slot] : node.maxX[slot]) +
+                          plane.y * (plane.y >= 0.0f ? node.minY[slot] : node.maxY[slot]) +
+                          plane.z * (plane.z >= 0.0f ? node.minZ[slot] : node.maxZ[slot]);
+          mask &= farthest + plane.w < 0.0f ? ~(1 << slot) : 0xf;
+          inside &= nearest + plane.w >= 0.0f ? 0xf : ~(1 << slot);
+        }
+      }
+#endif
+    }
+
+    for (int slot = 0; slot < 4; slot++) {
+      if ((mask & (1 << slot)) == 0 || node.child[slot] == emptySlot) {
+        continue;
+      }
+      if (node.count[slot] > 0) {
+        visible.insert(visible.end(),
+                       primitiveIndices.begin() + node.child[slot],
+                       primitiveIndices.begin() + node.child[slot] + node.count[slot]);
+      } else {
+        stack[stackSize++] = node.child[slot] | ((inside & (1 << slot)) != 0 ? insideBit : 0);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Expected cost of a random ray relative to testing the root box, one per node
+ * visited plus one per primitive tested. Lower is better.
+ *
+ * @return float
+ */
+float Bvh::sah_cost() const
+{
+  float rootArea = rootBounds.half_area();
+  if (nodes.empty() || rootArea <= 0.0f) {
+    return 0.0f;
+  }
+
+  float cost = 0.0f;
+  for (size_t index = 0; index < nodes.size(); index++) {
+    const Node& node = nodes[index];
+    cost += node_bounds(static_cast<uint32_t>(index)).half_area() / rootArea;
+    for (int slot = 0; slot < 4; slot++) {
+      if (node.child[slot] == emptySlot || node.count[slot] == 0) {
+        continue;
+      }
+      Aabb box;
+      box.minimum = glm::vec3(node.minX[slot], node.minY[slot], node.minZ[slot]);
+      box.maximum = glm::vec3(node.maxX[slot], node.maxY[slot], node.maxZ[slot]);
+      cost += box.half_area() / rootArea * node.count[slot];
+    }
+  }
+  return cost;
+}
+
+/**
+ * @brief Moller-Trumbore, both faces hit
+ *
+ * @param origin
+ * @param direction
+ * @param v0
+ * @param v1
+ * @param v2
+ * @param distance lowered to the hit when it is closer
+ * @return true on a hit closer than distance
+ */
+bool Bvh::intersect_triangle(const glm::vec3& origin,
+                             const glm::vec3& direction,
+                             const glm::vec3& v0,
+                             const glm::vec3& v1,
+                             const glm::vec3& v2,
+                             float&           distance)
+{
+  const float epsilon = 1.0e-8f;
+
+  glm::vec3 edge1       = v1 - v0;
+  glm::vec3 edge2       = v2 - v0;
+  glm::vec3 p           = glm::cross(direction, edge2);
+  float     determinant = glm::dot(edge1, p);
+  if (std::abs(determinant) < epsilon) {
+    return false;
+  }
+
+  float     inverse = 1.0f / determinant;
+  glm::vec3 s       = origin - v0;
+  float     u       = glm::dot(s, p) * inverse;
+  if (u < 0.0f || u > 1.0f) {
+    return false;
+  }
+
+  glm::vec3 q = glm::cross(s, edge1);
+  float     v = glm::dot(direction, q) * inverse;
+  if (v < 0.0f || u + v > 1.0f) {
+    return false;
+  }
+
+  float t = glm::dot(edge2, q) * inverse;
+  if (t <= epsilon || t >= distance) {
+    return false;
+  }
+  distance = t;
+  return true;
+}
+
+/**
+ * @brief Binary SAH node over primitiveIndices[first, first + count)
+ *
+ * @param subtrees when given, small nodes are only reserved and queued here for
+ * build_subtrees()
+ * @return index in buildNodes
+ */
+uint32_t Bvh::build_node(std::vector<BuildNode>& buildNodes,
+                         const BuildInput&       input,
+                         uint32_t                first,
+                         uint32_t                count,
+                         uint32_t                depth,
+                         std::vector<Subtree>*   subtrees)
+{
+  uint32_t index = static_cast<uint32_t>(buildNodes.size());
+  buildNodes.emplace_back();
+
+  if (subtrees != nullptr && count <= parallelSubtree) {
+    subtrees->push_back({index, first, count, depth});
+    return index;
+  }
+
+  Aabb bounds;
+  for (uint32_t i = first; i < first + count; i++) {
+    bounds.grow(input.boxes[primitiveIndices[i]]);
+  }
+  buildNodes[index].bounds = bounds;
+
+  if (count <= 2) {
+    buildNodes[index].first = first;
+    buildNodes[index].count = count;
+    return index;
+  }
+
+  auto     begin  = primitiveIndices.begin() + first;
+  auto     end    = begin + count;
+  uint32_t middle = first + count / 2;
+
+  Split split = depth < maxSahDepth ? find_split(input, first, count) : Split();
+  if (split.axis >= 0) {
+    // Traversal and intersection both cost one, relative to the parent's area.
+    float splitCost = 1.0f + split.cost / std::max(bounds.half_area(), std::numeric_limits<float>::min());
+    if (count <= maxLeafSize && splitCost >= static_cast<float>(count)) {
+      buildNodes[index].first = first;
+      buildNodes[index].count = count;
+      return index;
+    }
+
+    float minimum   = split.centroidBounds.minimum[split.axis];
+    float scale     = binCount / (split.centroidBounds.maximum[split.axis] - minimum);
+    auto  partition = std::partition(begin, end, [&](uint32_t primitive) {
+      return bin_of(input.centroids[primitive][split.axis], minimum, scale) <= split.bin;
+    });
+    middle = static_cast<uint32_t>(partition - primitiveIndices.begin());
+  }
+
+  if (split.axis < 0 || middle == first || middle == first + count) {
+    // Coincident centroids or too deep, split in half along the widest axis.
+    glm::vec3 extent = bounds.maximum - bounds.minimum;
+    int       axis   = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    middle           = first + count / 2;
+    std::nth_element(begin, primitiveIndices.begin() + middle, end, [&](uint32_t a, uint32_t b) {
+      return input.centroids[a][axis] < input.centroids[b][axis];
+    });
+  }
+
+  uint32_t left           = build_node(buildNodes, input, first, middle - first, depth + 1, subtrees);
+  uint32_t right          = build_node(buildNodes, input, middle, first + count - middle, depth + 1, subtrees);
+  buildNodes[index].left  = left;
+  buildNodes[index].right = right;
+  return index;
+}
+
+/**
+ * @brief Build the queued subtrees on the pool, each over its own range of primitive
+ * indices in to its own nodes, then move their nodes in to buildNodes
+ *
+ * @param buildNodes holds a placeholder for the root of every subtree
+ * @param input
+ * @param subtrees
+ */
+void Bvh::build_subtrees(std::vector<BuildNode>& buildNodes, const BuildInput& input, std::vector<Subtree>& subtrees)
+{
+  std::vector<std::vector<BuildNode>> built(subtrees.size());
+  std::vector<std::future<void>>      tasks;
+  for (size_t i = 0; i < subtrees.size(); i++) {
+    tasks.push_back(input.pool->submit([this, &built, &input, &subtrees, i]() {
+      const Subtree& subtree = subtrees[i];
+      built[i].reserve(2 * subtree.count / maxLeafSize + 1);
+      build_node(built[i], input, subtree.first, subtree.count, subtree.depth, nullptr);
+    }));
+  }
+  for (auto& task : tasks) {
+    task.get();
+  }
+
+  // The subtree root takes its placeholder, the other nodes are appended after each other
+  for (size_t i = 0; i < subtrees.size(); i++) {
+    const uint32_t offset = static_cast<uint32_t>(buildNodes.size()) - 1;
+    for (size_t node = 0; node < built[i].size(); node++) {
+      BuildNode moved = built[i][node];
+      if (moved.count == 0) {
+        moved.left += offset;
+        moved.right += offset;
+      }
+      if (node == 0) {
+        buildNodes[subtrees[i].node] = moved;
+      } else {
+        buildNodes.push_back(moved);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Cheapest split between bins of centroids over all three axes
+ *
+ * @return Split with axis -1 when every centroid is in the same place
+ */
+Bvh::Split Bvh::find_split(const BuildInput& input, uint32_t first, uint32_t count) const
+{
+  Split      split;
+  std::mutex mutex;
+  bool       parallel = input.pool != nullptr && count >= parallelBinCount;
+
+  auto run = [&](const std::function<void(size_t, size_t)>& body) {
+    if (parallel) {
+      input.pool->parallel_for(count, body, parallelChunk);
+    } else {
+      body(0, count);
+    }
+  };
+
+  run([&](size_t begin, size_t end) {
+    Aabb local;
+    for (size_t i = begin; i < end; i++) {
+      local.grow(input.centroids[primitiveIndices[first + i]]);
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    split.centroidBounds.grow(local);
+  });
+
+  glm::vec3 extent = split.centroidBounds.maximum - split.centroidBounds.minimum;
+  glm::vec3 scale  = glm::vec3(extent.x > 0.0f ? binCount / extent.x : 0.0f,
+                              extent.y > 0.0f ? binCount / extent.y : 0.0f,
+                              extent.z > 0.0f ? binCount / extent.z : 0.0f);
+
+  Bins bins;
+  run([&](size_t begin, size_t end) {
+    Bins local;
+    for (size_t i = begin; i < end; i++) {
+      uint32_t         primitive = primitiveIndices[first + i];
+      const glm::vec3& centroid  = input.centroids[primitive];
+      for (int axis = 0; axis < 3; axis++) {
+        uint32_t bin = bin_of(centroid[axis], split.centroidBounds.minimum[axis], scale[axis]);
+        local.bounds[axis][bin].grow(input.boxes[primitive]);
+        local.counts[axis][bin]++;
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int axis = 0; axis < 3; axis++) {
+      for (uint32_t bin = 0; bin < binCount; bin++) {
+        bins.bounds[axis][bin].grow(local.bounds[axis][bin]);
+        bins.counts[axis][bin] += local.counts[axis][bin];
+      }
+    }
+  });
+
+  for (int axis = 0; axis < 3; axis++) {
+    if (scale[axis] == 0.0f) {
+      continue;
+    }
+
+    // Sweep from the right to get the cost of everything above each bin.
+    std::array<float, binCount> rightCost = {};
+    Aabb                        rightBox;
+    uint32_t                    rightCount = 0;
+    for (uint32_t bin = binCount - 1; bin > 0; bin--) {
+      rightBox.grow(bins.bounds[axis][bin]);
+      rightCount += bins.counts[axis][bin];
+      rightCost[bin - 1] = rightBox.half_area() * rightCount;
+    }
+
+    Aabb     leftBox;
+    uint32_t leftCount = 0;
+    for (uint32_t bin = 0; bin + 1 < binCount; bin++) {
+      leftBox.grow(bins.bounds[axis][bin]);
+      leftCount += bins.counts[axis][bin];
+      float cost = leftBox.half_area() * leftCount + rightCost[bin];
+      if (leftCount > 0 && leftCount < count && cost < split.cost) {
+        split.axis = axis;
+        split.bin  = bin;
+        split.cost = cost;
+      }
+    }
+  }
+  return split;
+}
+
+/**
+ * @brief Turn a binary subtree in to four wide nodes by repeatedly opening the child
+ * with the largest surface
+ *
+ * @return index of the new node
+ */
+uint32_t Bvh::flatten(const std::vector<BuildNode>& buildNodes, uint32_t buildIndex)
+{
+  uint32_t index = static_cast<uint32_t>(nodes.size());
+  nodes.emplace_back();
+
+  std::array<uint32_t, 4> children;
+  int                     childCount = 0;
+  const BuildNode&        root       = buildNodes[buildIndex];
+  if (root.count > 0) {
+    children[childCount++] = buildIndex;
+  } else {
+    children[childCount++] = root.left;
+    children[childCount++] = root.right;
+  }
+
+  while (childCount < 4) {
+    int   largest = -1;
+    float area    = -1.0f;
+    for (int i = 0; i < childCount; i++) {
+      const BuildNode& child = buildNodes[children[i]];
+      if (child.count == 0 && child.bounds.half_area() > area) {
+        largest = i;
+        area    = child.bounds.half_area();
+      }
+    }
+    if (largest < 0) {
+      break;
+    }
+    const BuildNode& opened = buildNodes[children[largest]];
+    children[largest]       = opened.left;
+    children[childCount++]  = opened.right;
+  }
+
+  Node node = {};
+  for (int slot = 0; slot < 4; slot++) {
+    Aabb box;
+    node.child[slot] = emptySlot;
+    node.count[slot] = 0;
+    if (slot < childCount) {
+      const BuildNode& child = buildNodes[children[slot]];
+      box                    = child.bounds;
+      node.child[slot]       = child.first;
+      node.count[slot]       = child.count;
+    }
+    node.minX[slot] = box.minimum.x;
+    node.minY[slot] = box.minimum.y;
+    node.minZ[slot] = box.minimum.z;
+    node.maxX[slot] = box.maximum.x;
+    node.maxY[slot] = box.maximum.y;
+    node.maxZ[slot] = box.maximum.z;
+  }
+  nodes[index] = node;
+
+  for (int slot = 0; slot < childCount; slot++) {
+    if (buildNodes[children[slot]].count == 0) {
+      uint32_t child           = flatten(buildNodes, children[slot]);
+      nodes[index].child[slot] = child;
+    }
+  }
+  return index;
+}
+
+/**
+ * @brief
+ *
+ * @param node
+ * @return union of the node's child boxes
+ */
+Aabb Bvh::node_bounds(uint32_t node) const
+{
+  const Node& n = nodes[node];
+  Aabb        box;
+  for (int slot = 0; slot < 4; slot++) {
+    if (n.child[slot] != emptySlot) {
+      box.grow(glm::vec3(n.minX[slot], n.minY[slot], n.minZ[slot]));
+      box.grow(glm::vec3(n.maxX[slot], n.maxY[slot], n.maxZ[slot]));
+    }
+  }
+  return box;
+}
+
+}}  // namespace Rake::Scene
@@ -0,0 +1,142 @@
+#if !defined(BVH_H)
+#define BVH_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace Rake { namespace Base {
+class ThreadPool;
+}}  // namespace Rake::Base
+
+namespace Rake { namespace Scene {
+
+/**
+ * @brief Axis aligned box, empty boxes have minimum above maximum
+ */
+struct Aabb {
+  glm::vec3 minimum = glm::vec3(std::numeric_limits<float>::max());
+  glm::vec3 maximum = glm::vec3(std::numeric_limits<float>::lowest());
+
+  void grow(const glm::vec3& point)
+  {
+    minimum = glm::min(minimum, point);
+    maximum = glm::max(maximum, point);
+  }
+  void grow(const Aabb& box)
+  {
+    minimum = glm::min(minimum, box.minimum);
+    maximum = glm::max(maximum, box.maximum);
+  }
+
+  glm::vec3 center() const { return 0.5f * (minimum + maximum); }
+  float     half_area() const;
+};
+
+/**
+ * @brief Closest hit found by Bvh::raycast()
+ */
+struct RayHit {
+  uint32_t primitive = UINT32_MAX;  // UINT32_MAX when nothing was hit
+  float    distance  = std::numeric_limits<float>::max();
+};
+
+/**
+ * @brief Bounding volume hierarchy over boxes, built with a binned surface area
+ * heuristic and flattened to four wide nodes whose child boxes are stored as
+ * structure of arrays, so a ray or frustum is tested against all four at once.
+ *
+ * Nodes are in depth first order, a node's children always come after it. Primitives
+ * are referred to by their index in the array given to build().
+ */
+class Bvh {
+  public:
+  // Narrow phase for raycast(), returns true and lowers distance when the ray hits closer.
+  using Intersect = std::function<bool(uint32_t primitive, float& distance)>;
+
+  struct Node {
+    float    minX[4];
+    float    minY[4];
+    float    minZ[4];
+    float    maxX[4];
+    float    maxY[4];
+    float    maxZ[4];
+    uint32_t child[4];  // Node index, or first entry in the primitive list for a leaf
+    uint32_t count[4];  // Primitives in a leaf, 0 for an inner node or an empty slot
+  };
+
+  void build(const std::vector<Aabb>& primitives, Base::ThreadPool* pool = nullptr);
+  void refit(const std::vector<Aabb>& primitives);
+
+  RayHit raycast(const glm::vec3& origin,
+                 const glm::vec3& direction,
+                 float            maxDistance,
+                 const Intersect& intersect) const;
+  void   query_frustum(const std::array<glm::vec4, 6>& planes, std::vector<uint32_t>& visible) const;
+
+  bool        empty() const { return nodes.empty(); }
+  size_t      node_count() const { return nodes.size(); }
+  const Aabb& bounds() const { return rootBounds; }
+  float       sah_cost() const;
+
+  static bool intersect_triangle(const glm::vec3& origin,
+                                 const glm::vec3& direction,
+                                 const glm::vec3& v0,
+                                 const glm::vec3& v1,
+                                 const glm::vec3& v2,
+                                 float&           distance);
+
+  private:
+  struct BuildNode {
+    Aabb     bounds;
+    uint32_t left  = 0;  // Children, valid when count is 0
+    uint32_t right = 0;
+    uint32_t first = 0;
+    uint32_t count = 0;
+  };
+
+  struct BuildInput {
+    const std::vector<Aabb>& boxes;
+    std::vector<glm::vec3>   centroids;
+    Base::ThreadPool*        pool;
+  };
+
+  // Subtree left to a pool task, built in to its own nodes and spliced in afterwards
+  struct Subtree {
+    uint32_t node;  // Placeholder in buildNodes its root replaces
+    uint32_t first;
+    uint32_t count;
+    uint32_t depth;
+  };
+
+  struct Split {
+    int      axis  = -1;
+    uint32_t bin   = 0;
+    float    cost  = std::numeric_limits<float>::max();
+    Aabb     centroidBounds;
+  };
+
+  uint32_t build_node(std::vector<BuildNode>& buildNodes,
+                      const BuildInput&       input,
+                      uint32_t                first,
+                      uint32_t                count,
+                      uint32_t                depth,
+                      std::vector<Subtree>*   subtrees);
+  void     build_subtrees(std::vector<BuildNode>& buildNodes, const BuildInput& input, std::vector<Subtree>& subtrees);
+  Split    find_split(const BuildInput& input, uint32_t first, uint32_t count) const;
+  uint32_t flatten(const std::vector<BuildNode>& buildNodes, uint32_t buildIndex);
+  Aabb     node_bounds(uint32_t node) const;
+
+  std::vector<Node>     nodes;
+  std::vector<uint32_t> primitiveIndices;  // Leaves point in to this list
+  Aabb                  rootBounds;
+};
+
+}}  // namespace Rake::Scene
+
+#endif  // BVH_H
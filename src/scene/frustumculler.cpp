@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RAKE_X86_SIMD
+#endif
+
+#include "scene/frustumculler.h"
+
+namespace Rake { namespace Scene {
+
+/**
+ * @brief
+ *
+ * @param level clamped to what this CPU supports
+ */
+FrustumCuller::FrustumCuller(Base::SimdLevel level) : simdLevel(std::min(level, Base::best_simd_level())) {}
+
+/**
+ * @brief Existing spheres keep their values, new ones are empty until set
+ *
+ * @param count
+ */
+void FrustumCuller::resize(size_t count)
+{
+  if (count > UINT32_MAX) {
+    throw std::runtime_error("Too many spheres for 32 bit visible indices!");
+  }
+  centerX.resize(count);
+  centerY.resize(count);
+  centerZ.resize(count);
+  radius.resize(count);
+  visibleIndices.resize(count);
+}
+
+/**
+ * @brief
+ *
+ * @param index
+ * @param center world space
+ * @param sphereRadius
+ */
+void FrustumCuller::set_sphere(size_t index, const glm::vec3& center, float sphereRadius)
+{
+  centerX[index] = center.x;
+  centerY[index] = center.y;
+  centerZ[index] = center.z;
+  radius[index]  = sphereRadius;
+}
+
+/**
+ * @brief Move a mesh space sphere to world space, the radius grows with the largest
+ * axis scale so the sphere stays conservative under non uniform scaling
+ *
+ * @param index
+ * @param model
+ * @param localSphere xyz centre and w radius
+ */
+void FrustumCuller::set_sphere(size_t index, const glm::mat4& model, const glm::vec4& localSphere)
+{
+  glm::vec4 center = model * glm::vec4(glm::vec3(localSphere), 1.0f);
+  float     scale  = std::max(std::max(glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1]))),
+                          glm::length(glm::vec3(model[2])));
+
+  set_sphere(index, glm::vec3(center), localSphere.w * scale);
+}
+
+/**
+ * @brief Test every sphere, the survivors are read through visible()
+ *
+ * @param planes
+ * @return number of visible spheres
+ */
+size_t FrustumCuller::cull(const std::array<glm::vec4, 6>& planes)
+{
+  switch (simdLevel) {
+    case Base::SimdLevel::Avx2:
+      return cull_avx2(planes);
+    case Base::SimdLevel::Sse:
+      return cull_sse(planes);
+    default:
+      return cull_scalar(planes, 0, 0);
+  }
+}
+
+/**
+ * @brief Also finishes the spheres left over after the last full SIMD block
+ *
+ * @param planes
+ * @param begin first sphere to test
+ * @param visibleCount spheres already written to visibleIndices
+ * @return number of visible spheres
+ */
+size_t FrustumCuller::cull_scalar(const std::array<glm::vec4, 6>& planes, size_t begin, size_t visibleCount)
+{
+  for (size_t i = begin; i < radius.size(); i++) {
+    bool inside = true;
+    for (const auto& plane : planes) {
+      float distance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+      inside         = inside && !(distance < -radius[i]);
+    }
+    visibleIndices[visibleCount] = static_cast<uint32_t>(i);
+    visibleCount += inside ? 1 : 0;
+  }
+  return visibleCount;
+}
+
+#if defined(RAKE_X86_SIMD)
+/**
+ * @brief Four spheres per iteration. Products are summed in the same order as the
+ * scalar path without fused multiply-add, so every level culls the same spheres.
+ *
+ * @param planes
+ * @return number of visible spheres
+ */
+__attribute__((target("sse2"))) size_t FrustumCuller::cull_sse(const std::array<glm::vec4, 6>& planes)
+{
+  const size_t blockEnd     = radius.size() & ~size_t(3);
+  size_t       visibleCount = 0;
+
+  for (size_t i = 0; i < blockEnd; i += 4) {
+    __m128 x         = _mm_loadu_ps(&centerX[i]);
+    __m128 y         = _mm_loadu_ps(&centerY[i]);
+    __m128 z         = _mm_loadu_ps(&centerZ[i]);
+    __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&radius[i]));
+    __m128 inside    = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+    for (const auto& plane : planes) {
+      __m128 distance = _mm_mul_ps(x, _mm_set1_ps(plane.x));
+      distance        = _mm_add_ps(distance, _mm_mul_ps(y, _mm_set1_ps(plane.y)));
+      distance        = _mm_add_ps(distance, _mm_mul_ps(z, _mm_set1_ps(plane.z)));
+      distance        = _mm_add_ps(distance, _mm_set1_ps(plane.w));
+      inside          = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+    }
+
+    for (int mask = _mm_movemask_ps(inside); mask != 0; mask &= mask - 1) {
+      visibleIndices[visibleCount++] = static_cast<uint32_t>(i + __builtin_ctz(mask));
+    }
+  }
+  return cull_scalar(planes, blockEnd, visibleCount);
+}
+
+/**
+ * @brief Eight spheres per iteration
+ *
+ * @param planes
+ * @return number of visible spheres
+ */
+__attribute__((target("avx2"))) size_t FrustumCuller::cull_avx2(const std::array<glm::vec4, 6>& planes)
+{
+  const size_t blockEnd     = radius.size() & ~size_t(7);
+  size_t       visibleCount = 0;
+
+  for (size_t i = 0; i < blockEnd; i += 8) {
+    __m256 x         = _mm256_loadu_ps(&centerX[i]);
+    __m256 y         = _mm256_loadu_ps(&centerY[i]);
+    __m256 z         = _mm256_loadu_ps(&centerZ[i]);
+    __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&radius[i]));
+    __m256 inside    = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+    for (const auto& plane : planes) {
+      __m256 distance = _mm256_mul_ps(x, _mm256_set1_ps(plane.x));
+      distance        = _mm256_add_ps(distance, _mm256_mul_ps(y, _mm256_set1_ps(plane.y)));
+      distance        = _mm256_add_ps(distance, _mm256_mul_ps(z, _mm256_set1_ps(plane.z)));
+      distance        = _mm256_add_ps(distance, _mm256_set1_ps(plane.w));
+      inside          = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+    }
+
+    for (int mask = _mm256_movemask_ps(inside); mask != 0; mask &= mask - 1) {
+      visibleIndices[visibleCount++] = static_cast<uint32_t>(i + __builtin_ctz(mask));
+    }
+  }
+  return cull_scalar(planes, blockEnd, visibleCount);
+}
+#else
+size_t FrustumCuller::cull_sse(const std::array<glm::vec4, 6>& planes)
+{
+  return cull_scalar(planes, 0, 0);
+}
+
+size_t FrustumCuller::cull_avx2(const std::array<glm::vec4, 6>& planes)
+{
+  return cull_scalar(planes, 0, 0);
+}
+#endif
+
+}}  // namespace Rake::Scene
@@ -0,0 +1,52 @@
+#if !defined(FRUSTUMCULLER_H)
+#define FRUSTUMCULLER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "skeleton/simd.h"
+
+namespace Rake { namespace Scene {
+
+/**
+ * @brief World space bounding spheres kept as separate x, y, z and radius arrays so the
+ * six plane tests run on four or eight spheres at once. cull() writes the indices of
+ * the spheres that are not fully outside a plane, in increasing order.
+ *
+ * Planes are xyz inward normal and w distance, the same as Graphics::Frustum.
+ */
+class FrustumCuller {
+  public:
+  explicit FrustumCuller(Base::SimdLevel level = Base::best_simd_level());
+
+  void   resize(size_t count);
+  size_t size() const { return radius.size(); }
+
+  void set_sphere(size_t index, const glm::vec3& center, float sphereRadius);
+  void set_sphere(size_t index, const glm::mat4& model, const glm::vec4& localSphere);
+
+  size_t          cull(const std::array<glm::vec4, 6>& planes);
+  const uint32_t* visible() const { return visibleIndices.data(); }
+
+  Base::SimdLevel level() const { return simdLevel; }
+
+  private:
+  size_t cull_scalar(const std::array<glm::vec4, 6>& planes, size_t begin, size_t visibleCount);
+  size_t cull_sse(const std::array<glm::vec4, 6>& planes);
+  size_t cull_avx2(const std::array<glm::vec4, 6>& planes);
+
+  Base::SimdLevel       simdLevel;
+  std::vector<float>    centerX;
+  std::vector<float>    centerY;
+  std::vector<float>    centerZ;
+  std::vector<float>    radius;
+  std::vector<uint32_t> visibleIndices;  // Sized to the sphere count, cull() fills the front
+};
+
+}}  // namespace Rake::Scene
+
+#endif  // FRUSTUMCULLER_H
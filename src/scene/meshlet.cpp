@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "scene/meshlet.h"
+
+namespace Rake { namespace Scene {
+
+namespace {
+constexpr uint32_t noMeshlet   = UINT32_MAX;
+constexpr float    minConeSpan = 0.1f;  // Cosine of the widest normal spread a cone still culls
+
+/**
+ * @brief Bounding sphere around the box of the meshlet's vertices and its normal cone
+ *
+ * @param points
+ * @param indices the meshlet's triangles
+ * @param meshlet firstIndex and indexCount set, the bounds are written
+ */
+void compute_meshlet_bounds(const std::vector<glm::vec3>& points, const uint32_t* indices, Meshlet& meshlet)
+{
+  glm::vec3 minimum = points[indices[0]];
+  glm::vec3 maximum = minimum;
+  for (uint32_t i = 1; i < meshlet.indexCount; i++) {
+    minimum = glm::min(minimum, points[indices[i]]);
+    maximum = glm::max(maximum, points[indices[i]]);
+  }
+
+  glm::vec3 center = 0.5f * (minimum + maximum);
+  float     radius = 0.0f;
+  for (uint32_t i = 0; i < meshlet.indexCount; i++) {
+    radius = std::max(radius, glm::length(points[indices[i]] - center));
+  }
+  meshlet.sphere = glm::vec4(center, radius);
+
+  std::vector<glm::vec3> normals;
+  glm::vec3              axis = glm::vec3(0.0f);
+  for (uint32_t i = 0; i < meshlet.indexCount; i += 3) {
+    const glm::vec3& p0     = points[indices[i]];
+    glm::vec3        normal = glm::cross(points[indices[i + 1]] - p0, points[indices[i + 2]] - p0);
+    float            length = glm::length(normal);
+    normals.push_back(length > 0.0f ? normal / length : glm::vec3(0.0f));
+    axis += normals.back();
+  }
+
+  // Left at the default cutoff of 1 the cone never culls.
+  float axisLength = glm::length(axis);
+  if (axisLength <= 0.0f) {
+    return;
+  }
+  axis /= axisLength;
+
+  float span = 1.0f;
+  for (const auto& normal : normals) {
+    if (normal != glm::vec3(0.0f)) {
+      span = std::min(span, glm::dot(axis, normal));
+    }
+  }
+  if (span <= minConeSpan) {
+    return;
+  }
+
+  // The apex is the point along the axis behind every triangle's plane, from there a
+  // direction inside the cone sees only back faces.
+  float apexDistance = 0.0f;
+  for (uint32_t i = 0, t = 0; i < meshlet.indexCount; i += 3, t++) {
+    if (normals[t] == glm::vec3(0.0f)) {
+      continue;
+    }
+    float toCenter = glm::dot(center - points[indices[i]], normals[t]);
+    apexDistance   = std::max(apexDistance, toCenter / glm::dot(axis, normals[t]));
+  }
+
+  meshlet.coneApex   = center - axis * apexDistance;
+  meshlet.coneAxis   = axis;
+  meshlet.coneCutoff = std::sqrt(1.0f - span * span);
+}
+}  // namespace
+
+std::vector<Meshlet> build_meshlets(const PositionStream&  positions,
+                                    std::vector<uint32_t>& indices,
+                                    uint32_t               firstIndex,
+                                    uint32_t               indexCount,
+                                    uint32_t               maxVertices,
+                                    uint32_t               maxTriangles)
+{
+  const uint32_t  vertexCount   = static_cast<uint32_t>(positions.count);
+  const uint32_t  triangleCount = indexCount / 3;
+  const uint32_t* source        = indices.data() + firstIndex;
+
+  std::vector<glm::vec3> points(vertexCount);
+  for (uint32_t v = 0; v < vertexCount; v++) {
+    std::memcpy(&points[v], reinterpret_cast<const char*>(positions.data) + v * positions.stride, sizeof(glm::vec3));
+  }
+
+  // Triangles around each vertex.
+  std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+  for (uint32_t i = 0; i < 3 * triangleCount; i++) {
+    firstTriangle[source[i] + 1]++;
+  }
+  for (uint32_t v = 0; v < vertexCount; v++) {
+    firstTriangle[v + 1] += firstTriangle[v];
+  }
+  std::vector<uint32_t> triangles(3 * triangleCount);
+  std::vector<uint32_t> cursor(firstTriangle.begin(), firstTriangle.end() - 1);
+  for (uint32_t t = 0; t < triangleCount; t++) {
+    for (uint32_t c = 0; c < 3; c++) {
+      triangles[cursor[source[3 * t + c]]++] = t;
+    }
+  }
+
+  std::vector<uint8_t>  emitted(triangleCount, 0);
+  std::vector<uint32_t> vertexMeshlet(vertexCount, noMeshlet);
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> reordered;
+  std::vector<Meshlet>  meshlets;
+  reordered.reserve(3 * triangleCount);
+
+  auto new_vertices = [&](uint32_t t, uint32_t meshlet) {
+    uint32_t count = 0;
+    for (uint32_t c = 0; c < 3; c++) {
+      count += vertexMeshlet[source[3 * t + c]] != meshlet;
+    }
+    return count;
+  };
+
+  // Grow each meshlet from the first unused triangle, always taking the neighbour that
+  // adds the fewest new vertices, earlier neighbours first so the cluster stays round.
+  uint32_t seed = 0;
+  while (true) {
+    while (seed < triangleCount && emitted[seed]) {
+      seed++;
+    }
+    if (seed == triangleCount) {
+      break;
+    }
+
+    uint32_t id = static_cast<uint32_t>(meshlets.size());
+    Meshlet  meshlet;
+    meshlet.firstIndex = firstIndex + static_cast<uint32_t>(reordered.size());
+    candidates.assign(1, seed);
+
+    while (meshlet.indexCount / 3 < maxTriangles) {
+      uint32_t best      = noMeshlet;
+      uint32_t bestAdded = 4;
+      size_t   live      = 0;
+      for (uint32_t t : candidates) {
+        if (emitted[t]) {
+          continue;
+        }
+        candidates[live++] = t;
+        uint32_t added     = new_vertices(t, id);
+        if (added < bestAdded && meshlet.vertexCount + added <= maxVertices) {
+          best      = t;
+          bestAdded = added;
+        }
+      }
+      candidates.resize(live);
+      if (best == noMeshlet) {
+        break;
+      }
+
+      emitted[best] = 1;
+      for (uint32_t c = 0; c < 3; c++) {
+        uint32_t vertex = source[3 * best + c];
+        reordered.push_back(vertex);
+        if (vertexMeshlet[vertex] != id) {
+          vertexMeshlet[vertex] = id;
+          meshlet.vertexCount++;
+          for (uint32_t i = firstTriangle[vertex]; i < firstTriangle[vertex + 1]; i++) {
+            if (!emitted[triangles[i]]) {
+              candidates.push_back(triangles[i]);
+            }
+          }
+        }
+      }
+      meshlet.indexCount += 3;
+    }
+
+    meshlets.push_back(meshlet);
+  }
+
+  std::copy(reordered.begin(), reordered.end(), indices.begin() + firstIndex);
+  for (auto& meshlet : meshlets) {
+    compute_meshlet_bounds(points, indices.data() + meshlet.firstIndex, meshlet);
+  }
+  return meshlets;
+}
+
+bool cone_culled(const Meshlet& meshlet, const glm::vec3& cameraPosition)
+{
+  if (meshlet.coneCutoff >= 1.0f) {
+    return false;
+  }
+  glm::vec3 view     = meshlet.coneApex - cameraPosition;
+  float     distance = glm::length(view);
+  return distance > 0.0f && glm::dot(view, meshlet.coneAxis) >= meshlet.coneCutoff * distance;
+}
+
+}}  // namespace Rake::Scene
@@ -0,0 +1,59 @@
+#if !defined(MESHLET_H)
+#define MESHLET_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "scene/simplify.h"
+
+namespace Rake { namespace Scene {
+
+/**
+ * @brief A small cluster of triangles, a contiguous range of the index buffer, with the
+ * bounds needed to cull it on its own
+ */
+struct Meshlet {
+  uint32_t  firstIndex  = 0;
+  uint32_t  indexCount  = 0;
+  uint32_t  vertexCount = 0;  // Distinct vertices the triangles use
+  glm::vec4 sphere      = glm::vec4(0.0f);  // Mesh space, xyz centre and w radius
+  glm::vec3 coneApex    = glm::vec3(0.0f);
+  glm::vec3 coneAxis    = glm::vec3(0.0f, 0.0f, 1.0f);
+  float     coneCutoff  = 1.0f;  // Sine of the cone angle, 1 when the normals spread too far to cull
+};
+
+/**
+ * @brief Reorder the triangles of indices[firstIndex, firstIndex + indexCount) so they
+ * form meshlets of neighbouring triangles, and describe each meshlet. The triangles and
+ * their winding are unchanged, only their order.
+ *
+ * @param positions
+ * @param indices
+ * @param firstIndex
+ * @param indexCount
+ * @param maxVertices per meshlet
+ * @param maxTriangles per meshlet
+ * @return the meshlets in index buffer order
+ */
+std::vector<Meshlet> build_meshlets(const PositionStream&  positions,
+                                    std::vector<uint32_t>& indices,
+                                    uint32_t               firstIndex,
+                                    uint32_t               indexCount,
+                                    uint32_t               maxVertices  = 64,
+                                    uint32_t               maxTriangles = 124);
+
+/**
+ * @brief Every triangle of the meshlet faces away from a camera at this position, in the
+ * meshlet's space. The same test cull_clusters.comp runs.
+ *
+ * @param meshlet
+ * @param cameraPosition
+ * @return true when the meshlet can be skipped
+ */
+bool cone_culled(const Meshlet& meshlet, const glm::vec3& cameraPosition);
+
+}}  // namespace Rake::Scene
+
+#endif  // MESHLET_H
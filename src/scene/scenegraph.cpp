@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+#include "scene/scenegraph.h"
+#include "skeleton/threadpool.h"
+
+namespace Rake { namespace Scene {
+
+namespace {
+// Levels smaller than this are not worth handing to the pool.
+constexpr size_t parallelLevelSize = 16384;
+constexpr size_t parallelChunkSize = 4096;
+}  // namespace
+
+/**
+ * @brief
+ *
+ * @param count
+ */
+void SceneGraph::reserve(size_t count)
+{
+  translations.reserve(count);
+  rotations.reserve(count);
+  scales.reserve(count);
+  worlds.reserve(count);
+  parents.reserve(count);
+  depths.reserve(count);
+  flags.reserve(count);
+  nodes.reserve(count);
+  slots.reserve(count);
+}
+
+/**
+ * @brief Remove every node, the storage is kept for reuse
+ */
+void SceneGraph::clear()
+{
+  translations.clear();
+  rotations.clear();
+  scales.clear();
+  worlds.clear();
+  parents.clear();
+  depths.clear();
+  flags.clear();
+  nodes.clear();
+  slots.clear();
+  levelOffsets.clear();
+  unsorted = false;
+  dirty    = false;
+}
+
+/**
+ * @brief New nodes have an identity local transform
+ *
+ * @param parent must already exist, invalidNode for a root
+ * @return NodeId
+ */
+NodeId SceneGraph::create_node(NodeId parent)
+{
+  if (parent != invalidNode && parent >= slots.size()) {
+    throw std::runtime_error("Scene node parent does not exist!");
+  }
+  if (slots.size() >= invalidNode) {
+    throw std::runtime_error("Too many scene nodes!");
+  }
+
+  NodeId   node        = static_cast<NodeId>(slots.size());
+  uint32_t parentSlot  = parent == invalidNode ? invalidNode : slots[parent];
+  uint32_t parentDepth = parent == invalidNode ? 0 : depths[parentSlot] + 1;
+
+  // Appending keeps the depth order unless this node is shallower than the last one.
+  unsorted = unsorted || (!depths.empty() && parentDepth < depths.back());
+
+  slots.push_back(static_cast<uint32_t>(parents.size()));
+  translations.push_back(glm::vec3(0.0f));
+  rotations.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+  scales.push_back(glm::vec3(1.0f));
+  worlds.push_back(glm::mat4(1.0f));
+  parents.push_back(parentSlot);
+  depths.push_back(parentDepth);
+  flags.push_back(LocalDirty);
+  nodes.push_back(node);
+  dirty = true;
+  return node;
+}
+
+/**
+ * @brief
+ *
+ * @param node
+ * @param translation
+ */
+void SceneGraph::set_translation(NodeId node, const glm::vec3& translation)
+{
+  translations[slots[node]] = translation;
+  mark_dirty(slots[node]);
+}
+
+/**
+ * @brief
+ *
+ * @param node
+ * @param rotation unit quaternion
+ */
+void SceneGraph::set_rotation(NodeId node, const glm::quat& rotation)
+{
+  rotations[slots[node]] = rotation;
+  mark_dirty(slots[node]);
+}
+
+/**
+ * @brief
+ *
+ * @param node
+ * @param scale
+ */
+void SceneGraph::set_scale(NodeId node, const glm::vec3& scale)
+{
+  scales[slots[node]] = scale;
+  mark_dirty(slots[node]);
+}
+
+/**
+ * @brief
+ *
+ * @param node
+ * @return invalidNode for a root
+ */
+NodeId SceneGraph::parent(NodeId node) const
+{
+  uint32_t parentSlot = parents[slots[node]];
+  return parentSlot == invalidNode ? invalidNode : nodes[parentSlot];
+}
+
+/**
+ * @brief Recompute the world matrix of every node whose local transform changed and of
+ * everything below it. Levels run one after another, the nodes of a level are split
+ * across the pool when there are enough of them.
+ *
+ * @param pool optional, must not be called from one of its workers
+ * @return number of world matrices recomputed
+ */
+size_t SceneGraph::update(Base::ThreadPool* pool)
+{
+  if (unsorted) {
+    sort_by_depth();
+  }
+  if (!dirty) {
+    return 0;
+  }
+
+  if (levelOffsets.empty() || levelOffsets.back() != parents.size()) {
+    levelOffsets.clear();
+    for (size_t slot = 0; slot < depths.size(); slot++) {
+      if (slot == 0 || depths[slot] != depths[slot - 1]) {
+        levelOffsets.push_back(slot);
+      }
+    }
+    levelOffsets.push_back(parents.size());
+  }
+
+  size_t updated = 0;
+  for (size_t level = 0; level + 1 < levelOffsets.size(); level++) {
+    size_t begin = levelOffsets[level];
+    size_t count = levelOffsets[level + 1] - begin;
+
+    if (pool == nullptr || count < parallelLevelSize) {
+      updated += update_range(begin, begin + count);
+      continue;
+    }
+
+    std::atomic<size_t> levelUpdated(0);
+    pool->parallel_for(
+        count,
+        [this, begin, &levelUpdated](size_t first, size_t last) {
+          levelUpdated += update_range(begin + first, begin + last);
+        },
+        parallelChunkSize);
+    updated += levelUpdated;
+  }
+
+  dirty = false;
+  return updated;
+}
+
+/**
+ * @brief
+ *
+ * @param slot
+ */
+void SceneGraph::mark_dirty(uint32_t slot)
+{
+  flags[slot] |= LocalDirty;
+  dirty = true;
+}
+
+/**
+ * @brief Stable sort of every array by depth, parents keep coming before children
+ */
+void SceneGraph::sort_by_depth()
+{
+  std::vector<uint32_t> order(parents.size());
+  for (uint32_t slot = 0; slot < order.size(); slot++) {
+    order[slot] = slot;
+  }
+  std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return depths[a] < depths[b]; });
+
+  std::vector<uint32_t> newSlots(order.size());
+  for (uint32_t slot = 0; slot < order.size(); slot++) {
+    newSlots[order[slot]] = slot;
+  }
+
+  auto permute = [&order](auto& values) {
+    auto sorted = values;
+    for (size_t slot = 0; slot < order.size(); slot++) {
+      sorted[slot] = values[order[slot]];
+    }
+    values.swap(sorted);
+  };
+  permute(translations);
+  permute(rotations);
+  permute(scales);
+  permute(worlds);
+  permute(parents);
+  permute(depths);
+  permute(flags);
+  permute(nodes);
+
+  for (auto& parentSlot : parents) {
+    parentSlot = parentSlot == invalidNode ? invalidNode : newSlots[parentSlot];
+  }
+  for (size_t slot = 0; slot < nodes.size(); slot++) {
+    slots[nodes[slot]] = static_cast<uint32_t>(slot);
+  }
+
+  // Moved nodes need new world matrices, and their level offsets change.
+  std::fill(flags.begin(), flags.end(), LocalDirty);
+  levelOffsets.clear();
+  unsorted = false;
+  dirty    = true;
+}
+
+/**
+ * @brief Update slots of a single level. The flags of every slot are rewritten, so the
+ * next level only sees changes made by this update.
+ *
+ * @param begin
+ * @param end
+ * @return number of world matrices recomputed
+ */
+size_t SceneGraph::update_range(size_t begin, size_t end)
+{
+  size_t updated = 0;
+  for (size_t slot = begin; slot < end; slot++) {
+    uint32_t parentSlot    = parents[slot];
+    bool     parentChanged = parentSlot != invalidNode && (flags[parentSlot] & WorldChanged) != 0;
+
+    if ((flags[slot] & LocalDirty) == 0 && !parentChanged) {
+      flags[slot] = 0;
+      continue;
+    }
+
+    glm::mat4 local = glm::mat4_cast(rotations[slot]);
+    local[0] *= scales[slot].x;
+    local[1] *= scales[slot].y;
+    local[2] *= scales[slot].z;
+    local[3] = glm::vec4(translations[slot], 1.0f);
+
+    worlds[slot] = parentSlot == invalidNode ? local : worlds[parentSlot] * local;
+    flags[slot]  = WorldChanged;
+    updated++;
+  }
+  return updated;
+}
+
+}}  // namespace Rake::Scene
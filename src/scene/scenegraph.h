@@ -0,0 +1,78 @@
+#if !defined(SCENEGRAPH_H)
+#define SCENEGRAPH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace Rake { namespace Base {
+class ThreadPool;
+}}  // namespace Rake::Base
+
+namespace Rake { namespace Scene {
+
+using NodeId = uint32_t;
+
+const NodeId invalidNode = UINT32_MAX;
+
+/**
+ * @brief Transform hierarchy kept as flat arrays, one entry per node for each of
+ * translation, rotation, scale, world matrix, parent and flags.
+ *
+ * Nodes are stored grouped by depth, so every parent comes before its children and the
+ * nodes of one level can be updated in parallel. A NodeId stays valid until clear(),
+ * creating nodes out of depth order only costs a reorder on the next update().
+ */
+class SceneGraph {
+  public:
+  void   reserve(size_t count);
+  void   clear();
+  size_t size() const { return parents.size(); }
+
+  NodeId create_node(NodeId parent = invalidNode);
+
+  void set_translation(NodeId node, const glm::vec3& translation);
+  void set_rotation(NodeId node, const glm::quat& rotation);
+  void set_scale(NodeId node, const glm::vec3& scale);
+
+  const glm::vec3& translation(NodeId node) const { return translations[slots[node]]; }
+  const glm::quat& rotation(NodeId node) const { return rotations[slots[node]]; }
+  const glm::vec3& scale(NodeId node) const { return scales[slots[node]]; }
+  const glm::mat4& world(NodeId node) const { return worlds[slots[node]]; }
+  NodeId           parent(NodeId node) const;
+  uint32_t         depth(NodeId node) const { return depths[slots[node]]; }
+
+  size_t update(Base::ThreadPool* pool = nullptr);
+
+  private:
+  enum Flags : uint8_t {
+    LocalDirty   = 1 << 0,  // A local transform was set since the last update
+    WorldChanged = 1 << 1,  // The world matrix was recomputed by the last update
+  };
+
+  void   mark_dirty(uint32_t slot);
+  void   sort_by_depth();
+  size_t update_range(size_t begin, size_t end);
+
+  // Indexed by storage slot, sorted by depth.
+  std::vector<glm::vec3> translations;
+  std::vector<glm::quat> rotations;
+  std::vector<glm::vec3> scales;
+  std::vector<glm::mat4> worlds;
+  std::vector<uint32_t>  parents;  // Slot of the parent, invalidNode for roots
+  std::vector<uint32_t>  depths;
+  std::vector<uint8_t>   flags;
+  std::vector<NodeId>    nodes;  // Node stored in each slot
+
+  std::vector<uint32_t> slots;         // Indexed by NodeId
+  std::vector<size_t>   levelOffsets;  // First slot of each depth, plus the end
+  bool                  unsorted = false;
+  bool                  dirty    = false;
+};
+
+}}  // namespace Rake::Scene
+
+#endif  // SCENEGRAPH_H
@@ -0,0 +1,341 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+#include <glm/glm.hpp>
+
+#include "scene/simplify.h"
+
+namespace Rake { namespace Scene {
+
+namespace {
+/**
+ * @brief Sum of squared distances to a set of planes, weighted by triangle area. The
+ * symmetric 4x4 matrix is kept as its upper triangle.
+ */
+struct Quadric {
+  double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+  double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+  double a22 = 0.0, a23 = 0.0;
+  double a33    = 0.0;
+  double weight = 0.0;
+
+  void add_plane(double x, double y, double z, double d, double w)
+  {
+    a00 += w * x * x;
+    a01 += w * x * y;
+    a02 += w * x * z;
+    a03 += w * x * d;
+    a11 += w * y * y;
+    a12 += w * y * z;
+    a13 += w * y * d;
+    a22 += w * z * z;
+    a23 += w * z * d;
+    a33 += w * d * d;
+    weight += w;
+  }
+
+  void add(const Quadric& other)
+  {
+    a00 += other.a00;
+    a01 += other.a01;
+    a02 += other.a02;
+    a03 += other.a03;
+    a11 += other.a11;
+    a12 += other.a12;
+    a13 += other.a13;
+    a22 += other.a22;
+    a23 += other.a23;
+    a33 += other.a33;
+    weight += other.weight;
+  }
+
+  double evaluate(const glm::vec3& p) const
+  {
+    double x = p.x, y = p.y, z = p.z;
+    return a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x + a11 * y * y + 2.0 * a12 * y * z +
+           2.0 * a13 * y + a22 * z * z + 2.0 * a23 * z + a33;
+  }
+};
+
+struct Collapse {
+  uint32_t from;
+  uint32_t to;
+  float    cost;
+};
+
+/**
+ * @brief Average distance from p to the planes of a and b, the error of moving a on to b
+ */
+float collapse_cost(const Quadric& a, const Quadric& b, const glm::vec3& p)
+{
+  double weight = a.weight + b.weight;
+  if (weight <= 0.0) {
+    return 0.0f;
+  }
+  double squared = std::max(0.0, a.evaluate(p) + b.evaluate(p));
+  return static_cast<float>(std::sqrt(squared / weight));
+}
+}  // namespace
+
+std::vector<uint32_t> simplify(const PositionStream&        positions,
+                               const std::vector<uint32_t>& indices,
+                               size_t                       targetIndexCount,
+                               float                        maxError,
+                               float*                       resultError)
+{
+  const uint32_t vertexCount = static_cast<uint32_t>(positions.count);
+
+  std::vector<glm::vec3> points(vertexCount);
+  for (uint32_t v = 0; v < vertexCount; v++) {
+    std::memcpy(&points[v], reinterpret_cast<const char*>(positions.data) + v * positions.stride, sizeof(glm::vec3));
+  }
+
+  // Vertices at the same position are wedges of one point, every wedge but the first
+  // refers to the first for its quadric. A wedge means an attribute seam, lock it.
+  std::vector<uint32_t> canonical(vertexCount);
+  std::vector<uint8_t>  locked(vertexCount, 0);
+  {
+    std::vector<uint32_t> order(vertexCount);
+    std::iota(order.begin(), order.end(), 0u);
+    auto less = [&points](uint32_t a, uint32_t b) {
+      const glm::vec3& p = points[a];
+      const glm::vec3& q = points[b];
+      return p.x != q.x ? p.x < q.x : (p.y != q.y ? p.y < q.y : p.z < q.z);
+    };
+    std::sort(order.begin(), order.end(), less);
+    for (uint32_t begin = 0, end = 0; begin < vertexCount; begin = end) {
+      for (end = begin + 1; end < vertexCount && !less(order[begin], order[end]); end++) {
+      }
+      for (uint32_t i = begin; i < end; i++) {
+        canonical[order[i]] = order[begin];
+        locked[order[i]]    = end - begin > 1;
+      }
+    }
+  }
+
+  // An edge between two points with no edge running the other way is an open border.
+  {
+    std::vector<uint64_t> edges;
+    edges.reserve(indices.size());
+    auto edge_key = [&canonical](uint32_t a, uint32_t b) {
+      return static_cast<uint64_t>(canonical[a]) << 32 | canonical[b];
+    };
+    for (size_t i = 0; i < indices.size(); i += 3) {
+      for (size_t e = 0; e < 3; e++) {
+        edges.push_back(edge_key(indices[i + e], indices[i + (e + 1) % 3]));
+      }
+    }
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < indices.size(); i += 3) {
+      for (size_t e = 0; e < 3; e++) {
+        uint32_t a = indices[i + e];
+        uint32_t b = indices[i + (e + 1) % 3];
+        if (!std::binary_search(edges.begin(), edges.end(), edge_key(b, a))) {
+          locked[a] = 1;
+          locked[b] = 1;
+        }
+      }
+    }
+  }
+
+  std::vector<Quadric> quadrics(vertexCount);
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    const glm::vec3& p0     = points[indices[i]];
+    glm::vec3        normal = glm::cross(points[indices[i + 1]] - p0, points[indices[i + 2]] - p0);
+    float            length = glm::length(normal);
+    if (length <= 0.0f) {
+      continue;
+    }
+    normal /= length;
+    double distance = -glm::dot(normal, p0);
+    double area     = 0.5 * length;
+    for (size_t corner = 0; corner < 3; corner++) {
+      quadrics[canonical[indices[i + corner]]].add_plane(normal.x, normal.y, normal.z, distance, area);
+    }
+  }
+
+  std::vector<uint32_t> result = indices;
+  std::vector<uint32_t> firstTriangle(vertexCount + 1);
+  std::vector<uint32_t> triangles;
+  std::vector<uint32_t> remap(vertexCount);
+  std::vector<uint8_t>  touched(vertexCount);
+  std::vector<Collapse> candidates;
+  float                 worst = 0.0f;
+
+  // Moving from on to to must not turn any remaining triangle around from over.
+  auto flips = [&](uint32_t from, uint32_t to) {
+    for (uint32_t t = firstTriangle[from]; t < firstTriangle[from + 1]; t++) {
+      const uint32_t* corners = &result[3 * triangles[t]];
+      if (corners[0] == to || corners[1] == to || corners[2] == to) {
+        continue;
+      }
+      glm::vec3 before[3];
+      glm::vec3 after[3];
+      for (uint32_t c = 0; c < 3; c++) {
+        before[c] = points[corners[c]];
+        after[c]  = corners[c] == from ? points[to] : before[c];
+      }
+      glm::vec3 oldNormal = glm::cross(before[1] - before[0], before[2] - before[0]);
+      glm::vec3 newNormal = glm::cross(after[1] - after[0], after[2] - after[0]);
+      if (glm::dot(oldNormal, newNormal) <= 0.0f) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  // Each pass collapses an independent set of the cheapest edges, vertices next to a
+  // collapse wait for the next pass so every flip test sees current positions.
+  while (result.size() > targetIndexCount) {
+    uint32_t triangleCount = static_cast<uint32_t>(result.size() / 3);
+
+    std::fill(firstTriangle.begin(), firstTriangle.end(), 0u);
+    for (uint32_t index : result) {
+      firstTriangle[index + 1]++;
+    }
+    std::partial_sum(firstTriangle.begin(), firstTriangle.end(), firstTriangle.begin());
+    triangles.resize(result.size());
+    std::vector<uint32_t> cursor(firstTriangle.begin(), firstTriangle.end() - 1);
+    for (uint32_t t = 0; t < triangleCount; t++) {
+      for (uint32_t c = 0; c < 3; c++) {
+        triangles[cursor[result[3 * t + c]]++] = t;
+      }
+    }
+
+    candidates.clear();
+    for (uint32_t t = 0; t < triangleCount; t++) {
+      for (uint32_t c = 0; c < 3; c++) {
+        uint32_t a = result[3 * t + c];
+        uint32_t b = result[3 * t + (c + 1) % 3];
+        if (!locked[a]) {
+          candidates.push_back({a, b, collapse_cost(quadrics[a], quadrics[canonical[b]], points[b])});
+        }
+        if (!locked[b]) {
+          candidates.push_back({b, a, collapse_cost(quadrics[b], quadrics[canonical[a]], points[a])});
+        }
+      }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Collapse& a, const Collapse& b) {
+      return a.cost < b.cost;
+    });
+
+    std::iota(remap.begin(), remap.end(), 0u);
+    std::fill(touched.begin(), touched.end(), 0);
+    uint32_t targetTriangles = static_cast<uint32_t>(targetIndexCount / 3);
+    uint32_t removed         = 0;
+    uint32_t collapsed       = 0;
+    bool     overError       = false;
+
+    for (const auto& candidate : candidates) {
+      if (candidate.cost > maxError) {
+        overError = true;
+        break;
+      }
+      if (triangleCount - removed <= targetTriangles) {
+        break;
+      }
+      if (touched[candidate.from] || touched[candidate.to] || flips(candidate.from, candidate.to)) {
+        continue;
+      }
+
+      remap[candidate.from] = candidate.to;
+      quadrics[canonical[candidate.to]].add(quadrics[candidate.from]);
+      worst = std::max(worst, candidate.cost);
+      collapsed++;
+
+      touched[candidate.to] = 1;
+      for (uint32_t t = firstTriangle[candidate.from]; t < firstTriangle[candidate.from + 1]; t++) {
+        const uint32_t* corners = &result[3 * triangles[t]];
+        touched[corners[0]]     = 1;
+        touched[corners[1]]     = 1;
+        touched[corners[2]]     = 1;
+        removed += corners[0] == candidate.to || corners[1] == candidate.to || corners[2] == candidate.to;
+      }
+    }
+
+    if (collapsed == 0) {
+      break;
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < result.size(); i += 3) {
+      uint32_t a = remap[result[i]];
+      uint32_t b = remap[result[i + 1]];
+      uint32_t c = remap[result[i + 2]];
+      if (a != b && b != c && c != a) {
+        result[kept++] = a;
+        result[kept++] = b;
+        result[kept++] = c;
+      }
+    }
+    result.resize(kept);
+
+    if (overError) {
+      break;
+    }
+  }
+
+  if (resultError) {
+    *resultError = worst;
+  }
+  return result;
+}
+
+std::vector<Lod> build_lod_chain(const PositionStream&  positions,
+                                 std::vector<uint32_t>& indices,
+                                 uint32_t               levelCount,
+                                 float                  reduction)
+{
+  std::vector<Lod> lods;
+  if (indices.empty()) {
+    return lods;
+  }
+
+  Lod full;
+  full.indexCount = static_cast<uint32_t>(indices.size());
+  lods.push_back(full);
+
+  while (lods.size() < levelCount) {
+    const Lod previous = lods.back();
+
+    std::vector<uint32_t> source(indices.begin() + previous.firstIndex,
+                                 indices.begin() + previous.firstIndex + previous.indexCount);
+    size_t                target = static_cast<size_t>(previous.indexCount / 3 * reduction) * 3;
+    float                 error  = 0.0f;
+    std::vector<uint32_t> reduced =
+        simplify(positions, source, target, std::numeric_limits<float>::max(), &error);
+
+    // Locked seams and borders limit how far a mesh reduces, stop when a level barely helps.
+    if (reduced.empty() || reduced.size() * 10 > static_cast<size_t>(previous.indexCount) * 9) {
+      break;
+    }
+
+    Lod lod;
+    lod.firstIndex = static_cast<uint32_t>(indices.size());
+    lod.indexCount = static_cast<uint32_t>(reduced.size());
+    lod.error      = previous.error + error;
+    indices.insert(indices.end(), reduced.begin(), reduced.end());
+    lods.push_back(lod);
+  }
+  return lods;
+}
+
+uint32_t select_lod(const std::vector<Lod>& lods, float distance, float pixelsPerUnit, float maxPixelError)
+{
+  if (lods.empty() || distance <= 0.0f) {
+    return 0;
+  }
+
+  float scale = pixelsPerUnit / distance;
+  for (uint32_t i = static_cast<uint32_t>(lods.size()) - 1; i > 0; i--) {
+    if (lods[i].error * scale <= maxPixelError) {
+      return i;
+    }
+  }
+  return 0;
+}
+
+}}  // namespace Rake::Scene
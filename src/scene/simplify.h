@@ -0,0 +1,79 @@
+#if !defined(SIMPLIFY_H)
+#define SIMPLIFY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Rake { namespace Scene {
+
+/**
+ * @brief One level of detail, a range of an index buffer shared by every level
+ */
+struct Lod {
+  uint32_t firstIndex   = 0;
+  uint32_t indexCount   = 0;
+  float    error        = 0.0f;  // Object space distance the level may stray from the full mesh
+  uint32_t firstMeshlet = 0;     // Meshlets covering the same triangles, none until they are built
+  uint32_t meshletCount = 0;
+};
+
+/**
+ * @brief Vertex positions read in place from an interleaved vertex array
+ */
+struct PositionStream {
+  const float* data   = nullptr;  // x, y, z of the first vertex
+  size_t       count  = 0;
+  size_t       stride = 0;  // Bytes between vertices
+};
+
+/**
+ * @brief Reduce a triangle list with quadric error edge collapses. Every collapse moves a
+ * vertex on to one of its neighbours so the result indexes the same vertex buffer.
+ *
+ * Vertices that share a position with another vertex sit on an attribute seam (a UV or
+ * colour split) and are never moved, nor are vertices on an open border, so seams and
+ * silhouettes of open meshes keep their shape.
+ *
+ * @param positions
+ * @param indices triangle list
+ * @param targetIndexCount stop once the list is this short
+ * @param maxError stop before a collapse would move the surface further than this
+ * @param resultError set to the largest error a collapse introduced
+ * @return the reduced triangle list, unchanged when nothing can collapse
+ */
+std::vector<uint32_t> simplify(const PositionStream&        positions,
+                               const std::vector<uint32_t>& indices,
+                               size_t                       targetIndexCount,
+                               float                        maxError,
+                               float*                       resultError = nullptr);
+
+/**
+ * @brief Simplify indices[0, n) repeatedly, each level from the one before, and append
+ * every level to indices. Stops early when a level would not be meaningfully smaller.
+ *
+ * @param positions
+ * @param indices the full detail triangle list, grown by the coarser levels
+ * @param levelCount levels wanted including the full detail one
+ * @param reduction fraction of the triangles each level keeps
+ * @return the levels, finest first, errors never decrease
+ */
+std::vector<Lod> build_lod_chain(const PositionStream&  positions,
+                                 std::vector<uint32_t>& indices,
+                                 uint32_t               levelCount,
+                                 float                  reduction = 0.5f);
+
+/**
+ * @brief Coarsest level whose error projects to at most maxPixelError pixels
+ *
+ * @param lods
+ * @param distance from the camera to the nearest point of the bounding sphere
+ * @param pixelsPerUnit screen height over 2 tan(fov / 2), pixels covered by one unit at distance one
+ * @param maxPixelError
+ * @return level index, zero when the camera is inside the bounds
+ */
+uint32_t select_lod(const std::vector<Lod>& lods, float distance, float pixelsPerUnit, float maxPixelError);
+
+}}  // namespace Rake::Scene
+
+#endif  // SIMPLIFY_H
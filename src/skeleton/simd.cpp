@@ -0,0 +1,58 @@
+#include "skeleton/simd.h"
+
+namespace Rake { namespace Base {
+
+/**
+ * @brief
+ *
+ * @param level
+ * @return const char*
+ */
+const char* to_string(SimdLevel level)
+{
+  switch (level) {
+    case SimdLevel::Sse:
+      return "sse";
+    case SimdLevel::Avx2:
+      return "avx2";
+    default:
+      return "scalar";
+  }
+}
+
+/**
+ * @brief Widest instruction set both the build target and this CPU support
+ *
+ * @return SimdLevel
+ */
+SimdLevel best_simd_level()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  if (__builtin_cpu_supports("avx2")) {
+    return SimdLevel::Avx2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return SimdLevel::Sse;
+  }
+#endif
+  return SimdLevel::Scalar;
+}
+
+/**
+ * @brief Every instruction set this CPU runs, scalar first
+ *
+ * @return std::vector<SimdLevel>
+ */
+std::vector<SimdLevel> simd_levels()
+{
+  std::vector<SimdLevel> levels = {SimdLevel::Scalar};
+  if (best_simd_level() >= SimdLevel::Sse) {
+    levels.push_back(SimdLevel::Sse);
+  }
+  if (best_simd_level() >= SimdLevel::Avx2) {
+    levels.push_back(SimdLevel::Avx2);
+  }
+  return levels;
+}
+
+}}  // namespace Rake::Base
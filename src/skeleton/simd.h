@@ -0,0 +1,19 @@
+#if !defined(SIMD_H)
+#define SIMD_H
+
+#include <vector>
+
+namespace Rake { namespace Base {
+
+/**
+ * @brief Instruction set a SIMD code path is written for, wider ones compare greater
+ */
+enum class SimdLevel { Scalar, Sse, Avx2 };
+
+const char*            to_string(SimdLevel level);
+SimdLevel              best_simd_level();
+std::vector<SimdLevel> simd_levels();
+
+}}  // namespace Rake::Base
+
+#endif  // SIMD_H
@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <exception>
+
+#include "skeleton/threadpool.h"
+
+namespace Rake { namespace Base {
+
+/**
+ * @brief Spin up the worker threads, at least one is always created
+ *
+ * @param threadCount
+ */
+ThreadPool::ThreadPool(size_t threadCount)
+{
+  threadCount = std::max<size_t>(threadCount, 1);
+  workers.reserve(threadCount);
+  for (size_t i = 0; i < threadCount; i++) {
+    workers.emplace_back(&ThreadPool::worker_loop, this);
+  }
+}
+
+/**
+ * @brief Drain the queue and join the workers
+ */
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  condition.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+/**
+ * @brief Leave one hardware thread for the thread driving the renderer
+ *
+ * @return size_t
+ */
+size_t ThreadPool::default_thread_count()
+{
+  size_t hardwareThreads = std::thread::hardware_concurrency();
+  return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+}
+
+/**
+ * @brief
+ *
+ * @param count
+ * @param body may throw, the first exception a chunk throws is rethrown once all are done
+ * @param minChunk smallest range handed to a single job
+ */
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t, size_t)>& body, size_t minChunk)
+{
+  if (count == 0) {
+    return;
+  }
+
+  minChunk          = std::max<size_t>(minChunk, 1);
+  size_t chunkCount = std::min(workers.size() * 4, (count + minChunk - 1) / minChunk);
+  if (chunkCount <= 1) {
+    body(0, count);
+    return;
+  }
+
+  size_t                         chunkSize = (count + chunkCount - 1) / chunkCount;
+  std::vector<std::future<void>> pending;
+  pending.reserve(chunkCount);
+
+  for (size_t begin = 0; begin < count; begin += chunkSize) {
+    size_t end = std::min(begin + chunkSize, count);
+    pending.push_back(submit([&body, begin, end]() { body(begin, end); }));
+  }
+
+  // Chunks still queued or running hold a reference to body, so every one of them is
+  // waited for before the first exception leaves
+  std::exception_ptr failure;
+  for (auto& job : pending) {
+    try {
+      job.get();
+    } catch (...) {
+      if (!failure) {
+        failure = std::current_exception();
+      }
+    }
+  }
+  if (failure) {
+    std::rethrow_exception(failure);
+  }
+}
+
+/**
+ * @brief
+ */
+void ThreadPool::worker_loop()
+{
+  for (;;) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      condition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+      if (jobs.empty()) {
+        return;
+      }
+      job = std::move(jobs.front());
+      jobs.pop_front();
+    }
+    job();
+  }
+}
+
+}}  // namespace Rake::Base
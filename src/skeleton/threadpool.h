@@ -0,0 +1,68 @@
+#if !defined(THREADPOOL_H)
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Rake { namespace Base {
+/**
+ * @brief Fixed size pool of worker threads pulling jobs from a shared FIFO queue
+ *
+ */
+class ThreadPool {
+  public:
+  explicit ThreadPool(size_t threadCount = default_thread_count());
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /**
+   * @brief Queue a job and get a future for its result, exceptions thrown by the
+   * job are rethrown from future::get()
+   */
+  template <typename F>
+  auto submit(F&& job) -> std::future<decltype(job())>
+  {
+    using Result = decltype(job());
+
+    auto task   = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+    auto result = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      jobs.emplace_back([task]() { (*task)(); });
+    }
+    condition.notify_one();
+    return result;
+  }
+
+  /**
+   * @brief Split [0, count) in to contiguous chunks and run body(begin, end) on the
+   * workers, blocks until every chunk is done, even when one throws. Must not be called
+   * from a worker.
+   */
+  void parallel_for(size_t count, const std::function<void(size_t, size_t)>& body, size_t minChunk = 1);
+
+  size_t size() const { return workers.size(); }
+
+  static size_t default_thread_count();
+
+  private:
+  void worker_loop();
+
+  std::vector<std::thread>          workers;
+  std::deque<std::function<void()>> jobs;
+  std::mutex                        mutex;
+  std::condition_variable           condition;
+  bool                              stopping = false;
+};
+
+}}  // namespace Rake::Base
+
+#endif  // THREADPOOL_H
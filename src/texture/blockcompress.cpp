@@ -0,0 +1,639 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RAKE_X86_SIMD
+#endif
+
+#include "texture/blockcompress.h"
+
+namespace Rake { namespace Texture {
+
+namespace {
+constexpr uint32_t colorMask = 0x00ffffff;  // RGB of a texel, alpha cleared
+constexpr uint32_t rgbaMask  = 0xffffffff;
+constexpr uint32_t fitPasses = 2;  // Least squares refits, most blocks settle after one
+
+// Weight of the first endpoint for each index
+constexpr float bc1Weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+
+// Weight of the second endpoint for each 4 bit index, in 64ths
+constexpr int32_t bc7Weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+/**
+ * @brief A 4x4 block, one RGBA8 texel per element with red in the low byte
+ */
+struct Block {
+  uint32_t texels[16];
+
+  uint32_t channel(uint32_t texel, uint32_t c) const { return texels[texel] >> (8 * c) & 0xff; }
+};
+
+/**
+ * @brief Picks the nearest palette entry for each texel of a block by squared distance,
+ * over the channels in mask. Ties go to the lower index.
+ *
+ * @return uint32_t sum of the squared distances
+ */
+using SelectFunction = uint32_t (*)(const Block&   block,
+                                    const uint32_t* palette,
+                                    uint32_t        paletteSize,
+                                    uint32_t        mask,
+                                    uint8_t*        indices);
+
+uint32_t select_scalar(const Block&    block,
+                       const uint32_t* palette,
+                       uint32_t        paletteSize,
+                       uint32_t        mask,
+                       uint8_t*        indices)
+{
+  uint32_t error = 0;
+  for (uint32_t i = 0; i < 16; i++) {
+    uint32_t texel = block.texels[i] & mask;
+    uint32_t best  = UINT32_MAX;
+    for (uint32_t k = 0; k < paletteSize; k++) {
+      uint32_t entry    = palette[k] & mask;
+      uint32_t distance = 0;
+      for (uint32_t shift = 0; shift < 32; shift += 8) {
+        int32_t difference = static_cast<int32_t>(texel >> shift & 0xff) - static_cast<int32_t>(entry >> shift & 0xff);
+        distance += static_cast<uint32_t>(difference * difference);
+      }
+      // Distances fit in 19 bits, the index rides below them so the minimum keeps the first
+      best = std::min(best, distance << 4 | k);
+    }
+    indices[i] = static_cast<uint8_t>(best & 15);
+    error += best >> 4;
+  }
+  return error;
+}
+
+#if defined(RAKE_X86_SIMD)
+/**
+ * @brief Four texels against one palette entry per iteration
+ */
+__attribute__((target("sse2"))) uint32_t select_sse(const Block&    block,
+                                                    const uint32_t* palette,
+                                                    uint32_t        paletteSize,
+                                                    uint32_t        mask,
+                                                    uint8_t*        indices)
+{
+  const __m128i zero  = _mm_setzero_si128();
+  const __m128i masks = _mm_set1_epi32(static_cast<int32_t>(mask));
+  alignas(16) uint32_t keys[4];
+
+  uint32_t error = 0;
+  for (uint32_t i = 0; i < 16; i += 4) {
+    __m128i texels = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block.texels + i)), masks);
+    __m128i low    = _mm_unpacklo_epi8(texels, zero);
+    __m128i high   = _mm_unpackhi_epi8(texels, zero);
+    __m128i best   = _mm_set1_epi32(INT32_MAX);
+    for (uint32_t k = 0; k < paletteSize; k++) {
+      __m128i entry = _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int32_t>(palette[k] & mask)), zero);
+      // Red and green, then blue and alpha of each texel
+      __m128i lowPairs  = _mm_madd_epi16(_mm_sub_epi16(low, entry), _mm_sub_epi16(low, entry));
+      __m128i highPairs = _mm_madd_epi16(_mm_sub_epi16(high, entry), _mm_sub_epi16(high, entry));
+      __m128  first     = _mm_castsi128_ps(lowPairs);
+      __m128  second    = _mm_castsi128_ps(highPairs);
+      __m128i distance  = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0))),
+                                       _mm_castps_si128(_mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1))));
+      __m128i key       = _mm_or_si128(_mm_slli_epi32(distance, 4), _mm_set1_epi32(static_cast<int32_t>(k)));
+      __m128i less      = _mm_cmplt_epi32(key, best);
+      best              = _mm_or_si128(_mm_and_si128(less, key), _mm_andnot_si128(less, best));
+    }
+    _mm_store_si128(reinterpret_cast<__m128i*>(keys), best);
+    for (uint32_t j = 0; j < 4; j++) {
+      indices[i + j] = static_cast<uint8_t>(keys[j] & 15);
+      error += keys[j] >> 4;
+    }
+  }
+  return error;
+}
+
+/**
+ * @brief Eight texels against one palette entry per iteration
+ */
+__attribute__((target("avx2"))) uint32_t select_avx2(const Block&    block,
+                                                     const uint32_t* palette,
+                                                     uint32_t        paletteSize,
+                                                     uint32_t        mask,
+                                                     uint8_t*        indices)
+{
+  // Lanes of the horizontal add below, it works within each 128 bit half
+  static const uint32_t lanes[8] = {0, 1, 4, 5, 2, 3, 6, 7};
+
+  const __m128i masks = _mm_set1_epi32(static_cast<int32_t>(mask));
+  alignas(32) uint32_t keys[8];
+
+  uint32_t error = 0;
+  for (uint32_t i = 0; i < 16; i += 8) {
+    const __m128i* source = reinterpret_cast<const __m128i*>(block.texels + i);
+    __m256i        first  = _mm256_cvtepu8_epi16(_mm_and_si128(_mm_loadu_si128(source), masks));
+    __m256i        second = _mm256_cvtepu8_epi16(_mm_and_si128(_mm_loadu_si128(source + 1), masks));
+    __m256i        best   = _mm256_set1_epi32(INT32_MAX);
+    for (uint32_t k = 0; k < paletteSize; k++) {
+      __m256i entry       = _mm256_cvtepu8_epi16(_mm_set1_epi32(static_cast<int32_t>(palette[k] & mask)));
+      __m256i firstPairs  = _mm256_madd_epi16(_mm256_sub_epi16(first, entry), _mm256_sub_epi16(first, entry));
+      __m256i secondPairs = _mm256_madd_epi16(_mm256_sub_epi16(second, entry), _mm256_sub_epi16(second, entry));
+      __m256i distance    = _mm256_hadd_epi32(firstPairs, secondPairs);
+      __m256i key = _mm256_or_si256(_mm256_slli_epi32(distance, 4), _mm256_set1_epi32(static_cast<int32_t>(k)));
+      best        = _mm256_min_epi32(best, key);
+    }
+    _mm256_store_si256(reinterpret_cast<__m256i*>(keys), best);
+    for (uint32_t j = 0; j < 8; j++) {
+      indices[i + lanes[j]] = static_cast<uint8_t>(keys[j] & 15);
+      error += keys[j] >> 4;
+    }
+  }
+  return error;
+}
+#else
+uint32_t select_sse(const Block& block, const uint32_t* palette, uint32_t paletteSize, uint32_t mask, uint8_t* indices)
+{
+  return select_scalar(block, palette, paletteSize, mask, indices);
+}
+uint32_t select_avx2(const Block& block, const uint32_t* palette, uint32_t paletteSize, uint32_t mask, uint8_t* indices)
+{
+  return select_scalar(block, palette, paletteSize, mask, indices);
+}
+#endif
+
+/**
+ * @brief Texels of the block at column x, row y, the edge texels repeat past the level
+ */
+void load_block(const MipLevel& level, const uint8_t* texels, uint32_t x, uint32_t y, Block& block)
+{
+  for (uint32_t row = 0; row < 4; row++) {
+    uint32_t       sourceY = std::min(4 * y + row, level.height - 1);
+    const uint8_t* source  = texels + size_t(sourceY) * level.width * 4;
+    for (uint32_t column = 0; column < 4; column++) {
+      uint32_t sourceX = std::min(4 * x + column, level.width - 1);
+      std::memcpy(&block.texels[4 * row + column], source + 4 * sourceX, 4);
+    }
+  }
+}
+
+/**
+ * @brief Starting endpoints: the corners of the bounding box inset by a sixteenth, on the
+ * diagonal whose direction the colours follow relative to the widest channel
+ *
+ * @param block
+ * @param channels 3 for RGB, 4 for RGBA
+ * @param first
+ * @param second
+ */
+void bounding_endpoints(const Block& block, uint32_t channels, float* first, float* second)
+{
+  float low[4], high[4], mean[4];
+  for (uint32_t c = 0; c < channels; c++) {
+    uint32_t minimum = 255, maximum = 0, sum = 0;
+    for (uint32_t i = 0; i < 16; i++) {
+      minimum = std::min(minimum, block.channel(i, c));
+      maximum = std::max(maximum, block.channel(i, c));
+      sum += block.channel(i, c);
+    }
+    float inset = (maximum - minimum) / 16.0f;
+    low[c]      = minimum + inset;
+    high[c]     = maximum - inset;
+    mean[c]     = sum / 16.0f;
+  }
+
+  uint32_t widest = 0;
+  for (uint32_t c = 1; c < channels; c++) {
+    if (high[c] - low[c] > high[widest] - low[widest]) {
+      widest = c;
+    }
+  }
+  for (uint32_t c = 0; c < channels; c++) {
+    float covariance = 0.0f;
+    for (uint32_t i = 0; i < 16; i++) {
+      covariance += (block.channel(i, c) - mean[c]) * (block.channel(i, widest) - mean[widest]);
+    }
+    first[c]  = covariance < 0.0f ? low[c] : high[c];
+    second[c] = covariance < 0.0f ? high[c] : low[c];
+  }
+}
+
+/**
+ * @brief Endpoints that best reproduce the block with the given indices, by least squares
+ *
+ * @param block
+ * @param indices
+ * @param weights of the first endpoint for each index
+ * @param channels
+ * @param first
+ * @param second
+ * @return false when every texel has the same weight, the endpoints are left as they were
+ */
+bool fit_endpoints(const Block&   block,
+                   const uint8_t* indices,
+                   const float*   weights,
+                   uint32_t       channels,
+                   float*         first,
+                   float*         second)
+{
+  float firstSquared = 0.0f, secondSquared = 0.0f, product = 0.0f;
+  float firstTexels[4] = {}, secondTexels[4] = {};
+  for (uint32_t i = 0; i < 16; i++) {
+    float weight = weights[indices[i]];
+    firstSquared += weight * weight;
+    secondSquared += (1.0f - weight) * (1.0f - weight);
+    product += weight * (1.0f - weight);
+    for (uint32_t c = 0; c < channels; c++) {
+      firstTexels[c] += weight * block.channel(i, c);
+      secondTexels[c] += (1.0f - weight) * block.channel(i, c);
+    }
+  }
+  float determinant = firstSquared * secondSquared - product * product;
+  if (std::fabs(determinant) < 1.0e-6f) {
+    return false;
+  }
+  for (uint32_t c = 0; c < channels; c++) {
+    first[c]  = (firstTexels[c] * secondSquared - secondTexels[c] * product) / determinant;
+    second[c] = (secondTexels[c] * firstSquared - firstTexels[c] * product) / determinant;
+    first[c]  = std::min(std::max(first[c], 0.0f), 255.0f);
+    second[c] = std::min(std::max(second[c], 0.0f), 255.0f);
+  }
+  return true;
+}
+
+/**
+ * @brief Appends fields to a block least significant bit first, as BC7 lays them out
+ */
+struct BitWriter {
+  uint8_t* bytes;
+  uint32_t position = 0;
+
+  void write(uint32_t value, uint32_t bits)
+  {
+    for (uint32_t bit = 0; bit < bits; bit++, position++) {
+      bytes[position / 8] |= static_cast<uint8_t>((value >> bit & 1) << (position % 8));
+    }
+  }
+};
+
+struct Bc1Block {
+  uint16_t endpoints[2];
+  uint8_t  indices[16];
+  uint32_t error;
+};
+
+uint16_t pack_565(const float* color)
+{
+  uint32_t red   = static_cast<uint32_t>(std::lrint(color[0] * 31.0f / 255.0f));
+  uint32_t green = static_cast<uint32_t>(std::lrint(color[1] * 63.0f / 255.0f));
+  uint32_t blue  = static_cast<uint32_t>(std::lrint(color[2] * 31.0f / 255.0f));
+  return static_cast<uint16_t>(red << 11 | green << 5 | blue);
+}
+
+uint32_t unpack_565(uint16_t color)
+{
+  uint32_t red   = color >> 11 & 31;
+  uint32_t green = color >> 5 & 63;
+  uint32_t blue  = color & 31;
+  return (red << 3 | red >> 2) | (green << 2 | green >> 4) << 8 | (blue << 3 | blue >> 2) << 16;
+}
+
+/**
+ * @brief Mix of two texels with weights in thirds or 64ths, per byte
+ */
+uint32_t mix(uint32_t first, uint32_t second, uint32_t firstWeight, uint32_t secondWeight, uint32_t total)
+{
+  uint32_t texel = 0;
+  for (uint32_t shift = 0; shift < 32; shift += 8) {
+    uint32_t value = (firstWeight * (first >> shift & 0xff) + secondWeight * (second >> shift & 0xff)) / total;
+    texel |= value << shift;
+  }
+  return texel;
+}
+
+/**
+ * @brief Quantise endpoints to RGB565 and pick indices in four colour mode, the first
+ * endpoint must be the larger. Equal endpoints decode in three colour mode, where only
+ * index 0 is safe, and that is the one every texel picks.
+ */
+Bc1Block try_bc1(const Block& block, const float* first, const float* second, SelectFunction select)
+{
+  Bc1Block candidate = {{pack_565(first), pack_565(second)}, {}, 0};
+  if (candidate.endpoints[0] < candidate.endpoints[1]) {
+    std::swap(candidate.endpoints[0], candidate.endpoints[1]);
+  }
+  uint32_t start = unpack_565(candidate.endpoints[0]);
+  uint32_t end   = unpack_565(candidate.endpoints[1]);
+
+  const uint32_t palette[4] = {start, end, mix(start, end, 2, 1, 3), mix(start, end, 1, 2, 3)};
+  candidate.error           = select(block, palette, 4, colorMask, candidate.indices);
+  return candidate;
+}
+
+void encode_bc1(const Block& block, SelectFunction select, uint8_t* output)
+{
+  float first[4], second[4];
+  bounding_endpoints(block, 3, first, second);
+  Bc1Block best = try_bc1(block, first, second, select);
+  for (uint32_t pass = 0; pass < fitPasses && best.error > 0; pass++) {
+    if (!fit_endpoints(block, best.indices, bc1Weights, 3, first, second)) {
+      break;
+    }
+    Bc1Block candidate = try_bc1(block, first, second, select);
+    if (candidate.error >= best.error) {
+      break;
+    }
+    best = candidate;
+  }
+
+  uint32_t indices = 0;
+  for (uint32_t i = 0; i < 16; i++) {
+    indices |= static_cast<uint32_t>(best.indices[i]) << (2 * i);
+  }
+  std::memcpy(output, best.endpoints, 4);
+  std::memcpy(output + 4, &indices, 4);
+}
+
+/**
+ * @brief Alpha block of BC3, eight levels between the block's extremes
+ */
+void encode_alpha(const Block& block, uint8_t* output)
+{
+  uint32_t maximum = 0, minimum = 255;
+  for (uint32_t i = 0; i < 16; i++) {
+    maximum = std::max(maximum, block.channel(i, 3));
+    minimum = std::min(minimum, block.channel(i, 3));
+  }
+
+  uint32_t palette[8] = {maximum, minimum};
+  for (uint32_t k = 2; k < 8; k++) {
+    palette[k] = ((8 - k) * maximum + (k - 1) * minimum) / 7;
+  }
+
+  uint64_t indices = 0;
+  if (maximum > minimum) {  // Equal extremes pick the six level mode, index 0 is still the value
+    for (uint32_t i = 0; i < 16; i++) {
+      uint32_t alpha = block.channel(i, 3);
+      uint32_t best  = 0;
+      for (uint32_t k = 1; k < 8; k++) {
+        uint32_t distance = palette[k] > alpha ? palette[k] - alpha : alpha - palette[k];
+        uint32_t nearest  = palette[best] > alpha ? palette[best] - alpha : alpha - palette[best];
+        best              = distance < nearest ? k : best;
+      }
+      indices |= static_cast<uint64_t>(best) << (3 * i);
+    }
+  }
+  output[0] = static_cast<uint8_t>(maximum);
+  output[1] = static_cast<uint8_t>(minimum);
+  for (uint32_t byte = 0; byte < 6; byte++) {
+    output[2 + byte] = static_cast<uint8_t>(indices >> (8 * byte));
+  }
+}
+
+struct Bc7Block {
+  uint32_t endpoints[2][4];  // 7 bits a channel
+  uint32_t pbits[2];
+  uint8_t  indices[16];
+  uint32_t error;
+};
+
+/**
+ * @brief 7 bit channels and the shared low bit that reproduce an endpoint best
+ */
+void quantize_bc7(const float* color, uint32_t* channels, uint32_t& pbit)
+{
+  float bestError = INFINITY;
+  for (uint32_t bit = 0; bit < 2; bit++) {
+    uint32_t candidate[4];
+    float    error = 0.0f;
+    for (uint32_t c = 0; c < 4; c++) {
+      candidate[c] = static_cast<uint32_t>(std::min(std::max(std::lrint((color[c] - bit) / 2.0f), 0l), 127l));
+      float difference = static_cast<float>(candidate[c] << 1 | bit) - color[c];
+      error += difference * difference;
+    }
+    if (error < bestError) {
+      bestError = error;
+      pbit      = bit;
+      std::memcpy(channels, candidate, sizeof(candidate));
+    }
+  }
+}
+
+/**
+ * @brief Quantise endpoints for mode 6 and pick indices. The first texel's index is
+ * stored without its top bit, so the endpoints swap when it would be set.
+ */
+Bc7Block try_bc7(const Block& block, const float* first, const float* second, SelectFunction select)
+{
+  Bc7Block candidate = {};
+  quantize_bc7(first, candidate.endpoints[0], candidate.pbits[0]);
+  quantize_bc7(second, candidate.endpoints[1], candidate.pbits[1]);
+
+  uint32_t start = 0, end = 0;
+  for (uint32_t c = 0; c < 4; c++) {
+    start |= (candidate.endpoints[0][c] << 1 | candidate.pbits[0]) << (8 * c);
+    end |= (candidate.endpoints[1][c] << 1 | candidate.pbits[1]) << (8 * c);
+  }
+  uint32_t palette[16];
+  for (uint32_t k = 0; k < 16; k++) {
+    // The interpolation of the format, rounded to nearest in 64ths
+    uint32_t texel = 0;
+    for (uint32_t shift = 0; shift < 32; shift += 8) {
+      uint32_t value = ((64 - bc7Weights[k]) * (start >> shift & 0xff) + bc7Weights[k] * (end >> shift & 0xff) + 32);
+      texel |= (value >> 6) << shift;
+    }
+    palette[k] = texel;
+  }
+  candidate.error = select(block, palette, 16, rgbaMask, candidate.indices);
+
+  if (candidate.indices[0] >= 8) {
+    std::swap(candidate.endpoints[0], candidate.endpoints[1]);
+    std::swap(candidate.pbits[0], candidate.pbits[1]);
+    for (auto& index : candidate.indices) {
+      index = static_cast<uint8_t>(15 - index);
+    }
+  }
+  return candidate;
+}
+
+void encode_bc7(const Block& block, SelectFunction select, uint8_t* output)
+{
+  float weights[16];
+  for (uint32_t k = 0; k < 16; k++) {
+    weights[k] = 1.0f - bc7Weights[k] / 64.0f;
+  }
+
+  float first[4], second[4];
+  bounding_endpoints(block, 4, first, second);
+  Bc7Block best = try_bc7(block, first, second, select);
+  for (uint32_t pass = 0; pass < fitPasses && best.error > 0; pass++) {
+    if (!fit_endpoints(block, best.indices, weights, 4, first, second)) {
+      break;
+    }
+    Bc7Block candidate = try_bc7(block, first, second, select);
+    if (candidate.error >= best.error) {
+      break;
+    }
+    best = candidate;
+  }
+
+  std::memset(output, 0, 16);
+  BitWriter bits = {output};
+  bits.write(1 << 6, 7);  // Mode 6
+  for (uint32_t c = 0; c < 4; c++) {
+    bits.write(best.endpoints[0][c], 7);
+    bits.write(best.endpoints[1][c], 7);
+  }
+  bits.write(best.pbits[0], 1);
+  bits.write(best.pbits[1], 1);
+  bits.write(best.indices[0], 3);
+  for (uint32_t i = 1; i < 16; i++) {
+    bits.write(best.indices[i], 4);
+  }
+}
+}  // namespace
+
+/**
+ * @brief
+ *
+ * @param format
+ * @return const char*
+ */
+const char* to_string(BlockFormat format)
+{
+  switch (format) {
+    case BlockFormat::Bc1:
+      return "bc1";
+    case BlockFormat::Bc3:
+      return "bc3";
+    case BlockFormat::Bc7:
+      return "bc7";
+  }
+  return "unknown";
+}
+
+/**
+ * @brief Bytes of one 4x4 block
+ *
+ * @param format
+ * @return size_t
+ */
+size_t block_size(BlockFormat format)
+{
+  return format == BlockFormat::Bc1 ? 8 : 16;
+}
+
+/**
+ * @brief Bytes of a level, partial blocks at the edges count whole
+ *
+ * @param format
+ * @param width
+ * @param height
+ * @return size_t
+ */
+size_t block_level_size(BlockFormat format, uint32_t width, uint32_t height)
+{
+  return size_t((width + 3) / 4) * ((height + 3) / 4) * block_size(format);
+}
+
+/**
+ * @brief
+ *
+ * @param level clamped to what this CPU supports
+ * @param workers rows of blocks are encoded on the calling thread without one
+ */
+BlockEncoder::BlockEncoder(Base::SimdLevel level, Base::ThreadPool* workers)
+    : simdLevel(std::min(level, Base::best_simd_level()))
+    , workers(workers)
+{
+}
+
+/**
+ * @brief
+ *
+ * @param texels RGBA8 chain
+ * @param format
+ * @return MipChain with the same level sizes, data holds rows of blocks
+ */
+MipChain BlockEncoder::encode(const MipChain& texels, BlockFormat format) const
+{
+  MipChain chain;
+  chain.levels = texels.levels;
+  size_t offset = 0;
+  for (auto& level : chain.levels) {
+    level.offset = offset;
+    level.size   = block_level_size(format, level.width, level.height);
+    offset += level.size;
+  }
+  chain.data.resize(offset);
+  for (uint32_t level = 0; level < chain.level_count(); level++) {
+    encode_level(texels.levels[level], texels.level_data(level), format, chain.level_data(level));
+  }
+  return chain;
+}
+
+/**
+ * @brief Encode one level, split over the workers by rows of blocks
+ *
+ * @param level
+ * @param texels RGBA8 rows, tightly packed
+ * @param format
+ * @param blocks block_level_size() bytes
+ */
+void BlockEncoder::encode_level(const MipLevel& level, const uint8_t* texels, BlockFormat format, uint8_t* blocks) const
+{
+  if (level.width == 0 || level.height == 0) {
+    throw std::runtime_error("Cannot encode an empty level!");
+  }
+  const size_t blockRows    = (level.height + 3) / 4;
+  const size_t blockColumns = (level.width + 3) / 4;
+  auto         rows         = [&](size_t begin, size_t end) { encode_rows(level, texels, format, blocks, begin, end); };
+  // Chunks of at least 256 blocks, about as long as handing one out
+  const size_t minRows = std::max<size_t>(256 / blockColumns, 1);
+  if (workers != nullptr) {
+    workers->parallel_for(blockRows, rows, minRows);
+  } else {
+    rows(0, blockRows);
+  }
+}
+
+/**
+ * @brief Rows of blocks [begin, end) of a level
+ */
+void BlockEncoder::encode_rows(const MipLevel& level,
+                               const uint8_t*  texels,
+                               BlockFormat     format,
+                               uint8_t*        blocks,
+                               size_t          begin,
+                               size_t          end) const
+{
+  SelectFunction select = select_scalar;
+  if (simdLevel == Base::SimdLevel::Avx2) {
+    select = select_avx2;
+  } else if (simdLevel == Base::SimdLevel::Sse) {
+    select = select_sse;
+  }
+
+  const uint32_t blockColumns = (level.width + 3) / 4;
+  const size_t   size         = block_size(format);
+  Block          block;
+  for (size_t y = begin; y < end; y++) {
+    uint8_t* row = blocks + y * blockColumns * size;
+    for (uint32_t x = 0; x < blockColumns; x++) {
+      load_block(level, texels, x, static_cast<uint32_t>(y), block);
+      uint8_t* output = row + x * size;
+      switch (format) {
+        case BlockFormat::Bc1:
+          encode_bc1(block, select, output);
+          break;
+        case BlockFormat::Bc3:
+          encode_alpha(block, output);
+          encode_bc1(block, select, output + 8);
+          break;
+        case BlockFormat::Bc7:
+          encode_bc7(block, select, output);
+          break;
+      }
+    }
+  }
+}
+
+}}  // namespace Rake::Texture
@@ -0,0 +1,59 @@
+#if !defined(BLOCKCOMPRESS_H)
+#define BLOCKCOMPRESS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "skeleton/simd.h"
+#include "skeleton/threadpool.h"
+#include "texture/mipchain.h"
+
+namespace Rake { namespace Texture {
+
+/**
+ * @brief Block compressed formats, each stores 4x4 texel blocks
+ */
+enum class BlockFormat {
+  Bc1,  // 8 bytes a block, RGB565 endpoints and 2 bit indices, opaque
+  Bc3,  // 16 bytes a block, BC1 colour and an interpolated alpha block
+  Bc7,  // 16 bytes a block, encoded in mode 6: RGBA endpoints and 4 bit indices
+};
+
+const char* to_string(BlockFormat format);
+size_t      block_size(BlockFormat format);
+size_t      block_level_size(BlockFormat format, uint32_t width, uint32_t height);
+
+/**
+ * @brief Encodes RGBA8 mip chains in to block compressed ones. Endpoints start at the
+ * corners of the block's bounding box along the diagonal the colours follow, and are refit
+ * by least squares to the indices they picked. Picking the nearest palette entry for each
+ * texel is the costly step, it runs on SSE or AVX2. Rows of blocks are split over the
+ * worker pool when one is given.
+ *
+ * Every SIMD level produces the same blocks as the scalar path.
+ */
+class BlockEncoder {
+  public:
+  explicit BlockEncoder(Base::SimdLevel   level   = Base::best_simd_level(),
+                        Base::ThreadPool* workers = nullptr);
+
+  MipChain encode(const MipChain& texels, BlockFormat format) const;
+  void     encode_level(const MipLevel& level, const uint8_t* texels, BlockFormat format, uint8_t* blocks) const;
+
+  Base::SimdLevel level() const { return simdLevel; }
+
+  private:
+  void encode_rows(const MipLevel& level,
+                   const uint8_t*  texels,
+                   BlockFormat     format,
+                   uint8_t*        blocks,
+                   size_t          begin,
+                   size_t          end) const;
+
+  Base::SimdLevel   simdLevel;
+  Base::ThreadPool* workers;
+};
+
+}}  // namespace Rake::Texture
+
+#endif  // BLOCKCOMPRESS_H
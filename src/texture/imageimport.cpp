@@ -0,0 +1,358 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RAKE_X86_SIMD
+#endif
+
+#include <stb_image.h>
+
+#include "texture/imageimport.h"
+
+namespace Rake { namespace Texture {
+
+namespace {
+
+void expand_scalar(const uint8_t* rgb, uint8_t* rgba, size_t begin, size_t end)
+{
+  for (size_t texel = begin; texel < end; texel++) {
+    rgba[4 * texel]     = rgb[3 * texel];
+    rgba[4 * texel + 1] = rgb[3 * texel + 1];
+    rgba[4 * texel + 2] = rgb[3 * texel + 2];
+    rgba[4 * texel + 3] = 255;
+  }
+}
+
+#if defined(RAKE_X86_SIMD)
+/**
+ * @brief Four texels per shuffle, each load reads four bytes past its texels so the last
+ * two texels are left to the scalar path
+ */
+__attribute__((target("ssse3"))) void expand_ssse3(const uint8_t* rgb, uint8_t* rgba, size_t texels)
+{
+  const __m128i spread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m128i alpha  = _mm_set1_epi32(static_cast<int32_t>(0xff000000u));
+
+  size_t texel = 0;
+  for (; texel + 6 <= texels; texel += 4) {
+    __m128i source = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + 3 * texel));
+    __m128i color  = _mm_or_si128(_mm_shuffle_epi8(source, spread), alpha);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + 4 * texel), color);
+  }
+  expand_scalar(rgb, rgba, texel, texels);
+}
+
+/**
+ * @brief Eight texels per shuffle, four from each 128 bit lane
+ */
+__attribute__((target("avx2"))) void expand_avx2(const uint8_t* rgb, uint8_t* rgba, size_t texels)
+{
+  const __m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                          0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m256i alpha  = _mm256_set1_epi32(static_cast<int32_t>(0xff000000u));
+
+  size_t texel = 0;
+  for (; texel + 10 <= texels; texel += 8) {
+    __m128i low    = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + 3 * texel));
+    __m128i high   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + 3 * texel + 12));
+    __m256i source = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+    __m256i color  = _mm256_or_si256(_mm256_shuffle_epi8(source, spread), alpha);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + 4 * texel), color);
+  }
+  expand_scalar(rgb, rgba, texel, texels);
+}
+#else
+void expand_ssse3(const uint8_t* rgb, uint8_t* rgba, size_t texels)
+{
+  expand_scalar(rgb, rgba, 0, texels);
+}
+
+void expand_avx2(const uint8_t* rgb, uint8_t* rgba, size_t texels)
+{
+  expand_scalar(rgb, rgba, 0, texels);
+}
+#endif
+
+bool has_ssse3()
+{
+#if defined(RAKE_X86_SIMD)
+  static const bool supported = __builtin_cpu_supports("ssse3");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+}  // namespace
+
+/**
+ * @brief Widen RGB8 texels to RGBA8 with an opaque alpha, the same bytes stb_image writes
+ * when asked for four channels. The Sse level needs SSSE3 for its byte shuffle and falls
+ * back to the scalar loop without it.
+ *
+ * @param rgb tightly packed, 3 * texels bytes
+ * @param rgba 4 * texels bytes, must not overlap rgb
+ * @param texels
+ * @param level
+ */
+void expand_rgb(const uint8_t* rgb, uint8_t* rgba, size_t texels, Base::SimdLevel level)
+{
+  switch (std::min(level, Base::best_simd_level())) {
+    case Base::SimdLevel::Avx2:
+      expand_avx2(rgb, rgba, texels);
+      break;
+    case Base::SimdLevel::Sse:
+      if (has_ssse3()) {
+        expand_ssse3(rgb, rgba, texels);
+        break;
+      }
+      expand_scalar(rgb, rgba, 0, texels);
+      break;
+    default:
+      expand_scalar(rgb, rgba, 0, texels);
+      break;
+  }
+}
+
+/**
+ * @brief
+ *
+ * @param memory capacity bytes the ring hands out, it does not own them
+ * @param capacity
+ */
+StagingRing::StagingRing(uint8_t* memory, size_t capacity) : memory(memory), ringCapacity(capacity) {}
+
+/**
+ * @brief Where a range of size bytes would start, front to back after head or else from
+ * the start of the ring up to the oldest live range
+ *
+ * @param size
+ * @param offset set when it fits
+ * @return bool
+ */
+bool StagingRing::fits(size_t size, size_t& offset) const
+{
+  if (live.empty()) {
+    offset = 0;
+    return size <= ringCapacity;
+  }
+
+  const size_t tail = live.front().allocation.offset;
+  if (head > tail) {
+    if (head + size <= ringCapacity) {
+      offset = head;
+      return true;
+    }
+    offset = 0;
+    return size <= tail;
+  }
+  offset = head;
+  return head < tail && head + size <= tail;  // Head meeting the tail from below is a full ring
+}
+
+/**
+ * @brief Take a range, waiting for other threads to release ranges when the ring is full
+ *
+ * @param size bytes
+ * @return Allocation at an offset aligned to alignment
+ */
+StagingRing::Allocation StagingRing::acquire(size_t size)
+{
+  if (size > ringCapacity) {
+    throw std::runtime_error("Image does not fit in the staging ring!");
+  }
+
+  std::unique_lock<std::mutex> lock(mutex);
+  size_t                       offset = 0;
+  released.wait(lock, [&]() { return fits(size, offset); });
+
+  Allocation allocation = {offset, size};
+  live.push_back({allocation, false});
+  head = std::min((offset + size + alignment - 1) / alignment * alignment, ringCapacity);
+  return allocation;
+}
+
+/**
+ * @brief Give a range back, its space is reused once the ranges acquired before it are
+ * released as well
+ *
+ * @param allocation from acquire()
+ */
+void StagingRing::release(const Allocation& allocation)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto range = std::find_if(live.begin(), live.end(), [&](const Range& range) {
+      return range.allocation.offset == allocation.offset && !range.released;
+    });
+    if (range == live.end()) {
+      throw std::runtime_error("Released a range the staging ring did not hand out!");
+    }
+    range->released = true;
+    while (!live.empty() && live.front().released) {
+      live.pop_front();
+    }
+    if (live.empty()) {
+      head = 0;
+    }
+  }
+  released.notify_all();
+}
+
+/**
+ * @brief
+ *
+ * @param ring the decoded texels are written to
+ * @param workers optional, decodes one image per job
+ * @param level of expand_rgb()
+ */
+ImageImporter::ImageImporter(StagingRing& ring, Base::ThreadPool* workers, Base::SimdLevel level)
+    : ring(ring)
+    , workers(workers)
+    , simdLevel(std::min(level, Base::best_simd_level()))
+{
+}
+
+/**
+ * @brief Waits for the jobs still running, their images are released unseen
+ */
+ImageImporter::~ImageImporter()
+{
+  outstanding -= queued.size();
+  queued.clear();
+  while (outstanding > 0) {
+    try {
+      ring.release(next().texels);
+    } catch (...) {
+    }
+  }
+}
+
+/**
+ * @brief Queue an image to decode
+ *
+ * @param path any format stb_image reads
+ */
+void ImageImporter::submit(const std::string& path)
+{
+  outstanding++;
+  if (!workers) {
+    queued.push_back(path);
+    return;
+  }
+
+  workers->submit([this, path]() {
+    Result result;
+    try {
+      result.image = decode(path);
+    } catch (...) {
+      result.image.path = path;
+      result.error      = std::current_exception();
+    }
+    // Notified under the lock, the importer may be destroyed as soon as the result is taken
+    std::lock_guard<std::mutex> lock(mutex);
+    finished.push_back(std::move(result));
+    completed.notify_one();
+  });
+}
+
+/**
+ * @brief Wait for the next image to finish, a failed decode is rethrown from here
+ *
+ * @return ImportedImage whose texels the caller releases to the ring
+ */
+ImportedImage ImageImporter::next()
+{
+  if (outstanding == 0) {
+    throw std::runtime_error("No images left to import!");
+  }
+  outstanding--;
+
+  if (!workers) {
+    std::string path = std::move(queued.front());
+    queued.pop_front();
+    return decode(path);
+  }
+
+  Result result;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    completed.wait(lock, [this]() { return !finished.empty(); });
+    result = std::move(finished.front());
+    finished.pop_front();
+  }
+  if (result.error) {
+    std::rethrow_exception(result.error);
+  }
+  return result.image;
+}
+
+/**
+ * @brief Read an image's dimensions from its header
+ *
+ * @param path any format stb_image reads
+ * @param width
+ * @param height
+ * @return bool false when stb_image does not recognise the file
+ */
+bool ImageImporter::image_size(const std::string& path, uint32_t& width, uint32_t& height)
+{
+  int x, y, channels;
+  if (!stbi_info(path.c_str(), &x, &y, &channels)) {
+    return false;
+  }
+  width  = static_cast<uint32_t>(x);
+  height = static_cast<uint32_t>(y);
+  return true;
+}
+
+/**
+ * @brief Read a file whole and decode it in to the ring, runs on a worker
+ *
+ * @param path
+ * @return ImportedImage
+ */
+ImportedImage ImageImporter::decode(const std::string& path) const
+{
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    throw std::runtime_error("Failed to open texture image!");
+  }
+  std::vector<uint8_t> encoded(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  if (!file.read(reinterpret_cast<char*>(encoded.data()), encoded.size())) {
+    throw std::runtime_error("Failed to read texture image!");
+  }
+
+  // Three channels are widened here rather than by stb_image, any other count is converted by it
+  int width, height, channels;
+  if (!stbi_info_from_memory(encoded.data(), static_cast<int>(encoded.size()), &width, &height, &channels)) {
+    throw std::runtime_error("Failed to load texture image!");
+  }
+  const int wanted = channels == 3 ? STBI_rgb : STBI_rgb_alpha;
+  std::unique_ptr<stbi_uc, void (*)(void*)> pixels(
+      stbi_load_from_memory(encoded.data(), static_cast<int>(encoded.size()), &width, &height, &channels, wanted),
+      stbi_image_free);
+  if (!pixels) {
+    throw std::runtime_error("Failed to load texture image!");
+  }
+
+  ImportedImage image;
+  image.path   = path;
+  image.width  = static_cast<uint32_t>(width);
+  image.height = static_cast<uint32_t>(height);
+  image.texels = ring.acquire(size_t(width) * height * 4);
+  if (wanted == STBI_rgb) {
+    expand_rgb(pixels.get(), ring.data(image.texels), size_t(width) * height, simdLevel);
+  } else {
+    std::memcpy(ring.data(image.texels), pixels.get(), image.texels.size);
+  }
+  return image;
+}
+
+}}  // namespace Rake::Texture
@@ -0,0 +1,116 @@
+#if !defined(IMAGEIMPORT_H)
+#define IMAGEIMPORT_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+
+#include "skeleton/simd.h"
+#include "skeleton/threadpool.h"
+
+namespace Rake { namespace Texture {
+
+void expand_rgb(const uint8_t* rgb, uint8_t* rgba, size_t texels, Base::SimdLevel level);
+
+/**
+ * @brief Allocator over one block of staging memory that is handed out front to back and
+ * wraps around. Ranges may be released in any order, their space is reused once every
+ * range acquired before them was released too. Safe to use from several threads.
+ */
+class StagingRing {
+  public:
+  static constexpr size_t alignment = 16;  // Of every offset, a multiple of any texel size copied from it
+
+  struct Allocation {
+    size_t offset = 0;
+    size_t size   = 0;
+  };
+
+  StagingRing(uint8_t* memory, size_t capacity);
+
+  StagingRing(const StagingRing&) = delete;
+  StagingRing& operator=(const StagingRing&) = delete;
+
+  Allocation acquire(size_t size);
+  void       release(const Allocation& allocation);
+
+  uint8_t* data(const Allocation& allocation) const { return memory + allocation.offset; }
+  size_t   capacity() const { return ringCapacity; }
+
+  private:
+  struct Range {
+    Allocation allocation;
+    bool       released = false;
+  };
+
+  bool fits(size_t size, size_t& offset) const;
+
+  uint8_t*                memory;
+  size_t                  ringCapacity;
+  std::deque<Range>       live;  // In the order they were acquired
+  size_t                  head = 0;  // Where the next range starts unless it has to wrap
+  std::mutex              mutex;
+  std::condition_variable released;
+};
+
+/**
+ * @brief Image decoded to RGBA8 texels in a StagingRing, the caller releases them
+ */
+struct ImportedImage {
+  std::string             path;
+  uint32_t                width  = 0;
+  uint32_t                height = 0;
+  StagingRing::Allocation texels;
+};
+
+/**
+ * @brief Decodes images with stb_image on a worker pool, each straight in to a StagingRing.
+ * Files are read whole and decoded to their own channel count, three channel images are
+ * widened to RGBA8 with expand_rgb() as they are written to the ring, the others are
+ * converted by stb_image.
+ *
+ * Images come out of next() in the order they finish. A worker waits for ring space while
+ * the caller holds on to earlier images, so a caller that keeps every image must size the
+ * ring for all of them. Without workers every image is decoded by next() itself.
+ */
+class ImageImporter {
+  public:
+  explicit ImageImporter(StagingRing&      ring,
+                         Base::ThreadPool* workers = nullptr,
+                         Base::SimdLevel   level   = Base::best_simd_level());
+  ~ImageImporter();
+
+  ImageImporter(const ImageImporter&) = delete;
+  ImageImporter& operator=(const ImageImporter&) = delete;
+
+  void          submit(const std::string& path);
+  ImportedImage next();
+  size_t        pending() const { return outstanding; }
+
+  static bool image_size(const std::string& path, uint32_t& width, uint32_t& height);
+
+  private:
+  struct Result {
+    ImportedImage      image;
+    std::exception_ptr error;
+  };
+
+  ImportedImage decode(const std::string& path) const;
+
+  StagingRing&            ring;
+  Base::ThreadPool*       workers;
+  Base::SimdLevel         simdLevel;
+  size_t                  outstanding = 0;  // Submitted and not yet returned by next()
+  std::deque<std::string> queued;           // Paths next() decodes when there are no workers
+  std::deque<Result>      finished;
+  std::mutex              mutex;
+  std::condition_variable completed;
+};
+
+}}  // namespace Rake::Texture
+
+#endif  // IMAGEIMPORT_H
@@ -0,0 +1,362 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RAKE_X86_SIMD
+#endif
+
+#include "texture/mipchain.h"
+
+namespace Rake { namespace Texture {
+
+namespace {
+constexpr uint32_t encodeSteps = 8192;  // Linear intensity is quantised to this many steps for the sRGB table
+constexpr float    encodeScale = static_cast<float>(encodeSteps - 1);
+
+/**
+ * @brief Byte to linear intensity for both colour spaces, and quantised linear intensity
+ * back to an sRGB byte
+ */
+struct ColorTables {
+  float   decode[2][256];  // Indexed by ColorSpace
+  uint8_t encode[encodeSteps];
+
+  ColorTables()
+  {
+    for (uint32_t value = 0; value < 256; value++) {
+      float encoded    = value / 255.0f;
+      decode[0][value] = encoded;
+      decode[1][value] = encoded <= 0.04045f ? encoded / 12.92f : std::pow((encoded + 0.055f) / 1.055f, 2.4f);
+    }
+    for (uint32_t step = 0; step < encodeSteps; step++) {
+      float linear  = step / encodeScale;
+      float encoded = linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+      encode[step]  = static_cast<uint8_t>(std::lrint(std::min(std::max(encoded, 0.0f), 1.0f) * 255.0f));
+    }
+  }
+};
+
+const ColorTables& tables()
+{
+  static const ColorTables instance;
+  return instance;
+}
+
+/**
+ * @brief Linear RGBA of a row of texels, four floats per texel
+ */
+void decode_row(const uint8_t* texels, uint32_t width, ColorSpace space, float* row)
+{
+  const float* color = tables().decode[static_cast<int>(space)];
+  const float* alpha = tables().decode[0];
+  for (uint32_t i = 0; i < width * 4; i += 4) {
+    row[i]     = color[texels[i]];
+    row[i + 1] = color[texels[i + 1]];
+    row[i + 2] = color[texels[i + 2]];
+    row[i + 3] = alpha[texels[i + 3]];
+  }
+}
+
+/**
+ * @brief Texel bytes from intensities already scaled and rounded, sRGB colour goes
+ * through the encode table
+ */
+inline void write_texel(const int32_t* quantised, ColorSpace space, uint8_t* texel)
+{
+  if (space == ColorSpace::Srgb) {
+    const uint8_t* encode = tables().encode;
+    texel[0]              = encode[quantised[0]];
+    texel[1]              = encode[quantised[1]];
+    texel[2]              = encode[quantised[2]];
+  } else {
+    texel[0] = static_cast<uint8_t>(quantised[0]);
+    texel[1] = static_cast<uint8_t>(quantised[1]);
+    texel[2] = static_cast<uint8_t>(quantised[2]);
+  }
+  texel[3] = static_cast<uint8_t>(quantised[3]);
+}
+
+inline float color_scale(ColorSpace space)
+{
+  return space == ColorSpace::Srgb ? encodeScale : 255.0f;
+}
+
+/**
+ * @brief Average 2x2 blocks of two decoded rows. The sums run in the order the SIMD
+ * kernels use, columns first, so every path rounds the same.
+ *
+ * @param top
+ * @param bottom
+ * @param begin first target texel
+ * @param width target texels in the row
+ * @param space
+ * @param texels target row
+ */
+void halve_scalar(const float* top,
+                  const float* bottom,
+                  uint32_t     begin,
+                  uint32_t     width,
+                  ColorSpace   space,
+                  uint8_t*     texels)
+{
+  const float scale[4] = {color_scale(space), color_scale(space), color_scale(space), 255.0f};
+  for (uint32_t x = begin; x < width; x++) {
+    int32_t quantised[4];
+    for (uint32_t c = 0; c < 4; c++) {
+      float left   = top[8 * x + c] + bottom[8 * x + c];
+      float right  = top[8 * x + 4 + c] + bottom[8 * x + 4 + c];
+      quantised[c] = static_cast<int32_t>(std::lrint((left + right) * 0.25f * scale[c]));
+    }
+    write_texel(quantised, space, texels + 4 * x);
+  }
+}
+
+#if defined(RAKE_X86_SIMD)
+/**
+ * @brief One target texel per iteration
+ */
+__attribute__((target("sse2"))) void halve_sse(const float* top,
+                                               const float* bottom,
+                                               uint32_t     width,
+                                               ColorSpace   space,
+                                               uint8_t*     texels)
+{
+  const __m128 quarter = _mm_set1_ps(0.25f);
+  const __m128 scale   = _mm_setr_ps(color_scale(space), color_scale(space), color_scale(space), 255.0f);
+  alignas(16) int32_t quantised[4];
+
+  for (uint32_t x = 0; x < width; x++) {
+    __m128 left  = _mm_add_ps(_mm_loadu_ps(top + 8 * x), _mm_loadu_ps(bottom + 8 * x));
+    __m128 right = _mm_add_ps(_mm_loadu_ps(top + 8 * x + 4), _mm_loadu_ps(bottom + 8 * x + 4));
+    __m128 color = _mm_mul_ps(_mm_mul_ps(_mm_add_ps(left, right), quarter), scale);
+    _mm_store_si128(reinterpret_cast<__m128i*>(quantised), _mm_cvtps_epi32(color));
+    write_texel(quantised, space, texels + 4 * x);
+  }
+}
+
+/**
+ * @brief Two target texels per iteration, the odd one out is left to the scalar path
+ */
+__attribute__((target("avx2"))) void halve_avx2(const float* top,
+                                                const float* bottom,
+                                                uint32_t     width,
+                                                ColorSpace   space,
+                                                uint8_t*     texels)
+{
+  const __m256   quarter = _mm256_set1_ps(0.25f);
+  const float    s       = color_scale(space);
+  const __m256   scale   = _mm256_setr_ps(s, s, s, 255.0f, s, s, s, 255.0f);
+  const uint32_t pairEnd = width & ~1u;
+  alignas(32) int32_t quantised[8];
+
+  for (uint32_t x = 0; x < pairEnd; x += 2) {
+    // Columns of four source texels, then the left and right column of each target texel
+    __m256 first  = _mm256_add_ps(_mm256_loadu_ps(top + 8 * x), _mm256_loadu_ps(bottom + 8 * x));
+    __m256 second = _mm256_add_ps(_mm256_loadu_ps(top + 8 * x + 8), _mm256_loadu_ps(bottom + 8 * x + 8));
+    __m256 left   = _mm256_permute2f128_ps(first, second, 0x20);
+    __m256 right  = _mm256_permute2f128_ps(first, second, 0x31);
+    __m256 color  = _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(left, right), quarter), scale);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(quantised), _mm256_cvtps_epi32(color));
+    write_texel(quantised, space, texels + 4 * x);
+    write_texel(quantised + 4, space, texels + 4 * x + 4);
+  }
+  halve_scalar(top, bottom, pairEnd, width, space, texels);
+}
+#else
+void halve_sse(const float* top, const float* bottom, uint32_t width, ColorSpace space, uint8_t* texels)
+{
+  halve_scalar(top, bottom, 0, width, space, texels);
+}
+
+void halve_avx2(const float* top, const float* bottom, uint32_t width, ColorSpace space, uint8_t* texels)
+{
+  halve_scalar(top, bottom, 0, width, space, texels);
+}
+#endif
+}  // namespace
+
+/**
+ * @brief Levels of a full chain, the largest axis halves down to 1
+ *
+ * @param width
+ * @param height
+ * @return uint32_t
+ */
+uint32_t mip_level_count(uint32_t width, uint32_t height)
+{
+  uint32_t levelCount = 1;
+  while (std::max(width, height) >> levelCount) {
+    levelCount++;
+  }
+  return levelCount;
+}
+
+/**
+ * @brief
+ *
+ * @param level clamped to what this CPU supports
+ * @param workers rows are filtered on the calling thread without one
+ */
+MipBuilder::MipBuilder(Base::SimdLevel level, Base::ThreadPool* workers)
+    : simdLevel(std::min(level, Base::best_simd_level()))
+    , workers(workers)
+{
+}
+
+/**
+ * @brief
+ *
+ * @param texels RGBA8 rows of level 0, tightly packed
+ * @param width
+ * @param height
+ * @param space
+ * @return MipChain with level 0 copied from texels
+ */
+MipChain MipBuilder::build(const uint8_t* texels, uint32_t width, uint32_t height, ColorSpace space) const
+{
+  if (width == 0 || height == 0) {
+    throw std::runtime_error("Cannot build mip levels of an empty image!");
+  }
+
+  MipChain chain;
+  chain.levels.resize(mip_level_count(width, height));
+
+  size_t offset = 0;
+  for (uint32_t level = 0; level < chain.level_count(); level++) {
+    MipLevel& mip = chain.levels[level];
+    mip.width     = std::max(width >> level, 1u);
+    mip.height    = std::max(height >> level, 1u);
+    mip.offset    = offset;
+    mip.size      = size_t(mip.width) * mip.height * 4;
+    offset += mip.size;
+  }
+  chain.data.resize(offset);
+
+  std::memcpy(chain.level_data(0), texels, chain.levels[0].size);
+  for (uint32_t level = 1; level < chain.level_count(); level++) {
+    downsample(chain.levels[level - 1],
+               chain.level_data(level - 1),
+               chain.levels[level],
+               chain.level_data(level),
+               space);
+  }
+  return chain;
+}
+
+/**
+ * @brief Filter one level in to a smaller one, split over the workers by target rows
+ *
+ * @param source
+ * @param sourceTexels
+ * @param target at most as large as source on either axis
+ * @param targetTexels
+ * @param space
+ */
+void MipBuilder::downsample(const MipLevel& source,
+                            const uint8_t*  sourceTexels,
+                            const MipLevel& target,
+                            uint8_t*        targetTexels,
+                            ColorSpace      space) const
+{
+  const bool halves = source.width == 2 * target.width && source.height == 2 * target.height;
+  auto       rows   = [&](size_t begin, size_t end) {
+    if (halves) {
+      halve_rows(source, sourceTexels, target, targetTexels, space, begin, end);
+    } else {
+      filter_rows(source, sourceTexels, target, targetTexels, space, begin, end);
+    }
+  };
+
+  // Chunks of at least 16k target texels, smaller ones cost more to hand out than to filter
+  const size_t minRows = std::max<size_t>(16384 / target.width, 1);
+  if (workers != nullptr) {
+    workers->parallel_for(target.height, rows, minRows);
+  } else {
+    rows(0, target.height);
+  }
+}
+
+/**
+ * @brief Rows of a target exactly half the source on both axes
+ */
+void MipBuilder::halve_rows(const MipLevel& source,
+                            const uint8_t*  sourceTexels,
+                            const MipLevel& target,
+                            uint8_t*        targetTexels,
+                            ColorSpace      space,
+                            size_t          begin,
+                            size_t          end) const
+{
+  const size_t       sourcePitch = size_t(source.width) * 4;
+  const size_t       targetPitch = size_t(target.width) * 4;
+  std::vector<float> top(sourcePitch);
+  std::vector<float> bottom(sourcePitch);
+
+  for (size_t y = begin; y < end; y++) {
+    decode_row(sourceTexels + 2 * y * sourcePitch, source.width, space, top.data());
+    decode_row(sourceTexels + (2 * y + 1) * sourcePitch, source.width, space, bottom.data());
+
+    uint8_t* row = targetTexels + y * targetPitch;
+    switch (simdLevel) {
+      case Base::SimdLevel::Avx2:
+        halve_avx2(top.data(), bottom.data(), target.width, space, row);
+        break;
+      case Base::SimdLevel::Sse:
+        halve_sse(top.data(), bottom.data(), target.width, space, row);
+        break;
+      default:
+        halve_scalar(top.data(), bottom.data(), 0, target.width, space, row);
+        break;
+    }
+  }
+}
+
+/**
+ * @brief Rows of a target of any smaller size. A target texel averages every source
+ * texel it overlaps, up to three on an axis when the source size is odd.
+ */
+void MipBuilder::filter_rows(const MipLevel& source,
+                             const uint8_t*  sourceTexels,
+                             const MipLevel& target,
+                             uint8_t*        targetTexels,
+                             ColorSpace      space,
+                             size_t          begin,
+                             size_t          end) const
+{
+  const float* color    = tables().decode[static_cast<int>(space)];
+  const float* alpha    = tables().decode[0];
+  const float  scale[4] = {color_scale(space), color_scale(space), color_scale(space), 255.0f};
+
+  for (size_t y = begin; y < end; y++) {
+    size_t firstY = y * source.height / target.height;
+    size_t lastY  = std::min(((y + 1) * source.height + target.height - 1) / target.height, size_t(source.height));
+
+    for (size_t x = 0; x < target.width; x++) {
+      size_t firstX = x * source.width / target.width;
+      size_t lastX  = std::min(((x + 1) * source.width + target.width - 1) / target.width, size_t(source.width));
+
+      float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+      for (size_t sy = firstY; sy < lastY; sy++) {
+        const uint8_t* texel = sourceTexels + (sy * source.width + firstX) * 4;
+        for (size_t sx = firstX; sx < lastX; sx++, texel += 4) {
+          sum[0] += color[texel[0]];
+          sum[1] += color[texel[1]];
+          sum[2] += color[texel[2]];
+          sum[3] += alpha[texel[3]];
+        }
+      }
+
+      const float count = static_cast<float>((lastX - firstX) * (lastY - firstY));
+      int32_t     quantised[4];
+      for (uint32_t c = 0; c < 4; c++) {
+        quantised[c] = static_cast<int32_t>(std::lrint(sum[c] / count * scale[c]));
+      }
+      write_texel(quantised, space, targetTexels + (y * target.width + x) * 4);
+    }
+  }
+}
+
+}}  // namespace Rake::Texture
@@ -0,0 +1,88 @@
+#if !defined(MIPCHAIN_H)
+#define MIPCHAIN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "skeleton/simd.h"
+#include "skeleton/threadpool.h"
+
+namespace Rake { namespace Texture {
+
+/**
+ * @brief How the bytes of an RGBA8 texel map to intensity. Filtering averages light, so
+ * sRGB colour is decoded before and encoded after, alpha is always linear.
+ */
+enum class ColorSpace { Linear, Srgb };
+
+/**
+ * @brief One level of a mip chain, tightly packed rows of texels or of compressed blocks in
+ * MipChain::data
+ */
+struct MipLevel {
+  uint32_t width  = 0;
+  uint32_t height = 0;
+  size_t   offset = 0;
+  size_t   size   = 0;
+};
+
+/**
+ * @brief Levels of an image down to 1x1, largest first, in one allocation
+ */
+struct MipChain {
+  std::vector<MipLevel> levels;
+  std::vector<uint8_t>  data;
+
+  uint32_t       level_count() const { return static_cast<uint32_t>(levels.size()); }
+  const uint8_t* level_data(uint32_t level) const { return data.data() + levels[level].offset; }
+  uint8_t*       level_data(uint32_t level) { return data.data() + levels[level].offset; }
+};
+
+uint32_t mip_level_count(uint32_t width, uint32_t height);
+
+/**
+ * @brief Builds RGBA8 mip chains on the CPU with a box filter. Level k is max(1, size >> k)
+ * like a GPU chain. A level that halves exactly averages 2x2 texels with SSE or AVX2,
+ * other sizes average every texel a target texel overlaps. Rows are split over the worker
+ * pool when one is given.
+ *
+ * Every SIMD level produces the same bytes as the scalar path.
+ */
+class MipBuilder {
+  public:
+  explicit MipBuilder(Base::SimdLevel   level   = Base::best_simd_level(),
+                      Base::ThreadPool* workers = nullptr);
+
+  MipChain build(const uint8_t* texels, uint32_t width, uint32_t height, ColorSpace space) const;
+  void     downsample(const MipLevel& source,
+                      const uint8_t*  sourceTexels,
+                      const MipLevel& target,
+                      uint8_t*        targetTexels,
+                      ColorSpace      space) const;
+
+  Base::SimdLevel level() const { return simdLevel; }
+
+  private:
+  void halve_rows(const MipLevel& source,
+                  const uint8_t*  sourceTexels,
+                  const MipLevel& target,
+                  uint8_t*        targetTexels,
+                  ColorSpace      space,
+                  size_t          begin,
+                  size_t          end) const;
+  void filter_rows(const MipLevel& source,
+                   const uint8_t*  sourceTexels,
+                   const MipLevel& target,
+                   uint8_t*        targetTexels,
+                   ColorSpace      space,
+                   size_t          begin,
+                   size_t          end) const;
+
+  Base::SimdLevel   simdLevel;
+  Base::ThreadPool* workers;
+};
+
+}}  // namespace Rake::Texture
+
+#endif  // MIPCHAIN_H
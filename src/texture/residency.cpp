@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "texture/residency.h"
+
+namespace Rake { namespace Texture {
+
+/**
+ * @brief
+ *
+ * @param budget bytes of level data the textures may keep resident, tails may go over it
+ */
+ResidencyManager::ResidencyManager(uint64_t budget)
+{
+  counters.budget = budget;
+}
+
+/**
+ * @brief Track a texture with its tail resident
+ *
+ * @param levels largest first
+ * @param tailLevel most detailed level that is never evicted
+ * @return uint32_t index of the texture
+ */
+uint32_t ResidencyManager::add(const std::vector<MipLevel>& levels, uint32_t tailLevel)
+{
+  if (tailLevel >= levels.size()) {
+    throw std::runtime_error("Texture tail is not one of its levels!");
+  }
+
+  Entry entry;
+  for (const auto& level : levels) {
+    entry.sizes.push_back(level.size);
+  }
+  entry.tail     = tailLevel;
+  entry.resident = tailLevel;
+  entry.wanted   = tailLevel;
+  for (uint32_t level = tailLevel; level < levels.size(); level++) {
+    counters.residentBytes += entry.sizes[level];
+  }
+
+  textures.push_back(std::move(entry));
+  counters.textureCount = static_cast<uint32_t>(textures.size());
+  return counters.textureCount - 1;
+}
+
+/**
+ * @brief Note that a texture is sampled in the current frame
+ *
+ * @param texture
+ * @param level most detailed level the sampling reaches, the tail when coarser
+ */
+void ResidencyManager::use(uint32_t texture, uint32_t level)
+{
+  Entry& entry = textures[texture];
+  level        = std::min(level, entry.tail);
+  if (entry.lastUse != currentFrame) {
+    entry.lastUse = currentFrame;
+    entry.wanted  = level;
+  } else {
+    entry.wanted = std::min(entry.wanted, level);
+  }
+}
+
+/**
+ * @brief End the current frame and decide the levels to move for the uses it saw
+ *
+ * @return std::vector<ResidencyChange> one for each texture whose resident level changes,
+ * they are pending until complete()
+ */
+std::vector<ResidencyChange> ResidencyManager::plan()
+{
+  std::vector<uint32_t> target(textures.size());
+  for (uint32_t texture = 0; texture < textures.size(); texture++) {
+    target[texture] = textures[texture].resident;
+  }
+
+  // Least recently used textures first, then the ones used this frame, down to what they asked for
+  std::vector<uint32_t> victims;
+  std::vector<uint32_t> growing;
+  for (uint32_t texture = 0; texture < textures.size(); texture++) {
+    const Entry& entry = textures[texture];
+    if (!entry.pending && entry.lastUse != currentFrame && entry.resident < entry.tail) {
+      victims.push_back(texture);
+    }
+  }
+  std::stable_sort(victims.begin(), victims.end(), [this](uint32_t a, uint32_t b) {
+    return textures[a].lastUse < textures[b].lastUse;
+  });
+  for (uint32_t texture = 0; texture < textures.size(); texture++) {
+    const Entry& entry = textures[texture];
+    if (!entry.pending && entry.lastUse == currentFrame && entry.resident < entry.wanted) {
+      victims.push_back(texture);
+    }
+    if (!entry.pending && entry.lastUse == currentFrame && entry.wanted < entry.resident) {
+      growing.push_back(texture);
+    }
+  }
+
+  auto lowest = [this](const Entry& entry) { return entry.lastUse == currentFrame ? entry.wanted : entry.tail; };
+
+  // Nothing is evicted for a level that would not fit after all
+  uint64_t evictable = 0;
+  for (uint32_t texture : victims) {
+    const Entry& entry = textures[texture];
+    for (uint32_t level = entry.resident; level < lowest(entry); level++) {
+      evictable += entry.sizes[level];
+    }
+  }
+
+  size_t victim    = 0;
+  auto   make_room = [&](uint64_t bytes) {
+    if (bytes > 0 && counters.residentBytes + bytes > counters.budget + evictable) {
+      return false;
+    }
+    while (counters.residentBytes + bytes > counters.budget && victim < victims.size()) {
+      const Entry& entry = textures[victims[victim]];
+      uint32_t&    level = target[victims[victim]];
+      if (level >= lowest(entry)) {
+        victim++;
+        continue;
+      }
+      evictable -= entry.sizes[level];
+      counters.residentBytes -= entry.sizes[level];
+      counters.evictedBytes += entry.sizes[level];
+      counters.evictedLevels++;
+      level++;
+    }
+    return counters.residentBytes + bytes <= counters.budget;
+  };
+
+  // A budget that shrank below what the last frame asked for takes the largest levels first
+  if (!make_room(0)) {
+    while (counters.residentBytes > counters.budget) {
+      uint32_t largest = static_cast<uint32_t>(textures.size());
+      for (uint32_t texture = 0; texture < textures.size(); texture++) {
+        const Entry& entry = textures[texture];
+        if (entry.pending || target[texture] >= entry.tail) {
+          continue;
+        }
+        if (largest == textures.size() || entry.sizes[target[texture]] > textures[largest].sizes[target[largest]]) {
+          largest = texture;
+        }
+      }
+      if (largest == textures.size()) {
+        break;  // Down to the tails
+      }
+      const uint64_t size = textures[largest].sizes[target[largest]];
+      counters.residentBytes -= size;
+      counters.evictedBytes += size;
+      counters.evictedLevels++;
+      target[largest]++;
+    }
+    growing.clear();
+  }
+
+  while (!growing.empty()) {
+    size_t kept = 0;
+    for (uint32_t texture : growing) {
+      const Entry& entry = textures[texture];
+      uint32_t     level = target[texture] - 1;
+      if (!make_room(entry.sizes[level])) {
+        continue;  // A coarser level of another texture may still fit
+      }
+      counters.residentBytes += entry.sizes[level];
+      counters.streamedBytes += entry.sizes[level];
+      counters.streamedLevels++;
+      target[texture] = level;
+      if (level > entry.wanted) {
+        growing[kept++] = texture;
+      }
+    }
+    growing.resize(kept);
+  }
+
+  std::vector<ResidencyChange> changes;
+  for (uint32_t texture = 0; texture < textures.size(); texture++) {
+    Entry& entry = textures[texture];
+    if (target[texture] != entry.resident) {
+      entry.resident = target[texture];
+      entry.pending  = true;
+      changes.push_back({texture, target[texture]});
+    }
+  }
+  currentFrame++;
+  return changes;
+}
+
+/**
+ * @brief The caller moved a texture to the level plan() gave it
+ *
+ * @param texture
+ */
+void ResidencyManager::complete(uint32_t texture)
+{
+  textures[texture].pending = false;
+}
+
+}}  // namespace Rake::Texture
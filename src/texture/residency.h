@@ -0,0 +1,76 @@
+#if !defined(RESIDENCY_H)
+#define RESIDENCY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "texture/mipchain.h"
+
+namespace Rake { namespace Texture {
+
+/**
+ * @brief Counters of a ResidencyManager, bytes are of level data as it is stored
+ */
+struct ResidencyStats {
+  uint64_t budget         = 0;
+  uint64_t residentBytes  = 0;
+  uint32_t textureCount   = 0;
+  uint64_t evictedLevels  = 0;  // Dropped to stay under budget
+  uint64_t evictedBytes   = 0;
+  uint64_t streamedLevels = 0;  // Made resident on demand, tails aside
+  uint64_t streamedBytes  = 0;
+};
+
+/**
+ * @brief A texture's most detailed resident level moving, every level below it stays
+ */
+struct ResidencyChange {
+  uint32_t texture;
+  uint32_t level;
+};
+
+/**
+ * @brief Decides which mip levels of a set of textures are resident under a memory budget.
+ * Every texture keeps its tail. Levels above it go to the textures used in the last frame,
+ * one level a texture at a time so coarse levels are granted before fine ones. Room is made
+ * by dropping the most detailed levels of the least recently used textures, then levels
+ * textures used in the frame have but did not ask for. Only a budget shrinking below what
+ * the frame asked for takes levels that were asked for, the largest ones first.
+ *
+ * The manager only plans. Bytes are counted from the moment a change is planned, the
+ * caller moves the level data and reports back with complete(). A texture with a change
+ * in flight is left alone until then.
+ */
+class ResidencyManager {
+  public:
+  explicit ResidencyManager(uint64_t budget);
+
+  uint32_t                     add(const std::vector<MipLevel>& levels, uint32_t tailLevel);
+  void                         use(uint32_t texture, uint32_t level);
+  std::vector<ResidencyChange> plan();
+  void                         complete(uint32_t texture);
+  void                         set_budget(uint64_t bytes) { counters.budget = bytes; }
+
+  uint32_t              resident_level(uint32_t texture) const { return textures[texture].resident; }
+  uint64_t              frame() const { return currentFrame; }
+  const ResidencyStats& stats() const { return counters; }
+
+  private:
+  struct Entry {
+    std::vector<uint64_t> sizes;  // Of each level
+    uint32_t              tail     = 0;
+    uint32_t              resident = 0;
+    uint32_t              wanted   = 0;  // Most detailed level asked for in the frame it was last used in
+    uint64_t              lastUse  = 0;  // Frame, 0 before the first use
+    bool                  pending  = false;
+  };
+
+  std::vector<Entry> textures;
+  ResidencyStats     counters;
+  uint64_t           currentFrame = 1;
+};
+
+}}  // namespace Rake::Texture
+
+#endif  // RESIDENCY_H
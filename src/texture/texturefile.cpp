@@ -0,0 +1,304 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Images are decoded on several threads at once, and stb_image keeps its failure reason in
+// a global every failed format probe writes. Nothing here reads it.
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_NO_FAILURE_STRINGS
+#include <stb_image.h>
+
+#define VK_NO_PROTOTYPES
+#include <vulkan/vulkan.h>
+
+#include "texture/imageimport.h"
+#include "texture/texturefile.h"
+
+namespace Rake { namespace Texture {
+
+namespace {
+constexpr char     fileMagic[8] = {'R', 'A', 'K', 'E', 'T', 'E', 'X', '\0'};
+constexpr uint32_t fileVersion  = 1;
+constexpr uint32_t srgbFlag     = 1;
+
+struct FileHeader {
+  char     magic[8];
+  uint32_t version;
+  uint32_t format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t levelCount;
+  uint32_t flags;
+};
+
+struct FileLevel {
+  uint64_t offset;  // From the start of the file
+  uint64_t size;
+};
+}  // namespace
+
+/**
+ * @brief
+ *
+ * @param path
+ * @param texture
+ */
+void write_texture_file(const std::string& path, const TextureFile& texture)
+{
+  const MipChain& mips = texture.mips;
+  if (mips.levels.empty()) {
+    throw std::runtime_error("Cannot write a texture without levels!");
+  }
+
+  FileHeader header = {};
+  std::memcpy(header.magic, fileMagic, sizeof(fileMagic));
+  header.version    = fileVersion;
+  header.format     = texture.format;
+  header.width      = mips.levels[0].width;
+  header.height     = mips.levels[0].height;
+  header.levelCount = mips.level_count();
+  header.flags      = texture.space == ColorSpace::Srgb ? srgbFlag : 0;
+
+  const uint64_t         dataOffset = sizeof(FileHeader) + sizeof(FileLevel) * mips.levels.size();
+  std::vector<FileLevel> index;
+  for (const auto& level : mips.levels) {
+    index.push_back({dataOffset + level.offset, level.size});
+  }
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to create texture file!");
+  }
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(index.data()), sizeof(FileLevel) * index.size());
+  file.write(reinterpret_cast<const char*>(mips.data.data()), mips.data.size());
+  if (!file) {
+    throw std::runtime_error("Failed to write texture file!");
+  }
+}
+
+/**
+ * @brief Map a texture file and check that its index fits the file. Level extents follow
+ * from the header, each halves down to 1 like a GPU mip chain, and every level must be
+ * exactly as large as its extent in the header's format, so copies sized from the extent
+ * stay within the file.
+ *
+ * @param path
+ */
+MappedTexture::MappedTexture(const std::string& path)
+{
+  int file = open(path.c_str(), O_RDONLY);
+  if (file < 0) {
+    throw std::runtime_error("Failed to open texture file!");
+  }
+
+  struct stat status;
+  if (fstat(file, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(FileHeader))) {
+    close(file);
+    throw std::runtime_error("Texture file is truncated!");
+  }
+  mappingSize = static_cast<size_t>(status.st_size);
+  mapping     = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, file, 0);
+  close(file);  // The mapping keeps its own reference
+  if (mapping == MAP_FAILED) {
+    mapping = nullptr;
+    throw std::runtime_error("Failed to map texture file!");
+  }
+  // Read front to back once, by the copy in to staging memory
+  madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+
+  const uint8_t* bytes  = static_cast<const uint8_t*>(mapping);
+  FileHeader     header = {};
+  std::memcpy(&header, bytes, sizeof(header));
+  try {
+    if (std::memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0 || header.version != fileVersion) {
+      throw std::runtime_error("Not a texture file of this version!");
+    }
+    BlockFormat blockFormat;
+    const bool  compressed = block_format(header.format, blockFormat);
+    if (!compressed && header.format != VK_FORMAT_R8G8B8A8_UNORM && header.format != VK_FORMAT_R8G8B8A8_SRGB) {
+      throw std::runtime_error("Texture file has an unsupported format!");
+    }
+    if (header.width == 0 || header.height == 0) {
+      throw std::runtime_error("Texture file has an empty extent!");
+    }
+    if (header.levelCount == 0 || header.levelCount > mip_level_count(header.width, header.height) ||
+        sizeof(FileHeader) + sizeof(FileLevel) * header.levelCount > mappingSize) {
+      throw std::runtime_error("Texture file has an invalid level count!");
+    }
+
+    std::vector<FileLevel> index(header.levelCount);
+    std::memcpy(index.data(), bytes + sizeof(FileHeader), sizeof(FileLevel) * index.size());
+
+    // Levels are stored back to back after the index, so all of them are one range of the
+    // file. dataOffset + dataSize stays within the mapping, so neither sum can wrap.
+    const uint64_t dataOffset = index[0].offset;
+    uint64_t       dataSize   = 0;
+    if (dataOffset < sizeof(FileHeader) + sizeof(FileLevel) * header.levelCount || dataOffset > mappingSize) {
+      throw std::runtime_error("Texture file levels are outside its data!");
+    }
+    for (uint32_t level = 0; level < header.levelCount; level++) {
+      if (index[level].offset != dataOffset + dataSize) {
+        throw std::runtime_error("Texture file levels are not tightly packed!");
+      }
+      MipLevel mip = {std::max(header.width >> level, 1u),
+                      std::max(header.height >> level, 1u),
+                      static_cast<size_t>(dataSize),
+                      static_cast<size_t>(index[level].size)};
+      size_t expected = compressed ? block_level_size(blockFormat, mip.width, mip.height)
+                                   : size_t(mip.width) * mip.height * 4;
+      if (index[level].size != expected) {
+        throw std::runtime_error("Texture file level size does not match its extent!");
+      }
+      if (index[level].size > mappingSize - dataOffset - dataSize) {
+        throw std::runtime_error("Texture file is truncated!");
+      }
+      mipLevels.push_back(mip);
+      dataSize += index[level].size;
+    }
+
+    textureFormat = header.format;
+    colorSpace    = header.flags & srgbFlag ? ColorSpace::Srgb : ColorSpace::Linear;
+    levelData     = bytes + dataOffset;
+    levelDataSize = static_cast<size_t>(dataSize);
+  } catch (...) {
+    munmap(mapping, mappingSize);
+    throw;
+  }
+}
+
+MappedTexture::~MappedTexture()
+{
+  munmap(mapping, mappingSize);
+}
+
+/**
+ * @brief Copy of a whole texture file
+ *
+ * @param path
+ * @return TextureFile
+ */
+TextureFile read_texture_file(const std::string& path)
+{
+  MappedTexture mapped(path);
+
+  TextureFile texture;
+  texture.format      = mapped.format();
+  texture.space       = mapped.space();
+  texture.mips.levels = mapped.levels();
+  texture.mips.data.assign(mapped.data(), mapped.data() + mapped.data_size());
+  return texture;
+}
+
+/**
+ * @brief The block format a VkFormat stores its levels in
+ *
+ * @param format VkFormat
+ * @param blockFormat set when the format is block compressed
+ * @return false for uncompressed formats, and compressed ones there is no encoder for
+ */
+bool block_format(uint32_t format, BlockFormat& blockFormat)
+{
+  switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+      blockFormat = BlockFormat::Bc1;
+      return true;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+      blockFormat = BlockFormat::Bc3;
+      return true;
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+      blockFormat = BlockFormat::Bc7;
+      return true;
+    default:
+      return false;
+  }
+}
+
+/**
+ * @brief Where bake_texture() output for an image is kept, next to it
+ *
+ * @param imagePath
+ * @return std::string the image path with its extension replaced by .rtex
+ */
+std::string baked_texture_path(const std::string& imagePath)
+{
+  size_t dot   = imagePath.find_last_of('.');
+  size_t slash = imagePath.find_last_of('/');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+    return imagePath + ".rtex";
+  }
+  return imagePath.substr(0, dot) + ".rtex";
+}
+
+/**
+ * @brief Decode an image to RGBA8, without further levels
+ *
+ * @param imagePath any format stb_image reads
+ * @param format VkFormat to record, must store RGBA8 texels
+ * @param space of the image's colour channels
+ * @return TextureFile with level 0 only
+ */
+TextureFile decode_image(const std::string& imagePath, uint32_t format, ColorSpace space)
+{
+  uint32_t width, height;
+  if (!ImageImporter::image_size(imagePath, width, height)) {
+    throw std::runtime_error("Failed to load texture image!");
+  }
+
+  MipLevel level = {width, height, 0, size_t(width) * height * 4};
+
+  TextureFile texture;
+  texture.format = format;
+  texture.space  = space;
+  texture.mips.levels.push_back(level);
+  texture.mips.data.resize(level.size);
+
+  // The ring is the level itself, the importer decodes straight in to it
+  StagingRing   ring(texture.mips.data.data(), level.size);
+  ImageImporter importer(ring);
+  importer.submit(imagePath);
+  ring.release(importer.next().texels);
+  return texture;
+}
+
+/**
+ * @brief Decode an image to RGBA8 and build its mip chain on the CPU, then block compress
+ * every level when the format is one block_format() knows
+ *
+ * @param imagePath any format stb_image reads
+ * @param format VkFormat to record, RGBA8 texels or a block compressed format
+ * @param space of the image's colour channels
+ * @param workers optional, to filter and encode in parallel
+ * @return TextureFile
+ */
+TextureFile bake_texture(const std::string& imagePath, uint32_t format, ColorSpace space, Base::ThreadPool* workers)
+{
+  TextureFile     image = decode_image(imagePath, format, space);
+  const MipLevel& top   = image.mips.levels[0];
+  MipBuilder      builder(Base::best_simd_level(), workers);
+
+  TextureFile texture;
+  texture.format = format;
+  texture.space  = space;
+  texture.mips   = builder.build(image.mips.level_data(0), top.width, top.height, space);
+
+  BlockFormat blockFormat;
+  if (block_format(format, blockFormat)) {
+    BlockEncoder encoder(Base::best_simd_level(), workers);
+    texture.mips = encoder.encode(texture.mips, blockFormat);
+  }
+  return texture;
+}
+
+}}  // namespace Rake::Texture
@@ -0,0 +1,65 @@
+#if !defined(TEXTUREFILE_H)
+#define TEXTUREFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "skeleton/threadpool.h"
+#include "texture/blockcompress.h"
+#include "texture/mipchain.h"
+
+namespace Rake { namespace Texture {
+
+/**
+ * @brief Texture ready for upload, every level in the layout the GPU copies from
+ */
+struct TextureFile {
+  uint32_t   format = 0;  // VkFormat of the level data
+  ColorSpace space  = ColorSpace::Linear;
+  MipChain   mips;
+};
+
+/**
+ * @brief A texture file mapped read only. Level data is read in place from the page cache,
+ * a copy to staging memory is the only one it takes.
+ *
+ * On disk a texture is a header, an index with the offset and size of each level, then the
+ * level data tightly packed, largest level first. Fields are little endian.
+ */
+class MappedTexture {
+  public:
+  explicit MappedTexture(const std::string& path);
+  ~MappedTexture();
+
+  MappedTexture(const MappedTexture&) = delete;
+  MappedTexture& operator=(const MappedTexture&) = delete;
+
+  uint32_t                     format() const { return textureFormat; }
+  ColorSpace                   space() const { return colorSpace; }
+  const std::vector<MipLevel>& levels() const { return mipLevels; }
+  const uint8_t*               data() const { return levelData; }  // Level 0, the others follow
+  size_t                       data_size() const { return levelDataSize; }
+
+  private:
+  void*                 mapping       = nullptr;
+  size_t                mappingSize   = 0;
+  uint32_t              textureFormat = 0;
+  ColorSpace            colorSpace    = ColorSpace::Linear;
+  std::vector<MipLevel> mipLevels;  // Offsets from data()
+  const uint8_t*        levelData     = nullptr;
+  size_t                levelDataSize = 0;
+};
+
+void        write_texture_file(const std::string& path, const TextureFile& texture);
+TextureFile read_texture_file(const std::string& path);
+
+bool        block_format(uint32_t format, BlockFormat& blockFormat);
+std::string baked_texture_path(const std::string& imagePath);
+TextureFile decode_image(const std::string& imagePath, uint32_t format, ColorSpace space);
+TextureFile bake_texture(const std::string& imagePath, uint32_t format, ColorSpace space, Base::ThreadPool* workers);
+
+}}  // namespace Rake::Texture
+
+#endif  // TEXTUREFILE_H
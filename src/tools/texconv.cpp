@@ -0,0 +1,86 @@
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define VK_NO_PROTOTYPES
+#include <vulkan/vulkan.h>
+
+#include "skeleton/threadpool.h"
+#include "texture/texturefile.h"
+
+namespace {
+struct FormatName {
+  const char* name;
+  VkFormat    format;
+};
+
+// The formats the renderer asks for
+const FormatName formats[] = {{"rgba8", VK_FORMAT_R8G8B8A8_UNORM},
+                              {"bc1", VK_FORMAT_BC1_RGB_UNORM_BLOCK},
+                              {"bc3", VK_FORMAT_BC3_UNORM_BLOCK},
+                              {"bc7", VK_FORMAT_BC7_UNORM_BLOCK}};
+
+void usage(const std::string& name)
+{
+  std::cout << "Usage: " << name << " [--linear] [--format <f>] <image> [<output.rtex>]\n"
+            << " Decode an image, build its mip chain and store it as a texture file the renderer\n"
+            << " maps at startup. The output defaults to the image path with the extension .rtex.\n"
+            << " --linear \t the image holds data rather than sRGB colour\n"
+            << " --format <f> \t bc7 (default), bc3, bc1 or rgba8\n";
+}
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  std::vector<std::string> params(argv, argv + argc);
+
+  Rake::Texture::ColorSpace space  = Rake::Texture::ColorSpace::Srgb;
+  VkFormat                  format = VK_FORMAT_BC7_UNORM_BLOCK;
+  std::vector<std::string>  paths;
+  for (size_t i = 1; i < params.size(); i++) {
+    if (params[i] == "--linear") {
+      space = Rake::Texture::ColorSpace::Linear;
+    } else if (params[i] == "--format" && i + 1 < params.size()) {
+      const std::string& name = params[++i];
+      format                  = VK_FORMAT_UNDEFINED;
+      for (const auto& candidate : formats) {
+        if (name == candidate.name) {
+          format = candidate.format;
+        }
+      }
+      if (format == VK_FORMAT_UNDEFINED) {
+        std::cerr << "Unknown format: " << name << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if (params[i] == "-h" || params[i] == "--help") {
+      usage(params[0]);
+      return EXIT_SUCCESS;
+    } else {
+      paths.push_back(params[i]);
+    }
+  }
+  if (paths.empty() || paths.size() > 2) {
+    usage(params[0]);
+    return EXIT_FAILURE;
+  }
+
+  const std::string& imagePath  = paths[0];
+  std::string        outputPath = paths.size() > 1 ? paths[1] : Rake::Texture::baked_texture_path(imagePath);
+  try {
+    Rake::Base::ThreadPool     workers;
+    Rake::Texture::TextureFile texture =
+        Rake::Texture::bake_texture(imagePath, format, space, &workers);
+    Rake::Texture::write_texture_file(outputPath, texture);
+
+    const Rake::Texture::MipLevel& top = texture.mips.levels[0];
+    std::cout << imagePath << ": " << top.width << "x" << top.height << ", " << texture.mips.level_count()
+              << " levels, " << texture.mips.data.size() << " bytes to " << outputPath << std::endl;
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
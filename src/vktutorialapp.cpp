@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <string>
 
@@ -7,6 +8,8 @@
 #include "vktutorialapp.h"
 #include "config.h"
 
+#include "benchmark/benchmark.h"
+
 #include "vulkan/VulkanFunctions.h"
 
 namespace Rake::Application {
@@ -34,12 +37,30 @@ int vkTutorialApp::main()
   // SDL_Event event;
   // Start Main Application Here.
   init_window();
+  if (benchmark == "gpu-culling") {
+    settings.validateCulling = true;
+  }
+  if (benchmark == "mipmaps") {  // Levels are generated again in the texture, which needs it uncompressed
+    settings.textureCompression = Graphics::TextureCompression::None;
+  }
+  if (benchmark == "texture-residency") {
+    settings.texturePool   = true;
+    settings.textureCount  = std::max(settings.textureCount, 16u);
+    settings.instanceCount = std::max(settings.instanceCount, settings.textureCount);
+  }
+  vkcore.configure(settings);
   vkcore.init_vulkan(connection, handle);
 
   /*   while (event.type != SDL_QUIT) {
         SDL_PollEvent(&event);
     }
 */
+  if (!benchmark.empty()) {
+    bool completed = run_benchmark(benchmark);
+    cleanup();
+    return completed ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
   if (!rendering_loop()) {
     cleanup();
     return EXIT_FAILURE;
@@ -58,6 +79,8 @@ int vkTutorialApp::main(std::vector<std::string>& params)
 {
   // std::vector<std::string> actions;
   std::vector<std::string> dump;
+  bool                     qualityGiven     = false;
+  bool                     compressionGiven = false;
 
   // iterate through params to remove the -- from the text
   for (std::vector<std::string>::const_iterator i = params.begin(); i != params.end(); ++i) {
@@ -68,10 +91,81 @@ int vkTutorialApp::main(std::vector<std::string>& params)
     } else if (*i == "--version" || *i == "-V") {
       version();
       return EXIT_SUCCESS;
+    } else if (*i == "--no-bindless") {
+      settings.bindlessTextures = false;
+    } else if (*i == "--no-gpu-culling") {
+      settings.gpuCulling = false;
+    } else if (*i == "--no-cpu-culling") {
+      settings.cpuCulling = false;
+    } else if (*i == "--no-cluster-culling") {
+      settings.clusterCulling = false;
+    } else if (*i == "--no-occlusion-culling") {
+      settings.occlusionCulling = false;
+    } else if (*i == "--depth-prepass") {
+      settings.depthPrepass = true;
+    } else if (*i == "--no-lazy-attachments") {
+      settings.lazyAttachments = false;
+    } else if (*i == "--no-baked-mipmaps") {
+      settings.bakedMipmaps = false;
+    } else if (*i == "--blit-mipmaps") {
+      settings.computeMipmaps = false;
+    } else if (*i == "--no-texture-streaming") {
+      settings.streamTextures = false;
+    } else if (*i == "--texture-pool") {
+      settings.texturePool = true;
+    } else if (*i == "--texture-budget" && i + 1 != params.end()) {
+      settings.texturePool   = true;
+      settings.textureBudget = static_cast<uint32_t>(std::stoul(*++i));
+    } else if (*i == "--texture-count" && i + 1 != params.end()) {
+      settings.texturePool  = true;
+      settings.textureCount = static_cast<uint32_t>(std::stoul(*++i));
+    } else if (*i == "--quality" && i + 1 != params.end()) {
+      const std::string& name = *++i;
+      qualityGiven            = false;
+      for (uint32_t tier = 0; tier < Graphics::qualityTierCount; tier++) {
+        if (name == Graphics::quality_tier_name(static_cast<Graphics::QualityTier>(tier))) {
+          settings.quality = static_cast<Graphics::QualityTier>(tier);
+          qualityGiven     = true;
+        }
+      }
+      if (!qualityGiven) {
+        std::cerr << "Unknown quality tier: " << name << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if (*i == "--texture-compression" && i + 1 != params.end()) {
+      const std::string& name = *++i;
+      compressionGiven        = false;
+      for (uint32_t compression = 0; compression < Graphics::textureCompressionCount; compression++) {
+        auto candidate = static_cast<Graphics::TextureCompression>(compression);
+        if (name == Graphics::texture_compression_name(candidate)) {
+          settings.textureCompression = candidate;
+          compressionGiven            = true;
+        }
+      }
+      if (!compressionGiven) {
+        std::cerr << "Unknown texture compression: " << name << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if (*i == "--auto-quality" && i + 1 != params.end()) {
+      settings.qualityTargetMs = std::stod(*++i);
+    } else if (*i == "--render-scale" && i + 1 != params.end()) {
+      settings.renderScale = std::stof(*++i);
+    } else if (*i == "--dynamic-resolution" && i + 1 != params.end()) {
+      settings.resolutionTargetMs = std::stod(*++i);
+    } else if (*i == "--lods" && i + 1 != params.end()) {
+      settings.lodCount = static_cast<uint32_t>(std::stoul(*++i));
+    } else if (*i == "--instances" && i + 1 != params.end()) {
+      settings.instanceCount = static_cast<uint32_t>(std::stoul(*++i));
+    } else if (*i == "--benchmark" && i + 1 != params.end()) {
+      benchmark = *++i;
     } else {  // catch all to make sure there are no invalid parameters
       dump.push_back(*i);
     }
   }
+  // Auto-tuning only steps down, without a ceiling it starts from the top.
+  if (settings.qualityTargetMs > 0.0 && !qualityGiven) {
+    settings.quality = Graphics::QualityTier::Ultra;
+  }
 
   return main();
 }
@@ -86,6 +180,30 @@ void vkTutorialApp::help(void)
   std::cout << "Options: \n";
   std::cout << " -h, --help \t\t Print this help message and exit the program.\n";
   std::cout << " -V, --version \t\t Print the version and exit.\n";
+  std::cout << " --no-bindless \t\t Bind textures per model instead of through a global texture array.\n";
+  std::cout << " --no-gpu-culling \t Cull instances on the CPU instead of in a compute pass.\n";
+  std::cout << " --no-cpu-culling \t Draw every instance when GPU culling is off.\n";
+  std::cout << " --no-cluster-culling \t Draw whole meshes instead of culling their meshlets on the GPU.\n";
+  std::cout << " --no-occlusion-culling Skip the depth pyramid and cull against the frustum only.\n";
+  std::cout << " --depth-prepass \t Lay down depth first so only visible fragments are shaded.\n";
+  std::cout << " --no-lazy-attachments \t Back the multisampled attachments with device local memory.\n";
+  std::cout << " --no-baked-mipmaps \t Upload level 0 and generate the other texture mip levels on the GPU.\n";
+  std::cout << " --blit-mipmaps \t Generate texture mip levels with a blit per level instead of in compute.\n";
+  std::cout << " --texture-compression <c> Bake textures as bc7 (default), bc3, bc1 or none.\n";
+  std::cout << " --no-texture-streaming \t Upload every texture level before the first frame.\n";
+  std::cout << " --texture-pool \t Keep textures in a pool that evicts their top levels to stay under budget.\n";
+  std::cout << " --texture-budget <MB> \t Pool textures within MB, 0 (default) takes half of the free device memory.\n";
+  std::cout << " --texture-count <n> \t Pool n copies of the model's texture, instances take them in turn.\n";
+  std::cout << " --quality <tier> \t MSAA and sample shading: low, medium (default), high or ultra.\n";
+  std::cout << " --auto-quality <ms> \t Step the quality tier down at startup until a GPU frame takes at most ms.\n";
+  std::cout << " --render-scale <s> \t Draw at s times the window resolution per axis and upscale.\n";
+  std::cout << " --dynamic-resolution <ms> Scale the resolution so a GPU frame takes about ms.\n";
+  std::cout << " --instances <n> \t Draw n copies of the model on a grid.\n";
+  std::cout << " --lods <n> \t\t Generate n detail levels for the model, 1 always draws full detail.\n";
+  std::cout << " --benchmark <name> \t Run a benchmark and exit.\n";
+  std::cout << " \t\t\t Benchmarks: instancing, gpu-culling, depth-prepass, attachment-memory,\n";
+  std::cout << " \t\t\t msaa, dynamic-resolution, mipmaps, texture-streaming, texture-residency.\n";
+  std::cout << " \t\t\t The benchmarks that need no GPU are run with vktut-bench.\n";
 }
 
 /**
@@ -166,7 +284,7 @@ void vkTutorialApp::init_input()
 * @return true
 * @return false
 */
-bool vkTutorialApp::rendering_loop()
+void vkTutorialApp::show_window()
 {
   xcb_intern_atom_cookie_t protocols_cookie = xcb_intern_atom(connection, 1, 12, "WM_PROTOCOLS");
   xcb_intern_atom_reply_t* protocols_reply  = xcb_intern_atom_reply(connection, protocols_cookie, 0);
@@ -180,11 +298,24 @@ bool vkTutorialApp::rendering_loop()
                       32,
                       1,
                       &(*delete_reply).atom);
+  wm_delete_window = (*delete_reply).atom;
   free(protocols_reply);
+  free(delete_reply);
 
   // Display window
   xcb_map_window(connection, handle);
   xcb_flush(connection);
+}
+
+/**
+* @brief
+*
+* @return true
+* @return false
+*/
+bool vkTutorialApp::rendering_loop()
+{
+  show_window();
 
   // Main message loop
   xcb_generic_event_t* xevent;
@@ -211,9 +342,8 @@ bool vkTutorialApp::rendering_loop()
         } break;
           //close
         case XCB_CLIENT_MESSAGE:
-          if ((*(xcb_client_message_event_t*)xevent).data.data32[0] == (*delete_reply).atom) {
+          if ((*(xcb_client_message_event_t*)xevent).data.data32[0] == wm_delete_window) {
             loop = false;
-            free(delete_reply);
           }
           break;
         case XCB_KEY_PRESS:
@@ -245,4 +375,523 @@ bool vkTutorialApp::rendering_loop()
   return result;
 }
 
+/**
+ * @brief Drain pending window events without acting on resizes
+ *
+ * @return false once the window was closed or a key was pressed
+ */
+bool vkTutorialApp::poll_events()
+{
+  bool open = true;
+  while (xcb_generic_event_t* xevent = xcb_poll_for_event(connection)) {
+    switch (xevent->response_type & 0x7f) {
+      case XCB_CLIENT_MESSAGE:
+        if ((*(xcb_client_message_event_t*)xevent).data.data32[0] == wm_delete_window) {
+          open = false;
+        }
+        break;
+      case XCB_KEY_PRESS:
+        open = false;
+        break;
+    }
+    free(xevent);
+  }
+  return open;
+}
+
+/**
+ * @brief
+ *
+ * @param name
+ * @return false when the benchmark is unknown or was interrupted
+ */
+bool vkTutorialApp::run_benchmark(const std::string& name)
+{
+  show_window();
+
+  if (name == "instancing") {
+    return benchmark_instancing();
+  }
+  if (name == "gpu-culling") {
+    return benchmark_gpu_culling();
+  }
+  if (name == "depth-prepass") {
+    return benchmark_depth_prepass();
+  }
+  if (name == "attachment-memory") {
+    return benchmark_attachment_memory();
+  }
+  if (name == "msaa") {
+    return benchmark_msaa();
+  }
+  if (name == "dynamic-resolution") {
+    return benchmark_dynamic_resolution();
+  }
+  if (name == "mipmaps") {
+    return benchmark_mipmaps();
+  }
+  if (name == "texture-streaming") {
+    return benchmark_texture_streaming();
+  }
+  if (name == "texture-residency") {
+    return benchmark_texture_residency();
+  }
+
+  std::cerr << "Unknown benchmark: " << name << std::endl;
+  return false;
+}
+
+/**
+ * @brief Render frames until count more have completed, sampling the frame timings
+ *
+ * @param count
+ * @param cpu
+ * @param gpu
+ * @return false when the window was closed or drawing failed
+ */
+bool vkTutorialApp::render_frames(uint32_t count, Benchmark::Samples* cpu, Benchmark::Samples* gpu)
+{
+  uint64_t last = vkcore.frames_rendered() + count;
+  while (vkcore.frames_rendered() < last) {
+    if (!poll_events() || !vkcore.draw()) {
+      return false;
+    }
+    if (cpu != nullptr) {
+      cpu->add(vkcore.frame_timings().cpuMilliseconds);
+    }
+    if (gpu != nullptr) {
+      gpu->add(vkcore.frame_timings().gpuMilliseconds);
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Frame cost of one instanced draw as the instance count grows. GPU times are
+ * read back a couple of frames late, the warm up frames cover that.
+ *
+ * @return false when interrupted
+ */
+bool vkTutorialApp::benchmark_instancing()
+{
+  const std::vector<uint32_t> counts         = {1, 10, 100, 1000, 10000, 100000, 1000000};
+  const uint32_t              warmupFrames   = 30;
+  const uint32_t              measuredFrames = 200;
+
+  Benchmark::Table table({"instances", "cpu ms", "gpu ms", "gpu ns/instance"});
+
+  for (auto count : counts) {
+    vkcore.set_instance_count(count);
+
+    Benchmark::Samples cpu;
+    Benchmark::Samples gpu;
+    if (!render_frames(warmupFrames, nullptr, nullptr) || !render_frames(measuredFrames, &cpu, &gpu)) {
+      return false;
+    }
+
+    table.row({std::to_string(count),
+               Benchmark::format(cpu.median()),
+               Benchmark::format(gpu.median()),
+               Benchmark::format(gpu.median() * 1.0e6 / count, 1)});
+  }
+
+  std::cout << "Instancing, " << measuredFrames << " frames per count, median\n";
+  table.print(std::cout);
+  return true;
+}
+
+/**
+ * @brief Frame cost with compute culling as the instance count grows. The draw count
+ * and the surviving instances are read back from the GPU and checked against the same
+ * test run on the CPU, so this also verifies culling on a software implementation.
+ * With occlusion culling the frustum count of the late phase is checked, the occluded
+ * column is how many of those the depth pyramid rejected.
+ *
+ * @return false when interrupted, culling is unavailable or the counts disagree
+ */
+bool vkTutorialApp::benchmark_gpu_culling()
+{
+  const std::vector<uint32_t> counts         = {1, 100, 10000, 100000, 1000000};
+  const uint32_t              warmupFrames   = 30;
+  const uint32_t              measuredFrames = 200;
+
+  if (!vkcore.gpu_culling_enabled()) {
+    std::cerr << "GPU culling is not available on this device." << std::endl;
+    return false;
+  }
+
+  Benchmark::Table table({"instances", "cpu ms", "gpu ms", "draws", "visible", "expected", "occluded", "meshlets"});
+  bool             matched = true;
+
+  for (auto count : counts) {
+    vkcore.set_instance_count(count);
+
+    Benchmark::Samples cpu;
+    Benchmark::Samples gpu;
+    if (!render_frames(warmupFrames, nullptr, nullptr) || !render_frames(measuredFrames, &cpu, &gpu)) {
+      return false;
+    }
+
+    // The camera only moves with the instance count, the last frame is representative.
+    const auto& stats = vkcore.culling_stats();
+    matched           = matched && stats.frustumInstances == stats.expectedVisible;
+
+    table.row({std::to_string(count),
+               Benchmark::format(cpu.median()),
+               Benchmark::format(gpu.median()),
+               std::to_string(stats.drawCount),
+               std::to_string(stats.visibleInstances),
+               std::to_string(stats.expectedVisible),
+               vkcore.occlusion_culling_enabled() ? std::to_string(stats.occludedInstances) : "-",
+               stats.totalClusters > 0
+                   ? std::to_string(stats.visibleClusters) + "/" + std::to_string(stats.totalClusters)
+                   : "-"});
+  }
+
+  std::cout << "GPU culling, " << measuredFrames << " frames per count, median\n";
+  table.print(std::cout);
+  if (!matched) {
+    std::cerr << "GPU visible instance counts do not match the CPU reference!" << std::endl;
+  }
+  return matched;
+}
+
+/**
+ * @brief GPU frame time with and without the depth pre-pass as the instance count grows.
+ * The pre-pass pays for a second geometry pass to shade each covered sample once, so it
+ * only wins once instances overlap enough.
+ *
+ * @return false when interrupted
+ */
+bool vkTutorialApp::benchmark_depth_prepass()
+{
+  const std::vector<uint32_t> counts         = {1, 100, 10000, 100000};
+  const uint32_t              warmupFrames   = 30;
+  const uint32_t              measuredFrames = 200;
+
+  Benchmark::Table table({"instances", "gpu ms off", "gpu ms on", "speedup"});
+
+  for (auto count : counts) {
+    vkcore.set_instance_count(count);
+
+    Benchmark::Samples gpu[2];
+    for (int prepass = 0; prepass < 2; prepass++) {
+      vkcore.set_depth_prepass(prepass == 1);
+      if (!render_frames(warmupFrames, nullptr, nullptr) || !render_frames(measuredFrames, nullptr, &gpu[prepass])) {
+        return false;
+      }
+    }
+
+    table.row({std::to_string(count),
+               Benchmark::format(gpu[0].median()),
+               Benchmark::format(gpu[1].median()),
+               Benchmark::format(gpu[0].median() / std::max(gpu[1].median(), 1.0e-6), 2) + "x"});
+  }
+  vkcore.set_depth_prepass(settings.depthPrepass);
+
+  std::cout << "Depth pre-pass, " << measuredFrames << " frames per count and mode, median\n";
+  table.print(std::cout);
+  return true;
+}
+
+/**
+ * @brief Memory the multisampled attachments take with device local memory and with
+ * lazily allocated memory, after some frames have been drawn so the device has committed
+ * whatever it needs. On tiled GPUs the transient attachments never leave tile memory.
+ *
+ * @return false when interrupted
+ */
+bool vkTutorialApp::benchmark_attachment_memory()
+{
+  const uint32_t warmupFrames   = 30;
+  const uint32_t measuredFrames = 200;
+  const double   megabyte       = 1024.0 * 1024.0;
+
+  Benchmark::Table table({"memory", "attachment", "allocated MB", "committed MB", "transient", "gpu ms"});
+  double           committed[2] = {0.0, 0.0};
+
+  for (int lazy = 0; lazy < 2; lazy++) {
+    vkcore.set_lazy_attachments(lazy == 1);
+
+    Benchmark::Samples gpu;
+    if (!render_frames(warmupFrames, nullptr, nullptr) || !render_frames(measuredFrames, nullptr, &gpu)) {
+      return false;
+    }
+
+    for (const auto& attachment : vkcore.attachment_memory()) {
+      committed[lazy] += attachment.committed / megabyte;
+      table.row({attachment.lazy ? "lazy" : "device local",
+                 attachment.name,
+                 Benchmark::format(attachment.size / megabyte, 1),
+                 Benchmark::format(attachment.committed / megabyte, 1),
+                 attachment.transient ? "yes" : "no",
+                 Benchmark::format(gpu.median())});
+    }
+  }
+  vkcore.set_lazy_attachments(settings.lazyAttachments);
+
+  std::cout << "Attachment memory, " << measuredFrames << " frames per mode, median gpu time\n";
+  table.print(std::cout);
+  std::cout << "Saved " << Benchmark::format(committed[0] - committed[1], 1) << " MB of "
+            << Benchmark::format(committed[0], 1) << " MB\n";
+  if (vkcore.occlusion_culling_enabled()) {
+    std::cout << "The late draw loads both attachments with occlusion culling, see --no-occlusion-culling\n";
+  }
+  return true;
+}
+
+/**
+ * @brief GPU frame time of every quality tier as the instance count grows, and the tier
+ * the auto-tuner would settle on for the target frame time, 16.7 ms unless one is given
+ *
+ * @return false when interrupted
+ */
+bool vkTutorialApp::benchmark_msaa()
+{
+  const std::vector<uint32_t> counts         = {1, 1000, 100000};
+  const uint32_t              warmupFrames   = 30;
+  const uint32_t              measuredFrames = 200;
+  const double                target         = settings.qualityTargetMs > 0.0 ? settings.qualityTargetMs : 16.7;
+
+  Benchmark::Table         table({"instances", "tier", "samples", "sample shading", "gpu ms", "within target"});
+  std::vector<std::string> picks;
+
+  for (auto count : counts) {
+    vkcore.set_instance_count(count);
+
+    std::string picked = Graphics::quality_tier_name(Graphics::QualityTier::Low);
+    for (uint32_t tier = 0; tier < Graphics::qualityTierCount; tier++) {
+      vkcore.set_quality_tier(static_cast<Graphics::QualityTier>(tier));
+
+      Benchmark::Samples gpu;
+      if (!render_frames(warmupFrames, nullptr, nullptr) || !render_frames(measuredFrames, nullptr, &gpu)) {
+        return false;
+      }
+
+      bool within = gpu.median() <= target;
+      if (within) {
+        picked = Graphics::quality_tier_name(vkcore.quality_tier());
+      }
+      table.row({std::to_string(count),
+                 Graphics::quality_tier_name(vkcore.quality_tier()),
+                 std::to_string(vkcore.sample_count()) + "x",
+                 Benchmark::format(vkcore.sample_shading(), 2),
+                 Benchmark::format(gpu.median()),
+                 within ? "yes" : "no"});
+    }
+    picks.push_back(std::to_string(count) + " instances: " + picked);
+  }
+  vkcore.set_quality_tier(settings.quality);
+
+  std::cout << "Quality tiers, " << measuredFrames << " frames per count and tier, median\n";
+  table.print(std::cout);
+  std::cout << "Highest tier within " << Benchmark::format(target, 1) << " ms\n";
+  for (const auto& pick : picks) {
+    std::cout << "  " << pick << "\n";
+  }
+  return true;
+}
+
+/**
+ * @brief GPU frame time at fixed render scales, then how close the resolution controller
+ * holds a target below the native cost, 75% of it unless one is given. Native resolution
+ * is measured without the upscale pass.
+ *
+ * @return false when interrupted
+ */
+bool vkTutorialApp::benchmark_dynamic_resolution()
+{
+  const std::vector<float> scales           = {1.0f, 0.85f, 0.7f, 0.5f};
+  const uint32_t           warmupFrames     = 30;
+  const uint32_t           measuredFrames   = 200;
+  const uint32_t           controlledFrames = 600;  // For the controller to settle
+
+  Benchmark::Table table({"render scale", "extent", "gpu ms", "speedup"});
+  double           native = 0.0;
+
+  for (auto scale : scales) {
+    vkcore.set_render_scale(scale);
+
+    Benchmark::Samples gpu;
+    if (!render_frames(warmupFrames, nullptr, nullptr) || !render_frames(measuredFrames, nullptr, &gpu)) {
+      return false;
+    }
+    if (native == 0.0) {
+      native = gpu.median();
+    }
+
+    VkExtent2D extent = vkcore.render_extent();
+    table.row({Benchmark::format(vkcore.render_scale(), 2),
+               std::to_string(extent.width) + "x" + std::to_string(extent.height),
+               Benchmark::format(gpu.median()),
+               Benchmark::format(native / std::max(gpu.median(), 1.0e-6), 2) + "x"});
+  }
+
+  std::cout << "Render scale, " << measuredFrames << " frames per scale, median\n";
+  table.print(std::cout);
+  if (!vkcore.upscaling_enabled()) {
+    std::cout << "Upscaling is not supported, every scale drew at native resolution\n";
+    return true;
+  }
+
+  double target = settings.resolutionTargetMs > 0.0 ? settings.resolutionTargetMs : 0.75 * native;
+  vkcore.set_resolution_target(target);
+
+  Benchmark::Samples controlled;
+  if (!render_frames(controlledFrames, nullptr, nullptr) || !render_frames(measuredFrames, nullptr, &controlled)) {
+    return false;
+  }
+  float settled = vkcore.render_scale();
+
+  vkcore.set_render_scale(settings.renderScale);
+  vkcore.set_resolution_target(settings.resolutionTargetMs);
+
+  std::cout << "Dynamic resolution: " << Benchmark::format(controlled.median()) << " ms against a target of "
+            << Benchmark::format(target) << " ms at render scale " << Benchmark::format(settled, 2) << "\n";
+  return true;
+}
+
+/**
+ * @brief Time to generate the mip chain of the model's texture by blitting level by level
+ * and by downsampling in compute, from recording until the queue is idle. On a software
+ * ICD such as lavapipe both run on the CPU, so this compares the work and the barriers
+ * each path takes rather than GPU fixed function blit hardware.
+ *
+ * @return false when interrupted
+ */
+bool vkTutorialApp::benchmark_mipmaps()
+{
+  const uint32_t warmupRuns   = 3;
+  const uint32_t measuredRuns = 20;
+
+  Benchmark::Table table({"path", "runs", "median ms", "min ms", "speedup"});
+  double           blit = 0.0;
+
+  for (int compute = 0; compute < 2; compute++) {
+    if (compute == 1 && !vkcore.compute_mipmaps_enabled()) {
+      const char* reason = settings.computeMipmaps ? "the texture format has no storage support" : "--blit-mipmaps";
+      std::cout << "Compute mip generation skipped, " << reason << "\n";
+      break;
+    }
+
+    Benchmark::Samples runs;
+    for (uint32_t run = 0; run < warmupRuns + measuredRuns; run++) {
+      if (!poll_events()) {
+        return false;
+      }
+      double milliseconds = vkcore.regenerate_mipmaps(compute == 1);
+      if (run >= warmupRuns) {
+        runs.add(milliseconds);
+      }
+    }
+    if (compute == 0) {
+      blit = runs.median();
+    }
+    table.row({compute == 1 ? "compute" : "blit",
+               std::to_string(runs.count()),
+               Benchmark::format(runs.median()),
+               Benchmark::format(runs.min()),
+               Benchmark::format(blit / std::max(runs.median(), 1.0e-6), 2) + "x"});
+  }
+
+  std::cout << "Mip generation, " << measuredRuns << " runs per path\n";
+  table.print(std::cout);
+  return true;
+}
+
+/**
+ * @brief How long the texture held up startup, then when each level became resident as
+ * frames are drawn. Run it with --no-texture-streaming to compare with uploading every
+ * level up front.
+ *
+ * @return false when interrupted
+ */
+bool vkTutorialApp::benchmark_texture_streaming()
+{
+  Benchmark::Table table({"resident level", "frames", "ms"});
+  uint32_t         level  = vkcore.texture_resident_level();
+  uint64_t         frames = 0;
+  auto             start  = std::chrono::steady_clock::now();
+
+  table.row({std::to_string(level), "0", Benchmark::format(0.0)});
+  while (vkcore.texture_streaming()) {
+    if (!poll_events() || !vkcore.draw()) {
+      return false;
+    }
+    frames++;
+    if (vkcore.texture_resident_level() != level) {
+      level = vkcore.texture_resident_level();
+      table.row({std::to_string(level),
+                 std::to_string(frames),
+                 Benchmark::format(
+                     std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count())});
+    }
+  }
+
+  std::cout << "Texture loading before the first frame: " << Benchmark::format(vkcore.texture_upload_ms())
+            << " ms\n";
+  std::cout << "Levels streamed in after it\n";
+  table.print(std::cout);
+  return true;
+}
+
+/**
+ * @brief The texture pool under shrinking budgets. The first phase makes every level the
+ * instances ask for resident, later ones give the pool a share of that, then leave half of
+ * the textures unused so the least recently used ones make room, and finally lift the budget
+ * so evicted levels stream back in.
+ *
+ * @return false when interrupted
+ */
+bool vkTutorialApp::benchmark_texture_residency()
+{
+  const uint32_t frames   = 120;  // For levels to settle after a change
+  const double   megabyte = 1024.0 * 1024.0;
+
+  if (!vkcore.texture_pool_enabled()) {
+    std::cout << "Skipped: the texture pool needs baked mip levels\n";
+    return true;
+  }
+
+  Benchmark::Table table({"phase", "budget MB", "resident MB", "evicted", "streamed", "cpu ms", "gpu ms"});
+  uint32_t         instances = vkcore.instance_count();
+  uint32_t         full      = 0;  // MB every level asked for takes
+
+  auto run_phase = [&](const std::string& phase, uint32_t budget, uint32_t count) {
+    vkcore.set_texture_budget(budget);
+    vkcore.set_instance_count(count);
+    Texture::ResidencyStats before = vkcore.texture_residency();
+
+    Benchmark::Samples cpu;
+    Benchmark::Samples gpu;
+    if (!render_frames(frames, &cpu, &gpu)) {
+      return false;
+    }
+
+    Texture::ResidencyStats after = vkcore.texture_residency();
+    table.row({phase,
+               Benchmark::format(after.budget / megabyte, 1),
+               Benchmark::format(after.residentBytes / megabyte, 1),
+               std::to_string(after.evictedLevels - before.evictedLevels),
+               std::to_string(after.streamedLevels - before.streamedLevels),
+               Benchmark::format(cpu.median()),
+               Benchmark::format(gpu.median())});
+    return true;
+  };
+
+  if (!run_phase("all levels", 0, instances)) {
+    return false;
+  }
+  full = std::max(static_cast<uint32_t>(vkcore.texture_residency().residentBytes / megabyte), 4u);
+  if (!run_phase("1/2 budget", full / 2, instances) || !run_phase("1/4 budget", full / 4, instances) ||
+      !run_phase("1/4, half used", full / 4, std::max(instances / 2, 1u)) ||
+      !run_phase("restored", 0, instances)) {
+    return false;
+  }
+
+  std::cout << vkcore.texture_residency().textureCount << " textures over " << instances << " instances\n";
+  table.print(std::cout);
+  return true;
+}
+
 }  // namespace Rake::Application
@@ -9,6 +9,10 @@
 #include "skeleton/skeleton.h"
 #include "vulkan/VulkanCore.h"
 
+namespace Rake::Benchmark {
+class Samples;
+}
+
 // clang-format off
 // clang-format on
 
@@ -39,13 +43,29 @@ class vkTutorialApp : public Rake::Base::Skeleton {
 
   // SDL_Window* window;
   void*             window;  // Eric: void for now until I get the windowing part up and runnint
-  xcb_connection_t* connection = nullptr;
-  xcb_window_t      handle     = 0;
+  xcb_connection_t* connection       = nullptr;
+  xcb_window_t      handle           = 0;
+  xcb_atom_t        wm_delete_window = 0;
 
-  Graphics::Core vkcore;
+  Graphics::Core     vkcore;
+  Graphics::Settings settings;
+  std::string        benchmark;
 
   bool rendering_loop();
   void init_window();
+  void show_window();
+  bool poll_events();
+  bool run_benchmark(const std::string& name);
+  bool render_frames(uint32_t count, Benchmark::Samples* cpu, Benchmark::Samples* gpu);
+  bool benchmark_instancing();
+  bool benchmark_gpu_culling();
+  bool benchmark_depth_prepass();
+  bool benchmark_attachment_memory();
+  bool benchmark_msaa();
+  bool benchmark_dynamic_resolution();
+  bool benchmark_mipmaps();
+  bool benchmark_texture_streaming();
+  bool benchmark_texture_residency();
   void init_input();
   void cleanup()
   {
@@ -1,3 +1,4 @@
+#include <cstring>
 
 
 #include <iostream>
@@ -7,11 +8,9 @@
 
 #include <thread>
 #include <chrono>
+#include <cmath>
 #include <unordered_map>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
-
 #include "VulkanFunctions.h"
 #include "VulkanUtilities.h"
 #include "VulkanCore.h"
@@ -91,24 +90,47 @@ void Core::cleanup()
   }
 
   cleanup_swapchain();
+  cleanup_pipelines();
 
-  vkDestroySampler(device, textureSampler, nullptr);
+  culler.reset();
+  depthPyramid.reset();
+  mipGenerator.reset();
+  textureStreamer.reset();
+  texturePool.reset();
+  textureTable.reset();
+  for (auto sampler : textureSamplers) {
+    vkDestroySampler(device, sampler, nullptr);
+  }
   vkDestroyImageView(device, textureImageView, nullptr);
   vkDestroyImage(device, textureImage, nullptr);
   vkFreeMemory(device, textureImageMemory, nullptr);
 
-  vkDestroyDescriptorPool(device, descriptorPool, nullptr);
-  vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+  descriptorAllocator.reset();
+  layoutCache.reset();
 
-  for (size_t i = 0; i < swapchainImages.size(); i++) {
+  for (size_t i = 0; i < uniformBuffers.size(); i++) {
+    vkUnmapMemory(device, uniformBuffersMemory[i]);
     vkDestroyBuffer(device, uniformBuffers[i], nullptr);
     vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
   }
 
+  for (size_t i = 0; i < instanceBuffers.size(); i++) {
+    if (instanceBuffers[i] != VK_NULL_HANDLE) {
+      vkUnmapMemory(device, instanceBuffersMemory[i]);
+      vkDestroyBuffer(device, instanceBuffers[i], nullptr);
+      vkFreeMemory(device, instanceBuffersMemory[i], nullptr);
+    }
+  }
+  gpuTimer.reset();
+
   vkDestroyBuffer(device, indexBuffer, nullptr);
   vkFreeMemory(device, indexBufferMemory, nullptr);
   vkDestroyBuffer(device, vertexBuffer, nullptr);
   vkFreeMemory(device, vertexBufferMemory, nullptr);
+  if (positionBuffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(device, positionBuffer, nullptr);
+    vkFreeMemory(device, positionBufferMemory, nullptr);
+  }
 
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     vkDestroySemaphore(device, renderFinishedSemaphore[i], nullptr);
@@ -157,12 +179,25 @@ void Core::cleanup_swapchain()
   vkDestroyImage(device, depthImage, nullptr);
   vkFreeMemory(device, depthImageMemory, nullptr);
 
+  if (sceneImage != VK_NULL_HANDLE) {
+    vkDestroyImageView(device, sceneImageView, nullptr);
+    vkDestroyImage(device, sceneImage, nullptr);
+    sceneImage = VK_NULL_HANDLE;
+  }
+
+  for (auto memory : attachmentBlocks) {
+    vkFreeMemory(device, memory, nullptr);
+  }
+  attachmentBlocks.clear();
+
   vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
   commandBuffers.clear();
 
-  vkDestroyPipeline(device, graphicsPipeline, nullptr);
-  vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
   vkDestroyRenderPass(device, renderPass, nullptr);
+  if (occlusionRenderPass != VK_NULL_HANDLE) {
+    vkDestroyRenderPass(device, occlusionRenderPass, nullptr);
+    occlusionRenderPass = VK_NULL_HANDLE;
+  }
 
   for (auto imageView : swapchainImageViews) {
     vkDestroyImageView(device, imageView, nullptr);
@@ -243,13 +278,42 @@ void Core::pick_physical_device()
   for (const auto& device : devices) {
     if (helper->is_device_suitable(device, surface)) {
       physicalDevice = device;
-      msaaSamples    = helper->get_max_usable_sample_count(physicalDevice);
+      maxMsaaSamples = helper->get_max_usable_sample_count(physicalDevice);
     }
   }
 
   if (physicalDevice == VK_NULL_HANDLE) {
     throw std::runtime_error("failed to find a sutible GPU!");
   }
+  apply_quality_tier();
+
+  bindlessCapacity = settings.bindlessTextures ? helper->get_bindless_texture_capacity(physicalDevice) : 0;
+  if (settings.bindlessTextures && bindlessCapacity == 0) {
+    std::cerr << "Descriptor indexing is not supported, binding textures per model." << std::endl;
+  }
+  memoryBudget =
+      settings.texturePool && helper->supports_device_extension(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+  drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance == VK_TRUE;
+  multiDrawIndirect         = supportedFeatures.multiDrawIndirect == VK_TRUE;
+
+  const char* countExtension = VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME;
+  drawIndirectCount = settings.gpuCulling && helper->supports_device_extension(physicalDevice, countExtension);
+  if (settings.gpuCulling && !drawIndirectFirstInstance) {
+    std::cerr << "drawIndirectFirstInstance is not supported, drawing every instance." << std::endl;
+  }
+
+  // The depth pyramid is built from the multisampled depth attachment, it has to be sampled.
+  VkFormatProperties depthProperties;
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, helper->find_depth_format(physicalDevice), &depthProperties);
+  const bool depthSampled = (depthProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+  occlusionCulling        = settings.gpuCulling && settings.occlusionCulling && drawIndirectFirstInstance;
+  if (occlusionCulling && (msaaSamples == VK_SAMPLE_COUNT_1_BIT || !depthSampled)) {
+    std::cerr << "Multisampled depth cannot be sampled, culling against the frustum only." << std::endl;
+    occlusionCulling = false;
+  }
 }
 
 /**
@@ -341,13 +405,39 @@ void Core::create_logical_device()
   deviceFeatures.samplerAnisotropy        = VK_TRUE;
   deviceFeatures.sampleRateShading        = VK_TRUE;
 
+  std::vector<const char*> extensions = deviceExtensions;
+
+  if (settings.gpuCulling && drawIndirectFirstInstance) {
+    deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+    deviceFeatures.multiDrawIndirect         = multiDrawIndirect ? VK_TRUE : VK_FALSE;
+    if (drawIndirectCount) {
+      extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
+  }
+
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+  indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  if (bindlessCapacity != 0) {
+    extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    deviceFeatures.shaderSampledImageArrayDynamicIndexing        = VK_TRUE;
+    indexingFeatures.shaderSampledImageArrayNonUniformIndexing    = VK_TRUE;
+    indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    indexingFeatures.descriptorBindingPartiallyBound              = VK_TRUE;
+    indexingFeatures.runtimeDescriptorArray                       = VK_TRUE;
+  }
+
+  if (memoryBudget) {
+    extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  }
+
   VkDeviceCreateInfo createInfo      = {};
   createInfo.sType                   = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  createInfo.pNext                   = bindlessCapacity != 0 ? &indexingFeatures : nullptr;
   createInfo.queueCreateInfoCount    = queueCreateInfos.size();
   createInfo.pQueueCreateInfos       = queueCreateInfos.data();
   createInfo.pEnabledFeatures        = &deviceFeatures;
-  createInfo.enabledExtensionCount   = static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  createInfo.enabledExtensionCount   = static_cast<uint32_t>(extensions.size());
+  createInfo.ppEnabledExtensionNames = extensions.data();
 
   if (enableValidationLayers) {
     createInfo.enabledLayerCount   = validationLayers.size();
@@ -394,6 +484,9 @@ void Core::init_vulkan(xcb_connection_t* connection, xcb_window_t handle)
   pick_physical_device();
   create_logical_device();
   load_device_entry_level_points();
+  pipelineCompiler = std::make_unique<PipelineCompiler>(device, "pipeline.cache");
+  layoutCache      = std::make_unique<DescriptorLayoutCache>(device);
+  sceneWorkers     = std::make_unique<Base::ThreadPool>();
   helper->get_device_queues(device, familyIndicies, presentQueue, graphicsQueue);
   create_swap_chain();
   create_image_views();
@@ -403,17 +496,46 @@ void Core::init_vulkan(xcb_connection_t* connection, xcb_window_t handle)
   create_command_pool();
   create_color_resources();
   create_depth_resources();
+  bind_attachments();
   create_frame_buffer();
-  create_texture_image();
-  create_texture_image_view();
-  create_texture_sampler();
+  if (settings.texturePool) {
+    create_texture_pool();
+  }
+  if (!texturePool) {
+    create_texture_image();
+    create_texture_image_view();
+    create_texture_sampler();
+    if (textureTable) {
+      // A slot for each sampler, so residency changes never rewrite a descriptor in use
+      for (auto sampler : textureSamplers) {
+        textureSlots.push_back(textureTable->add(sampler, textureImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+      }
+      chaletTextureIndex = textureSlots[textureResidentLevel];
+    }
+  }
   utility->load_model(chalet);
+  if (settings.lodCount > 1) {
+    Utility::build_lods(chalet, settings.lodCount);
+  }
+  if (settings.gpuCulling && settings.clusterCulling) {
+    Utility::build_meshlets(chalet);
+  }
   create_vertex_buffer();
+  if (settings.depthPrepass) {
+    create_position_buffer();
+  }
   create_index_buffer();
   create_uniform_buffers();
-  create_descriptor_pool();
+  create_instance_buffers();
+  set_instance_count(settings.instanceCount);
+  create_descriptor_allocator();
   create_descriptor_sets();
   create_command_buffers();
+  create_gpu_timer();
+  create_culler();
+  create_depth_pyramid();
+  create_quality_tuner();
+  create_resolution_controller();
   create_sync_objects();
 }
 
@@ -424,22 +546,29 @@ void Core::create_color_resources()
 {
   VkFormat colorFormat = swapchainImageFormat;
 
-  create_image(swapchainExtent.width,
-               swapchainExtent.height,
-               1,
-               msaaSamples,
-               colorFormat,
-               VK_IMAGE_TILING_OPTIMAL,
-               VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-               colorImage,
-               colorImageMemory);
-  colorImageView = create_image_view(colorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
-  transition_image_layout(colorImage,
-                          colorFormat,
-                          VK_IMAGE_LAYOUT_UNDEFINED,
-                          VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                          1);
+  // The render pass takes it from the undefined layout, no transition needed
+  create_attachment(colorFormat,
+                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                    colorTarget,
+                    colorImage,
+                    colorImageMemory,
+                    colorAttachmentMemory);
+
+  if (!upscaling) {
+    return;
+  }
+  create_unbound_image(swapchainExtent.width,
+                       swapchainExtent.height,
+                       1,
+                       VK_SAMPLE_COUNT_1_BIT,
+                       colorFormat,
+                       VK_IMAGE_TILING_OPTIMAL,
+                       VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                       sceneImage);
+
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(device, sceneImage, &memRequirements);
+  frameGraph.set_memory(resolveTarget, memRequirements);
 }
 
 /**
@@ -447,29 +576,73 @@ void Core::create_color_resources()
  */
 void Core::create_depth_resources()
 {
-  VkFormat depthFormat = helper->find_depth_format(physicalDevice);
+  depthFormat = helper->find_depth_format(physicalDevice);
 
-  create_image(swapchainExtent.width,
-               swapchainExtent.height,
-               1,
-               msaaSamples,
-               depthFormat,
-               VK_IMAGE_TILING_OPTIMAL,
-               VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-               depthImage,
-               depthImageMemory);
-  depthImageView = create_image_view(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+  // Like the colour image the render pass takes it from the undefined layout. Nothing
+  // stores it unless the depth pyramid samples it.
+  create_attachment(depthFormat,
+                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (occlusionCulling ? VK_IMAGE_USAGE_SAMPLED_BIT : 0),
+                    depthTarget,
+                    depthImage,
+                    depthImageMemory,
+                    depthAttachmentMemory);
 
-  transition_image_layout(depthImage,
-                          depthFormat,
-                          VK_IMAGE_LAYOUT_UNDEFINED,
-                          VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-                          1);
+  if (depthPyramid) {
+    depthPyramid->resize(swapchainExtent);
+  }
 }
 
 /**
- * @brief
+ * @brief Give the transient images of the frame graph their memory and views. The graph
+ * is compiled again with their memory requirements, then each of its memory blocks is
+ * allocated once and every image it holds is bound to the start of it.
+ */
+void Core::bind_attachments()
+{
+  frameGraph.compile();
+
+  VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  for (const auto& block : frameGraph.memory_blocks()) {
+    uint32_t typeBits = block.memoryTypeBits;
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType                = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize       = block.size;
+    allocInfo.memoryTypeIndex      = helper->find_memory_type(physicalDevice, typeBits, properties);
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to allocate attachment memory!");
+    }
+    attachmentBlocks.push_back(memory);
+  }
+
+  auto bind = [this](ResourceId target, VkImage image, VkDeviceMemory ownMemory) {
+    if (ownMemory != VK_NULL_HANDLE) {
+      return;
+    }
+    uint32_t block = frameGraph.memory_block(target);
+    if (block == ~0u) {
+      throw std::runtime_error("Frame graph left an attachment without memory!");
+    }
+    vkBindImageMemory(device, image, attachmentBlocks[block], 0);
+  };
+  bind(colorTarget, colorImage, colorImageMemory);
+  bind(depthTarget, depthImage, depthImageMemory);
+  if (upscaling) {
+    bind(resolveTarget, sceneImage, VK_NULL_HANDLE);
+  }
+
+  colorImageView = create_image_view(colorImage, swapchainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+  depthImageView = create_image_view(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+  if (upscaling) {
+    sceneImageView = create_image_view(sceneImage, swapchainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+  }
+}
+
+/**
+ * @brief One sampler for each level the texture can be resident down to, its minLod keeps
+ * it off the levels still streaming
  */
 void Core::create_texture_sampler()
 {
@@ -488,11 +661,14 @@ void Core::create_texture_sampler()
   samplerInfo.compareOp               = VK_COMPARE_OP_ALWAYS;
   samplerInfo.mipmapMode              = VK_SAMPLER_MIPMAP_MODE_LINEAR;
   samplerInfo.mipLodBias              = 0.0f;
-  samplerInfo.minLod                  = 0.0f;
   samplerInfo.maxLod                  = static_cast<uint32_t>(mipLevels);
 
-  if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS) {
-    throw std::runtime_error("Failed to create texture sampler!");
+  textureSamplers.resize(textureResidentLevel + 1);
+  for (uint32_t level = 0; level < textureSamplers.size(); level++) {
+    samplerInfo.minLod = static_cast<float>(level);
+    if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSamplers[level]) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create texture sampler!");
+    }
   }
 }
 
@@ -501,7 +677,7 @@ void Core::create_texture_sampler()
  */
 void Core::create_texture_image_view()
 {
-  textureImageView = create_image_view(textureImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+  textureImageView = create_image_view(textureImage, textureFormat, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
 }
 
 /**
@@ -531,81 +707,248 @@ VkImageView Core::create_image_view(VkImage image, VkFormat format, VkImageAspec
 }
 
 /**
- * @brief
+ * @brief The mip chain is baked on the CPU, block compressed when the device samples the
+ * format settings ask for, and uploaded with every level at once, or streamed in smallest
+ * first when settings allow. Without baking only level 0 is uploaded and the rest
+ * downsampled on the GPU, in compute when the format supports storage images and settings
+ * allow it, blitted otherwise.
  */
 void Core::create_texture_image()
 {
-  int          texWidth, texHeight, texChannels;
-  stbi_uc*     pixels    = stbi_load(chalet.texturePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-  VkDeviceSize imageSize = texWidth * texHeight * 4;
-
-  mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
-
-  if (!pixels) {
-    throw std::runtime_error("Failed to load texture image!");
+  auto start = std::chrono::steady_clock::now();
+
+  // Levels are copied straight from the mapped file, without one level 0 is decoded in to staging
+  std::unique_ptr<Texture::MappedTexture> mapped;
+  std::vector<Texture::MipLevel>          levels;
+  VkBuffer                                stagingBuffer       = VK_NULL_HANDLE;
+  VkDeviceMemory                          stagingBufferMemory = VK_NULL_HANDLE;
+  if (settings.bakedMipmaps) {
+    mapped = map_baked_texture(chalet.texturePath, choose_texture_format());
+  }
+  if (mapped) {
+    levels        = mapped->levels();
+    textureFormat = static_cast<VkFormat>(mapped->format());
+  } else {
+    levels        = {import_texture_image(chalet.texturePath, stagingBuffer, stagingBufferMemory)};
+    textureFormat = VK_FORMAT_R8G8B8A8_UNORM;
+  }
+  const Texture::MipLevel top = levels[0];
+
+  // Only uncompressed levels can be blitted or written in compute
+  VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  if (textureFormat == VK_FORMAT_R8G8B8A8_UNORM) {
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, textureFormat, &formatProperties);
+
+    usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    if (settings.computeMipmaps && (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT)) {
+      mipGenerator = std::make_unique<MipGenerator>(
+          device, *layoutCache, *pipelineCompiler, utility->read_file("mip_downsample.comp.spv"));
+      usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+    }
   }
 
-  VkBuffer       stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-
-  create_buffer(imageSize,
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                stagingBuffer,
-                stagingBufferMemory);
-
-  void* data;
-  vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-  memcpy(data, pixels, static_cast<size_t>(imageSize));
-  vkUnmapMemory(device, stagingBufferMemory);
+  mipLevels     = Texture::mip_level_count(top.width, top.height);
+  textureExtent = {top.width, top.height};
 
-  stbi_image_free(pixels);
-
-  create_image(texWidth,
-               texHeight,
+  create_image(top.width,
+               top.height,
                mipLevels,
                VK_SAMPLE_COUNT_1_BIT,
-               VK_FORMAT_R8G8B8A8_UNORM,
+               textureFormat,
                VK_IMAGE_TILING_OPTIMAL,
-               VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+               usage,
                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                textureImage,
                textureImageMemory);
 
-  transition_image_layout(textureImage,
-                          VK_FORMAT_R8G8B8A8_UNORM,
-                          VK_IMAGE_LAYOUT_UNDEFINED,
-                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                          mipLevels);
+  // Baked chains are complete and stream in, only their tail is uploaded before the first frame
+  if (mapped && settings.streamTextures) {
+    auto createBuffer = [this](VkDeviceSize          size,
+                               VkBufferUsageFlags    usage,
+                               VkMemoryPropertyFlags properties,
+                               VkBuffer&             buffer,
+                               VkDeviceMemory&       bufferMemory) {
+      create_buffer(size, usage, properties, buffer, bufferMemory);
+    };
+    textureStreamer = std::make_unique<TextureStreamer>(
+        device, commandPool, graphicsQueue, textureImage, std::move(mapped), createBuffer);
+    textureResidentLevel = textureStreamer->resident_level();
+    textureUploadMs      = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return;
+  }
 
-  copy_buffer_to_image(stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-  /*
-  transition_image_layout(textureImage,
-                          VK_FORMAT_R8G8B8A8_UNORM,
-                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                          mipLevels);
-*/
+  if (mapped) {
+    VkDeviceSize imageSize = mapped->data_size();
+    create_buffer(imageSize,
+                  VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                  stagingBuffer,
+                  stagingBufferMemory);
 
-  generate_mipmaps(textureImage, VK_FORMAT_R8G8B8A8_UNORM, texWidth, texHeight, mipLevels);
+    void* data;
+    vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
+    memcpy(data, mapped->data(), static_cast<size_t>(imageSize));
+    vkUnmapMemory(device, stagingBufferMemory);
+  }
+
+  uint32_t levelCount = static_cast<uint32_t>(levels.size());
+  copy_buffer_to_image(stagingBuffer, textureImage, levels, mipLevels);
+  if (levelCount < mipLevels) {
+    if (!(usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+      throw std::runtime_error("Texture format can't have its mip levels generated!");
+    }
+    generate_mipmaps(textureImage,
+                     textureFormat,
+                     static_cast<int32_t>(top.width),
+                     static_cast<int32_t>(top.height),
+                     mipLevels,
+                     mipGenerator != nullptr);
+  }
 
   vkDestroyBuffer(device, stagingBuffer, nullptr);
   vkFreeMemory(device, stagingBufferMemory, nullptr);
+  textureUploadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 }
 
 /**
- * @brief
+ * @brief Decode an image to RGBA8 on the scene workers, straight in to a staging buffer
+ * the importer's ring is laid over
+ *
+ * @param imagePath any format stb_image reads
+ * @param buffer staging buffer holding the level, the caller destroys it
+ * @param bufferMemory
+ * @return Texture::MipLevel with its offset in to buffer
+ */
+Texture::MipLevel Core::import_texture_image(const std::string& imagePath,
+                                             VkBuffer&          buffer,
+                                             VkDeviceMemory&    bufferMemory)
+{
+  uint32_t width, height;
+  if (!Texture::ImageImporter::image_size(imagePath, width, height)) {
+    throw std::runtime_error("Failed to load texture image!");
+  }
+  VkDeviceSize bufferSize = VkDeviceSize(width) * height * 4;
+
+  create_buffer(bufferSize,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                buffer,
+                bufferMemory);
+
+  void* data;
+  vkMapMemory(device, bufferMemory, 0, bufferSize, 0, &data);
+  Texture::StagingRing   ring(static_cast<uint8_t*>(data), static_cast<size_t>(bufferSize));
+  Texture::ImportedImage image;
+  {
+    Texture::ImageImporter importer(ring, sceneWorkers.get());
+    importer.submit(imagePath);
+    image = importer.next();
+  }
+  vkUnmapMemory(device, bufferMemory);
+
+  return {image.width, image.height, image.texels.offset, image.texels.size};
+}
+
+/**
+ * @brief The first format of the compression settings ask for, or the ones standing in for
+ * it, that the device samples with linear filtering. RGBA8 when it samples none of them.
+ *
+ * @return VkFormat
+ */
+VkFormat Core::choose_texture_format()
+{
+  std::vector<VkFormat> candidates;
+  switch (settings.textureCompression) {
+    case TextureCompression::Bc7:
+      candidates = {VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_BC3_UNORM_BLOCK};
+      break;
+    case TextureCompression::Bc3:
+      candidates = {VK_FORMAT_BC3_UNORM_BLOCK};
+      break;
+    case TextureCompression::Bc1:
+      candidates = {VK_FORMAT_BC1_RGB_UNORM_BLOCK};
+      break;
+    case TextureCompression::None:
+      break;
+  }
+  candidates.push_back(VK_FORMAT_R8G8B8A8_UNORM);
+
+  return helper->find_supported_format(physicalDevice,
+                                       candidates,
+                                       VK_IMAGE_TILING_OPTIMAL,
+                                       VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+                                           VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+}
+
+/**
+ * @brief Map the baked mip chain of an image, baked and stored next to it on first use or
+ * when the stored one has another format or lacks levels. Delete the baked file, or convert the image
+ * with texconv, to pick up changes to the image.
+ *
+ * @param imagePath
+ * @param format VkFormat to bake the levels in
+ * @return std::unique_ptr<Texture::MappedTexture> nullptr when the chain can't be stored
+ */
+std::unique_ptr<Texture::MappedTexture> Core::map_baked_texture(const std::string& imagePath, VkFormat format)
+{
+  std::string bakedPath = Texture::baked_texture_path(imagePath);
+  try {
+    // A partial chain would leave levels to generate, which compressed formats can't be
+    auto                     mapped = std::make_unique<Texture::MappedTexture>(bakedPath);
+    const Texture::MipLevel& top    = mapped->levels()[0];
+    if (mapped->format() == static_cast<uint32_t>(format) &&
+        mapped->levels().size() == Texture::mip_level_count(top.width, top.height)) {
+      return mapped;
+    }
+  } catch (const std::runtime_error&) {
+    // Missing or stale, bake it again
+  }
+
+  try {
+    Texture::TextureFile texture =
+        Texture::bake_texture(imagePath, format, Texture::ColorSpace::Srgb, sceneWorkers.get());
+    Texture::write_texture_file(bakedPath, texture);
+
+    Texture::BlockFormat blockFormat;
+    bool                 compressed = Texture::block_format(format, blockFormat);
+    std::cout << "Baked " << texture.mips.level_count() << " mip levels of " << imagePath << " as "
+              << (compressed ? Texture::to_string(blockFormat) : "rgba8") << " to " << bakedPath << std::endl;
+    return std::make_unique<Texture::MappedTexture>(bakedPath);
+  } catch (const std::runtime_error& error) {
+    std::cerr << "Could not store baked texture " << bakedPath << ": " << error.what() << std::endl;
+  }
+  return nullptr;
+}
+
+/**
+ * @brief Fill levels 1 and up from level 0, which is in the transfer destination layout.
+ * Every level ends up in the shader read only layout.
  * @param image
  * @param texWidth
  * @param texHeight
  * @param mipLevels
+ * @param compute downsample with mipGenerator in a few dispatches instead of a blit per level
  */
 void Core::generate_mipmaps(VkImage  image,
                             VkFormat imageFormat,
                             int32_t  texWidth,
                             int32_t  texHeight,
-                            uint32_t mipLevels)
+                            uint32_t mipLevels,
+                            bool     compute)
 {
+  if (compute) {
+    VkCommandBuffer commandBuffer = begin_single_time_commands();
+    mipGenerator->record(commandBuffer,
+                         image,
+                         imageFormat,
+                         {static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight)},
+                         mipLevels);
+    end_single_time_commands(commandBuffer);
+    mipGenerator->release();
+    return;
+  }
+
   VkFormatProperties formatProperties;
   vkGetPhysicalDeviceFormatProperties(physicalDevice, imageFormat, &formatProperties);
 
@@ -714,26 +1057,22 @@ void Core::generate_mipmaps(VkImage  image,
 }
 
 /**
- * @brief
+ * @brief Image without memory, for the caller to bind
  * @param width
  * @param height
  * @param format
  * @param tiling
  * @param usage
- * @param properties
  * @param image
- * @param imageMemory
  */
-void Core::create_image(uint32_t              width,
-                        uint32_t              height,
-                        uint32_t              mipLevels,
-                        VkSampleCountFlagBits numSamples,
-                        VkFormat              format,
-                        VkImageTiling         tiling,
-                        VkImageUsageFlags     usage,
-                        VkMemoryPropertyFlags properties,
-                        VkImage&              image,
-                        VkDeviceMemory&       imageMemory)
+void Core::create_unbound_image(uint32_t              width,
+                                uint32_t              height,
+                                uint32_t              mipLevels,
+                                VkSampleCountFlagBits numSamples,
+                                VkFormat              format,
+                                VkImageTiling         tiling,
+                                VkImageUsageFlags     usage,
+                                VkImage&              image)
 {
   VkImageCreateInfo imageInfo = {};
   imageInfo.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -755,115 +1094,322 @@ void Core::create_image(uint32_t              width,
   if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
     throw std::runtime_error("Failed to create image");
   }
+}
+
+/**
+ * @brief
+ * @param width
+ * @param height
+ * @param format
+ * @param tiling
+ * @param usage
+ * @param properties
+ * @param image
+ * @param imageMemory
+ */
+bool Core::create_image(uint32_t              width,
+                        uint32_t              height,
+                        uint32_t              mipLevels,
+                        VkSampleCountFlagBits numSamples,
+                        VkFormat              format,
+                        VkImageTiling         tiling,
+                        VkImageUsageFlags     usage,
+                        VkMemoryPropertyFlags properties,
+                        VkImage&              image,
+                        VkDeviceMemory&       imageMemory,
+                        VkMemoryPropertyFlags preferredProperties)
+{
+  create_unbound_image(width, height, mipLevels, numSamples, format, tiling, usage, image);
 
   VkMemoryRequirements memRequirements;
   vkGetImageMemoryRequirements(device, image, &memRequirements);
 
+  VkMemoryPropertyFlags wanted    = properties | preferredProperties;
+  bool                  preferred = helper->has_memory_type(physicalDevice, memRequirements.memoryTypeBits, wanted);
+  if (!preferred) {
+    wanted = properties;
+  }
+
   VkMemoryAllocateInfo allocInfo = {};
   allocInfo.sType                = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
   allocInfo.allocationSize       = memRequirements.size;
-  allocInfo.memoryTypeIndex      = helper->find_memory_type(physicalDevice, memRequirements.memoryTypeBits, properties);
+  allocInfo.memoryTypeIndex      = helper->find_memory_type(physicalDevice, memRequirements.memoryTypeBits, wanted);
 
   if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
     throw std::runtime_error("Failed to allocate image memory!");
   }
 
   vkBindImageMemory(device, image, imageMemory, 0);
+  return preferred;
 }
 
 /**
- * @brief
+ * @brief Multisampled attachment the size of the swapchain. When the frame graph keeps
+ * its contents within the render pass it gets transient usage and its own memory,
+ * lazily allocated where the device has it so tiled GPUs never back it; other devices
+ * fall back to device local memory. Any other attachment is left unbound, with its
+ * memory requirements handed to the frame graph for bind_attachments() to alias.
+ *
+ * @param format
+ * @param usage
+ * @param target image of the frame graph the attachment stands for
+ * @param image
+ * @param imageMemory
+ * @param report filled in with what the attachment got
  */
-void Core::create_descriptor_sets()
+void Core::create_attachment(VkFormat          format,
+                             VkImageUsageFlags usage,
+                             ResourceId        target,
+                             VkImage&          image,
+                             VkDeviceMemory&   imageMemory,
+                             AttachmentMemory& report)
 {
-  std::vector<VkDescriptorSetLayout> layouts(swapchainImages.size(), descriptorSetLayout);
+  report.transient = settings.lazyAttachments && frameGraph.memoryless(target);
+  if (report.transient) {
+    usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+  }
+
+  imageMemory = VK_NULL_HANDLE;
+  report.lazy = false;
+  if (report.transient) {
+    report.lazy = create_image(swapchainExtent.width,
+                               swapchainExtent.height,
+                               1,
+                               msaaSamples,
+                               format,
+                               VK_IMAGE_TILING_OPTIMAL,
+                               usage,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                               image,
+                               imageMemory,
+                               VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+  } else {
+    create_unbound_image(
+        swapchainExtent.width, swapchainExtent.height, 1, msaaSamples, format, VK_IMAGE_TILING_OPTIMAL, usage, image);
+  }
 
-  VkDescriptorSetAllocateInfo allocInfo = {};
-  allocInfo.sType                       = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-  allocInfo.descriptorPool              = descriptorPool;
-  allocInfo.descriptorSetCount          = static_cast<uint32_t>(swapchainImages.size());
-  allocInfo.pSetLayouts                 = layouts.data();
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(device, image, &memRequirements);
+  report.size = memRequirements.size;
+  if (!report.transient) {
+    frameGraph.set_memory(target, memRequirements);
+  }
+}
 
-  descriptorSets.resize(swapchainImages.size());
-  if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
-    throw std::runtime_error("Failed to allocate descriptor sets");
+/**
+ * @brief Sets are cached, except when they bind a pooled texture directly. Its view is
+ * destroyed once the texture moves and a later view may reuse the handle, so those sets
+ * are frame sets, written again by draw() every frame.
+ */
+void Core::create_descriptor_sets()
+{
+  descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+
+  for (size_t i = 0; i < descriptorSets.size(); i++) {
+    if (!textureTable && texturePool) {
+      descriptorSets[i] = descriptorAllocator->allocate_frame_set(
+          static_cast<uint32_t>(i), descriptorSetLayout, descriptor_writes(i));
+    } else {
+      descriptorSets[i] = descriptorAllocator->get_cached(descriptorSetLayout, descriptor_writes(i));
+    }
   }
+}
 
-  for (size_t i = 0; i < swapchainImages.size(); i++) {
-    VkDescriptorBufferInfo bufferInfo = {};
-    bufferInfo.buffer                 = uniformBuffers[i];
-    bufferInfo.offset                 = 0;
-    bufferInfo.range                  = sizeof(Object::UniformBufferObject);
+/**
+ * @brief
+ * @param frame
+ * @return the uniform buffer of the frame and, without bindless textures, the texture
+ */
+DescriptorWrites Core::descriptor_writes(size_t frame) const
+{
+  DescriptorWrites writes;
+  writes.buffer(0, uniformBuffers[frame], 0, sizeof(Object::CameraBufferObject));
+  if (!textureTable && texturePool) {
+    writes.image(1, texturePool->sampler(), texturePool->view(0), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  } else if (!textureTable) {
+    VkSampler sampler = textureSamplers[textureResidentLevel];
+    writes.image(1, sampler, textureImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  }
+  return writes;
+}
 
-    VkDescriptorImageInfo imageInfo = {};
-    imageInfo.imageLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    imageInfo.imageView             = textureImageView;
-    imageInfo.sampler               = textureSampler;
+/**
+ * @brief Pools are created by the allocator on demand, sized from what gets allocated
+ */
+void Core::create_descriptor_allocator()
+{
+  descriptorAllocator = std::make_unique<DescriptorAllocator>(device, *layoutCache, MAX_FRAMES_IN_FLIGHT);
+}
 
-    std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
+/**
+ * @brief One persistently mapped instance buffer per frame in flight, created on first use
+ */
+void Core::create_instance_buffers()
+{
+  instanceBuffers.assign(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+  instanceBuffersMemory.assign(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+  instanceBuffersMapped.assign(MAX_FRAMES_IN_FLIGHT, nullptr);
+  instanceBufferCapacities.assign(MAX_FRAMES_IN_FLIGHT, 0);
+  instanceDrawCounts.assign(MAX_FRAMES_IN_FLIGHT, std::vector<uint32_t>(chalet.lods.size(), 0));
+}
 
-    descriptorWrites[0].sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrites[0].dstSet           = descriptorSets[i];
-    descriptorWrites[0].dstBinding       = 0;
-    descriptorWrites[0].dstArrayElement  = 0;
-    descriptorWrites[0].descriptorType   = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    descriptorWrites[0].descriptorCount  = 1;
-    descriptorWrites[0].pBufferInfo      = &bufferInfo;
-    descriptorWrites[0].pImageInfo       = nullptr;  // Optional
-    descriptorWrites[0].pTexelBufferView = nullptr;  // Optional
+/**
+ * @brief Frame timestamps on the graphics queue, disabled when it has no timestamp support
+ */
+void Core::create_gpu_timer()
+{
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+
+  gpuTimer = std::make_unique<GpuTimer>(device,
+                                        physicalDevice,
+                                        families[familyIndicies.graphicsFamily.value()].timestampValidBits,
+                                        MAX_FRAMES_IN_FLIGHT);
+}
 
-    descriptorWrites[1].sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrites[1].dstSet           = descriptorSets[i];
-    descriptorWrites[1].dstBinding       = 1;
-    descriptorWrites[1].dstArrayElement  = 0;
-    descriptorWrites[1].descriptorType   = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    descriptorWrites[1].descriptorCount  = 1;
-    descriptorWrites[1].pBufferInfo      = nullptr;
-    descriptorWrites[1].pImageInfo       = &imageInfo;  // Optional
-    descriptorWrites[1].pTexelBufferView = nullptr;     // Optional
+/**
+ * @brief The quality auto-tuner, when a target frame time is set and the GPU can time
+ * frames. It starts from the configured tier.
+ */
+void Core::create_quality_tuner()
+{
+  if (settings.qualityTargetMs <= 0.0) {
+    return;
+  }
+  if (!gpuTimer->supported()) {
+    std::cerr << "GPU timestamps are not supported, keeping the " << quality_tier_name(settings.quality)
+              << " quality tier." << std::endl;
+    return;
+  }
+  qualityTuner = std::make_unique<QualityTuner>(settings.quality, settings.qualityTargetMs);
+}
 
-    vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+/**
+ * @brief The dynamic resolution controller, when a target frame time is set, the frame
+ * is upscaled and the GPU can time frames
+ */
+void Core::create_resolution_controller()
+{
+  resolutionController.reset();
+  if (settings.resolutionTargetMs <= 0.0 || !upscaling) {
+    return;
+  }
+  if (!gpuTimer->supported()) {
+    std::cerr << "GPU timestamps are not supported, keeping the render scale." << std::endl;
+    return;
   }
+  resolutionController = std::make_unique<ResolutionController>(
+      settings.resolutionTargetMs, settings.minRenderScale, 1.0f, settings.renderScale);
 }
 
 /**
- * @brief
+ * @brief The compute culler, left empty when GPU culling is off or the device cannot
+ * offset instances from an indirect command
  */
-void Core::create_descriptor_pool()
+void Core::create_culler()
 {
-  std::array<VkDescriptorPoolSize, 2> poolSizes = {};
-  poolSizes[0].type                             = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  poolSizes[0].descriptorCount                  = static_cast<uint32_t>(swapchainImages.size());
-  poolSizes[1].type                             = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  poolSizes[1].descriptorCount                  = static_cast<uint32_t>(swapchainImages.size());
+  expectedVisible.assign(MAX_FRAMES_IN_FLIGHT, 0);
+  if (!settings.gpuCulling || !drawIndirectFirstInstance) {
+    return;
+  }
 
-  VkDescriptorPoolCreateInfo poolInfo = {};
-  poolInfo.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  poolInfo.poolSizeCount              = static_cast<uint32_t>(poolSizes.size());
-  poolInfo.pPoolSizes                 = poolSizes.data();
-  poolInfo.maxSets                    = static_cast<uint32_t>(swapchainImages.size());
+  auto createBuffer = [this](VkDeviceSize          size,
+                             VkBufferUsageFlags    usage,
+                             VkMemoryPropertyFlags properties,
+                             VkBuffer&             buffer,
+                             VkDeviceMemory&       bufferMemory) {
+    create_buffer(size, usage, properties, buffer, bufferMemory);
+  };
+
+  culler = std::make_unique<GpuCuller>(device,
+                                       *layoutCache,
+                                       *descriptorAllocator,
+                                       *pipelineCompiler,
+                                       utility->read_file("cull_instances.comp.spv"),
+                                       utility->read_file("compact_draws.comp.spv"),
+                                       chalet.meshlets.empty() ? std::vector<char>()
+                                                               : utility->read_file("cull_clusters.comp.spv"),
+                                       occlusionCulling ? utility->read_file("cull_occlusion.comp.spv")
+                                                        : std::vector<char>(),
+                                       createBuffer,
+                                       MAX_FRAMES_IN_FLIGHT,
+                                       drawIndirectCount && vkCmdDrawIndexedIndirectCountKHR != nullptr);
+
+  // One indirect command per LOD, instances pick theirs through meshIndex.
+  std::vector<IndirectMesh> meshes;
+  for (const auto& lod : chalet.lods) {
+    IndirectMesh mesh   = {};
+    mesh.indexCount     = lod.indexCount;
+    mesh.firstIndex     = lod.firstIndex;
+    mesh.vertexOffset   = 0;
+    mesh.boundingSphere = chalet.bounds.sphere;
+    mesh.firstMeshlet   = lod.firstMeshlet;
+    mesh.meshletCount   = lod.meshletCount;
+    meshes.push_back(mesh);
+  }
+  culler->set_meshes(meshes, chalet.meshlets);
+}
 
-  if (auto result = vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool); result != VK_SUCCESS) {
-    throw std::runtime_error("Failed to create descriptor pool!");
+/**
+ * @brief The Hi-Z pyramid the late occlusion phase tests against, left empty without
+ * occlusion culling. Resized with the depth attachment.
+ */
+void Core::create_depth_pyramid()
+{
+  if (!culler || !culler->occlusion_enabled()) {
+    return;
   }
+
+  auto createImage = [this](uint32_t          width,
+                            uint32_t          height,
+                            uint32_t          levels,
+                            VkFormat          format,
+                            VkImageUsageFlags usage,
+                            VkImage&          image,
+                            VkDeviceMemory&   imageMemory) {
+    create_image(width,
+                 height,
+                 levels,
+                 VK_SAMPLE_COUNT_1_BIT,
+                 format,
+                 VK_IMAGE_TILING_OPTIMAL,
+                 usage,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 image,
+                 imageMemory);
+  };
+
+  depthPyramid = std::make_unique<DepthPyramid>(device,
+                                                *layoutCache,
+                                                *descriptorAllocator,
+                                                *pipelineCompiler,
+                                                utility->read_file("hiz_depth.comp.spv"),
+                                                utility->read_file("hiz_reduce.comp.spv"),
+                                                createImage);
+  depthPyramid->resize(swapchainExtent);
+  culler->set_depth_pyramid(depthPyramid.get());
 }
 
 /**
- * @brief
+ * @brief One persistently mapped camera buffer per frame in flight
  */
 void Core::create_uniform_buffers()
 {
-  VkDeviceSize bufferSize = sizeof(Object::UniformBufferObject);
+  VkDeviceSize bufferSize = sizeof(Object::CameraBufferObject);
 
-  uniformBuffers.resize(swapchainImages.size());
-  uniformBuffersMemory.resize(swapchainImages.size());
+  uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+  uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+  uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
 
-  for (size_t i = 0; i < swapchainImages.size(); i++) {
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     create_buffer(bufferSize,
                   VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
                   uniformBuffers[i],
                   uniformBuffersMemory[i]);
+    vkMapMemory(device, uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
   }
 }
 
@@ -883,9 +1429,14 @@ bool Core::recreate_swap_chain()
   if (canRender) {
     create_image_views();
     create_render_pass();
-    create_graphics_pipeline();
+    // The pipelines only depend on the render pass formats, samples and subpasses, viewport and scissor are dynamic.
+    if (swapchainImageFormat != pipelineColorFormat || settings.depthPrepass != pipelineDepthPrepass ||
+        settings.quality != pipelineQuality) {
+      create_graphics_pipeline();
+    }
     create_color_resources();
     create_depth_resources();
+    bind_attachments();
     create_frame_buffer();
     create_command_buffers();
     return true;
@@ -998,6 +1549,13 @@ void Core::transition_image_layout(VkImage       image,
 
     sourceStage      = VK_PIPELINE_STAGE_TRANSFER_BIT;
     destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  } else if (oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL &&
+             newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+    barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    sourceStage      = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
   } else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
     barrier.srcAccessMask = 0;
     barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
@@ -1020,33 +1578,87 @@ void Core::transition_image_layout(VkImage       image,
 }  // namespace Application
 
 /**
- * @brief
+ * @brief Copy every level of a mip chain in one command, the buffer holds the chain's
+ * data as it is. Leaves the image in the shader read only layout when the chain has every
+ * level, the transfer destination layout for generate_mipmaps() otherwise.
  * @param buffer
  * @param image
- * @param width
- * @param height
+ * @param levels offsets into the buffer
+ * @param levelCount of the image
  */
-void Core::copy_buffer_to_image(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
+void Core::copy_buffer_to_image(VkBuffer                              buffer,
+                                VkImage                               image,
+                                const std::vector<Texture::MipLevel>& levels,
+                                uint32_t                              levelCount)
 {
   VkCommandBuffer commandBuffer = begin_single_time_commands();
 
-  VkBufferImageCopy region = {};
-  region.bufferOffset      = 0;
-  region.bufferRowLength   = 0;
-  region.bufferImageHeight = 0;
-
-  region.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
-  region.imageSubresource.mipLevel       = 0;
-  region.imageSubresource.baseArrayLayer = 0;
-  region.imageSubresource.layerCount     = 1;
-
-  region.imageOffset = {0, 0, 0};
-  region.imageExtent = {width, height, 1};
-
-  vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-  end_single_time_commands(commandBuffer);
-}
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType                = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask        = 0;
+  barrier.dstAccessMask        = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.oldLayout            = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout            = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image                = image;
+  barrier.subresourceRange     = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1};
+
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       0,
+                       0,
+                       nullptr,
+                       0,
+                       nullptr,
+                       1,
+                       &barrier);
+
+  std::vector<VkBufferImageCopy> regions;
+  for (uint32_t level = 0; level < levels.size(); level++) {
+    VkBufferImageCopy region = {};
+    region.bufferOffset      = levels[level].offset;
+    region.bufferRowLength   = 0;
+    region.bufferImageHeight = 0;
+
+    region.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel       = level;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount     = 1;
+
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {levels[level].width, levels[level].height, 1};
+    regions.push_back(region);
+  }
+
+  vkCmdCopyBufferToImage(commandBuffer,
+                         buffer,
+                         image,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         static_cast<uint32_t>(regions.size()),
+                         regions.data());
+
+  if (levels.size() == levelCount) {
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         1,
+                         &barrier);
+  }
+
+  end_single_time_commands(commandBuffer);
+}
 
 /**
  * @brief
@@ -1080,6 +1692,44 @@ void Core::create_vertex_buffer()
   vkFreeMemory(device, stagingBufferMemory, nullptr);
 }
 
+/**
+ * @brief Positions alone, tightly packed, for the depth pre-pass. A quarter of the
+ * interleaved vertex size, so the pre-pass fetches far less vertex data.
+ */
+void Core::create_position_buffer()
+{
+  std::vector<glm::vec3> positions(chalet.verticies.size());
+  for (size_t i = 0; i < positions.size(); i++) {
+    positions[i] = chalet.verticies[i].pos;
+  }
+
+  VkDeviceSize bufferSize = sizeof(positions[0]) * positions.size();
+
+  VkBuffer       stagingBuffer;
+  VkDeviceMemory stagingBufferMemory;
+
+  create_buffer(bufferSize,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                stagingBuffer,
+                stagingBufferMemory);
+
+  void* data;
+  vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
+  memcpy(data, positions.data(), (size_t)bufferSize);
+  vkUnmapMemory(device, stagingBufferMemory);
+
+  create_buffer(bufferSize,
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                positionBuffer,
+                positionBufferMemory);
+
+  copy_buffer(stagingBuffer, positionBuffer, bufferSize);
+  vkDestroyBuffer(device, stagingBuffer, nullptr);
+  vkFreeMemory(device, stagingBufferMemory, nullptr);
+}
+
 /**
  * @brief
  */
@@ -1113,23 +1763,515 @@ void Core::create_index_buffer()
   vkFreeMemory(device, stagingBufferMemory, nullptr);
 }
 
-void Core::update_uniform_buffer(uint32_t currentImage)
+/**
+ * @brief Write the camera for this frame and fill the frame's instance stream
+ *
+ * @param frame index of the frame in flight
+ */
+void Core::update_uniform_buffer(uint32_t frame)
 {
   static auto startTime = std::chrono::high_resolution_clock::now();
 
   auto  currentTime = std::chrono::high_resolution_clock::now();
   float time        = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
-  struct Object::UniformBufferObject ubo = {};
-  ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-  ubo.view  = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-  ubo.proj  = glm::perspective(glm::radians(45.0f), swapchainExtent.width / (float)swapchainExtent.height, 0.1f, 10.0f);
-  ubo.proj[1][1] *= -1;
+  // Back the camera off so the whole instance grid stays in view.
+  const float fieldOfView = glm::radians(45.0f);
 
-  void* data;
-  vkMapMemory(device, uniformBuffersMemory[currentImage], 0, sizeof(ubo), 0, &data);
-  memcpy(data, &ubo, sizeof(ubo));
-  vkUnmapMemory(device, uniformBuffersMemory[currentImage]);
+  cameraPosition = glm::vec3(2.0f * sceneRadius);
+  lodPixelScale  = renderExtent.height / (2.0f * std::tan(0.5f * fieldOfView));
+
+  Object::CameraBufferObject camera = {};
+  camera.view = glm::lookAt(cameraPosition, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+  camera.proj = glm::perspective(
+      fieldOfView, swapchainExtent.width / (float)swapchainExtent.height, 0.1f, 10.0f * sceneRadius);
+  camera.proj[1][1] *= -1;
+
+  memcpy(uniformBuffersMapped[frame], &camera, sizeof(camera));
+  cameraViewProjection = camera.proj * camera.view;
+  cameraFrustum        = Frustum::from_view_projection(cameraViewProjection);
+
+  update_instance_buffer(frame, time);
+}
+
+/**
+ * @brief Write every instance of the scene in to the frame's instance buffer, growing it
+ * first when the instance count went up. The frame's fence has signaled so the old
+ * buffer is no longer read.
+ *
+ * @param frame
+ * @param time seconds since start, every instance spins in place
+ */
+void Core::update_instance_buffer(uint32_t frame, float time)
+{
+  uint32_t count = instance_count();
+
+  if (instanceBufferCapacities[frame] < count) {
+    if (instanceBuffers[frame] != VK_NULL_HANDLE) {
+      vkUnmapMemory(device, instanceBuffersMemory[frame]);
+      vkDestroyBuffer(device, instanceBuffers[frame], nullptr);
+      vkFreeMemory(device, instanceBuffersMemory[frame], nullptr);
+    }
+
+    uint32_t     capacity   = std::max(count, instanceBufferCapacities[frame] * 2);
+    VkDeviceSize bufferSize = capacity * sizeof(Object::InstanceData);
+    create_buffer(bufferSize,
+                  VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                  instanceBuffers[frame],
+                  instanceBuffersMemory[frame]);
+    vkMapMemory(device, instanceBuffersMemory[frame], 0, bufferSize, 0, &instanceBuffersMapped[frame]);
+    instanceBufferCapacities[frame] = capacity;
+  }
+
+  glm::quat spin = glm::angleAxis(time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+  for (auto node : instanceNodes) {
+    scene.set_rotation(node, spin);
+  }
+  scene.update(sceneWorkers.get());
+
+  // Instances take the pooled textures in turn. Each asks for the level whose texels are about a
+  // pixel apart, taking the texture to span the instance's bounding sphere once.
+  const glm::vec4 localSphere = chalet.bounds.sphere;
+  auto            use_texture = [&](uint32_t i) {
+    uint32_t  texture  = i % texturePool->size();
+    uint32_t  extent   = std::max(texturePool->levels(texture)[0].width, texturePool->levels(texture)[0].height);
+    glm::vec3 center   = glm::vec3(scene.world(instanceNodes[i]) * glm::vec4(glm::vec3(localSphere), 1.0f));
+    float     distance = glm::length(center - cameraPosition) - localSphere.w;
+    float     level    = 0.0f;
+    if (distance > 0.0f) {
+      float pixels = 2.0f * localSphere.w * lodPixelScale / distance;
+      level        = std::max(std::log2(extent / std::max(pixels, 1.0f)), 0.0f);
+    }
+    texturePool->use(texture, static_cast<uint32_t>(level));
+    return texturePool->slot(texture);
+  };
+
+  auto instances      = static_cast<Object::InstanceData*>(instanceBuffersMapped[frame]);
+  auto write_instance = [&](uint32_t slot, uint32_t i, uint32_t lod) {
+    instances[slot].model         = scene.world(instanceNodes[i]);
+    instances[slot].materialIndex = texturePool ? use_texture(i) : chaletTextureIndex;
+    instances[slot].meshIndex     = lod;
+  };
+
+  // The coarsest LOD whose error stays under settings.lodPixelError at the instance's distance.
+  auto select_lod = [&](uint32_t i) {
+    glm::vec3 center   = glm::vec3(scene.world(instanceNodes[i]) * glm::vec4(glm::vec3(localSphere), 1.0f));
+    float     distance = glm::length(center - cameraPosition) - localSphere.w;
+    return Scene::select_lod(chalet.lods, distance, lodPixelScale, settings.lodPixelError);
+  };
+
+  // Without the compute culler the CPU culls, with it the CPU count is the reference.
+  const bool cpuCulling = !culler && settings.cpuCulling;
+  uint32_t   visible    = count;
+  if (cpuCulling || (culler && settings.validateCulling)) {
+    sphereCuller.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+      sphereCuller.set_sphere(i, scene.world(instanceNodes[i]), chalet.bounds.sphere);
+    }
+    visible = static_cast<uint32_t>(sphereCuller.cull(cameraFrustum.planes));
+  }
+
+  auto& lodCounts = instanceDrawCounts[frame];
+  std::fill(lodCounts.begin(), lodCounts.end(), 0u);
+
+  // The compute culler scatters survivors by LOD itself, it only needs the counts.
+  if (culler) {
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t lod = select_lod(i);
+      write_instance(i, i, lod);
+      lodCounts[lod]++;
+    }
+    expectedVisible[frame] = visible;
+    return;
+  }
+
+  // Drawn directly, so group the instances by LOD and draw each group with one call.
+  const uint32_t* order = cpuCulling ? sphereCuller.visible() : nullptr;
+  uint32_t        drawn = cpuCulling ? visible : count;
+  instanceLods.resize(drawn);
+  for (uint32_t slot = 0; slot < drawn; slot++) {
+    instanceLods[slot] = select_lod(order ? order[slot] : slot);
+    lodCounts[instanceLods[slot]]++;
+  }
+
+  std::vector<uint32_t> lodSlots(lodCounts.size(), 0);
+  for (size_t lod = 1; lod < lodCounts.size(); lod++) {
+    lodSlots[lod] = lodSlots[lod - 1] + lodCounts[lod - 1];
+  }
+  for (uint32_t slot = 0; slot < drawn; slot++) {
+    uint32_t lod = instanceLods[slot];
+    write_instance(lodSlots[lod]++, order ? order[slot] : slot, lod);
+  }
+
+  cullStats.drawCount =
+      static_cast<uint32_t>(std::count_if(lodCounts.begin(), lodCounts.end(), [](uint32_t n) { return n > 0; }));
+  cullStats.visibleInstances = drawn;
+  cullStats.totalInstances   = count;
+  cullStats.expectedVisible  = visible;
+}
+
+/**
+ * @brief Rebuild the scene as one node per instance on a square grid centred on the
+ * origin. Takes effect from the next frame, instance buffers grow as frames reach them.
+ *
+ * @param count
+ */
+void Core::set_instance_count(uint32_t count)
+{
+  const float spacing = 2.5f;
+
+  count = std::max(count, 1u);
+
+  uint32_t side  = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+  float    start = -0.5f * spacing * (side - 1);
+
+  scene.clear();
+  scene.reserve(count + 1);
+  Scene::NodeId root = scene.create_node();
+
+  instanceNodes.resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    glm::vec3 offset = glm::vec3(start + spacing * (i % side), start + spacing * (i / side), 0.0f);
+    instanceNodes[i] = scene.create_node(root);
+    scene.set_translation(instanceNodes[i], offset);
+  }
+  sceneRadius = std::max(1.0f, 0.5f * spacing * side);
+}
+
+/**
+ * @brief Switch the depth pre-pass on or off. Rebuilds the render passes and pipelines,
+ * so frames are skipped until the new pipelines have compiled.
+ *
+ * @param enabled
+ */
+void Core::set_depth_prepass(bool enabled)
+{
+  if (settings.depthPrepass == enabled) {
+    return;
+  }
+  settings.depthPrepass = enabled;
+  if (enabled && positionBuffer == VK_NULL_HANDLE) {
+    create_position_buffer();
+  }
+  recreate_swap_chain();
+}
+
+/**
+ * @brief Picks the sample count and sample shading of the current tier, clamped to what
+ * the device supports
+ */
+void Core::apply_quality_tier()
+{
+  TierMultisampling tier = tier_multisampling(settings.quality);
+  msaaSamples            = static_cast<VkSampleCountFlagBits>(std::min<uint32_t>(tier.samples, maxMsaaSamples));
+  minSampleShading       = tier.minSampleShading;
+}
+
+/**
+ * @brief Changes MSAA and sample shading at runtime, rebuilding the attachments and
+ * pipelines. An explicit choice stops the auto-tuner.
+ *
+ * @param tier
+ */
+void Core::set_quality_tier(QualityTier tier)
+{
+  qualityTuner.reset();
+  change_quality_tier(tier);
+}
+
+/**
+ * @brief
+ * @param tier
+ */
+void Core::change_quality_tier(QualityTier tier)
+{
+  if (settings.quality == tier) {
+    return;
+  }
+  settings.quality = tier;
+  apply_quality_tier();
+  recreate_swap_chain();
+}
+
+/**
+ * @brief Hands the GPU time of a frame to the auto-tuner and moves to the tier it asks for
+ *
+ * @param gpuMilliseconds
+ * @return true when the tier changed
+ */
+bool Core::tune_quality(double gpuMilliseconds)
+{
+  bool changed = qualityTuner->add(gpuMilliseconds);
+  if (changed) {
+    change_quality_tier(qualityTuner->tier());
+  }
+  if (qualityTuner->done()) {
+    std::cout << "Quality tier " << quality_tier_name(settings.quality) << ", " << qualityTuner->median()
+              << " ms per frame on the GPU against a target of " << settings.qualityTargetMs << " ms" << std::endl;
+    qualityTuner.reset();
+  }
+  return changed;
+}
+
+/**
+ * @brief Scales the swapchain extent by the render scale, the part of the attachments
+ * this frame draws to
+ */
+void Core::update_render_extent()
+{
+  float scale  = upscaling ? std::clamp(settings.renderScale, settings.minRenderScale, 1.0f) : 1.0f;
+  renderExtent = {std::max(static_cast<uint32_t>(swapchainExtent.width * scale + 0.5f), 1u),
+                  std::max(static_cast<uint32_t>(swapchainExtent.height * scale + 0.5f), 1u)};
+}
+
+/**
+ * @brief Draws at a fixed fraction of the swapchain resolution from the next frame on,
+ * an explicit scale stops dynamic resolution. The attachments stay at full size and
+ * frames only draw part of them, so changing the scale recreates nothing; only the first
+ * scale below 1 rebuilds the swapchain to add the upscale pass.
+ *
+ * @param scale per axis
+ */
+void Core::set_render_scale(float scale)
+{
+  resolutionController.reset();
+  settings.resolutionTargetMs = 0.0;
+  settings.renderScale        = std::clamp(scale, settings.minRenderScale, 1.0f);
+  if (!upscaling && settings.renderScale < 1.0f) {
+    recreate_swap_chain();
+  }
+}
+
+/**
+ * @brief Lets the GPU frame time drive the render scale
+ *
+ * @param milliseconds GPU frame time to hold, 0 keeps the current scale
+ */
+void Core::set_resolution_target(double milliseconds)
+{
+  settings.resolutionTargetMs = milliseconds;
+  if (milliseconds > 0.0 && !upscaling) {
+    recreate_swap_chain();
+  }
+  create_resolution_controller();
+}
+
+/**
+ * @brief Budget of the texture pool, levels move to meet it from the next frame
+ *
+ * @param megabytes 0 takes half of the free device memory
+ */
+void Core::set_texture_budget(uint32_t megabytes)
+{
+  settings.textureBudget = megabytes;
+  if (texturePool) {
+    texturePool->set_budget(texture_pool_budget());
+  }
+}
+
+/**
+ * @brief Switches the multisampled attachments between lazily allocated and device local
+ * memory, for comparing the two
+ *
+ * @param enabled
+ */
+void Core::set_lazy_attachments(bool enabled)
+{
+  if (settings.lazyAttachments == enabled) {
+    return;
+  }
+  settings.lazyAttachments = enabled;
+  recreate_swap_chain();
+}
+
+/**
+ * @brief
+ * @return the multisampled colour and depth attachments, with the memory the device has
+ * committed to them so far
+ */
+std::vector<AttachmentMemory> Core::attachment_memory() const
+{
+  std::vector<AttachmentMemory> attachments = {colorAttachmentMemory, depthAttachmentMemory};
+  attachments[0].name                       = "color";
+  attachments[1].name                       = "depth";
+
+  const VkDeviceMemory memories[] = {colorImageMemory, depthImageMemory};
+  for (size_t i = 0; i < attachments.size(); i++) {
+    attachments[i].committed = attachments[i].size;
+    if (attachments[i].lazy) {
+      vkGetDeviceMemoryCommitment(device, memories[i], &attachments[i].committed);
+    }
+  }
+  return attachments;
+}
+
+/**
+ * @brief Generate the texture's mip chain again from level 0, waits for the device first
+ *
+ * @param compute downsample in compute, needs compute_mipmaps_enabled()
+ * @return double milliseconds from recording the generation until it completed
+ */
+double Core::regenerate_mipmaps(bool compute)
+{
+  if (textureFormat != VK_FORMAT_R8G8B8A8_UNORM) {
+    throw std::runtime_error("Mip levels of a block compressed texture cannot be generated!");
+  }
+  if (compute && !mipGenerator) {
+    throw std::runtime_error("Compute mip generation is not available!");
+  }
+  if (texturePool) {
+    throw std::runtime_error("Mip levels of pooled textures cannot be generated!");
+  }
+  finish_texture_streaming();
+  vkDeviceWaitIdle(device);
+  transition_image_layout(textureImage,
+                          VK_FORMAT_R8G8B8A8_UNORM,
+                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                          mipLevels);
+
+  auto start = std::chrono::steady_clock::now();
+  generate_mipmaps(textureImage,
+                   VK_FORMAT_R8G8B8A8_UNORM,
+                   static_cast<int32_t>(textureExtent.width),
+                   static_cast<int32_t>(textureExtent.height),
+                   mipLevels,
+                   compute);
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Upload texture levels read since the last frame. Once more levels are resident,
+ * draws switch to the sampler that reaches them, through new cached descriptor sets or
+ * the bindless slot of that sampler, so sets of frames in flight stay as they are.
+ */
+void Core::stream_texture()
+{
+  textureStreamer->update();
+  if (textureStreamer->resident_level() != textureResidentLevel) {
+    textureResidentLevel = textureStreamer->resident_level();
+    if (textureTable) {
+      chaletTextureIndex = textureSlots[textureResidentLevel];
+    } else {
+      create_descriptor_sets();
+    }
+  }
+  if (textureStreamer->finished()) {
+    textureStreamer.reset();
+  }
+}
+
+/**
+ * @brief Make every texture level resident now, blocking on the reads left
+ */
+void Core::finish_texture_streaming()
+{
+  if (textureStreamer) {
+    textureStreamer->finish();
+    stream_texture();
+  }
+}
+
+/**
+ * @brief Pool the baked texture, settings.textureCount copies of it when textures are bindless.
+ * Left out when the texture can't be baked, the texture image takes its place.
+ */
+void Core::create_texture_pool()
+{
+  if (!settings.bakedMipmaps) {
+    std::cerr << "The texture pool needs baked mip levels, keeping every texture level resident." << std::endl;
+    return;
+  }
+  auto mapped = map_baked_texture(chalet.texturePath, choose_texture_format());
+  if (!mapped) {
+    return;
+  }
+
+  uint32_t count = std::max(settings.textureCount, 1u);
+  if (!textureTable && count > 1) {
+    std::cerr << "Textures are bound per model, every instance uses the first texture copy." << std::endl;
+    count = 1;
+  }
+
+  auto createImage = [this](uint32_t        width,
+                            uint32_t        height,
+                            uint32_t        levels,
+                            VkFormat        format,
+                            VkImage&        image,
+                            VkDeviceMemory& imageMemory) {
+    create_image(width,
+                 height,
+                 levels,
+                 VK_SAMPLE_COUNT_1_BIT,
+                 format,
+                 VK_IMAGE_TILING_OPTIMAL,
+                 VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 image,
+                 imageMemory);
+  };
+  auto createBuffer = [this](VkDeviceSize          size,
+                             VkBufferUsageFlags    usage,
+                             VkMemoryPropertyFlags properties,
+                             VkBuffer&             buffer,
+                             VkDeviceMemory&       bufferMemory) {
+    create_buffer(size, usage, properties, buffer, bufferMemory);
+  };
+
+  auto start    = std::chrono::steady_clock::now();
+  textureFormat = static_cast<VkFormat>(mapped->format());
+  textureExtent = {mapped->levels()[0].width, mapped->levels()[0].height};
+  mipLevels     = static_cast<uint32_t>(mapped->levels().size());
+  texturePool   = std::make_unique<TexturePool>(device,
+                                              commandPool,
+                                              graphicsQueue,
+                                              textureTable.get(),
+                                              createImage,
+                                              createBuffer,
+                                              static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT),
+                                              texture_pool_budget());
+  texturePool->add(std::move(mapped));
+  for (uint32_t copy = 1; copy < count; copy++) {
+    texturePool->add(std::make_unique<Texture::MappedTexture>(Texture::baked_texture_path(chalet.texturePath)));
+  }
+  textureUploadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Move pooled textures for the uses of the last frame. Without bindless textures
+ * the frame's set is written again with wherever the texture is now, the sets of frames
+ * in flight stay as they are.
+ */
+void Core::update_texture_pool()
+{
+  // Other processes change what is free, so a budget taken from the device follows it
+  const uint64_t budgetInterval = 120;
+  if (settings.textureBudget == 0 && memoryBudget && texturePool->frame_count() % budgetInterval == 0) {
+    texturePool->set_budget(texture_pool_budget());
+  }
+  texturePool->update();
+  if (!textureTable) {
+    descriptorSets[currentFrame] = descriptorAllocator->allocate_frame_set(
+        static_cast<uint32_t>(currentFrame), descriptorSetLayout, descriptor_writes(currentFrame));
+  }
+}
+
+/**
+ * @brief Bytes the texture pool may keep resident, settings.textureBudget or half of the
+ * device memory free to the pool
+ *
+ * @return uint64_t
+ */
+uint64_t Core::texture_pool_budget()
+{
+  const uint64_t megabyte = 1024 * 1024;
+  if (settings.textureBudget != 0) {
+    return settings.textureBudget * megabyte;
+  }
+  // The pool's own levels count as free, they are its to keep
+  uint64_t resident = texturePool ? texturePool->stats().residentBytes : 0;
+  return (helper->get_device_local_budget(physicalDevice, memoryBudget) + resident) / 2;
 }
 
 /**
@@ -1140,7 +2282,39 @@ void Core::update_uniform_buffer(uint32_t currentImage)
  */
 bool Core::draw()  // Eric: Draw is draw frame.
 {
+  if (graphicsPipeline == VK_NULL_HANDLE || (pipelineDepthPrepass && prepassPipeline == VK_NULL_HANDLE)) {
+    // Skip the frame instead of blocking while the pipelines compile.
+    if (!graphicsPipelineRequest.ready() || (pipelineDepthPrepass && !prepassPipelineRequest.ready())) {
+      std::this_thread::yield();
+      return true;
+    }
+    graphicsPipeline = graphicsPipelineRequest.wait();
+    if (pipelineDepthPrepass) {
+      prepassPipeline = prepassPipelineRequest.wait();
+    }
+  }
+
   vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+  descriptorAllocator->reset_frame(static_cast<uint32_t>(currentFrame));
+  if (textureStreamer) {
+    stream_texture();
+  }
+  if (texturePool) {
+    update_texture_pool();
+  }
+
+  if (double gpuMilliseconds; gpuTimer->collect(static_cast<uint32_t>(currentFrame), gpuMilliseconds)) {
+    frameTimings.gpuMilliseconds = gpuMilliseconds;
+    if (qualityTuner && tune_quality(gpuMilliseconds)) {
+      return true;  // The swapchain was rebuilt for the next tier, start over with it
+    }
+    if (!qualityTuner && resolutionController) {
+      settings.renderScale = resolutionController->add(gpuMilliseconds);
+    }
+  }
+  if (culler && culler->collect(static_cast<uint32_t>(currentFrame), cullStats)) {
+    cullStats.expectedVisible = expectedVisible[currentFrame];
+  }
 
   uint32_t imageIndex;
   VkResult result = vkAcquireNextImageKHR(device,
@@ -1162,20 +2336,25 @@ bool Core::draw()  // Eric: Draw is draw frame.
       return EXIT_FAILURE;
   }
 
-  update_uniform_buffer(imageIndex);
+  auto cpuStart = std::chrono::steady_clock::now();
+
+  update_render_extent();
+  update_uniform_buffer(static_cast<uint32_t>(currentFrame));
+  record_command_buffer(commandBuffers[currentFrame], imageIndex);
 
   VkSubmitInfo submitInfo = {};
   submitInfo.sType        = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
   VkSemaphore          waitSemaphores[] = {imageAvailableSemaphore[currentFrame]};
-  VkPipelineStageFlags waitStages[]     = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+  VkPipelineStageFlags waitStages[]     = {upscaling ? VK_PIPELINE_STAGE_TRANSFER_BIT
+                                                     : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
 
   submitInfo.waitSemaphoreCount = 1;
   submitInfo.pWaitSemaphores    = waitSemaphores;
   submitInfo.pWaitDstStageMask  = waitStages;
 
   submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers    = &commandBuffers[imageIndex];
+  submitInfo.pCommandBuffers    = &commandBuffers[currentFrame];
 
   VkSemaphore signalSemaphores[]  = {renderFinishedSemaphore[currentFrame]};
   submitInfo.signalSemaphoreCount = 1;
@@ -1185,6 +2364,8 @@ bool Core::draw()  // Eric: Draw is draw frame.
   if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
     throw std::runtime_error("Failed to submit draw command buffer!");
   }
+  frameTimings.cpuMilliseconds =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cpuStart).count();
 
   VkPresentInfoKHR presentInfo = {};
   presentInfo.sType            = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -1214,6 +2395,7 @@ bool Core::draw()  // Eric: Draw is draw frame.
   }
 
   currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+  framesRendered++;
   return true;
 }
 
@@ -1281,9 +2463,12 @@ void Core::create_buffer(VkDeviceSize          size,
   vkBindBufferMemory(device, buffer, bufferMemory, 0);
 }
 
+/**
+ * @brief One command buffer per frame in flight, they are recorded every frame
+ */
 void Core::create_command_buffers()
 {
-  commandBuffers.resize(swapchainFramebuffers.size());
+  commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
 
   VkCommandBufferAllocateInfo allocInfo = {};
   allocInfo.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -1294,22 +2479,48 @@ void Core::create_command_buffers()
   if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
     throw std::runtime_error("Failed to allocate command buffers!");
   }
+}
 
-  for (size_t i = 0; i < commandBuffers.size(); i++) {
-    VkCommandBufferBeginInfo beginInfo = {};
-    beginInfo.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags                    = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-    beginInfo.pInheritanceInfo         = nullptr;  // OptionalvkCmdDraw
-    if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) {
-      throw std::runtime_error("Failed to begin recording command buffers!");
-    }
+/**
+ * @brief Record the frame. Objects only differ by their entry in the per-instance vertex
+ * stream, so adding objects needs no descriptor updates, only more instance data.
+ *
+ * @param commandBuffer command buffer of the current frame, its fence has been waited on
+ * @param imageIndex swap chain image being rendered
+ */
+void Core::record_command_buffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  beginInfo.pInheritanceInfo         = nullptr;
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to begin recording command buffers!");
+  }
+
+  gpuTimer->begin(commandBuffer, static_cast<uint32_t>(currentFrame));
+
+  const uint32_t frame = static_cast<uint32_t>(currentFrame);
 
+  auto record_cull = [&](CullPhase phase) {
+    culler->record_cull(commandBuffer,
+                        frame,
+                        instanceBuffers[currentFrame],
+                        instanceDrawCounts[currentFrame],
+                        cameraFrustum,
+                        cameraPosition,
+                        cameraViewProjection,
+                        phase);
+  };
+
+  // One pass over the framebuffer, the load pass keeps what the clearing pass drew.
+  auto record_pass = [&](VkRenderPass pass, CullPhase phase) {
     VkRenderPassBeginInfo renderPassInfo = {};
     renderPassInfo.sType                 = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass            = renderPass;
-    renderPassInfo.framebuffer           = swapchainFramebuffers[i];
+    renderPassInfo.renderPass            = pass;
+    renderPassInfo.framebuffer           = swapchainFramebuffers[imageIndex];
     renderPassInfo.renderArea.offset     = {0, 0};
-    renderPassInfo.renderArea.extent     = swapchainExtent;
+    renderPassInfo.renderArea.extent     = renderExtent;
 
     std::array<VkClearValue, 2> clearValues = {};
     clearValues[0].color                    = {0.0f, 0.0f, 0.0f, 1.0f};
@@ -1318,31 +2529,143 @@ void Core::create_command_buffers()
     renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
     renderPassInfo.pClearValues    = clearValues.data();
 
-    vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    VkViewport viewport = {};
+    viewport.x          = 0.0f;
+    viewport.y          = 0.0f;
+    viewport.width      = (float)renderExtent.width;
+    viewport.height     = (float)renderExtent.height;
+    viewport.minDepth   = 0.0f;
+    viewport.maxDepth   = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor = {};
+    scissor.offset   = {0, 0};
+    scissor.extent   = renderExtent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-    VkBuffer     vertexBuffers[] = {vertexBuffer};
-    VkDeviceSize offsets[]       = {0};
-    vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
-    vkCmdBindIndexBuffer(commandBuffers[i], indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
 
-    vkCmdBindDescriptorSets(commandBuffers[i],
+    std::vector<VkDescriptorSet> sets = {descriptorSets[currentFrame]};
+    if (textureTable) {
+      sets.push_back(textureTable->set());
+    }
+    vkCmdBindDescriptorSets(commandBuffer,
                             VK_PIPELINE_BIND_POINT_GRAPHICS,
                             pipelineLayout,
                             0,
-                            1,
-                            &descriptorSets[i],
+                            static_cast<uint32_t>(sets.size()),
+                            sets.data(),
                             0,
                             nullptr);
-    vkCmdDrawIndexed(commandBuffers[i], static_cast<uint32_t>(chalet.indices.size()), 1, 0, 0, 0);
-    vkCmdEndRenderPass(commandBuffers[i]);
 
-    if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
-      throw std::runtime_error("Failed recording command buffers!");
+    // The pre-pass draws the same list as the colour subpass from the position stream.
+    auto record_draws = [&](VkPipeline pipeline, VkBuffer vertices) {
+      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+      VkBuffer     vertexBuffers[] = {vertices, instanceBuffers[currentFrame]};
+      VkDeviceSize offsets[]       = {0, 0};
+      vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+
+      if (culler) {
+        culler->record_draw(commandBuffer, frame, multiDrawIndirect, phase);
+        return;
+      }
+      uint32_t firstInstance = 0;
+      for (size_t lod = 0; lod < chalet.lods.size(); lod++) {
+        uint32_t lodInstances = instanceDrawCounts[currentFrame][lod];
+        if (lodInstances > 0) {
+          vkCmdDrawIndexed(
+              commandBuffer, chalet.lods[lod].indexCount, lodInstances, chalet.lods[lod].firstIndex, 0, firstInstance);
+        }
+        firstInstance += lodInstances;
+      }
+    };
+
+    if (pipelineDepthPrepass) {
+      record_draws(prepassPipeline, positionBuffer);
+      vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+    }
+    record_draws(graphicsPipeline, vertexBuffer);
+    vkCmdEndRenderPass(commandBuffer);
+  };
+
+  frameGraph.bind(colorTarget, colorImage);
+  frameGraph.bind(depthTarget, depthImage);
+  frameGraph.bind(swapchainTarget, swapchainImages[imageIndex]);
+  if (upscaling) {
+    frameGraph.bind(resolveTarget, sceneImage);
+  }
+  if (depthPyramid) {
+    depthPyramid->set_region(renderExtent);
+    depthPyramid->record_prepare(commandBuffer);
+  }
+
+  // Occlusion culling draws last frame's visible set, builds the depth pyramid from it and
+  // then draws whatever the pyramid shows became visible.
+  frameGraph.execute(commandBuffer, [&](PassId pass) {
+    if (pass == pyramidPass) {
+      depthPyramid->record_build(commandBuffer, frame, depthImageView);
+      return;
+    }
+    if (pass == upscalePass) {
+      record_upscale(commandBuffer, swapchainImages[imageIndex]);
+      return;
+    }
+
+    CullPhase phase = CullPhase::All;
+    if (depthPyramid) {
+      phase = pass == latePass ? CullPhase::Late : CullPhase::Early;
+    }
+    if (culler) {
+      record_cull(phase);
     }
+    record_pass(pass == latePass ? occlusionRenderPass : renderPass, phase);
+  });
+
+  gpuTimer->end(commandBuffer, static_cast<uint32_t>(currentFrame));
+
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("Failed recording command buffers!");
   }
 }
 
+/**
+ * @brief Stretches the part of the scene image drawn this frame over the whole swapchain
+ * image, the frame graph has put both in their transfer layouts
+ *
+ * @param commandBuffer
+ * @param target swapchain image
+ */
+void Core::record_upscale(VkCommandBuffer commandBuffer, VkImage target)
+{
+  const int32_t srcWidth  = static_cast<int32_t>(renderExtent.width);
+  const int32_t srcHeight = static_cast<int32_t>(renderExtent.height);
+  const int32_t dstWidth  = static_cast<int32_t>(swapchainExtent.width);
+  const int32_t dstHeight = static_cast<int32_t>(swapchainExtent.height);
+
+  VkImageBlit blit                   = {};
+  blit.srcOffsets[0]                 = {0, 0, 0};
+  blit.srcOffsets[1]                 = {srcWidth, srcHeight, 1};
+  blit.srcSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+  blit.srcSubresource.mipLevel       = 0;
+  blit.srcSubresource.baseArrayLayer = 0;
+  blit.srcSubresource.layerCount     = 1;
+  blit.dstOffsets[0]                 = {0, 0, 0};
+  blit.dstOffsets[1]                 = {dstWidth, dstHeight, 1};
+  blit.dstSubresource                = blit.srcSubresource;
+
+  vkCmdBlitImage(commandBuffer,
+                 sceneImage,
+                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                 target,
+                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                 1,
+                 &blit,
+                 VK_FILTER_LINEAR);
+}
+
 void Core::create_command_pool()
 {
   QueueFamilyIndices queueFamilyIndices = helper->find_queue_families(physicalDevice, surface);
@@ -1350,7 +2673,7 @@ void Core::create_command_pool()
   VkCommandPoolCreateInfo poolInfo = {};
   poolInfo.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
   poolInfo.queueFamilyIndex        = queueFamilyIndices.graphicsFamily.value();
-  poolInfo.flags                   = 0;
+  poolInfo.flags                   = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
   if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
     throw std::runtime_error("Failed to create command pool!");
@@ -1362,7 +2685,8 @@ void Core::create_frame_buffer()
   swapchainFramebuffers.resize(swapchainImageViews.size());
 
   for (size_t i = 0; i < swapchainImageViews.size(); i++) {
-    std::array<VkImageView, 3> attachments = {colorImageView, depthImageView, swapchainImageViews[i]};
+    VkImageView                resolveView = upscaling ? sceneImageView : swapchainImageViews[i];
+    std::array<VkImageView, 3> attachments = {colorImageView, depthImageView, resolveView};
 
     VkFramebufferCreateInfo framebufferInfo = {};
     framebufferInfo.sType                   = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
@@ -1379,37 +2703,109 @@ void Core::create_frame_buffer()
   }
 }
 
+/**
+ * @brief Declare the passes of a frame and what they read and write. The graph picks
+ * the attachment ops of the render passes and the barriers between passes.
+ */
+void Core::build_frame_graph()
+{
+  frameGraph = RenderGraph();
+
+  ImageInfo color;
+  color.name = "color";
+
+  VkFormat  format = helper->find_depth_format(physicalDevice);
+  ImageInfo depth;
+  depth.name   = "depth";
+  depth.aspect = helper->has_stencil_component(format) ? VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT
+                                                       : VK_IMAGE_ASPECT_DEPTH_BIT;
+
+  ImageInfo swapchain;
+  swapchain.name        = "swapchain";
+  swapchain.imported    = true;
+  swapchain.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+  // The render pass waits for the image itself, the blit needs a barrier that does.
+  if (upscaling) {
+    swapchain.initialStages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  }
+
+  ImageInfo scene;
+  scene.name = "scene";
+
+  colorTarget     = frameGraph.add_image(color);
+  depthTarget     = frameGraph.add_image(depth);
+  swapchainTarget = frameGraph.add_image(swapchain);
+  resolveTarget   = upscaling ? frameGraph.add_image(scene) : swapchainTarget;
+
+  auto       draw         = frameGraph.add_pass("draw");
+  ResourceId drawnColor   = draw.write(colorTarget, ImageUse::ColorAttachment, true);
+  ResourceId drawnDepth   = draw.write(depthTarget, ImageUse::DepthAttachment, true);
+  ResourceId resolvedDraw = draw.write(resolveTarget, ImageUse::Resolve);
+
+  mainPass    = draw.id();
+  pyramidPass = RenderGraph::noPass;
+  latePass    = RenderGraph::noPass;
+  upscalePass = RenderGraph::noPass;
+
+  if (occlusionCulling) {
+    auto pyramid = frameGraph.add_pass("depth pyramid", PassType::Compute);
+    pyramid.read(drawnDepth, ImageUse::Sampled).side_effects();
+
+    auto late = frameGraph.add_pass("late draw");
+    late.read(drawnColor, ImageUse::ColorAttachment).read(drawnDepth, ImageUse::DepthAttachment);
+    late.write(drawnColor, ImageUse::ColorAttachment);
+    late.write(drawnDepth, ImageUse::DepthAttachment);
+    resolvedDraw = late.write(resolvedDraw, ImageUse::Resolve);
+
+    pyramidPass = pyramid.id();
+    latePass    = late.id();
+  }
+
+  if (upscaling) {
+    // A blit, not a render pass, so barriers change the layouts.
+    auto upscale = frameGraph.add_pass("upscale", PassType::Transfer);
+    upscale.read(resolvedDraw, ImageUse::TransferSource);
+    upscale.write(swapchainTarget, ImageUse::TransferDestination);
+
+    upscalePass = upscale.id();
+  }
+
+  frameGraph.compile();
+}
+
 void Core::create_render_pass()
 {
+  build_frame_graph();
+
+  auto apply_ops = [this](VkAttachmentDescription& attachment, PassId pass, ResourceId resource) {
+    AttachmentOps ops        = frameGraph.attachment(pass, resource);
+    attachment.loadOp        = ops.loadOp;
+    attachment.storeOp       = ops.storeOp;
+    attachment.initialLayout = ops.initialLayout;
+    attachment.finalLayout   = ops.finalLayout;
+  };
+
   VkAttachmentDescription colorAttachment = {};
   colorAttachment.format                  = swapchainImageFormat;
   colorAttachment.samples                 = msaaSamples;
-  colorAttachment.loadOp                  = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  colorAttachment.storeOp                 = VK_ATTACHMENT_STORE_OP_STORE;
   colorAttachment.stencilLoadOp           = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   colorAttachment.stencilStoreOp          = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  colorAttachment.initialLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
-  colorAttachment.finalLayout             = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  apply_ops(colorAttachment, mainPass, colorTarget);
 
   VkAttachmentDescription depthAttachment = {};
   depthAttachment.format                  = helper->find_depth_format(physicalDevice);
   depthAttachment.samples                 = msaaSamples;
-  depthAttachment.loadOp                  = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  depthAttachment.storeOp                 = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   depthAttachment.stencilLoadOp           = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   depthAttachment.stencilStoreOp          = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  depthAttachment.initialLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
-  depthAttachment.finalLayout             = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  apply_ops(depthAttachment, mainPass, depthTarget);
 
   VkAttachmentDescription colorAttachmentResolve = {};
   colorAttachmentResolve.format                  = swapchainImageFormat;
   colorAttachmentResolve.samples                 = VK_SAMPLE_COUNT_1_BIT;
-  colorAttachmentResolve.loadOp                  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  colorAttachmentResolve.storeOp                 = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   colorAttachmentResolve.stencilLoadOp           = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   colorAttachmentResolve.stencilStoreOp          = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  colorAttachmentResolve.initialLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
-  colorAttachmentResolve.finalLayout             = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  apply_ops(colorAttachmentResolve, mainPass, resolveTarget);
 
   VkAttachmentReference colorAttachmentRef = {};
   colorAttachmentRef.attachment            = 0;
@@ -1437,6 +2833,49 @@ void Core::create_render_pass()
   dependency.srcAccessMask       = 0;
   dependency.dstStageMask        = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
   dependency.dstAccessMask       = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  if (upscaling) {
+    dependency.srcStageMask |= VK_PIPELINE_STAGE_TRANSFER_BIT;  // The previous frame's blit reads the scene image
+  }
+
+  std::vector<VkSubpassDescription> subpasses    = {subpass};
+  std::vector<VkSubpassDependency>  dependencies = {dependency};
+
+  // The pre-pass is a depth only subpass ahead of the colour one, which then only reads
+  // depth. Both stay in one render pass so tilers keep depth on chip between them.
+  VkAttachmentReference depthReadOnlyRef = {};
+  depthReadOnlyRef.attachment            = 1;
+  depthReadOnlyRef.layout                = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+  if (settings.depthPrepass) {
+    VkSubpassDescription prepass    = {};
+    prepass.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    prepass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    subpass.pDepthStencilAttachment = &depthReadOnlyRef;
+    subpasses                       = {prepass, subpass};
+
+    VkSubpassDependency depthDependency = {};
+    depthDependency.srcSubpass          = VK_SUBPASS_EXTERNAL;
+    depthDependency.dstSubpass          = 0;
+    depthDependency.srcStageMask        = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    depthDependency.srcAccessMask       = 0;
+    depthDependency.dstStageMask        = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    depthDependency.dstAccessMask       = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    VkSubpassDependency prepassDependency = {};
+    prepassDependency.srcSubpass          = 0;
+    prepassDependency.dstSubpass          = 1;
+    prepassDependency.srcStageMask        = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    prepassDependency.srcAccessMask       = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    prepassDependency.dstStageMask        = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    prepassDependency.dstAccessMask       = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+    prepassDependency.dependencyFlags     = VK_DEPENDENCY_BY_REGION_BIT;
+
+    dependencies[0].dstSubpass = 1;
+    dependencies.push_back(depthDependency);
+    dependencies.push_back(prepassDependency);
+  }
 
   std::array<VkAttachmentDescription, 3> attachments = {colorAttachment, depthAttachment, colorAttachmentResolve};
 
@@ -1444,199 +2883,182 @@ void Core::create_render_pass()
   renderPassInfo.sType                  = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
   renderPassInfo.attachmentCount        = static_cast<uint32_t>(attachments.size());
   renderPassInfo.pAttachments           = attachments.data();
-  renderPassInfo.subpassCount           = 1;
-  renderPassInfo.pSubpasses             = &subpass;
-  renderPassInfo.dependencyCount        = 1;
-  renderPassInfo.pDependencies          = &dependency;
+  renderPassInfo.subpassCount           = static_cast<uint32_t>(subpasses.size());
+  renderPassInfo.pSubpasses             = subpasses.data();
+  renderPassInfo.dependencyCount        = static_cast<uint32_t>(dependencies.size());
+  renderPassInfo.pDependencies          = dependencies.data();
 
   if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
     throw std::runtime_error("Failed to create render pass!");
   }
+
+  if (!occlusionCulling) {
+    return;
+  }
+
+  // Same attachments and subpasses, so the framebuffers and the pipelines are compatible
+  // with both passes, but the late phase draws over what the early phase left. The frame
+  // graph's barriers order it after the early phase and the depth pyramid.
+  apply_ops(attachments[0], latePass, colorTarget);
+  apply_ops(attachments[1], latePass, depthTarget);
+  apply_ops(attachments[2], latePass, resolveTarget);
+
+  if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &occlusionRenderPass) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create render pass!");
+  }
 }
 
+/**
+ * @brief Reflect the shaders and fetch the matching layouts from the layout cache
+ *
+ * With bindless textures set 1 is the texture table, its layout comes from the table
+ * since the shader only declares an unsized array.
+ */
 void Core::create_descriptor_set_layout()
 {
-  VkDescriptorSetLayoutBinding uboLayoutBinding = {};
-  uboLayoutBinding.binding                      = 0;
-  uboLayoutBinding.descriptorType               = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  uboLayoutBinding.descriptorCount              = 1;
-  uboLayoutBinding.stageFlags                   = VK_SHADER_STAGE_VERTEX_BIT;
-  uboLayoutBinding.pImmutableSamplers           = nullptr;  // Optional
-
-  VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
-  samplerLayoutBinding.binding                      = 1;
-  samplerLayoutBinding.descriptorCount              = 1;
-  samplerLayoutBinding.descriptorType               = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  samplerLayoutBinding.pImmutableSamplers           = nullptr;
-  samplerLayoutBinding.stageFlags                   = VK_SHADER_STAGE_FRAGMENT_BIT;
+  if (bindlessCapacity != 0 && !textureTable) {
+    textureTable = std::make_unique<BindlessTextureTable>(device, *layoutCache, bindlessCapacity);
+  }
 
-  std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, samplerLayoutBinding};
+  shaderInterface = ShaderReflection();
+  shaderInterface.reflect(utility->read_file("triangle.vert.spv"));
+  shaderInterface.reflect(utility->read_file(fragment_shader_path()));
 
-  VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-  layoutInfo.sType                           = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-  layoutInfo.bindingCount                    = static_cast<uint32_t>(bindings.size());
-  layoutInfo.pBindings                       = bindings.data();
+  auto attributes = Object::Vertex::getAttributesDescription();
+  if (!shaderInterface.vertex_inputs_match(attributes.data(), attributes.size())) {
+    throw std::runtime_error("Vertex shader inputs do not match the vertex layout!");
+  }
 
-  if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
-    throw std::runtime_error("Failed to create descriptor set layout!");
+  std::vector<uint32_t> expectedSets = {0};
+  if (textureTable) {
+    expectedSets.push_back(1);
+  }
+  if (shaderInterface.set_indices() != expectedSets) {
+    throw std::runtime_error("Shaders use unexpected descriptor sets!");
   }
+  descriptorSetLayout = layoutCache->get_set_layout(shaderInterface.set_bindings(0));
 }
 
 /**
-* @brief
+ * @brief
+ * @return fragment shader matching the texture binding model in use
+ */
+std::string Core::fragment_shader_path() const
+{
+  return textureTable ? "triangle_bindless.frag.spv" : "triangle.frag.spv";
+}
+
+/**
+* @brief Fetch the pipeline layout and queue the graphics pipeline on the
+* pipeline compiler. draw() skips frames until the pipeline is ready.
 *
+* Must be called while the device is idle, ready pipelines from earlier
+* requests are destroyed here.
 */
 void Core::create_graphics_pipeline()
 {
-  auto vertShaderCode = utility->read_file("triangle.vert.spv");
-  auto fragShaderCode = utility->read_file("triangle.frag.spv");
-
-  VkShaderModule vertShaderModule;
-  VkShaderModule fragShaderModule;
-
-  vertShaderModule = shader->create_shader_module(device, vertShaderCode);
-  fragShaderModule = shader->create_shader_module(device, fragShaderCode);
-
-  VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
-  vertShaderStageInfo.sType                           = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  vertShaderStageInfo.stage                           = VK_SHADER_STAGE_VERTEX_BIT;
-  vertShaderStageInfo.module                          = vertShaderModule;
-  vertShaderStageInfo.pName                           = "main";
-
-  VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
-  fragShaderStageInfo.sType                           = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  fragShaderStageInfo.stage                           = VK_SHADER_STAGE_FRAGMENT_BIT;
-  fragShaderStageInfo.module                          = fragShaderModule;
-  fragShaderStageInfo.pName                           = "main";
-
-  VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
-
-  VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-  vertexInputInfo.sType                                = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-
-  auto bindingDescription   = Object::Vertex::getBindingDescription();
-  auto attributeDescription = Object::Vertex::getAttributesDescription();
-
-  vertexInputInfo.vertexBindingDescriptionCount   = 1;
-  vertexInputInfo.pVertexBindingDescriptions      = &bindingDescription;  // optional
-  vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescription.size());
-  vertexInputInfo.pVertexAttributeDescriptions    = attributeDescription.data();  // optional
-
-  VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-  inputAssembly.sType                                  = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-  inputAssembly.topology                               = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-  inputAssembly.primitiveRestartEnable                 = VK_FALSE;
-
-  VkViewport viewport = {};
-  viewport.x          = 0.0f;
-  viewport.y          = 0.0f;
-  viewport.width      = (float)swapchainExtent.width;
-  viewport.height     = (float)swapchainExtent.height;
-  viewport.minDepth   = 0.0f;
-  viewport.maxDepth   = 1.0f;
-
-  VkRect2D scissor = {};
-  scissor.offset   = {0, 0};
-  scissor.extent   = swapchainExtent;
-
-  VkPipelineViewportStateCreateInfo viewportState = {};
-  viewportState.sType                             = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-  viewportState.viewportCount                     = 1;
-  viewportState.pViewports                        = &viewport;
-  viewportState.scissorCount                      = 1;
-  viewportState.pScissors                         = &scissor;
-
-  VkPipelineRasterizationStateCreateInfo rasterizer = {};
-  rasterizer.sType                                  = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-  rasterizer.depthClampEnable                       = VK_FALSE;
-  rasterizer.rasterizerDiscardEnable                = VK_FALSE;
-  rasterizer.polygonMode                            = VK_POLYGON_MODE_FILL;
-  rasterizer.lineWidth                              = 1.0f;
-  rasterizer.cullMode                               = VK_CULL_MODE_BACK_BIT;
-  rasterizer.frontFace                              = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-  rasterizer.depthBiasEnable                        = VK_FALSE;
-  rasterizer.depthBiasConstantFactor                = 0.0f;  // optional
-  rasterizer.depthBiasClamp                         = 0.0f;  // optional
-  rasterizer.depthBiasSlopeFactor                   = 0.0f;  // optional
-
-  VkPipelineMultisampleStateCreateInfo multisampling = {};
-  multisampling.sType                                = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-  multisampling.sampleShadingEnable                  = VK_TRUE;
-  multisampling.rasterizationSamples                 = msaaSamples;
-  multisampling.minSampleShading                     = 0.2f;      // optional
-  multisampling.pSampleMask                          = nullptr;   // optional
-  multisampling.alphaToCoverageEnable                = VK_FALSE;  // optional
-  multisampling.alphaToOneEnable                     = VK_FALSE;  // optional
-
-  VkPipelineDepthStencilStateCreateInfo depthStencil = {};
-  depthStencil.sType                                 = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-  depthStencil.depthTestEnable                       = VK_TRUE;
-  depthStencil.depthWriteEnable                      = VK_TRUE;
-  depthStencil.depthCompareOp                        = VK_COMPARE_OP_LESS;
-  depthStencil.depthBoundsTestEnable                 = VK_FALSE;
-  depthStencil.minDepthBounds                        = 0.0f;  // Optional
-  depthStencil.maxDepthBounds                        = 1.0f;  // Optional
-  depthStencil.stencilTestEnable                     = VK_FALSE;
-  depthStencil.front                                 = {};  // Optional
-  depthStencil.back                                  = {};  // Optional
-
-  VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-  colorBlendAttachment.colorWriteMask =
-      VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-  colorBlendAttachment.blendEnable         = VK_FALSE;
-  colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;   // optional
-  colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;  // optional
-  colorBlendAttachment.colorBlendOp        = VK_BLEND_OP_ADD;       // optional
-  colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;   // optional
-  colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;  // optional
-  colorBlendAttachment.alphaBlendOp        = VK_BLEND_OP_ADD;       // optional
-
-  VkPipelineColorBlendStateCreateInfo colorBlending = {};
-  colorBlending.sType                               = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-  colorBlending.logicOpEnable                       = VK_FALSE;
-  colorBlending.logicOp                             = VK_LOGIC_OP_COPY;  // optional
-  colorBlending.attachmentCount                     = 1;
-  colorBlending.pAttachments                        = &colorBlendAttachment;
-  colorBlending.blendConstants[0]                   = 0.0f;  // optional
-  colorBlending.blendConstants[1]                   = 0.0f;  // optional
-  colorBlending.blendConstants[2]                   = 0.0f;  // optional
-  colorBlending.blendConstants[3]                   = 0.0f;  // optional
-
-  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-  pipelineLayoutInfo.sType                      = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutInfo.setLayoutCount             = 1;                     // optional
-  pipelineLayoutInfo.pSetLayouts                = &descriptorSetLayout;  // optional
-  pipelineLayoutInfo.pushConstantRangeCount     = 0;                     // optional
-
-  if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-    throw std::runtime_error("Failed to create pipeline layout!");
-  }
-
-  VkGraphicsPipelineCreateInfo pipelineInfo = {};
-  pipelineInfo.sType                        = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  pipelineInfo.stageCount                   = 2;
-  pipelineInfo.pStages                      = shaderStages;
-  pipelineInfo.pVertexInputState            = &vertexInputInfo;
-  pipelineInfo.pInputAssemblyState          = &inputAssembly;
-  pipelineInfo.pViewportState               = &viewportState;
-  pipelineInfo.pRasterizationState          = &rasterizer;
-  pipelineInfo.pMultisampleState            = &multisampling;
-  pipelineInfo.pDepthStencilState           = &depthStencil;  // optional
-  pipelineInfo.pColorBlendState             = &colorBlending;
-  pipelineInfo.pDynamicState                = nullptr;  // optional
-
-  pipelineInfo.layout     = pipelineLayout;
-  pipelineInfo.renderPass = renderPass;
-  pipelineInfo.subpass    = 0;
-
-  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;  // optional
-
-  if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-    throw std::runtime_error("Failed to create graphics pipeline!");
-  }
-
-  vkDestroyShaderModule(device, fragShaderModule, nullptr);
-  vkDestroyShaderModule(device, vertShaderModule, nullptr);
+  std::vector<VkDescriptorSetLayout> setLayouts = {descriptorSetLayout};
+  if (textureTable) {
+    setLayouts.push_back(textureTable->layout());
+  }
+  pipelineLayout = layoutCache->get_pipeline_layout(setLayouts, shaderInterface.push_constant_ranges());
+
+
+  GraphicsPipelineDescription description;
+  description.vertexShaderCode   = utility->read_file("triangle.vert.spv");
+  description.fragmentShaderCode = utility->read_file(fragment_shader_path());
+
+  for (const auto& binding : Object::Vertex::getBindingDescription()) {
+    description.bindingDescriptions.push_back(binding);
+  }
+  for (const auto& attribute : Object::Vertex::getAttributesDescription()) {
+    description.attributeDescriptions.push_back(attribute);
+  }
+
+  description.samples             = msaaSamples;
+  description.sampleShadingEnable = minSampleShading > 0.0f;
+  description.minSampleShading    = minSampleShading;
+  description.layout              = pipelineLayout;
+  description.renderPass          = renderPass;
+  description.subpass             = 0;
+
+  // After the pre-pass the depth buffer already holds the nearest surface, so only the
+  // fragments that produced it are shaded.
+  if (settings.depthPrepass) {
+    description.depthWriteEnable = false;
+    description.depthCompareOp   = VK_COMPARE_OP_EQUAL;
+    description.subpass          = 1;
+  }
+
+  if (graphicsPipelineRequest.valid()) {
+    retiredPipelineRequests.push_back(graphicsPipelineRequest);
+  }
+  if (prepassPipelineRequest.valid()) {
+    retiredPipelineRequests.push_back(prepassPipelineRequest);
+    prepassPipelineRequest = PipelineHandle();
+  }
+  retiredPipelineRequests.erase(std::remove_if(retiredPipelineRequests.begin(),
+                                               retiredPipelineRequests.end(),
+                                               [this](const PipelineHandle& request) {
+                                                 if (!request.ready()) {
+                                                   return false;
+                                                 }
+                                                 vkDestroyPipeline(device, request.wait(), nullptr);
+                                                 return true;
+                                               }),
+                                retiredPipelineRequests.end());
+
+  graphicsPipeline        = VK_NULL_HANDLE;
+  graphicsPipelineRequest = pipelineCompiler->request(std::move(description));
+  pipelineColorFormat     = swapchainImageFormat;
+  prepassPipeline         = VK_NULL_HANDLE;
+  pipelineDepthPrepass    = settings.depthPrepass;
+  pipelineQuality         = settings.quality;
+
+  if (!settings.depthPrepass) {
+    return;
+  }
+
+  GraphicsPipelineDescription prepass;
+  prepass.vertexShaderCode = utility->read_file("depth_prepass.vert.spv");
+
+  for (const auto& binding : Object::Vertex::getPositionBindingDescription()) {
+    prepass.bindingDescriptions.push_back(binding);
+  }
+  for (const auto& attribute : Object::Vertex::getPositionAttributesDescription()) {
+    prepass.attributeDescriptions.push_back(attribute);
+  }
+
+  prepass.samples          = msaaSamples;
+  prepass.colorWriteEnable = false;
+  prepass.colorAttachments = 0;
+  prepass.layout           = pipelineLayout;
+  prepass.renderPass       = renderPass;
+  prepass.subpass          = 0;
+
+  prepassPipelineRequest = pipelineCompiler->request(std::move(prepass));
+}
+
+/**
+ * @brief Wait for outstanding compiles and destroy every pipeline we own
+ */
+void Core::cleanup_pipelines()
+{
+  retiredPipelineRequests.push_back(graphicsPipelineRequest);
+  retiredPipelineRequests.push_back(prepassPipelineRequest);
+  for (auto& request : retiredPipelineRequests) {
+    if (request.valid()) {
+      vkDestroyPipeline(device, request.wait(), nullptr);
+    }
+  }
+  retiredPipelineRequests.clear();
+  graphicsPipelineRequest = PipelineHandle();
+  graphicsPipeline        = VK_NULL_HANDLE;
+  prepassPipelineRequest  = PipelineHandle();
+  prepassPipeline         = VK_NULL_HANDLE;
+  pipelineLayout          = VK_NULL_HANDLE;
+
+  pipelineCompiler.reset();
 }
 
 /**
@@ -1681,6 +3103,22 @@ void Core::create_swap_chain()
   createInfo.imageArrayLayers         = 1;
   createInfo.imageUsage               = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
+  // Below native resolution the frame is drawn into an image of its own and blitted over
+  // the swapchain image with a linear filter.
+  const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                            VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  VkFormatProperties formatProperties;
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, surfaceFomat.format, &formatProperties);
+  upscaling = settings.renderScale < 1.0f || settings.resolutionTargetMs > 0.0;
+  if (upscaling && ((formatProperties.optimalTilingFeatures & blitFeatures) != blitFeatures ||
+                    !(swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT))) {
+    std::cerr << "Swapchain images cannot be blitted to, rendering at native resolution." << std::endl;
+    upscaling = false;
+  }
+  if (upscaling) {
+    createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  }
+
   QueueFamilyIndices indicies              = helper->find_queue_families(physicalDevice, surface);
   uint32_t           queueFamilyIndicies[] = {indicies.graphicsFamily.value(), indicies.presentFamily.value()};
 
@@ -1838,6 +3276,9 @@ bool Core::load_device_entry_level_points()
     return false;                                                                        \
   }
 
+#include "vulkan/VulkanFunctions.inl"
+
+#define VK_OPTIONAL_DEVICE_LEVEL_FUNCTION(fun) fun = (PFN_##fun)vkGetDeviceProcAddr(device, #fun);
 #include "vulkan/VulkanFunctions.inl"
   return true;
 }
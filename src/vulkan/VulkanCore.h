@@ -24,6 +24,22 @@
 #include "VulkanFunctions.h"
 #include "VulkanObjects.h"
 #include "VulkanFactories.h"
+#include "VulkanPipelines.h"
+#include "VulkanReflection.h"
+#include "VulkanDescriptors.h"
+#include "VulkanSettings.h"
+#include "VulkanProfiler.h"
+#include "VulkanCulling.h"
+#include "VulkanOcclusion.h"
+#include "VulkanMipmaps.h"
+#include "VulkanRenderGraph.h"
+#include "VulkanStreaming.h"
+#include "VulkanResidency.h"
+#include "scene/frustumculler.h"
+#include "scene/scenegraph.h"
+#include "skeleton/threadpool.h"
+#include "texture/imageimport.h"
+#include "texture/texturefile.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -104,6 +120,47 @@ public:
   void cleanup();
   bool ready_to_draw() { return canRender; }
   bool on_window_size_changed();
+  void configure(const Settings& newSettings) { settings = newSettings; }
+  bool bindless_enabled() const { return textureTable != nullptr; }
+  bool gpu_culling_enabled() const { return culler != nullptr; }
+  bool occlusion_culling_enabled() const { return depthPyramid != nullptr; }
+  bool depth_prepass_enabled() const { return settings.depthPrepass; }
+  bool lazy_attachments_enabled() const { return settings.lazyAttachments; }
+  bool quality_tuning() const { return qualityTuner != nullptr; }
+  bool upscaling_enabled() const { return upscaling; }
+  bool compute_mipmaps_enabled() const { return mipGenerator != nullptr; }
+  VkFormat texture_format() const { return textureFormat; }
+  bool     texture_streaming() const { return textureStreamer != nullptr; }
+  uint32_t texture_resident_level() const { return textureResidentLevel; }
+  double   texture_upload_ms() const { return textureUploadMs; }
+  bool     texture_pool_enabled() const { return texturePool != nullptr; }
+  Texture::ResidencyStats texture_residency() const
+  {
+    return texturePool ? texturePool->stats() : Texture::ResidencyStats();
+  }
+  void set_instance_count(uint32_t count);
+  void set_depth_prepass(bool enabled);
+  void set_lazy_attachments(bool enabled);
+  void set_quality_tier(QualityTier tier);
+  void set_render_scale(float scale);
+  void set_resolution_target(double milliseconds);
+  void set_texture_budget(uint32_t megabytes);
+
+  QualityTier           quality_tier() const { return settings.quality; }
+  VkSampleCountFlagBits sample_count() const { return msaaSamples; }
+  float                 sample_shading() const { return minSampleShading; }
+  float                 render_scale() const { return settings.renderScale; }
+  VkExtent2D            render_extent() const { return renderExtent; }
+
+  std::vector<AttachmentMemory> attachment_memory() const;
+  double                        regenerate_mipmaps(bool compute);
+
+  uint32_t            instance_count() const { return static_cast<uint32_t>(instanceNodes.size()); }
+  uint64_t            frames_rendered() const { return framesRendered; }
+  const FrameTimings& frame_timings() const { return frameTimings; }
+  const CullStats&    culling_stats() const { return cullStats; }
+
+  const DescriptorAllocator::Stats& descriptor_stats() const { return descriptorAllocator->stats(); }
 
   struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
@@ -125,9 +182,31 @@ private:
   const int MAX_FRAMES_IN_FLIGHT = 2;
   size_t    currentFrame         = 0;
 
-  std::unique_ptr<Helper>          helper;
-  std::unique_ptr<Utility>         utility;
-  std::unique_ptr<Factory::Shader> shader;
+  std::unique_ptr<Helper>                helper;
+  std::unique_ptr<Utility>               utility;
+  std::unique_ptr<Factory::Shader>       shader;
+  std::unique_ptr<PipelineCompiler>      pipelineCompiler;
+  std::unique_ptr<DescriptorLayoutCache> layoutCache;
+  std::unique_ptr<DescriptorAllocator>   descriptorAllocator;
+  std::unique_ptr<BindlessTextureTable>  textureTable;
+  std::unique_ptr<GpuTimer>              gpuTimer;
+  std::unique_ptr<GpuCuller>             culler;
+  std::unique_ptr<DepthPyramid>          depthPyramid;  // Hi-Z of the early phase, only with occlusion culling
+  std::unique_ptr<QualityTuner>          qualityTuner;  // Until auto-tuning has settled on a tier
+  std::unique_ptr<ResolutionController>  resolutionController;  // Dynamic resolution, needs upscaling
+  std::unique_ptr<MipGenerator>          mipGenerator;  // Only when the texture format supports storage
+  std::unique_ptr<TextureStreamer>       textureStreamer;  // Until every texture level is resident
+  std::unique_ptr<TexturePool>           texturePool;      // In place of the texture image when settings ask for it
+  std::unique_ptr<Base::ThreadPool>      sceneWorkers;  // Parallel scene graph levels
+  ShaderReflection                       shaderInterface;
+  Settings                               settings;
+  uint32_t                               bindlessCapacity          = 0;
+  bool                                   drawIndirectFirstInstance = false;
+  bool                                   multiDrawIndirect         = false;
+  bool                                   drawIndirectCount         = false;
+  bool                                   occlusionCulling          = false;  // Multisampled depth can be sampled
+  bool                                   upscaling                 = false;  // Blit sceneImage up to the swapchain
+  bool                                   memoryBudget              = false;  // VK_EXT_memory_budget for the pool
 
   VkInstance                   instance;
   VkDebugUtilsMessengerEXT     callback;
@@ -140,37 +219,77 @@ private:
   std::vector<VkImage>         swapchainImages;
   VkFormat                     swapchainImageFormat;
   VkExtent2D                   swapchainExtent;
+  VkExtent2D                   renderExtent = {0, 0};  // Drawn part of the attachments, the swapchain extent scaled
   std::vector<VkImageView>     swapchainImageViews;
   VkRenderPass                 renderPass;
+  VkRenderPass                 occlusionRenderPass = VK_NULL_HANDLE;  // Loads what renderPass drew, for the late phase
+  RenderGraph                  frameGraph;  // Passes of a frame, rebuilt with the render passes
+  PassId                       mainPass        = 0;  // The early phase with occlusion culling
+  PassId                       pyramidPass     = RenderGraph::noPass;
+  PassId                       latePass        = RenderGraph::noPass;
+  PassId                       upscalePass     = RenderGraph::noPass;
+  ResourceId                   colorTarget     = 0;
+  ResourceId                   depthTarget     = 0;
+  ResourceId                   swapchainTarget = 0;
+  ResourceId                   resolveTarget   = 0;  // The swapchain, or the scene image when upscaling
   VkDescriptorSetLayout        descriptorSetLayout;
-  VkPipelineLayout             pipelineLayout;
-  VkPipeline                   graphicsPipeline;
+  VkPipelineLayout             pipelineLayout   = VK_NULL_HANDLE;
+  VkPipeline                   graphicsPipeline = VK_NULL_HANDLE;
+  PipelineHandle               graphicsPipelineRequest;
+  VkPipeline                   prepassPipeline = VK_NULL_HANDLE;  // Depth only, subpass 0 when the pre-pass is on
+  PipelineHandle               prepassPipelineRequest;
+  std::vector<PipelineHandle>  retiredPipelineRequests;
+  VkFormat                     pipelineColorFormat  = VK_FORMAT_UNDEFINED;
+  bool                         pipelineDepthPrepass = false;  // Subpass layout the pipelines were built for
+  QualityTier                  pipelineQuality      = QualityTier::Medium;
   std::vector<VkFramebuffer>   swapchainFramebuffers;
   VkCommandPool                commandPool;
   std::vector<VkCommandBuffer> commandBuffers;
   VkBuffer                     vertexBuffer = VK_NULL_HANDLE;
   VkDeviceMemory               vertexBufferMemory;
+  VkBuffer                     positionBuffer       = VK_NULL_HANDLE;  // Packed positions for the depth pre-pass
+  VkDeviceMemory               positionBufferMemory = VK_NULL_HANDLE;
   VkBuffer                     indexBuffer;
   VkDeviceMemory               indexBufferMemory;
   std::vector<VkBuffer>        uniformBuffers;
   std::vector<VkDeviceMemory>  uniformBuffersMemory;
-  VkDescriptorPool             descriptorPool;
+  std::vector<void*>           uniformBuffersMapped;
+  std::vector<VkBuffer>        instanceBuffers;
+  std::vector<VkDeviceMemory>  instanceBuffersMemory;
+  std::vector<void*>           instanceBuffersMapped;
+  std::vector<uint32_t>        instanceBufferCapacities;
   std::vector<VkDescriptorSet> descriptorSets;
-  VkSampleCountFlagBits        msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+  VkSampleCountFlagBits        msaaSamples      = VK_SAMPLE_COUNT_1_BIT;
+  VkSampleCountFlagBits        maxMsaaSamples   = VK_SAMPLE_COUNT_1_BIT;
+  float                        minSampleShading = 0.0f;
 
   uint32_t       mipLevels;
-  VkImage        textureImage;
-  VkDeviceMemory textureImageMemory;
-  VkImageView    textureImageView;
-  VkSampler      textureSampler;
+  VkExtent2D     textureExtent = {0, 0};
+  VkFormat       textureFormat = VK_FORMAT_R8G8B8A8_UNORM;
+  VkImage        textureImage       = VK_NULL_HANDLE;
+  VkDeviceMemory textureImageMemory = VK_NULL_HANDLE;
+  VkImageView    textureImageView   = VK_NULL_HANDLE;
+  uint32_t       textureResidentLevel = 0;    // Most detailed level resident, larger ones are still streaming
+  double         textureUploadMs      = 0.0;  // Spent loading the texture before the first frame
+
+  std::vector<VkSampler> textureSamplers;  // By the most detailed level they sample
+  std::vector<uint32_t>  textureSlots;     // Bindless slot of each sampler
+
+  VkImage          depthImage;
+  VkDeviceMemory   depthImageMemory;
+  VkImageView      depthImageView;
+  VkFormat         depthFormat = VK_FORMAT_UNDEFINED;
+  AttachmentMemory depthAttachmentMemory;
+
+  VkImage          colorImage;
+  VkDeviceMemory   colorImageMemory;
+  VkImageView      colorImageView;
+  AttachmentMemory colorAttachmentMemory;
 
-  VkImage        depthImage;
-  VkDeviceMemory depthImageMemory;
-  VkImageView    depthImageView;
+  VkImage     sceneImage     = VK_NULL_HANDLE;  // Resolved colour before upscaling
+  VkImageView sceneImageView = VK_NULL_HANDLE;
 
-  VkImage        colorImage;
-  VkDeviceMemory colorImageMemory;
-  VkImageView    colorImageView;
+  std::vector<VkDeviceMemory> attachmentBlocks;  // One per memory block of frameGraph
 
   std::vector<VkSemaphore> imageAvailableSemaphore;
   std::vector<VkSemaphore> renderFinishedSemaphore;
@@ -185,12 +304,29 @@ private:
 
   QueueFamilyIndices familyIndicies;
 
-  Object::Model chalet;
+  Object::Model              chalet;
+  uint32_t                   chaletTextureIndex = 0;
+  Scene::SceneGraph          scene;
+  std::vector<Scene::NodeId> instanceNodes;
+  float                      sceneRadius = 1.0f;
+  FrameTimings               frameTimings;
+  uint64_t                   framesRendered = 0;
+  Frustum                    cameraFrustum;
+  glm::mat4                  cameraViewProjection = glm::mat4(1.0f);
+  glm::vec3                  cameraPosition       = glm::vec3(0.0f);
+  float                      lodPixelScale        = 1.0f;  // Pixels covered by one unit at distance one
+  CullStats                  cullStats;
+  Scene::FrustumCuller       sphereCuller;
+  std::vector<uint32_t>      instanceLods;     // LOD of each instance drawn without the compute culler
+  std::vector<uint32_t>      expectedVisible;  // CPU reference per frame in flight
+
+  std::vector<std::vector<uint32_t>> instanceDrawCounts;  // Per frame in flight, instances at each LOD
 
   // Vulkan Private Interface Methods.
 
   void setup_debug_callback();
-  void update_uniform_buffer(uint32_t currentImage);
+  void update_uniform_buffer(uint32_t frame);
+  void update_instance_buffer(uint32_t frame, float time);
   bool clear();
 
   void create_buffer(VkDeviceSize          size,
@@ -199,7 +335,15 @@ private:
                      VkBuffer&             buffer,
                      VkDeviceMemory&       bufferMemory);
 
-  void            create_image(uint32_t              width,
+  void            create_unbound_image(uint32_t              width,
+                                       uint32_t              height,
+                                       uint32_t              mipLevels,
+                                       VkSampleCountFlagBits numSamples,
+                                       VkFormat              format,
+                                       VkImageTiling         tiling,
+                                       VkImageUsageFlags     usage,
+                                       VkImage&              image);
+  bool            create_image(uint32_t              width,
                                uint32_t              height,
                                uint32_t              mipLevels,
                                VkSampleCountFlagBits numSamples,
@@ -208,7 +352,14 @@ private:
                                VkImageUsageFlags     usage,
                                VkMemoryPropertyFlags properties,
                                VkImage&              image,
-                               VkDeviceMemory&       imageMemory);
+                               VkDeviceMemory&       imageMemory,
+                               VkMemoryPropertyFlags preferredProperties = 0);
+  void            create_attachment(VkFormat          format,
+                                    VkImageUsageFlags usage,
+                                    ResourceId        target,
+                                    VkImage&          image,
+                                    VkDeviceMemory&   imageMemory,
+                                    AttachmentMemory& report);
   void            copy_buffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
   VkCommandBuffer begin_single_time_commands();
   void            end_single_time_commands(VkCommandBuffer commandBuffer);
@@ -217,14 +368,24 @@ private:
                                           VkImageLayout oldLayout,
                                           VkImageLayout newLayout,
                                           uint32_t      mipLevels);
-  void            copy_buffer_to_image(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+  void            copy_buffer_to_image(VkBuffer                              buffer,
+                                       VkImage                               image,
+                                       const std::vector<Texture::MipLevel>& levels,
+                                       uint32_t                              levelCount);
   VkImageView     create_image_view(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
-  void generate_mipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
+  void            generate_mipmaps(VkImage  image,
+                                   VkFormat imageFormat,
+                                   int32_t  texWidth,
+                                   int32_t  texHeight,
+                                   uint32_t mipLevels,
+                                   bool     compute);
   void create_color_resources();
 
   VkSurfaceFormatKHR choose_swap_surface_format(const std::vector<VkSurfaceFormatKHR>& availableFormats);
   VkPresentModeKHR   choose_swap_present_mode(const std::vector<VkPresentModeKHR> availablePresentModes);
   VkExtent2D         choose_swap_extent(const VkSurfaceCapabilitiesKHR& capabilities);
+  std::string        fragment_shader_path() const;
+  DescriptorWrites   descriptor_writes(size_t frame) const;
 
   // Initialization
   void create_instance();
@@ -233,22 +394,51 @@ private:
   void create_surface(xcb_connection_t* connection, xcb_window_t handle);
   void create_swap_chain();
   void create_image_views();
+  void build_frame_graph();
   void create_render_pass();
   void create_descriptor_set_layout();
   void create_graphics_pipeline();
   void create_frame_buffer();
   void create_command_pool();
   void create_depth_resources();
+  void bind_attachments();
   void create_command_buffers();
+  void record_command_buffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
   void create_sync_objects();
   void create_texture_image();
+  VkFormat                                choose_texture_format();
+  void                                    stream_texture();
+  void                                    finish_texture_streaming();
+  void                                    create_texture_pool();
+  void                                    update_texture_pool();
+  uint64_t                                texture_pool_budget();
+  std::unique_ptr<Texture::MappedTexture> map_baked_texture(const std::string& imagePath, VkFormat format);
+  Texture::MipLevel                       import_texture_image(const std::string& imagePath,
+                                                               VkBuffer&          buffer,
+                                                               VkDeviceMemory&    bufferMemory);
   void create_texture_image_view();
   void create_texture_sampler();
   void create_vertex_buffer();
+  void create_position_buffer();
   void create_index_buffer();
   void create_uniform_buffers();
-  void create_descriptor_pool();
+  void create_descriptor_allocator();
   void create_descriptor_sets();
+  void create_instance_buffers();
+  void create_gpu_timer();
+  void create_culler();
+  void create_depth_pyramid();
+  void create_quality_tuner();
+  void create_resolution_controller();
+
+  // Quality
+  void apply_quality_tier();
+  void change_quality_tier(QualityTier tier);
+  bool tune_quality(double gpuMilliseconds);
+
+  // Dynamic resolution
+  void update_render_extent();
+  void record_upscale(VkCommandBuffer commandBuffer, VkImage target);
 
   // Recreation
   bool recreate_swap_chain();
@@ -256,6 +446,7 @@ private:
   // Cleanup
 
   void cleanup_swapchain();
+  void cleanup_pipelines();
 
   // Vulkan Private Interface Methods Borrowed from https://software.intel.com/en-us/articles/api-without-secrets-introduction-to-vulkan-part-1
 
@@ -0,0 +1,677 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include "VulkanFunctions.h"
+#include "VulkanCulling.h"
+#include "VulkanObjects.h"
+#include "VulkanReflection.h"
+
+namespace Rake { namespace Graphics {
+
+namespace {
+constexpr uint32_t     workgroupSize   = 64;
+constexpr uint32_t     maxGroupsPerRow = 65535;                 // Smallest maxComputeWorkGroupCount a device may have
+constexpr uint32_t     maxClusterDraws = 1 << 20;               // 20 MiB of meshlet commands per frame in flight
+constexpr VkDeviceSize countSize       = 4 * sizeof(uint32_t);  // Mesh draws, meshlet draws, in frustum, occluded
+constexpr VkDeviceSize commandsOffset  = 16;                    // Readback layout: counts, compacted commands
+constexpr uint32_t     earlyPhase      = 1;                     // OcclusionData::pyramid[3], as in cull_occlusion.comp
+constexpr uint32_t     latePhase       = 2;
+
+/**
+ * @brief Meshlet record read by cull_clusters.comp, std430
+ */
+struct GpuMeshlet {
+  glm::vec4 sphere;
+  glm::vec4 coneApex;
+  glm::vec4 cone;  // xyz axis and w cutoff
+  uint32_t  firstIndex;
+  uint32_t  indexCount;
+  uint32_t  padding[2];
+};
+static_assert(sizeof(GpuMeshlet) == 64, "GpuMeshlet must match the std430 layout in cull_clusters.comp");
+}  // namespace
+
+/**
+ * @brief Extract the planes from a clip space transform, depth is in [0, 1]
+ *
+ * @param viewProjection
+ * @return Frustum with normalized planes
+ */
+Frustum Frustum::from_view_projection(const glm::mat4& viewProjection)
+{
+  auto row = [&viewProjection](int i) {
+    return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+  };
+
+  Frustum frustum;
+  frustum.planes[0] = row(3) + row(0);
+  frustum.planes[1] = row(3) - row(0);
+  frustum.planes[2] = row(3) + row(1);
+  frustum.planes[3] = row(3) - row(1);
+  frustum.planes[4] = row(2);
+  frustum.planes[5] = row(3) - row(2);
+
+  for (auto& plane : frustum.planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+  return frustum;
+}
+
+/**
+ * @brief Same test as cull_instances.comp
+ *
+ * @param center
+ * @param radius
+ * @return false when the sphere is fully outside one plane
+ */
+bool Frustum::intersects_sphere(const glm::vec3& center, float radius) const
+{
+  for (const auto& plane : planes) {
+    if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief
+ *
+ * @param device
+ * @param layoutCache
+ * @param descriptorAllocator per frame descriptor sets come from its transient pools
+ * @param pipelineCompiler
+ * @param cullShaderCode cull_instances.comp
+ * @param compactShaderCode compact_draws.comp
+ * @param clusterShaderCode cull_clusters.comp, empty to always draw whole meshes. Ignored
+ * without useDrawCount as the meshlet draw count is only known on the GPU.
+ * @param occlusionShaderCode cull_occlusion.comp, empty to cull against the frustum only
+ * @param createBuffer
+ * @param frameCount number of frames in flight
+ * @param useDrawCount draw with vkCmdDrawIndexedIndirectCountKHR, VK_KHR_draw_indirect_count must be enabled
+ */
+GpuCuller::GpuCuller(VkDevice                 device,
+                     DescriptorLayoutCache&   layoutCache,
+                     DescriptorAllocator&     descriptorAllocator,
+                     PipelineCompiler&        pipelineCompiler,
+                     const std::vector<char>& cullShaderCode,
+                     const std::vector<char>& compactShaderCode,
+                     const std::vector<char>& clusterShaderCode,
+                     const std::vector<char>& occlusionShaderCode,
+                     CreateBuffer             createBuffer,
+                     uint32_t                 frameCount,
+                     bool                     useDrawCount)
+    : device(device)
+    , descriptorAllocator(descriptorAllocator)
+    , createBuffer(std::move(createBuffer))
+    , useDrawCount(useDrawCount)
+    , frames(occlusionShaderCode.empty() ? frameCount : 2 * frameCount)
+{
+  const bool clusters = useDrawCount && !clusterShaderCode.empty();
+
+  ShaderReflection reflection;
+  reflection.reflect(cullShaderCode);
+  reflection.reflect(compactShaderCode);
+  if (clusters) {
+    reflection.reflect(clusterShaderCode);
+  }
+  if (!occlusionShaderCode.empty()) {
+    reflection.reflect(occlusionShaderCode);
+  }
+
+  auto setLayouts = layoutCache.get_set_layouts(reflection);
+  if (setLayouts.size() != 1) {
+    throw std::runtime_error("Culling shaders must use exactly one descriptor set!");
+  }
+  setLayout      = setLayouts[0];
+  pipelineLayout = layoutCache.get_pipeline_layout(reflection);
+
+  cullPipeline    = pipelineCompiler.compile_compute(cullShaderCode, pipelineLayout);
+  compactPipeline = pipelineCompiler.compile_compute(compactShaderCode, pipelineLayout);
+  if (clusters) {
+    clusterPipeline = pipelineCompiler.compile_compute(clusterShaderCode, pipelineLayout);
+  }
+  if (!occlusionShaderCode.empty()) {
+    occlusionPipeline = pipelineCompiler.compile_compute(occlusionShaderCode, pipelineLayout);
+  }
+}
+
+/**
+ * @brief The pipeline and set layouts belong to the layout cache
+ */
+GpuCuller::~GpuCuller()
+{
+  vkDestroyPipeline(device, cullPipeline, nullptr);
+  vkDestroyPipeline(device, compactPipeline, nullptr);
+  if (clusterPipeline != VK_NULL_HANDLE) {
+    vkDestroyPipeline(device, clusterPipeline, nullptr);
+  }
+  if (occlusionPipeline != VK_NULL_HANDLE) {
+    vkDestroyPipeline(device, occlusionPipeline, nullptr);
+  }
+
+  for (auto& frame : frames) {
+    if (frame.readbackMapped != nullptr) {
+      vkUnmapMemory(device, frame.readbackMemory);
+    }
+    if (frame.occlusionMapped != nullptr) {
+      vkUnmapMemory(device, frame.occlusionMemory);
+    }
+    destroy_buffer(frame.draws, frame.drawsMemory);
+    destroy_buffer(frame.commands, frame.commandsMemory);
+    destroy_buffer(frame.count, frame.countMemory);
+    destroy_buffer(frame.visible, frame.visibleMemory);
+    destroy_buffer(frame.clusters, frame.clustersMemory);
+    destroy_buffer(frame.readback, frame.readbackMemory);
+    destroy_buffer(frame.occlusion, frame.occlusionMemory);
+  }
+  destroy_buffer(boundsBuffer, boundsBufferMemory);
+  destroy_buffer(meshletBuffer, meshletBufferMemory);
+  destroy_buffer(meshletRanges, meshletRangesMemory);
+  destroy_buffer(visibility, visibilityMemory);
+}
+
+/**
+ * @brief Replace the mesh list, instances select a mesh by InstanceData::meshIndex.
+ * The device must be idle.
+ *
+ * @param newMeshes
+ * @param meshlets indexed by IndirectMesh::firstMeshlet, required with a cluster shader
+ */
+void GpuCuller::set_meshes(const std::vector<IndirectMesh>& newMeshes, const std::vector<Scene::Meshlet>& meshlets)
+{
+  meshes = newMeshes;
+  destroy_buffer(boundsBuffer, boundsBufferMemory);
+  destroy_buffer(meshletBuffer, meshletBufferMemory);
+  destroy_buffer(meshletRanges, meshletRangesMemory);
+  if (meshes.empty()) {
+    return;
+  }
+
+  auto upload = [this](const void* source, VkDeviceSize size, VkBuffer& buffer, VkDeviceMemory& memory) {
+    createBuffer(size,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 buffer,
+                 memory);
+
+    void* data;
+    vkMapMemory(device, memory, 0, size, 0, &data);
+    memcpy(data, source, static_cast<size_t>(size));
+    vkUnmapMemory(device, memory);
+  };
+
+  std::vector<glm::vec4> spheres;
+  for (const auto& mesh : meshes) {
+    spheres.push_back(mesh.boundingSphere);
+  }
+  upload(spheres.data(), spheres.size() * sizeof(glm::vec4), boundsBuffer, boundsBufferMemory);
+
+  if (clusterPipeline == VK_NULL_HANDLE) {
+    return;
+  }
+  if (meshlets.empty()) {
+    throw std::runtime_error("The cluster pass needs meshlets!");
+  }
+
+  std::vector<GpuMeshlet> records(meshlets.size());
+  for (size_t i = 0; i < meshlets.size(); i++) {
+    records[i].sphere     = meshlets[i].sphere;
+    records[i].coneApex   = glm::vec4(meshlets[i].coneApex, 0.0f);
+    records[i].cone       = glm::vec4(meshlets[i].coneAxis, meshlets[i].coneCutoff);
+    records[i].firstIndex = meshlets[i].firstIndex;
+    records[i].indexCount = meshlets[i].indexCount;
+  }
+
+  std::vector<uint32_t> ranges;
+  for (const auto& mesh : meshes) {
+    ranges.push_back(mesh.firstMeshlet);
+    ranges.push_back(mesh.meshletCount);
+  }
+
+  upload(records.data(), records.size() * sizeof(GpuMeshlet), meshletBuffer, meshletBufferMemory);
+  upload(ranges.data(), ranges.size() * sizeof(uint32_t), meshletRanges, meshletRangesMemory);
+}
+
+/**
+ * @brief Record the cull and compaction passes, outside of a render pass. The frame's
+ * fence must have signaled.
+ *
+ * The early and late phases need the occlusion shader, and the late phase a depth
+ * pyramid built from the early phase's depth after its draws.
+ *
+ * @param commandBuffer
+ * @param frame
+ * @param instanceBuffer InstanceData of every instance, sorted by mesh
+ * @param meshInstanceCounts number of instances of each mesh
+ * @param frustum
+ * @param cameraPosition world space, for the meshlet cone test
+ * @param viewProjection projects bounds on to the depth pyramid
+ * @param phase
+ */
+void GpuCuller::record_cull(VkCommandBuffer              commandBuffer,
+                            uint32_t                     frame,
+                            VkBuffer                     instanceBuffer,
+                            const std::vector<uint32_t>& meshInstanceCounts,
+                            const Frustum&               frustum,
+                            const glm::vec3&             cameraPosition,
+                            const glm::mat4&             viewProjection,
+                            CullPhase                    phase)
+{
+  if (meshInstanceCounts.size() != meshes.size()) {
+    throw std::runtime_error("Instance counts do not match the culled meshes!");
+  }
+  if (phase != CullPhase::All && occlusionPipeline == VK_NULL_HANDLE) {
+    throw std::runtime_error("Occlusion phases need the occlusion shader!");
+  }
+  if (occlusionPipeline != VK_NULL_HANDLE && depthPyramid == nullptr) {
+    throw std::runtime_error("Occlusion culling needs a depth pyramid!");
+  }
+
+  std::vector<VkDrawIndexedIndirectCommand> draws(meshes.size());
+  uint32_t                                  instanceCount = 0;
+  uint64_t                                  clusterCount  = 0;
+  for (size_t i = 0; i < meshes.size(); i++) {
+    draws[i].indexCount    = meshes[i].indexCount;
+    draws[i].instanceCount = 0;
+    draws[i].firstIndex    = meshes[i].firstIndex;
+    draws[i].vertexOffset  = meshes[i].vertexOffset;
+    draws[i].firstInstance = instanceCount;
+    instanceCount += meshInstanceCounts[i];
+    clusterCount += static_cast<uint64_t>(meshInstanceCounts[i]) * meshes[i].meshletCount;
+  }
+
+  // Meshlets only when every one of them fits, the GPU count is never clamped.
+  const bool clusters = meshletBuffer != VK_NULL_HANDLE && clusterCount > 0 && clusterCount <= maxClusterDraws;
+
+  auto& resources = resources_of(frame, phase);
+  reserve(resources, static_cast<uint32_t>(meshes.size()), instanceCount);
+  if (meshletBuffer != VK_NULL_HANDLE) {
+    reserve_clusters(resources, clusters ? static_cast<uint32_t>(clusterCount) : 1);
+  }
+  if (occlusionPipeline != VK_NULL_HANDLE) {
+    reserve_visibility(instanceCount);
+    if (phase != CullPhase::Late) {
+      // Nothing to read back for the late phase until it is recorded again.
+      resources_of(frame, CullPhase::Late).recordedMeshes = 0;
+    }
+  }
+  resources.recordedMeshes    = static_cast<uint32_t>(meshes.size());
+  resources.recordedInstances = instanceCount;
+  resources.recordedClusters  = clusters ? static_cast<uint32_t>(clusterCount) : 0;
+  if (meshes.empty()) {
+    return;
+  }
+
+  VkDeviceSize drawsSize = draws.size() * sizeof(VkDrawIndexedIndirectCommand);
+  vkCmdUpdateBuffer(commandBuffer, resources.draws, 0, drawsSize, draws.data());
+  vkCmdFillBuffer(commandBuffer, resources.count, 0, countSize, 0);
+  if (!visibilityCleared) {
+    vkCmdFillBuffer(commandBuffer, visibility, 0, VK_WHOLE_SIZE, 0);
+    visibilityCleared = true;
+  }
+
+  if (occlusionPipeline != VK_NULL_HANDLE) {
+    OcclusionData occlusion  = {};
+    occlusion.viewProjection = viewProjection;
+    occlusion.pyramid[0]     = depthPyramid->region().width;
+    occlusion.pyramid[1]     = depthPyramid->region().height;
+    occlusion.pyramid[2]     = depthPyramid->level_count();
+    occlusion.pyramid[3]     = phase == CullPhase::Late ? latePhase : earlyPhase;
+    memcpy(resources.occlusionMapped, &occlusion, sizeof(occlusion));
+  }
+
+  // The visibility buffer was last written by the previous frame's late phase.
+  VkMemoryBarrier barrier = {};
+  barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0,
+                       1,
+                       &barrier,
+                       0,
+                       nullptr,
+                       0,
+                       nullptr);
+
+  DescriptorWrites writes;
+  writes.buffer(0, instanceBuffer, 0, VK_WHOLE_SIZE)
+      .buffer(1, boundsBuffer, 0, VK_WHOLE_SIZE)
+      .buffer(2, resources.draws, 0, VK_WHOLE_SIZE)
+      .buffer(3, resources.visible, 0, VK_WHOLE_SIZE)
+      .buffer(4, resources.commands, 0, VK_WHOLE_SIZE)
+      .buffer(5, resources.count, 0, VK_WHOLE_SIZE);
+  // Every binding of the layout is written, so the cluster ones stay valid when the pass is skipped.
+  if (meshletBuffer != VK_NULL_HANDLE) {
+    writes.buffer(6, meshletRanges, 0, VK_WHOLE_SIZE)
+        .buffer(7, meshletBuffer, 0, VK_WHOLE_SIZE)
+        .buffer(8, resources.clusters, 0, VK_WHOLE_SIZE);
+  }
+  if (occlusionPipeline != VK_NULL_HANDLE) {
+    writes.buffer(9, visibility, 0, VK_WHOLE_SIZE)
+        .image(10, depthPyramid->sampler(), depthPyramid->view(), VK_IMAGE_LAYOUT_GENERAL)
+        .buffer(11, resources.occlusion, 0, sizeof(OcclusionData));
+  }
+  VkDescriptorSet set = descriptorAllocator.allocate_frame_set(frame, setLayout, writes);
+
+  uint32_t groupsPerRow = std::min(std::max(instanceCount, 1u), maxGroupsPerRow);
+
+  CullConstants constants = {};
+  for (size_t i = 0; i < frustum.planes.size(); i++) {
+    constants.planes[i] = frustum.planes[i];
+  }
+  constants.cameraPosition  = glm::vec4(cameraPosition, 1.0f);
+  constants.instanceCount   = instanceCount;
+  constants.drawCount       = static_cast<uint32_t>(meshes.size());
+  constants.clusterCapacity = resources.recordedClusters;
+  constants.groupsPerRow    = groupsPerRow;
+
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &set, 0, nullptr);
+  vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+
+  VkPipeline instancePipeline = phase == CullPhase::All ? cullPipeline : occlusionPipeline;
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, instancePipeline);
+  vkCmdDispatch(commandBuffer, (instanceCount + workgroupSize - 1) / workgroupSize, 1, 1);
+
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0,
+                       1,
+                       &barrier,
+                       0,
+                       nullptr,
+                       0,
+                       nullptr);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compactPipeline);
+  vkCmdDispatch(commandBuffer, (constants.drawCount + workgroupSize - 1) / workgroupSize, 1, 1);
+
+  // One workgroup per visible instance slot, slots past a mesh's survivors exit early.
+  if (clusters) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, clusterPipeline);
+    vkCmdDispatch(commandBuffer, groupsPerRow, (instanceCount + groupsPerRow - 1) / groupsPerRow, 1);
+  }
+
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask =
+      VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       0,
+                       1,
+                       &barrier,
+                       0,
+                       nullptr,
+                       0,
+                       nullptr);
+
+  std::array<VkBufferCopy, 1> countCopy = {};
+  countCopy[0].size                     = countSize;
+  vkCmdCopyBuffer(commandBuffer, resources.count, resources.readback, 1, countCopy.data());
+
+  std::array<VkBufferCopy, 1> commandsCopy = {};
+  commandsCopy[0].dstOffset                = commandsOffset;
+  commandsCopy[0].size                     = drawsSize;
+  vkCmdCopyBuffer(commandBuffer, resources.commands, resources.readback, 1, commandsCopy.data());
+}
+
+/**
+ * @brief Draw the survivors of record_cull(), inside the render pass with the graphics
+ * pipeline and its descriptor sets bound and the mesh at vertex binding 0. Meshlet
+ * commands draw one visible instance each, firstInstance is its slot.
+ *
+ * @param commandBuffer
+ * @param frame
+ * @param multiDraw multiDrawIndirect is enabled, only used without the draw count
+ * @param phase the phase culled by record_cull()
+ */
+void GpuCuller::record_draw(VkCommandBuffer commandBuffer, uint32_t frame, bool multiDraw, CullPhase phase)
+{
+  auto& resources = resources_of(frame, phase);
+  if (resources.recordedMeshes == 0) {
+    return;
+  }
+
+  VkDeviceSize offset = 0;
+  vkCmdBindVertexBuffers(commandBuffer, 1, 1, &resources.visible, &offset);
+
+  uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+  if (resources.recordedClusters > 0) {
+    vkCmdDrawIndexedIndirectCountKHR(commandBuffer,
+                                     resources.clusters,
+                                     0,
+                                     resources.count,
+                                     sizeof(uint32_t),
+                                     resources.recordedClusters,
+                                     stride);
+  } else if (useDrawCount) {
+    vkCmdDrawIndexedIndirectCountKHR(
+        commandBuffer, resources.commands, 0, resources.count, 0, resources.recordedMeshes, stride);
+  } else if (multiDraw) {
+    // Meshes without survivors are empty draws.
+    vkCmdDrawIndexedIndirect(commandBuffer, resources.draws, 0, resources.recordedMeshes, stride);
+  } else {
+    for (uint32_t i = 0; i < resources.recordedMeshes; i++) {
+      vkCmdDrawIndexedIndirect(commandBuffer, resources.draws, i * stride, 1, stride);
+    }
+  }
+}
+
+/**
+ * @brief Read back the last cull recorded for this frame slot, its fence must have signaled
+ *
+ * @param frame
+ * @param stats everything but expectedVisible is written
+ * @return false when nothing was recorded for the slot yet
+ */
+bool GpuCuller::collect(uint32_t frame, CullStats& stats)
+{
+  auto& first = resources_of(frame, CullPhase::Early);
+  if (first.readbackMapped == nullptr || first.recordedMeshes == 0) {
+    return false;
+  }
+
+  stats.drawCount         = 0;
+  stats.visibleInstances  = 0;
+  stats.totalInstances    = first.recordedInstances;
+  stats.visibleClusters   = 0;
+  stats.totalClusters     = 0;
+  stats.occludedInstances = 0;
+  stats.earlyInstances    = 0;
+  stats.lateInstances     = 0;
+
+  std::vector<FrameResources*> phases = {&first};
+  auto&                        late   = resources_of(frame, CullPhase::Late);
+  if (&late != &first && late.readbackMapped != nullptr && late.recordedMeshes > 0) {
+    phases.push_back(&late);
+  }
+
+  for (auto* resources : phases) {
+    auto     data      = static_cast<const uint8_t*>(resources->readbackMapped);
+    auto     counts    = reinterpret_cast<const uint32_t*>(data);
+    auto     drawCount = counts[0];
+    auto     commands  = reinterpret_cast<const VkDrawIndexedIndirectCommand*>(data + commandsOffset);
+    uint32_t visible   = 0;
+    for (uint32_t i = 0; i < std::min(drawCount, resources->recordedMeshes); i++) {
+      visible += commands[i].instanceCount;
+      if (resources->recordedClusters > 0) {
+        auto mesh = std::find_if(meshes.begin(), meshes.end(), [&](const IndirectMesh& candidate) {
+          return candidate.firstIndex == commands[i].firstIndex;
+        });
+        stats.totalClusters += commands[i].instanceCount * (mesh != meshes.end() ? mesh->meshletCount : 0);
+      }
+    }
+
+    stats.drawCount += resources->recordedClusters > 0 ? counts[1] : drawCount;
+    stats.visibleClusters += resources->recordedClusters > 0 ? counts[1] : 0;
+    stats.visibleInstances += visible;
+    if (resources != &first) {
+      stats.lateInstances     = visible;
+      stats.frustumInstances  = counts[2];
+      stats.occludedInstances = counts[3];
+    } else {
+      stats.earlyInstances   = visible;
+      stats.frustumInstances = visible;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Buffers a phase of a frame culls in to, every phase is the same slot without
+ * the occlusion shader
+ *
+ * @param frame
+ * @param phase
+ * @return FrameResources&
+ */
+GpuCuller::FrameResources& GpuCuller::resources_of(uint32_t frame, CullPhase phase)
+{
+  if (occlusionPipeline == VK_NULL_HANDLE) {
+    return frames.at(frame);
+  }
+  return frames.at(2 * frame + (phase == CullPhase::Late ? 1 : 0));
+}
+
+/**
+ * @brief
+ *
+ * @param buffer
+ * @param memory
+ */
+void GpuCuller::destroy_buffer(VkBuffer& buffer, VkDeviceMemory& memory)
+{
+  if (buffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(device, buffer, nullptr);
+    vkFreeMemory(device, memory, nullptr);
+  }
+  buffer = VK_NULL_HANDLE;
+  memory = VK_NULL_HANDLE;
+}
+
+/**
+ * @brief Grow a frame's buffers, its fence has signaled so nothing reads them
+ *
+ * @param frame
+ * @param meshCount
+ * @param instanceCount
+ */
+void GpuCuller::reserve(FrameResources& frame, uint32_t meshCount, uint32_t instanceCount)
+{
+  if (meshCount > frame.meshCapacity) {
+    if (frame.readbackMapped != nullptr) {
+      vkUnmapMemory(device, frame.readbackMemory);
+      frame.readbackMapped = nullptr;
+    }
+    destroy_buffer(frame.draws, frame.drawsMemory);
+    destroy_buffer(frame.commands, frame.commandsMemory);
+    destroy_buffer(frame.count, frame.countMemory);
+    destroy_buffer(frame.readback, frame.readbackMemory);
+
+    frame.meshCapacity     = std::max(meshCount, frame.meshCapacity * 2);
+    VkDeviceSize drawsSize = frame.meshCapacity * sizeof(VkDrawIndexedIndirectCommand);
+
+    createBuffer(drawsSize,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                     VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 frame.draws,
+                 frame.drawsMemory);
+    createBuffer(drawsSize,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 frame.commands,
+                 frame.commandsMemory);
+    createBuffer(countSize,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 frame.count,
+                 frame.countMemory);
+    createBuffer(commandsOffset + drawsSize,
+                 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 frame.readback,
+                 frame.readbackMemory);
+    vkMapMemory(device, frame.readbackMemory, 0, VK_WHOLE_SIZE, 0, &frame.readbackMapped);
+    memset(frame.readbackMapped, 0, static_cast<size_t>(commandsOffset + drawsSize));
+  }
+
+  if (occlusionPipeline != VK_NULL_HANDLE && frame.occlusion == VK_NULL_HANDLE) {
+    createBuffer(sizeof(OcclusionData),
+                 VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 frame.occlusion,
+                 frame.occlusionMemory);
+    vkMapMemory(device, frame.occlusionMemory, 0, VK_WHOLE_SIZE, 0, &frame.occlusionMapped);
+  }
+
+  if (instanceCount > frame.visibleCapacity) {
+    destroy_buffer(frame.visible, frame.visibleMemory);
+
+    frame.visibleCapacity = std::max(instanceCount, frame.visibleCapacity * 2);
+    createBuffer(frame.visibleCapacity * sizeof(Object::InstanceData),
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 frame.visible,
+                 frame.visibleMemory);
+  }
+}
+
+/**
+ * @brief Grow a frame's meshlet command buffer, its fence has signaled
+ *
+ * @param frame
+ * @param clusterCount
+ */
+void GpuCuller::reserve_clusters(FrameResources& frame, uint32_t clusterCount)
+{
+  if (clusterCount <= frame.clusterCapacity) {
+    return;
+  }
+  destroy_buffer(frame.clusters, frame.clustersMemory);
+
+  frame.clusterCapacity = std::min(std::max(clusterCount, frame.clusterCapacity * 2), maxClusterDraws);
+  createBuffer(frame.clusterCapacity * sizeof(VkDrawIndexedIndirectCommand),
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+               frame.clusters,
+               frame.clustersMemory);
+}
+
+/**
+ * @brief Grow the visibility buffer shared by every frame. Frames in flight may still
+ * read the old one, so growing waits for the device, instance counts rarely change.
+ * The new buffer is zeroed by the next record_cull(), nothing counts as visible yet.
+ *
+ * @param instanceCount
+ */
+void GpuCuller::reserve_visibility(uint32_t instanceCount)
+{
+  if (instanceCount <= visibilityCapacity && visibility != VK_NULL_HANDLE) {
+    return;
+  }
+  vkDeviceWaitIdle(device);
+  destroy_buffer(visibility, visibilityMemory);
+
+  visibilityCapacity = std::max({instanceCount, visibilityCapacity * 2, 1u});
+  createBuffer(visibilityCapacity * sizeof(uint32_t),
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+               visibility,
+               visibilityMemory);
+  visibilityCleared = false;
+}
+
+}}  // namespace Rake::Graphics
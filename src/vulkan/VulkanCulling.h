@@ -0,0 +1,197 @@
+#if !defined(VULKANCULLING_H)
+#define VULKANCULLING_H
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#define VK_NO_PROTOTYPES
+#define VK_USE_PLATFORM_XCB_KHR
+#include <vulkan/vulkan.h>
+
+#include <glm/glm.hpp>
+
+#include "VulkanDescriptors.h"
+#include "VulkanOcclusion.h"
+#include "VulkanPipelines.h"
+#include "scene/meshlet.h"
+
+namespace Rake { namespace Graphics {
+
+/**
+ * @brief Six inward facing planes, xyz normal and w distance, in the order left,
+ * right, bottom, top, near, far
+ */
+struct Frustum {
+  std::array<glm::vec4, 6> planes;
+
+  static Frustum from_view_projection(const glm::mat4& viewProjection);
+
+  bool intersects_sphere(const glm::vec3& center, float radius) const;
+};
+
+/**
+ * @brief A mesh the culler can draw, one indirect command per mesh
+ */
+struct IndirectMesh {
+  uint32_t  indexCount;
+  uint32_t  firstIndex;
+  int32_t   vertexOffset;
+  glm::vec4 boundingSphere;    // Mesh space, xyz centre and w radius
+  uint32_t  firstMeshlet = 0;  // Range of the meshlets given to set_meshes(), covering the same triangles
+  uint32_t  meshletCount = 0;
+};
+
+/**
+ * @brief Which instances a cull pass draws. Occlusion culling splits a frame in two, the
+ * early phase draws what was visible last frame, the late phase tests the rest against
+ * the depth pyramid built in between.
+ */
+enum class CullPhase { All, Early, Late };
+
+/**
+ * @brief Read back results of one culled frame, both phases summed
+ */
+struct CullStats {
+  uint32_t drawCount         = 0;  // Non empty indirect commands after compaction
+  uint32_t visibleInstances  = 0;
+  uint32_t totalInstances    = 0;
+  uint32_t expectedVisible   = 0;  // CPU reference, only filled when culling is validated
+  uint32_t visibleClusters   = 0;  // Meshlet draws, both zero when whole meshes were drawn
+  uint32_t totalClusters     = 0;  // Meshlets of the visible instances
+  uint32_t frustumInstances  = 0;  // Inside the frustum, what the CPU reference counts
+  uint32_t occludedInstances = 0;  // Inside the frustum but behind the depth pyramid
+  uint32_t earlyInstances    = 0;  // Drawn by the early phase, visible last frame
+  uint32_t lateInstances     = 0;  // Drawn by the late phase, newly visible
+};
+
+/**
+ * @brief GPU driven submission. A compute pass tests every instance against the view
+ * frustum and appends survivors to a visible instance stream, a second pass compacts
+ * the non empty per mesh commands and counts them. The draw then takes its commands
+ * and count from those buffers, so CPU cost does not depend on the instance count.
+ *
+ * With a cluster shader and meshlets, a third pass tests each meshlet of every visible
+ * instance against the frustum and its normal cone, and appends one single instance
+ * command per surviving meshlet. Frames whose meshlets could exceed the command buffer
+ * draw whole meshes instead, so nothing is ever dropped.
+ *
+ * With an occlusion shader the cull runs in two phases around a depth pyramid build,
+ * see CullPhase. A persistent buffer remembers which instances were visible, the late
+ * phase rewrites it for the next frame. Each phase has its own buffers.
+ *
+ * All buffers are per frame in flight. The count and commands are copied to host
+ * memory each frame and read with collect() once the frame's fence has signaled.
+ */
+class GpuCuller {
+  public:
+  using CreateBuffer =
+      std::function<void(VkDeviceSize, VkBufferUsageFlags, VkMemoryPropertyFlags, VkBuffer&, VkDeviceMemory&)>;
+
+  GpuCuller(VkDevice                 device,
+            DescriptorLayoutCache&   layoutCache,
+            DescriptorAllocator&     descriptorAllocator,
+            PipelineCompiler&        pipelineCompiler,
+            const std::vector<char>& cullShaderCode,
+            const std::vector<char>& compactShaderCode,
+            const std::vector<char>& clusterShaderCode,
+            const std::vector<char>& occlusionShaderCode,
+            CreateBuffer             createBuffer,
+            uint32_t                 frameCount,
+            bool                     useDrawCount);
+  ~GpuCuller();
+
+  GpuCuller(const GpuCuller&) = delete;
+  GpuCuller& operator=(const GpuCuller&) = delete;
+
+  void set_meshes(const std::vector<IndirectMesh>& meshes, const std::vector<Scene::Meshlet>& meshlets = {});
+  void set_depth_pyramid(const DepthPyramid* pyramid) { depthPyramid = pyramid; }
+
+  void record_cull(VkCommandBuffer              commandBuffer,
+                   uint32_t                     frame,
+                   VkBuffer                     instanceBuffer,
+                   const std::vector<uint32_t>& meshInstanceCounts,
+                   const Frustum&               frustum,
+                   const glm::vec3&             cameraPosition,
+                   const glm::mat4&             viewProjection,
+                   CullPhase                    phase = CullPhase::All);
+  void record_draw(VkCommandBuffer commandBuffer, uint32_t frame, bool multiDraw, CullPhase phase = CullPhase::All);
+  bool collect(uint32_t frame, CullStats& stats);
+
+  bool occlusion_enabled() const { return occlusionPipeline != VK_NULL_HANDLE; }
+
+  private:
+  struct FrameResources {
+    VkBuffer       draws             = VK_NULL_HANDLE;  // One command per mesh, the cull pass bumps instance counts
+    VkDeviceMemory drawsMemory       = VK_NULL_HANDLE;
+    VkBuffer       commands          = VK_NULL_HANDLE;  // Non empty commands packed to the front
+    VkDeviceMemory commandsMemory    = VK_NULL_HANDLE;
+    VkBuffer       count             = VK_NULL_HANDLE;
+    VkDeviceMemory countMemory       = VK_NULL_HANDLE;
+    VkBuffer       visible           = VK_NULL_HANDLE;
+    VkDeviceMemory visibleMemory     = VK_NULL_HANDLE;
+    VkBuffer       clusters          = VK_NULL_HANDLE;  // One command per visible meshlet, packed
+    VkDeviceMemory clustersMemory    = VK_NULL_HANDLE;
+    VkBuffer       readback          = VK_NULL_HANDLE;
+    VkDeviceMemory readbackMemory    = VK_NULL_HANDLE;
+    void*          readbackMapped    = nullptr;
+    VkBuffer       occlusion         = VK_NULL_HANDLE;  // OcclusionData of the phase
+    VkDeviceMemory occlusionMemory   = VK_NULL_HANDLE;
+    void*          occlusionMapped   = nullptr;
+    uint32_t       visibleCapacity   = 0;
+    uint32_t       clusterCapacity   = 0;
+    uint32_t       meshCapacity      = 0;
+    uint32_t       recordedMeshes    = 0;
+    uint32_t       recordedInstances = 0;
+    uint32_t       recordedClusters  = 0;  // Worst case meshlet draws, 0 when whole meshes are drawn
+  };
+
+  struct CullConstants {
+    glm::vec4 planes[6];
+    glm::vec4 cameraPosition;
+    uint32_t  instanceCount;
+    uint32_t  drawCount;
+    uint32_t  clusterCapacity;
+    uint32_t  groupsPerRow;  // Cluster pass workgroups in x, one workgroup per visible instance slot
+  };
+
+  struct OcclusionData {
+    glm::mat4 viewProjection;
+    uint32_t  pyramid[4];  // Drawn width and height, level count, phase
+  };
+
+  FrameResources& resources_of(uint32_t frame, CullPhase phase);
+  void            destroy_buffer(VkBuffer& buffer, VkDeviceMemory& memory);
+  void            reserve(FrameResources& frame, uint32_t meshCount, uint32_t instanceCount);
+  void            reserve_clusters(FrameResources& frame, uint32_t clusterCount);
+  void            reserve_visibility(uint32_t instanceCount);
+
+  VkDevice                    device;
+  DescriptorAllocator&        descriptorAllocator;
+  CreateBuffer                createBuffer;
+  bool                        useDrawCount;
+  VkDescriptorSetLayout       setLayout;
+  VkPipelineLayout            pipelineLayout;
+  VkPipeline                  cullPipeline;
+  VkPipeline                  compactPipeline;
+  VkPipeline                  clusterPipeline   = VK_NULL_HANDLE;
+  VkPipeline                  occlusionPipeline = VK_NULL_HANDLE;
+  std::vector<IndirectMesh>   meshes;
+  VkBuffer                    boundsBuffer        = VK_NULL_HANDLE;
+  VkDeviceMemory              boundsBufferMemory  = VK_NULL_HANDLE;
+  VkBuffer                    meshletBuffer       = VK_NULL_HANDLE;  // GPU copy of the meshlets
+  VkDeviceMemory              meshletBufferMemory = VK_NULL_HANDLE;
+  VkBuffer                    meshletRanges       = VK_NULL_HANDLE;  // First meshlet and count of each mesh
+  VkDeviceMemory              meshletRangesMemory = VK_NULL_HANDLE;
+  VkBuffer                    visibility          = VK_NULL_HANDLE;  // Per instance, visible at the end of last frame
+  VkDeviceMemory              visibilityMemory    = VK_NULL_HANDLE;
+  uint32_t                    visibilityCapacity  = 0;
+  bool                        visibilityCleared   = true;  // False until a new buffer is zeroed on the GPU
+  const DepthPyramid*         depthPyramid        = nullptr;
+  std::vector<FrameResources> frames;  // Per frame in flight, two per frame with occlusion: early then late
+};
+
+}}  // namespace Rake::Graphics
+
+#endif  // VULKANCULLING_H
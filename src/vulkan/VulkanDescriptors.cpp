@@ -0,0 +1,647 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "VulkanFunctions.h"
+#include "VulkanDescriptors.h"
+
+namespace Rake { namespace Graphics {
+
+/**
+ * @brief
+ *
+ * @param device
+ */
+DescriptorLayoutCache::DescriptorLayoutCache(VkDevice device)
+    : device(device)
+{
+}
+
+/**
+ * @brief Pipeline layouts reference the set layouts, destroy them first
+ */
+DescriptorLayoutCache::~DescriptorLayoutCache()
+{
+  for (auto& layout : pipelineLayouts) {
+    vkDestroyPipelineLayout(device, layout.second, nullptr);
+  }
+  for (auto& layout : setLayouts) {
+    vkDestroyDescriptorSetLayout(device, layout.second, nullptr);
+  }
+}
+
+/**
+ * @brief Find or create a descriptor set layout. Binding order does not matter.
+ *
+ * @param bindings
+ * @param flags
+ * @param bindingFlags VK_EXT_descriptor_indexing flags, empty or one per entry of bindings
+ * @return VkDescriptorSetLayout
+ */
+VkDescriptorSetLayout DescriptorLayoutCache::get_set_layout(
+    const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+    VkDescriptorSetLayoutCreateFlags                 flags,
+    const std::vector<VkDescriptorBindingFlagsEXT>&  bindingFlags)
+{
+  if (!bindingFlags.empty() && bindingFlags.size() != bindings.size()) {
+    throw std::runtime_error("Descriptor binding flags do not match the bindings!");
+  }
+
+  std::vector<size_t> order(bindings.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&bindings](size_t a, size_t b) {
+    return bindings[a].binding < bindings[b].binding;
+  });
+
+  std::vector<VkDescriptorSetLayoutBinding> sorted;
+  std::vector<VkDescriptorBindingFlagsEXT>  sortedFlags;
+  for (auto index : order) {
+    sorted.push_back(bindings[index]);
+    if (!bindingFlags.empty()) {
+      sortedFlags.push_back(bindingFlags[index]);
+    }
+  }
+
+  Key key = {flags, sortedFlags.size()};
+  for (size_t i = 0; i < sorted.size(); i++) {
+    const auto& binding = sorted[i];
+    key.insert(key.end(), {binding.binding, binding.descriptorType, binding.descriptorCount, binding.stageFlags});
+    for (uint32_t j = 0; binding.pImmutableSamplers != nullptr && j < binding.descriptorCount; j++) {
+      key.push_back(reinterpret_cast<uint64_t>(binding.pImmutableSamplers[j]));
+    }
+    if (!sortedFlags.empty()) {
+      key.push_back(sortedFlags[i]);
+    }
+  }
+
+  if (auto found = setLayouts.find(key); found != setLayouts.end()) {
+    return found->second;
+  }
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+  layoutInfo.sType                           = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.flags                           = flags;
+  layoutInfo.bindingCount                    = static_cast<uint32_t>(sorted.size());
+  layoutInfo.pBindings                       = sorted.data();
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flagsInfo = {};
+  flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+  flagsInfo.bindingCount  = static_cast<uint32_t>(sortedFlags.size());
+  flagsInfo.pBindingFlags = sortedFlags.data();
+  if (!sortedFlags.empty()) {
+    layoutInfo.pNext = &flagsInfo;
+  }
+
+  VkDescriptorSetLayout layout;
+  if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create descriptor set layout!");
+  }
+
+  setLayouts.emplace(std::move(key), layout);
+  layoutBindings.emplace(layout, std::move(sorted));
+  return layout;
+}
+
+/**
+ * @brief Find or create a pipeline layout
+ *
+ * @param setLayouts layouts from this cache, index is the set number
+ * @param pushConstants
+ * @return VkPipelineLayout
+ */
+VkPipelineLayout DescriptorLayoutCache::get_pipeline_layout(const std::vector<VkDescriptorSetLayout>& setLayouts,
+                                                            const std::vector<VkPushConstantRange>&   pushConstants)
+{
+  Key key = {setLayouts.size()};
+  for (auto layout : setLayouts) {
+    key.push_back(reinterpret_cast<uint64_t>(layout));
+  }
+  for (const auto& range : pushConstants) {
+    key.insert(key.end(), {range.stageFlags, range.offset, range.size});
+  }
+
+  if (auto found = pipelineLayouts.find(key); found != pipelineLayouts.end()) {
+    return found->second;
+  }
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.sType                      = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount             = static_cast<uint32_t>(setLayouts.size());
+  pipelineLayoutInfo.pSetLayouts                = setLayouts.data();
+  pipelineLayoutInfo.pushConstantRangeCount     = static_cast<uint32_t>(pushConstants.size());
+  pipelineLayoutInfo.pPushConstantRanges        = pushConstants.data();
+
+  VkPipelineLayout layout;
+  if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create pipeline layout!");
+  }
+
+  pipelineLayouts.emplace(std::move(key), layout);
+  return layout;
+}
+
+/**
+ * @brief One layout per set number from 0 to the highest set the shaders use, gaps
+ * get an empty layout
+ *
+ * @param reflection
+ * @return std::vector<VkDescriptorSetLayout>
+ */
+std::vector<VkDescriptorSetLayout> DescriptorLayoutCache::get_set_layouts(const ShaderReflection& reflection)
+{
+  std::vector<VkDescriptorSetLayout> layouts;
+
+  auto indices = reflection.set_indices();
+  if (!indices.empty()) {
+    for (uint32_t set = 0; set <= indices.back(); set++) {
+      layouts.push_back(get_set_layout(reflection.set_bindings(set)));
+    }
+  }
+  return layouts;
+}
+
+/**
+ * @brief
+ *
+ * @param reflection
+ * @return VkPipelineLayout
+ */
+VkPipelineLayout DescriptorLayoutCache::get_pipeline_layout(const ShaderReflection& reflection)
+{
+  return get_pipeline_layout(get_set_layouts(reflection), reflection.push_constant_ranges());
+}
+
+/**
+ * @brief Bindings a layout from this cache was created with, sorted by binding number
+ *
+ * @param layout
+ * @return const std::vector<VkDescriptorSetLayoutBinding>&
+ */
+const std::vector<VkDescriptorSetLayoutBinding>& DescriptorLayoutCache::bindings(VkDescriptorSetLayout layout) const
+{
+  auto found = layoutBindings.find(layout);
+  if (found == layoutBindings.end()) {
+    throw std::runtime_error("Descriptor set layout is not owned by this cache!");
+  }
+  return found->second;
+}
+
+/**
+ * @brief
+ *
+ * @param binding
+ * @param buffer
+ * @param offset
+ * @param range
+ * @return DescriptorWrites&
+ */
+DescriptorWrites& DescriptorWrites::buffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+  DescriptorInfo info = {};
+  info.buffer.buffer  = buffer;
+  info.buffer.offset  = offset;
+  info.buffer.range   = range;
+
+  descriptors[{binding, 0}] = info;
+  return *this;
+}
+
+/**
+ * @brief
+ *
+ * @param binding
+ * @param sampler
+ * @param imageView
+ * @param imageLayout
+ * @param arrayElement
+ * @return DescriptorWrites&
+ */
+DescriptorWrites& DescriptorWrites::image(uint32_t      binding,
+                                          VkSampler     sampler,
+                                          VkImageView   imageView,
+                                          VkImageLayout imageLayout,
+                                          uint32_t      arrayElement)
+{
+  DescriptorInfo info    = {};
+  info.image.sampler     = sampler;
+  info.image.imageView   = imageView;
+  info.image.imageLayout = imageLayout;
+
+  descriptors[{binding, arrayElement}] = info;
+  return *this;
+}
+
+namespace {
+constexpr uint32_t initialPoolSets = 64;
+constexpr uint32_t maxPoolSets     = 4096;
+
+/**
+ * @brief FNV-1a, only used to bucket cached sets, hits are compared byte for byte
+ */
+uint64_t hash_bytes(uint64_t hash, const void* data, size_t size)
+{
+  auto bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+}  // namespace
+
+/**
+ * @brief
+ *
+ * @param device
+ * @param layoutCache cache the set layouts passed to this allocator come from
+ * @param frameCount number of frames in flight, one transient pool chain each
+ */
+DescriptorAllocator::DescriptorAllocator(VkDevice device, DescriptorLayoutCache& layoutCache, uint32_t frameCount)
+    : device(device)
+    , layoutCache(layoutCache)
+    , framePools(frameCount)
+{
+}
+
+/**
+ * @brief Destroying the pools frees every set allocated from them
+ */
+DescriptorAllocator::~DescriptorAllocator()
+{
+  for (auto& layout : layouts) {
+    if (layout.second.updateTemplate != VK_NULL_HANDLE) {
+      vkDestroyDescriptorUpdateTemplate(device, layout.second.updateTemplate, nullptr);
+    }
+  }
+
+  for (auto pool : cachedPools.pools) {
+    vkDestroyDescriptorPool(device, pool, nullptr);
+  }
+  for (auto& chain : framePools) {
+    for (auto pool : chain.pools) {
+      vkDestroyDescriptorPool(device, pool, nullptr);
+    }
+  }
+}
+
+/**
+ * @brief Find a set with the same layout and content or allocate and write a new one.
+ * The set stays valid until the allocator is destroyed and must not be updated.
+ *
+ * @param layout
+ * @param writes
+ * @return VkDescriptorSet
+ */
+VkDescriptorSet DescriptorAllocator::get_cached(VkDescriptorSetLayout layout, const DescriptorWrites& writes)
+{
+  const auto& info = layout_info(layout);
+  auto        data = flatten(info, writes);
+
+  uint64_t hash = hash_bytes(0xcbf29ce484222325ull, &layout, sizeof(layout));
+  hash          = hash_bytes(hash, data.data(), data.size() * sizeof(DescriptorInfo));
+
+  auto& bucket = cachedSets[hash];
+  for (const auto& cached : bucket) {
+    if (cached.layout == layout && cached.data.size() == data.size() &&
+        std::memcmp(cached.data.data(), data.data(), data.size() * sizeof(DescriptorInfo)) == 0) {
+      counters.cacheHits++;
+      return cached.set;
+    }
+  }
+
+  VkDescriptorSet set = allocate(cachedPools, layout);
+  if (info.updateTemplate != VK_NULL_HANDLE) {
+    vkUpdateDescriptorSetWithTemplate(device, set, info.updateTemplate, data.data());
+    counters.templateWrites++;
+  }
+
+  bucket.push_back({layout, std::move(data), set});
+  return set;
+}
+
+/**
+ * @brief Allocate and write a set that lives until reset_frame(frame)
+ *
+ * @param frame
+ * @param layout
+ * @param writes
+ * @return VkDescriptorSet
+ */
+VkDescriptorSet DescriptorAllocator::allocate_frame_set(uint32_t                frame,
+                                                        VkDescriptorSetLayout   layout,
+                                                        const DescriptorWrites& writes)
+{
+  const auto& info = layout_info(layout);
+  auto        data = flatten(info, writes);
+
+  VkDescriptorSet set = allocate(framePools.at(frame), layout);
+  if (info.updateTemplate != VK_NULL_HANDLE) {
+    vkUpdateDescriptorSetWithTemplate(device, set, info.updateTemplate, data.data());
+    counters.templateWrites++;
+  }
+  return set;
+}
+
+/**
+ * @brief Free every transient set of a frame. Call once the frame's fence has signaled.
+ *
+ * @param frame
+ */
+void DescriptorAllocator::reset_frame(uint32_t frame)
+{
+  auto& chain = framePools.at(frame);
+  if (chain.pools.empty()) {
+    return;
+  }
+
+  if (chain.pools.size() > 1) {
+    // The chain had to grow, replace it with one pool that fits the whole frame.
+    uint32_t peak = 0;
+    for (auto capacity : chain.capacities) {
+      peak += capacity;
+    }
+    for (auto pool : chain.pools) {
+      vkDestroyDescriptorPool(device, pool, nullptr);
+    }
+    chain.pools      = {create_pool(peak, LayoutInfo())};
+    chain.capacities = {peak};
+  } else {
+    vkResetDescriptorPool(device, chain.pools[0], 0);
+  }
+
+  chain.current = 0;
+  counters.poolResets++;
+}
+
+/**
+ * @brief Build, once per layout, the update template and the position of every
+ * binding in the template data
+ *
+ * @param layout
+ * @return const DescriptorAllocator::LayoutInfo&
+ */
+const DescriptorAllocator::LayoutInfo& DescriptorAllocator::layout_info(VkDescriptorSetLayout layout)
+{
+  if (auto found = layouts.find(layout); found != layouts.end()) {
+    return found->second;
+  }
+
+  LayoutInfo                                   info;
+  std::vector<VkDescriptorUpdateTemplateEntry> entries;
+
+  for (const auto& binding : layoutCache.bindings(layout)) {
+    if (binding.descriptorCount == 0) {
+      continue;
+    }
+
+    VkDescriptorUpdateTemplateEntry entry = {};
+    entry.dstBinding                      = binding.binding;
+    entry.dstArrayElement                 = 0;
+    entry.descriptorCount                 = binding.descriptorCount;
+    entry.descriptorType                  = binding.descriptorType;
+    entry.offset                          = info.descriptorCount * sizeof(DescriptorInfo);
+    entry.stride                          = sizeof(DescriptorInfo);
+    entries.push_back(entry);
+
+    info.bindingOffsets[binding.binding] = {info.descriptorCount, binding.descriptorCount};
+    info.descriptorCounts[binding.descriptorType] += binding.descriptorCount;
+    info.descriptorCount += binding.descriptorCount;
+  }
+
+  if (!entries.empty()) {
+    VkDescriptorUpdateTemplateCreateInfo templateInfo = {};
+    templateInfo.sType                                = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+    templateInfo.descriptorUpdateEntryCount           = static_cast<uint32_t>(entries.size());
+    templateInfo.pDescriptorUpdateEntries             = entries.data();
+    templateInfo.templateType                         = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+    templateInfo.descriptorSetLayout                  = layout;
+
+    if (vkCreateDescriptorUpdateTemplate(device, &templateInfo, nullptr, &info.updateTemplate) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create descriptor update template!");
+    }
+  }
+
+  return layouts.emplace(layout, std::move(info)).first->second;
+}
+
+/**
+ * @brief Lay the writes out in template order
+ *
+ * @param info
+ * @param writes
+ * @return std::vector<DescriptorInfo>
+ */
+std::vector<DescriptorInfo> DescriptorAllocator::flatten(const LayoutInfo& info, const DescriptorWrites& writes) const
+{
+  std::vector<DescriptorInfo> data(info.descriptorCount);
+
+  for (const auto& [index, descriptor] : writes.infos()) {
+    auto binding = info.bindingOffsets.find(index.first);
+    if (binding == info.bindingOffsets.end() || index.second >= binding->second.second) {
+      throw std::runtime_error("Descriptor write does not match the set layout!");
+    }
+    data[binding->second.first + index.second] = descriptor;
+  }
+  return data;
+}
+
+/**
+ * @brief Allocate from the current pool of a chain, moving on to the next pool or
+ * growing the chain when it is full
+ *
+ * @param chain
+ * @param layout
+ * @return VkDescriptorSet
+ */
+VkDescriptorSet DescriptorAllocator::allocate(PoolChain& chain, VkDescriptorSetLayout layout)
+{
+  const auto& info = layout_info(layout);
+
+  observedSets++;
+  for (const auto& [type, count] : info.descriptorCounts) {
+    observedDescriptors[type] += count;
+  }
+
+  for (;;) {
+    bool freshPool = false;
+    if (chain.current == chain.pools.size()) {
+      uint32_t setCount =
+          chain.capacities.empty() ? initialPoolSets : std::min(chain.capacities.back() * 2, maxPoolSets);
+      chain.pools.push_back(create_pool(setCount, info));
+      chain.capacities.push_back(setCount);
+      if (chain.pools.size() > 1) {
+        counters.poolGrowths++;
+      }
+      freshPool = true;
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType                       = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool              = chain.pools[chain.current];
+    allocInfo.descriptorSetCount          = 1;
+    allocInfo.pSetLayouts                 = &layout;
+
+    VkDescriptorSet set;
+    VkResult        result = vkAllocateDescriptorSets(device, &allocInfo, &set);
+    if (result == VK_SUCCESS) {
+      counters.setsAllocated++;
+      return set;
+    }
+    if (freshPool || (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)) {
+      throw std::runtime_error("Failed to allocate descriptor sets");
+    }
+    chain.current++;
+  }
+}
+
+/**
+ * @brief Size a pool for setCount sets using the average descriptors per set seen so
+ * far, never smaller than one set of the layout about to be allocated
+ *
+ * @param setCount
+ * @param needed
+ * @return VkDescriptorPool
+ */
+VkDescriptorPool DescriptorAllocator::create_pool(uint32_t setCount, const LayoutInfo& needed)
+{
+  std::map<VkDescriptorType, uint32_t> counts;
+  for (const auto& [type, total] : observedDescriptors) {
+    counts[type] = static_cast<uint32_t>((total * setCount + observedSets - 1) / std::max<uint64_t>(observedSets, 1));
+  }
+  for (const auto& [type, count] : needed.descriptorCounts) {
+    counts[type] = std::max(counts[type], count);
+  }
+
+  std::vector<VkDescriptorPoolSize> poolSizes;
+  for (const auto& [type, count] : counts) {
+    if (count != 0) {
+      poolSizes.push_back({type, count});
+    }
+  }
+
+  VkDescriptorPoolCreateInfo poolInfo = {};
+  poolInfo.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.poolSizeCount              = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes                 = poolSizes.data();
+  poolInfo.maxSets                    = setCount;
+
+  VkDescriptorPool pool;
+  if (auto result = vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool); result != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create descriptor pool!");
+  }
+  counters.poolsCreated++;
+  return pool;
+}
+
+/**
+ * @brief Create the layout, an update-after-bind pool and the one set of the table
+ *
+ * @param device
+ * @param layoutCache
+ * @param capacity number of texture slots, within the device update-after-bind limits
+ */
+BindlessTextureTable::BindlessTextureTable(VkDevice device, DescriptorLayoutCache& layoutCache, uint32_t capacity)
+    : device(device)
+    , slotCount(capacity)
+{
+  VkDescriptorSetLayoutBinding binding = {};
+  binding.binding                      = 0;
+  binding.descriptorType               = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  binding.descriptorCount              = capacity;
+  binding.stageFlags                   = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+  setLayout = layoutCache.get_set_layout({binding},
+                                         VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT,
+                                         {VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+                                          VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT});
+
+  VkDescriptorPoolSize poolSize = {};
+  poolSize.type                 = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSize.descriptorCount      = capacity;
+
+  VkDescriptorPoolCreateInfo poolInfo = {};
+  poolInfo.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.flags                      = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+  poolInfo.poolSizeCount              = 1;
+  poolInfo.pPoolSizes                 = &poolSize;
+  poolInfo.maxSets                    = 1;
+
+  if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create bindless descriptor pool!");
+  }
+
+  VkDescriptorSetAllocateInfo allocInfo = {};
+  allocInfo.sType                       = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool              = pool;
+  allocInfo.descriptorSetCount          = 1;
+  allocInfo.pSetLayouts                 = &setLayout;
+
+  if (vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate bindless descriptor set!");
+  }
+
+  // Hand out low slots first.
+  freeSlots.reserve(capacity);
+  for (uint32_t slot = capacity; slot > 0; slot--) {
+    freeSlots.push_back(slot - 1);
+  }
+}
+
+/**
+ * @brief The set layout belongs to the layout cache, the set goes with the pool
+ */
+BindlessTextureTable::~BindlessTextureTable()
+{
+  vkDestroyDescriptorPool(device, pool, nullptr);
+}
+
+/**
+ * @brief Write a texture in to a free slot
+ *
+ * @param sampler
+ * @param imageView
+ * @param imageLayout layout the image is in whenever a draw samples it
+ * @return uint32_t index for the shaders
+ */
+uint32_t BindlessTextureTable::add(VkSampler sampler, VkImageView imageView, VkImageLayout imageLayout)
+{
+  if (freeSlots.empty()) {
+    throw std::runtime_error("Bindless texture table is full!");
+  }
+  uint32_t index = freeSlots.back();
+  freeSlots.pop_back();
+
+  VkDescriptorImageInfo imageInfo = {};
+  imageInfo.sampler               = sampler;
+  imageInfo.imageView             = imageView;
+  imageInfo.imageLayout           = imageLayout;
+
+  VkWriteDescriptorSet write = {};
+  write.sType                = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet               = descriptorSet;
+  write.dstBinding           = 0;
+  write.dstArrayElement      = index;
+  write.descriptorType       = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  write.descriptorCount      = 1;
+  write.pImageInfo           = &imageInfo;
+
+  vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+  return index;
+}
+
+/**
+ * @brief Return a slot to the free list, the descriptor is left as is since the array
+ * is partially bound and no draw indexes it any more
+ *
+ * @param index
+ */
+void BindlessTextureTable::remove(uint32_t index)
+{
+  if (index >= slotCount || std::find(freeSlots.begin(), freeSlots.end(), index) != freeSlots.end()) {
+    throw std::runtime_error("Bindless texture slot is not in use!");
+  }
+  freeSlots.push_back(index);
+}
+
+}}  // namespace Rake::Graphics
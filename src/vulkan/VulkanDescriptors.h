@@ -0,0 +1,183 @@
+#if !defined(VULKANDESCRIPTORS_H)
+#define VULKANDESCRIPTORS_H
+
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#define VK_NO_PROTOTYPES
+#define VK_USE_PLATFORM_XCB_KHR
+#include <vulkan/vulkan.h>
+
+#include "VulkanReflection.h"
+
+namespace Rake { namespace Graphics {
+
+/**
+ * @brief Owns descriptor set and pipeline layouts, identical requests share one object
+ *
+ * Layouts are only destroyed with the cache.
+ */
+class DescriptorLayoutCache {
+  public:
+  explicit DescriptorLayoutCache(VkDevice device);
+  ~DescriptorLayoutCache();
+
+  DescriptorLayoutCache(const DescriptorLayoutCache&) = delete;
+  DescriptorLayoutCache& operator=(const DescriptorLayoutCache&) = delete;
+
+  VkDescriptorSetLayout get_set_layout(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+                                       VkDescriptorSetLayoutCreateFlags                 flags        = 0,
+                                       const std::vector<VkDescriptorBindingFlagsEXT>&  bindingFlags = {});
+  VkPipelineLayout      get_pipeline_layout(const std::vector<VkDescriptorSetLayout>& setLayouts,
+                                            const std::vector<VkPushConstantRange>&   pushConstants);
+
+  std::vector<VkDescriptorSetLayout> get_set_layouts(const ShaderReflection& reflection);
+  VkPipelineLayout                   get_pipeline_layout(const ShaderReflection& reflection);
+
+  const std::vector<VkDescriptorSetLayoutBinding>& bindings(VkDescriptorSetLayout layout) const;
+
+  size_t set_layout_count() const { return setLayouts.size(); }
+  size_t pipeline_layout_count() const { return pipelineLayouts.size(); }
+
+  private:
+  using Key = std::vector<uint64_t>;
+
+  VkDevice                                                                  device;
+  std::map<Key, VkDescriptorSetLayout>                                      setLayouts;
+  std::map<Key, VkPipelineLayout>                                           pipelineLayouts;
+  std::map<VkDescriptorSetLayout, std::vector<VkDescriptorSetLayoutBinding>> layoutBindings;
+};
+
+/**
+ * @brief One descriptor as laid out in the blob handed to vkUpdateDescriptorSetWithTemplate
+ */
+union DescriptorInfo {
+  VkDescriptorBufferInfo buffer;
+  VkDescriptorImageInfo  image;
+  VkBufferView           texelBuffer;
+};
+
+/**
+ * @brief Resources to write in to a descriptor set, addressed by binding and array element
+ */
+class DescriptorWrites {
+  public:
+  DescriptorWrites& buffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+  DescriptorWrites& image(uint32_t      binding,
+                          VkSampler     sampler,
+                          VkImageView   imageView,
+                          VkImageLayout imageLayout,
+                          uint32_t      arrayElement = 0);
+
+  const std::map<std::pair<uint32_t, uint32_t>, DescriptorInfo>& infos() const { return descriptors; }
+
+  private:
+  std::map<std::pair<uint32_t, uint32_t>, DescriptorInfo> descriptors;
+};
+
+/**
+ * @brief Hands out descriptor sets from chains of pools that grow on demand
+ *
+ * Cached sets are immutable, identical layout and content return the same set. Frame
+ * sets are transient, every pool of a frame is reset at once by reset_frame(). New
+ * pools are sized from the descriptors per set seen so far, and a frame whose chain
+ * grew past one pool gets a single pool big enough for its peak after the reset.
+ */
+class DescriptorAllocator {
+  public:
+  struct Stats {
+    uint64_t setsAllocated  = 0;
+    uint64_t cacheHits      = 0;
+    uint64_t templateWrites = 0;
+    uint32_t poolsCreated   = 0;
+    uint32_t poolGrowths    = 0;
+    uint32_t poolResets     = 0;
+  };
+
+  DescriptorAllocator(VkDevice device, DescriptorLayoutCache& layoutCache, uint32_t frameCount);
+  ~DescriptorAllocator();
+
+  DescriptorAllocator(const DescriptorAllocator&) = delete;
+  DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+  VkDescriptorSet get_cached(VkDescriptorSetLayout layout, const DescriptorWrites& writes);
+  VkDescriptorSet allocate_frame_set(uint32_t frame, VkDescriptorSetLayout layout, const DescriptorWrites& writes);
+  void            reset_frame(uint32_t frame);
+
+  const Stats& stats() const { return counters; }
+
+  private:
+  struct PoolChain {
+    std::vector<VkDescriptorPool> pools;
+    std::vector<uint32_t>         capacities;
+    size_t                        current = 0;
+  };
+
+  struct LayoutInfo {
+    VkDescriptorUpdateTemplate                        updateTemplate = VK_NULL_HANDLE;
+    std::map<uint32_t, std::pair<uint32_t, uint32_t>> bindingOffsets;  // binding -> first descriptor, count
+    std::map<VkDescriptorType, uint32_t>              descriptorCounts;
+    uint32_t                                          descriptorCount = 0;
+  };
+
+  struct CachedSet {
+    VkDescriptorSetLayout       layout;
+    std::vector<DescriptorInfo> data;
+    VkDescriptorSet             set;
+  };
+
+  const LayoutInfo&           layout_info(VkDescriptorSetLayout layout);
+  std::vector<DescriptorInfo> flatten(const LayoutInfo& info, const DescriptorWrites& writes) const;
+  VkDescriptorSet             allocate(PoolChain& chain, VkDescriptorSetLayout layout);
+  VkDescriptorPool            create_pool(uint32_t setCount, const LayoutInfo& needed);
+
+  VkDevice                                             device;
+  DescriptorLayoutCache&                               layoutCache;
+  std::map<VkDescriptorSetLayout, LayoutInfo>          layouts;
+  PoolChain                                            cachedPools;
+  std::vector<PoolChain>                               framePools;
+  std::unordered_map<uint64_t, std::vector<CachedSet>> cachedSets;
+  std::map<VkDescriptorType, uint64_t>                 observedDescriptors;
+  uint64_t                                             observedSets = 0;
+  Stats                                                counters;
+};
+
+/**
+ * @brief One global array of combined image samplers, shaders index it with a per draw
+ * texture index so the whole scene binds a single set
+ *
+ * Needs VK_EXT_descriptor_indexing: the array is partially bound and slots are written
+ * with update-after-bind, so textures can be added while earlier frames are in flight.
+ * A slot must not be reused before the frames that sampled it have completed.
+ */
+class BindlessTextureTable {
+  public:
+  BindlessTextureTable(VkDevice device, DescriptorLayoutCache& layoutCache, uint32_t capacity);
+  ~BindlessTextureTable();
+
+  BindlessTextureTable(const BindlessTextureTable&) = delete;
+  BindlessTextureTable& operator=(const BindlessTextureTable&) = delete;
+
+  uint32_t add(VkSampler sampler, VkImageView imageView, VkImageLayout imageLayout);
+  void     remove(uint32_t index);
+
+  VkDescriptorSetLayout layout() const { return setLayout; }
+  VkDescriptorSet       set() const { return descriptorSet; }
+  uint32_t              capacity() const { return slotCount; }
+  uint32_t              size() const { return slotCount - static_cast<uint32_t>(freeSlots.size()); }
+
+  private:
+  VkDevice              device;
+  VkDescriptorSetLayout setLayout;
+  VkDescriptorPool      pool;
+  VkDescriptorSet       descriptorSet;
+  uint32_t              slotCount;
+  std::vector<uint32_t> freeSlots;
+};
+
+}}  // namespace Rake::Graphics
+
+#endif  // VULKANDESCRIPTORS_H
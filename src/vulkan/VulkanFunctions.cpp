@@ -4,5 +4,6 @@
 #define VK_GLOBAL_LEVEL_FUNCTION(fun) PFN_##fun fun;
 #define VK_INSTANCE_LEVEL_FUNCTION(fun) PFN_##fun fun;
 #define VK_DEVICE_LEVEL_FUNCTION(fun) PFN_##fun fun;
+#define VK_OPTIONAL_DEVICE_LEVEL_FUNCTION(fun) PFN_##fun fun;
 #include "VulkanFunctions.inl"
 // namespace Rake::Graphics
@@ -9,6 +9,7 @@
 #define VK_GLOBAL_LEVEL_FUNCTION(fun) extern PFN_##fun fun;
 #define VK_INSTANCE_LEVEL_FUNCTION(fun) extern PFN_##fun fun;
 #define VK_DEVICE_LEVEL_FUNCTION(fun) extern PFN_##fun fun;
+#define VK_OPTIONAL_DEVICE_LEVEL_FUNCTION(fun) extern PFN_##fun fun;
 
 #include "VulkanFunctions.inl"
 
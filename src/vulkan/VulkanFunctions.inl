@@ -38,6 +38,8 @@ VK_GLOBAL_LEVEL_FUNCTION(vkEnumerateInstanceLayerProperties)
 VK_INSTANCE_LEVEL_FUNCTION(vkEnumeratePhysicalDevices)
 VK_INSTANCE_LEVEL_FUNCTION(vkGetPhysicalDeviceProperties)
 VK_INSTANCE_LEVEL_FUNCTION(vkGetPhysicalDeviceFeatures)
+VK_INSTANCE_LEVEL_FUNCTION(vkGetPhysicalDeviceProperties2)
+VK_INSTANCE_LEVEL_FUNCTION(vkGetPhysicalDeviceFeatures2)
 VK_INSTANCE_LEVEL_FUNCTION(vkGetPhysicalDeviceQueueFamilyProperties)
 VK_INSTANCE_LEVEL_FUNCTION(vkCreateDevice)
 VK_INSTANCE_LEVEL_FUNCTION(vkGetDeviceProcAddr)
@@ -72,6 +74,7 @@ VK_INSTANCE_LEVEL_FUNCTION(vkResetFences)
 VK_INSTANCE_LEVEL_FUNCTION(vkCreateFence)
 VK_INSTANCE_LEVEL_FUNCTION(vkGetFenceStatus)
 VK_INSTANCE_LEVEL_FUNCTION(vkGetPhysicalDeviceMemoryProperties)
+VK_INSTANCE_LEVEL_FUNCTION(vkGetPhysicalDeviceMemoryProperties2)
 VK_INSTANCE_LEVEL_FUNCTION(vkQueueWaitIdle)
 VK_INSTANCE_LEVEL_FUNCTION(vkCmdBindIndexBuffer)
 VK_INSTANCE_LEVEL_FUNCTION(vkCmdDrawIndexed)
@@ -86,6 +89,7 @@ VK_INSTANCE_LEVEL_FUNCTION(vkDestroySampler)
 VK_INSTANCE_LEVEL_FUNCTION(vkCreateSampler)
 VK_INSTANCE_LEVEL_FUNCTION(vkGetPhysicalDeviceFormatProperties)
 VK_INSTANCE_LEVEL_FUNCTION(vkCmdBlitImage)
+VK_INSTANCE_LEVEL_FUNCTION(vkCmdCopyImage)
 
 #undef VK_INSTANCE_LEVEL_FUNCTION
 
@@ -108,6 +112,8 @@ VK_DEVICE_LEVEL_FUNCTION(vkCreateCommandPool)
 VK_DEVICE_LEVEL_FUNCTION(vkAllocateCommandBuffers)
 VK_DEVICE_LEVEL_FUNCTION(vkCmdBeginRenderPass)
 VK_DEVICE_LEVEL_FUNCTION(vkCmdDraw)
+VK_DEVICE_LEVEL_FUNCTION(vkCmdNextSubpass)
+VK_DEVICE_LEVEL_FUNCTION(vkGetDeviceMemoryCommitment)
 VK_DEVICE_LEVEL_FUNCTION(vkCmdEndRenderPass)
 VK_DEVICE_LEVEL_FUNCTION(vkEndCommandBuffer)
 VK_DEVICE_LEVEL_FUNCTION(vkCreateSemaphore)
@@ -130,5 +136,37 @@ VK_DEVICE_LEVEL_FUNCTION(vkUpdateDescriptorSets)
 VK_DEVICE_LEVEL_FUNCTION(vkCmdBindDescriptorSets)
 VK_DEVICE_LEVEL_FUNCTION(vkCreateImage)
 VK_DEVICE_LEVEL_FUNCTION(vkCreateShaderModule)
+VK_DEVICE_LEVEL_FUNCTION(vkCreatePipelineCache)
+VK_DEVICE_LEVEL_FUNCTION(vkDestroyPipelineCache)
+VK_DEVICE_LEVEL_FUNCTION(vkGetPipelineCacheData)
+VK_DEVICE_LEVEL_FUNCTION(vkCmdSetViewport)
+VK_DEVICE_LEVEL_FUNCTION(vkCmdSetScissor)
+VK_DEVICE_LEVEL_FUNCTION(vkCmdPushConstants)
+VK_DEVICE_LEVEL_FUNCTION(vkResetDescriptorPool)
+VK_DEVICE_LEVEL_FUNCTION(vkCreateDescriptorUpdateTemplate)
+VK_DEVICE_LEVEL_FUNCTION(vkDestroyDescriptorUpdateTemplate)
+VK_DEVICE_LEVEL_FUNCTION(vkUpdateDescriptorSetWithTemplate)
+VK_DEVICE_LEVEL_FUNCTION(vkCreateQueryPool)
+VK_DEVICE_LEVEL_FUNCTION(vkDestroyQueryPool)
+VK_DEVICE_LEVEL_FUNCTION(vkCmdResetQueryPool)
+VK_DEVICE_LEVEL_FUNCTION(vkCmdWriteTimestamp)
+VK_DEVICE_LEVEL_FUNCTION(vkGetQueryPoolResults)
+VK_DEVICE_LEVEL_FUNCTION(vkCreateComputePipelines)
+VK_DEVICE_LEVEL_FUNCTION(vkCmdDispatch)
+VK_DEVICE_LEVEL_FUNCTION(vkCmdFillBuffer)
+VK_DEVICE_LEVEL_FUNCTION(vkCmdUpdateBuffer)
+VK_DEVICE_LEVEL_FUNCTION(vkCmdDrawIndexedIndirect)
 
 #undef VK_DEVICE_LEVEL_FUNCTION
+
+/**
+ * @brief Device functions of optional extensions, left null when the extension is not enabled
+ *
+ */
+#if !defined(VK_OPTIONAL_DEVICE_LEVEL_FUNCTION)
+#define VK_OPTIONAL_DEVICE_LEVEL_FUNCTION(fun)
+#endif
+
+VK_OPTIONAL_DEVICE_LEVEL_FUNCTION(vkCmdDrawIndexedIndirectCountKHR)
+
+#undef VK_OPTIONAL_DEVICE_LEVEL_FUNCTION
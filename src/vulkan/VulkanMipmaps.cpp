@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "VulkanFunctions.h"
+#include "VulkanMipmaps.h"
+#include "VulkanReflection.h"
+
+namespace Rake { namespace Graphics {
+
+namespace {
+constexpr uint32_t tileSize = 16;  // Workgroup size of mip_downsample.comp in x and y
+
+VkExtent2D level_extent(VkExtent2D extent, uint32_t level)
+{
+  return {std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u)};
+}
+
+/**
+ * @brief Whether the level halves exactly into the next, so a workgroup can build it from
+ * its own tile. An axis of one texel stays one texel.
+ */
+bool halves_exactly(VkExtent2D extent)
+{
+  return (extent.width % 2 == 0 || extent.width == 1) && (extent.height % 2 == 0 || extent.height == 1);
+}
+}  // namespace
+
+/**
+ * @brief
+ *
+ * @param device
+ * @param layoutCache
+ * @param pipelineCompiler
+ * @param shaderCode mip_downsample.comp
+ */
+MipGenerator::MipGenerator(VkDevice                 device,
+                           DescriptorLayoutCache&   layoutCache,
+                           PipelineCompiler&        pipelineCompiler,
+                           const std::vector<char>& shaderCode)
+    : device(device)
+    , descriptorAllocator(device, layoutCache, 1)
+{
+  ShaderReflection reflection;
+  reflection.reflect(shaderCode);
+
+  auto setLayouts = layoutCache.get_set_layouts(reflection);
+  if (setLayouts.size() != 1) {
+    throw std::runtime_error("Mip generation shader must use exactly one descriptor set!");
+  }
+  setLayout      = setLayouts[0];
+  pipelineLayout = layoutCache.get_pipeline_layout(reflection);
+  pipeline       = pipelineCompiler.compile_compute(shaderCode, pipelineLayout);
+}
+
+/**
+ * @brief The pipeline and set layout belong to the layout cache
+ */
+MipGenerator::~MipGenerator()
+{
+  release();
+  vkDestroyPipeline(device, pipeline, nullptr);
+}
+
+/**
+ * @brief Record the generation of levels 1 and up from level 0. Level 0 must be in the
+ * transfer destination layout after a transfer write, the contents of the other levels
+ * are discarded. Leaves every level in the shader read only layout for fragment shaders,
+ * like the blit path.
+ *
+ * @param commandBuffer
+ * @param image
+ * @param format of the storage views, compatible with rgba8
+ * @param extent of level 0
+ * @param levelCount of the image
+ * @return uint32_t dispatches recorded
+ */
+uint32_t MipGenerator::record(VkCommandBuffer commandBuffer,
+                              VkImage         image,
+                              VkFormat        format,
+                              VkExtent2D      extent,
+                              uint32_t        levelCount)
+{
+  release();
+
+  VkImageViewCreateInfo viewInfo           = {};
+  viewInfo.sType                           = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image                           = image;
+  viewInfo.viewType                        = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format                          = format;
+  viewInfo.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+  viewInfo.subresourceRange.levelCount     = 1;
+  viewInfo.subresourceRange.baseArrayLayer = 0;
+  viewInfo.subresourceRange.layerCount     = 1;
+
+  levelViews.assign(levelCount, VK_NULL_HANDLE);
+  for (uint32_t level = 0; level < levelCount; level++) {
+    viewInfo.subresourceRange.baseMipLevel = level;
+    if (vkCreateImageView(device, &viewInfo, nullptr, &levelViews[level]) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create mip level view!");
+    }
+  }
+
+  // Level 0 is read as it is, the rest are overwritten whole.
+  VkImageMemoryBarrier barriers[2] = {};
+  barriers[0].sType                = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barriers[0].srcAccessMask        = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barriers[0].dstAccessMask        = VK_ACCESS_SHADER_READ_BIT;
+  barriers[0].oldLayout            = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barriers[0].newLayout            = VK_IMAGE_LAYOUT_GENERAL;
+  barriers[0].srcQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+  barriers[0].dstQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+  barriers[0].image                = image;
+  barriers[0].subresourceRange     = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  barriers[1]                      = barriers[0];
+  barriers[1].srcAccessMask        = 0;
+  barriers[1].dstAccessMask        = VK_ACCESS_SHADER_WRITE_BIT;
+  barriers[1].oldLayout            = VK_IMAGE_LAYOUT_UNDEFINED;
+  barriers[1].subresourceRange     = {VK_IMAGE_ASPECT_COLOR_BIT, 1, levelCount - 1, 0, 1};
+
+  const uint32_t firstBarrierCount = levelCount > 1 ? 2 : 1;  // A single level image has nothing to write
+
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0,
+                       0,
+                       nullptr,
+                       0,
+                       nullptr,
+                       firstBarrierCount,
+                       barriers);
+
+  VkMemoryBarrier dispatchBarrier = {};
+  dispatchBarrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  dispatchBarrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+  dispatchBarrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT;
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+  uint32_t dispatches = 0;
+  uint32_t source     = 0;
+  while (source + 1 < levelCount) {
+    const uint32_t first = source + 1;
+
+    // Continue into the next level while the last one halves exactly.
+    uint32_t count = 1;
+    while (count < maxLevelsPerDispatch && first + count < levelCount &&
+           halves_exactly(level_extent(extent, first + count - 1))) {
+      count++;
+    }
+
+    DescriptorWrites writes;
+    writes.image(0, VK_NULL_HANDLE, levelViews[source], VK_IMAGE_LAYOUT_GENERAL);
+    for (uint32_t element = 0; element < maxLevelsPerDispatch; element++) {
+      uint32_t level = first + std::min(element, count - 1);
+      writes.image(1, VK_NULL_HANDLE, levelViews[level], VK_IMAGE_LAYOUT_GENERAL, element);
+    }
+    VkDescriptorSet set = descriptorAllocator.allocate_frame_set(0, setLayout, writes);
+
+    VkExtent2D   sourceSize = level_extent(extent, source);
+    VkExtent2D   levelSize  = level_extent(extent, first);
+    MipConstants constants  = {{sourceSize.width, sourceSize.height}, {levelSize.width, levelSize.height}, count};
+
+    if (dispatches > 0) {
+      vkCmdPipelineBarrier(commandBuffer,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           0,
+                           1,
+                           &dispatchBarrier,
+                           0,
+                           nullptr,
+                           0,
+                           nullptr);
+    }
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &set, 0, nullptr);
+    vkCmdPushConstants(
+        commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MipConstants), &constants);
+    vkCmdDispatch(
+        commandBuffer, (levelSize.width + tileSize - 1) / tileSize, (levelSize.height + tileSize - 1) / tileSize, 1);
+
+    dispatches++;
+    source = first + count - 1;
+  }
+
+  barriers[0].srcAccessMask    = VK_ACCESS_SHADER_WRITE_BIT;
+  barriers[0].dstAccessMask    = VK_ACCESS_SHADER_READ_BIT;
+  barriers[0].oldLayout        = VK_IMAGE_LAYOUT_GENERAL;
+  barriers[0].newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barriers[0].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1};
+
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       0,
+                       0,
+                       nullptr,
+                       0,
+                       nullptr,
+                       1,
+                       barriers);
+  return dispatches;
+}
+
+/**
+ * @brief Free the views and descriptor sets of the last record(), its commands must have
+ * completed
+ */
+void MipGenerator::release()
+{
+  for (auto view : levelViews) {
+    vkDestroyImageView(device, view, nullptr);
+  }
+  levelViews.clear();
+  descriptorAllocator.reset_frame(0);
+}
+
+}}  // namespace Rake::Graphics
@@ -0,0 +1,61 @@
+#if !defined(VULKANMIPMAPS_H)
+#define VULKANMIPMAPS_H
+
+#include <cstdint>
+#include <vector>
+
+#define VK_NO_PROTOTYPES
+#define VK_USE_PLATFORM_XCB_KHR
+#include <vulkan/vulkan.h>
+
+#include "VulkanDescriptors.h"
+#include "VulkanPipelines.h"
+
+namespace Rake { namespace Graphics {
+
+/**
+ * @brief Fills the mip chain of an R8G8B8A8 texture from level 0 in compute. Each
+ * dispatch writes up to five levels through storage views, so a 4096 texture takes three
+ * dispatches where blitting takes twelve blits and twice as many barriers.
+ *
+ * The image needs storage usage and a format with storage image support. Views and
+ * descriptor sets of a record() live until release(), after its commands completed.
+ */
+class MipGenerator {
+  public:
+  MipGenerator(VkDevice                 device,
+               DescriptorLayoutCache&   layoutCache,
+               PipelineCompiler&        pipelineCompiler,
+               const std::vector<char>& shaderCode);
+  ~MipGenerator();
+
+  MipGenerator(const MipGenerator&) = delete;
+  MipGenerator& operator=(const MipGenerator&) = delete;
+
+  uint32_t record(VkCommandBuffer commandBuffer,
+                  VkImage         image,
+                  VkFormat        format,
+                  VkExtent2D      extent,
+                  uint32_t        levelCount);
+  void     release();
+
+  private:
+  static constexpr uint32_t maxLevelsPerDispatch = 5;  // 16x16 tile down to 1x1
+
+  struct MipConstants {
+    uint32_t sourceSize[2];
+    uint32_t levelSize[2];
+    uint32_t levelCount;
+  };
+
+  VkDevice                 device;
+  DescriptorAllocator      descriptorAllocator;  // Its one frame is reset by release()
+  VkDescriptorSetLayout    setLayout;
+  VkPipelineLayout         pipelineLayout;
+  VkPipeline               pipeline;
+  std::vector<VkImageView> levelViews;  // Of the last record()
+};
+
+}}  // namespace Rake::Graphics
+
+#endif  // VULKANMIPMAPS_H
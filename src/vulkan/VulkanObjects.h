@@ -7,20 +7,33 @@
 
 #include <glm/glm.hpp>
 
+#include "scene/meshlet.h"
+#include "scene/simplify.h"
+
 namespace Rake::Graphics::Object {
 /**
- * @class UniformBufferObject
- * @author Salamanderrake
- * @date 02/12/18
- * @file VulkanCommon.h
- * @brief
+ * @class CameraBufferObject
+ * @brief Camera matrices, one uniform buffer per frame in flight
  */
-struct UniformBufferObject {
-  glm::mat4 model;
+struct CameraBufferObject {
   glm::mat4 view;
   glm::mat4 proj;
 };
 
+/**
+ * @class InstanceData
+ * @brief Per instance vertex attributes read from binding 1, must match triangle.vert.
+ * The culling shaders read the same records as a std430 array.
+ */
+struct InstanceData {
+  glm::mat4 model;
+  uint32_t  materialIndex;  // Slot in the bindless texture table
+  uint32_t  meshIndex;      // Indirect command the instance is drawn by
+  uint32_t  padding[2];
+};
+
+static_assert(sizeof(InstanceData) == 80, "InstanceData must match the std430 layout of the culling shaders");
+
 /**
  * @class Vertex
  * @author Salamanderrake
@@ -33,19 +46,27 @@ struct Vertex {
   glm::vec3 color;
   glm::vec2 texCoord;
 
-  static VkVertexInputBindingDescription getBindingDescription()
+  /**
+   * @brief Binding 0 is the mesh, binding 1 steps once per instance through InstanceData
+   */
+  static std::array<VkVertexInputBindingDescription, 2> getBindingDescription()
   {
-    VkVertexInputBindingDescription bindingDescription = {};
-    bindingDescription.binding                         = 0;
-    bindingDescription.stride                          = sizeof(Vertex);
-    bindingDescription.inputRate                       = VK_VERTEX_INPUT_RATE_VERTEX;
+    std::array<VkVertexInputBindingDescription, 2> bindingDescription = {};
+
+    bindingDescription[0].binding   = 0;
+    bindingDescription[0].stride    = sizeof(Vertex);
+    bindingDescription[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    bindingDescription[1].binding   = 1;
+    bindingDescription[1].stride    = sizeof(InstanceData);
+    bindingDescription[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
 
     return bindingDescription;
   }
 
-  static std::array<VkVertexInputAttributeDescription, 3> getAttributesDescription()
+  static std::array<VkVertexInputAttributeDescription, 8> getAttributesDescription()
   {
-    std::array<VkVertexInputAttributeDescription, 3> attributesDescription = {};
+    std::array<VkVertexInputAttributeDescription, 8> attributesDescription = {};
 
     attributesDescription[0].binding  = 0;
     attributesDescription[0].location = 0;
@@ -62,6 +83,46 @@ struct Vertex {
     attributesDescription[2].format   = VK_FORMAT_R32G32_SFLOAT;
     attributesDescription[2].offset   = offsetof(Vertex, texCoord);
 
+    // A mat4 input takes one location per column.
+    for (uint32_t column = 0; column < 4; column++) {
+      attributesDescription[3 + column].binding  = 1;
+      attributesDescription[3 + column].location = 3 + column;
+      attributesDescription[3 + column].format   = VK_FORMAT_R32G32B32A32_SFLOAT;
+      attributesDescription[3 + column].offset   = offsetof(InstanceData, model) + column * sizeof(glm::vec4);
+    }
+
+    attributesDescription[7].binding  = 1;
+    attributesDescription[7].location = 7;
+    attributesDescription[7].format   = VK_FORMAT_R32_UINT;
+    attributesDescription[7].offset   = offsetof(InstanceData, materialIndex);
+
+    return attributesDescription;
+  }
+
+  /**
+   * @brief Binding 0 is a tightly packed position stream for depth only passes, binding 1
+   * the instances as above
+   */
+  static std::array<VkVertexInputBindingDescription, 2> getPositionBindingDescription()
+  {
+    std::array<VkVertexInputBindingDescription, 2> bindingDescription = getBindingDescription();
+    bindingDescription[0].stride                                      = sizeof(glm::vec3);
+    return bindingDescription;
+  }
+
+  /**
+   * @brief Position and instance transform only, must match depth_prepass.vert
+   */
+  static std::array<VkVertexInputAttributeDescription, 5> getPositionAttributesDescription()
+  {
+    auto all = getAttributesDescription();
+
+    std::array<VkVertexInputAttributeDescription, 5> attributesDescription = {};
+    attributesDescription[0]                                              = all[0];
+    attributesDescription[0].offset                                       = 0;
+    for (uint32_t column = 0; column < 4; column++) {
+      attributesDescription[1 + column] = all[3 + column];
+    }
     return attributesDescription;
   }
 
@@ -71,6 +132,16 @@ struct Vertex {
   }
 };
 
+/**
+ * @class Bounds
+ * @brief Mesh space bounding volumes, computed when the mesh is loaded
+ */
+struct Bounds {
+  glm::vec3 minimum = glm::vec3(0.0f);
+  glm::vec3 maximum = glm::vec3(0.0f);
+  glm::vec4 sphere  = glm::vec4(0.0f);  // xyz centre of the box and w radius
+};
+
 /**
  * @class Model
  * @author Salamanderrake
@@ -85,10 +156,13 @@ struct Model {
   std::string modelPath;    // = "data/models/chalet.obj"
   std::string texturePath;  // = "data/textures/chalet.jpg"
 
-  std::vector<Vertex>   verticies;
-  std::vector<uint32_t> indices;
-  VkBuffer              vertexBuffer;
-  VkDeviceMemory        vertexBufferMemory;
+  std::vector<Vertex>         verticies;
+  std::vector<uint32_t>       indices;
+  std::vector<Scene::Lod>     lods;  // Ranges of indices, finest first, the first covers the loaded mesh
+  std::vector<Scene::Meshlet> meshlets;
+  Bounds                      bounds;
+  VkBuffer                    vertexBuffer;
+  VkDeviceMemory              vertexBufferMemory;
 };
 }  // namespace Rake::Graphics::Object
 #endif  // VULKANOBJECTS_H
@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "VulkanFunctions.h"
+#include "VulkanOcclusion.h"
+#include "VulkanReflection.h"
+
+namespace Rake { namespace Graphics {
+
+namespace {
+constexpr uint32_t tileSize      = 8;  // Workgroup size of both pyramid shaders in x and y
+constexpr VkFormat pyramidFormat = VK_FORMAT_R32_SFLOAT;
+
+/**
+ * @brief Layouts and pipeline of one pyramid shader, each has its own set layout
+ */
+void compile_pyramid_shader(DescriptorLayoutCache&   layoutCache,
+                            PipelineCompiler&        pipelineCompiler,
+                            const std::vector<char>& shaderCode,
+                            VkDescriptorSetLayout&   setLayout,
+                            VkPipelineLayout&        pipelineLayout,
+                            VkPipeline&              pipeline)
+{
+  ShaderReflection reflection;
+  reflection.reflect(shaderCode);
+
+  auto setLayouts = layoutCache.get_set_layouts(reflection);
+  if (setLayouts.size() != 1) {
+    throw std::runtime_error("Depth pyramid shaders must use exactly one descriptor set!");
+  }
+  setLayout      = setLayouts[0];
+  pipelineLayout = layoutCache.get_pipeline_layout(reflection);
+  pipeline       = pipelineCompiler.compile_compute(shaderCode, pipelineLayout);
+}
+}  // namespace
+
+/**
+ * @brief
+ *
+ * @param device
+ * @param layoutCache
+ * @param descriptorAllocator per frame descriptor sets come from its transient pools
+ * @param pipelineCompiler
+ * @param depthShaderCode hiz_depth.comp
+ * @param reduceShaderCode hiz_reduce.comp
+ * @param createImage allocates device local, single sample, optimally tiled images
+ */
+DepthPyramid::DepthPyramid(VkDevice                 device,
+                           DescriptorLayoutCache&   layoutCache,
+                           DescriptorAllocator&     descriptorAllocator,
+                           PipelineCompiler&        pipelineCompiler,
+                           const std::vector<char>& depthShaderCode,
+                           const std::vector<char>& reduceShaderCode,
+                           CreateImage              createImage)
+    : device(device)
+    , descriptorAllocator(descriptorAllocator)
+    , createImage(std::move(createImage))
+{
+  compile_pyramid_shader(
+      layoutCache, pipelineCompiler, depthShaderCode, depthSetLayout, depthPipelineLayout, depthPipeline);
+  compile_pyramid_shader(
+      layoutCache, pipelineCompiler, reduceShaderCode, reduceSetLayout, reducePipelineLayout, reducePipeline);
+
+  VkSamplerCreateInfo samplerInfo = {};
+  samplerInfo.sType               = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter           = VK_FILTER_NEAREST;
+  samplerInfo.minFilter           = VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode          = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU        = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV        = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW        = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.maxLod              = 1000.0f;  // No clamp, the cull fetches texels from any level
+
+  if (vkCreateSampler(device, &samplerInfo, nullptr, &pyramidSampler) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create depth pyramid sampler!");
+  }
+}
+
+/**
+ * @brief The pipeline and set layouts belong to the layout cache
+ */
+DepthPyramid::~DepthPyramid()
+{
+  destroy_image();
+  vkDestroySampler(device, pyramidSampler, nullptr);
+  vkDestroyPipeline(device, depthPipeline, nullptr);
+  vkDestroyPipeline(device, reducePipeline, nullptr);
+}
+
+/**
+ * @brief Recreate the pyramid for a new depth attachment size, the device must be idle.
+ * Level 0 matches the depth attachment, level k is max(1, size >> k) down to 1x1.
+ *
+ * @param depthExtent
+ */
+void DepthPyramid::resize(VkExtent2D depthExtent)
+{
+  if (depthExtent.width == size.width && depthExtent.height == size.height && image != VK_NULL_HANDLE) {
+    return;
+  }
+  destroy_image();
+
+  size                = depthExtent;
+  used                = depthExtent;
+  prepared            = false;
+  uint32_t levelCount = 1;
+  while (std::max(size.width, size.height) >> levelCount) {
+    levelCount++;
+  }
+
+  createImage(size.width,
+              size.height,
+              levelCount,
+              pyramidFormat,
+              VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+              image,
+              imageMemory);
+
+  VkImageViewCreateInfo viewInfo           = {};
+  viewInfo.sType                           = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image                           = image;
+  viewInfo.viewType                        = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format                          = pyramidFormat;
+  viewInfo.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+  viewInfo.subresourceRange.baseMipLevel   = 0;
+  viewInfo.subresourceRange.levelCount     = levelCount;
+  viewInfo.subresourceRange.baseArrayLayer = 0;
+  viewInfo.subresourceRange.layerCount     = 1;
+
+  if (vkCreateImageView(device, &viewInfo, nullptr, &fullView) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create depth pyramid view!");
+  }
+
+  levelViews.assign(levelCount, VK_NULL_HANDLE);
+  for (uint32_t level = 0; level < levelCount; level++) {
+    viewInfo.subresourceRange.baseMipLevel = level;
+    viewInfo.subresourceRange.levelCount   = 1;
+    if (vkCreateImageView(device, &viewInfo, nullptr, &levelViews[level]) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create depth pyramid view!");
+    }
+  }
+}
+
+/**
+ * @brief Part of the depth attachment the frame draws to, from its top left corner. The
+ * next record_build() reduces only that.
+ *
+ * @param drawn
+ */
+void DepthPyramid::set_region(VkExtent2D drawn)
+{
+  used = {std::min(std::max(drawn.width, 1u), size.width), std::min(std::max(drawn.height, 1u), size.height)};
+}
+
+/**
+ * @brief Move a new pyramid to the general layout, every cull phase binds it and only the
+ * late phase waits for a build. Records nothing once done since the last resize().
+ *
+ * @param commandBuffer
+ */
+void DepthPyramid::record_prepare(VkCommandBuffer commandBuffer)
+{
+  if (prepared) {
+    return;
+  }
+  prepared = true;
+
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType                = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask        = 0;
+  barrier.dstAccessMask        = VK_ACCESS_SHADER_READ_BIT;
+  barrier.oldLayout            = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout            = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image                = image;
+  barrier.subresourceRange     = {VK_IMAGE_ASPECT_COLOR_BIT, 0, level_count(), 0, 1};
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0,
+                       0,
+                       nullptr,
+                       0,
+                       nullptr,
+                       1,
+                       &barrier);
+}
+
+/**
+ * @brief Build the pyramid from the depth attachment, outside of a render pass. The frame
+ * graph moves the depth image into the read only layout before and back after.
+ *
+ * @param commandBuffer
+ * @param frame
+ * @param depthView depth aspect view of the multisampled depth, readable by compute
+ */
+void DepthPyramid::record_build(VkCommandBuffer commandBuffer, uint32_t frame, VkImageView depthView)
+{
+  const uint32_t levelCount = level_count();
+
+  // Last frame's pyramid is not needed, only the reads of it must finish.
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType                = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask        = 0;
+  barrier.dstAccessMask        = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.oldLayout            = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout            = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image                = image;
+  barrier.subresourceRange     = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1};
+
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0,
+                       0,
+                       nullptr,
+                       0,
+                       nullptr,
+                       1,
+                       &barrier);
+
+  VkMemoryBarrier levelBarrier = {};
+  levelBarrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  levelBarrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+  levelBarrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT;
+
+  VkExtent2D source = used;
+  for (uint32_t level = 0; level < levelCount; level++) {
+    VkExtent2D target = {std::max(used.width >> level, 1u), std::max(used.height >> level, 1u)};
+
+    DescriptorWrites writes;
+    if (level == 0) {
+      writes.image(0, pyramidSampler, depthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+    } else {
+      writes.image(0, VK_NULL_HANDLE, levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL);
+      vkCmdPipelineBarrier(commandBuffer,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           0,
+                           1,
+                           &levelBarrier,
+                           0,
+                           nullptr,
+                           0,
+                           nullptr);
+    }
+    writes.image(1, VK_NULL_HANDLE, levelViews[level], VK_IMAGE_LAYOUT_GENERAL);
+
+    VkDescriptorSetLayout setLayout = level == 0 ? depthSetLayout : reduceSetLayout;
+    VkPipelineLayout      layout    = level == 0 ? depthPipelineLayout : reducePipelineLayout;
+    VkDescriptorSet       set       = descriptorAllocator.allocate_frame_set(frame, setLayout, writes);
+
+    PyramidConstants constants = {{source.width, source.height}, {target.width, target.height}};
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, level == 0 ? depthPipeline : reducePipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &set, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(
+        commandBuffer, (target.width + tileSize - 1) / tileSize, (target.height + tileSize - 1) / tileSize, 1);
+
+    source = target;
+  }
+
+  // The occlusion cull samples the pyramid.
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0,
+                       1,
+                       &levelBarrier,
+                       0,
+                       nullptr,
+                       0,
+                       nullptr);
+}
+
+/**
+ * @brief
+ */
+void DepthPyramid::destroy_image()
+{
+  for (auto view : levelViews) {
+    vkDestroyImageView(device, view, nullptr);
+  }
+  levelViews.clear();
+  if (fullView != VK_NULL_HANDLE) {
+    vkDestroyImageView(device, fullView, nullptr);
+  }
+  if (image != VK_NULL_HANDLE) {
+    vkDestroyImage(device, image, nullptr);
+    vkFreeMemory(device, imageMemory, nullptr);
+  }
+  fullView    = VK_NULL_HANDLE;
+  image       = VK_NULL_HANDLE;
+  imageMemory = VK_NULL_HANDLE;
+}
+
+}}  // namespace Rake::Graphics
@@ -0,0 +1,85 @@
+#if !defined(VULKANOCCLUSION_H)
+#define VULKANOCCLUSION_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#define VK_NO_PROTOTYPES
+#define VK_USE_PLATFORM_XCB_KHR
+#include <vulkan/vulkan.h>
+
+#include "VulkanDescriptors.h"
+#include "VulkanPipelines.h"
+
+namespace Rake { namespace Graphics {
+
+/**
+ * @brief Hierarchical depth buffer. Level 0 holds the farthest sample of each pixel of
+ * the multisampled depth attachment, every further level the farthest depth of the texels
+ * it covers in the level above, so one texel fetch bounds the depth of a whole region.
+ *
+ * The image stays in the general layout, compute writes it and the occlusion cull reads
+ * it through view() and sampler().
+ *
+ * When frames draw only part of the depth attachment the pyramid covers that region, its
+ * levels are the region's size halved rather than the image's.
+ */
+class DepthPyramid {
+  public:
+  using CreateImage =
+      std::function<void(uint32_t, uint32_t, uint32_t, VkFormat, VkImageUsageFlags, VkImage&, VkDeviceMemory&)>;
+
+  DepthPyramid(VkDevice                 device,
+               DescriptorLayoutCache&   layoutCache,
+               DescriptorAllocator&     descriptorAllocator,
+               PipelineCompiler&        pipelineCompiler,
+               const std::vector<char>& depthShaderCode,
+               const std::vector<char>& reduceShaderCode,
+               CreateImage              createImage);
+  ~DepthPyramid();
+
+  DepthPyramid(const DepthPyramid&) = delete;
+  DepthPyramid& operator=(const DepthPyramid&) = delete;
+
+  void resize(VkExtent2D depthExtent);
+  void set_region(VkExtent2D drawn);
+  void record_prepare(VkCommandBuffer commandBuffer);
+  void record_build(VkCommandBuffer commandBuffer, uint32_t frame, VkImageView depthView);
+
+  VkImageView view() const { return fullView; }
+  VkSampler   sampler() const { return pyramidSampler; }
+  VkExtent2D  extent() const { return size; }
+  VkExtent2D  region() const { return used; }
+  uint32_t    level_count() const { return static_cast<uint32_t>(levelViews.size()); }
+
+  private:
+  struct PyramidConstants {
+    uint32_t sourceSize[2];
+    uint32_t levelSize[2];
+  };
+
+  void destroy_image();
+
+  VkDevice                 device;
+  DescriptorAllocator&     descriptorAllocator;
+  CreateImage              createImage;
+  VkDescriptorSetLayout    depthSetLayout;
+  VkDescriptorSetLayout    reduceSetLayout;
+  VkPipelineLayout         depthPipelineLayout;
+  VkPipelineLayout         reducePipelineLayout;
+  VkPipeline               depthPipeline;
+  VkPipeline               reducePipeline;
+  VkSampler                pyramidSampler = VK_NULL_HANDLE;
+  VkImage                  image          = VK_NULL_HANDLE;
+  VkDeviceMemory           imageMemory    = VK_NULL_HANDLE;
+  VkImageView              fullView       = VK_NULL_HANDLE;
+  std::vector<VkImageView> levelViews;  // One view per mip level, for storage writes
+  VkExtent2D               size     = {0, 0};
+  VkExtent2D               used     = {0, 0};  // Drawn part of the depth attachment, see set_region()
+  bool                     prepared = false;  // In the general layout since the last resize
+};
+
+}}  // namespace Rake::Graphics
+
+#endif  // VULKANOCCLUSION_H
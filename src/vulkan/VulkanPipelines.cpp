@@ -0,0 +1,297 @@
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+
+#include "VulkanFunctions.h"
+#include "VulkanFactories.h"
+#include "VulkanPipelines.h"
+
+namespace Rake { namespace Graphics {
+
+/**
+ * @brief
+ * @return true once the compile job has finished, successfully or not
+ */
+bool PipelineHandle::ready() const
+{
+  return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+/**
+ * @brief The compiled pipeline if it is ready, otherwise fallback. Use this to keep
+ * drawing with an existing pipeline while a variant compiles.
+ *
+ * @param fallback
+ * @return VkPipeline
+ */
+VkPipeline PipelineHandle::get_or(VkPipeline fallback) const
+{
+  return ready() ? wait() : fallback;
+}
+
+/**
+ * @brief Block until the pipeline is compiled, rethrows any compile error
+ * @return VkPipeline
+ */
+VkPipeline PipelineHandle::wait() const
+{
+  if (!future.valid()) {
+    return VK_NULL_HANDLE;
+  }
+  return future.get();
+}
+
+/**
+ * @brief
+ *
+ * @param device
+ * @param cachePath file the pipeline cache is loaded from and saved to, may be empty
+ * @param threadCount
+ */
+PipelineCompiler::PipelineCompiler(VkDevice device, const std::string& cachePath, size_t threadCount)
+    : device(device)
+    , cachePath(cachePath)
+{
+  load_cache();
+  workers = std::make_unique<Base::ThreadPool>(threadCount);
+}
+
+/**
+ * @brief Finish queued jobs before the cache goes away
+ */
+PipelineCompiler::~PipelineCompiler()
+{
+  workers.reset();
+  save_cache();
+  vkDestroyPipelineCache(device, pipelineCache, nullptr);
+}
+
+/**
+ * @brief Queue a pipeline for compilation on a worker thread
+ *
+ * @param description
+ * @return PipelineHandle
+ */
+PipelineHandle PipelineCompiler::request(GraphicsPipelineDescription description)
+{
+  PipelineHandle handle;
+  handle.future = workers->submit([this, description = std::move(description)]() { return compile(description); })
+                      .share();
+  return handle;
+}
+
+/**
+ * @brief Build the pipeline on the calling thread. Safe to call from several threads
+ * at once, the pipeline cache is internally synchronized.
+ *
+ * @param description
+ * @return VkPipeline
+ */
+VkPipeline PipelineCompiler::compile(const GraphicsPipelineDescription& description)
+{
+  Factory::Shader shader;
+
+  std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+
+  VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
+  vertShaderStageInfo.sType                           = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  vertShaderStageInfo.stage                           = VK_SHADER_STAGE_VERTEX_BIT;
+  vertShaderStageInfo.module                          = shader.create_shader_module(device, description.vertexShaderCode);
+  vertShaderStageInfo.pName                           = "main";
+  shaderStages.push_back(vertShaderStageInfo);
+
+  if (!description.fragmentShaderCode.empty()) {
+    VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
+    fragShaderStageInfo.sType                           = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    fragShaderStageInfo.stage                           = VK_SHADER_STAGE_FRAGMENT_BIT;
+    fragShaderStageInfo.pName                           = "main";
+    try {
+      fragShaderStageInfo.module = shader.create_shader_module(device, description.fragmentShaderCode);
+    } catch (...) {
+      // The vertex module is only released further down, after the pipeline is built
+      vkDestroyShaderModule(device, vertShaderStageInfo.module, nullptr);
+      throw;
+    }
+    shaderStages.push_back(fragShaderStageInfo);
+  }
+
+  VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+  vertexInputInfo.sType                                = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertexInputInfo.vertexBindingDescriptionCount   = static_cast<uint32_t>(description.bindingDescriptions.size());
+  vertexInputInfo.pVertexBindingDescriptions      = description.bindingDescriptions.data();
+  vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(description.attributeDescriptions.size());
+  vertexInputInfo.pVertexAttributeDescriptions    = description.attributeDescriptions.data();
+
+  VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+  inputAssembly.sType                                  = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  inputAssembly.topology                               = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  inputAssembly.primitiveRestartEnable                 = VK_FALSE;
+
+  // Viewport and scissor are set when the command buffer is recorded.
+  VkPipelineViewportStateCreateInfo viewportState = {};
+  viewportState.sType                             = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewportState.viewportCount                     = 1;
+  viewportState.scissorCount                      = 1;
+
+  std::array<VkDynamicState, 2> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
+  VkPipelineDynamicStateCreateInfo dynamicState = {};
+  dynamicState.sType                            = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount                = static_cast<uint32_t>(dynamicStates.size());
+  dynamicState.pDynamicStates                   = dynamicStates.data();
+
+  VkPipelineRasterizationStateCreateInfo rasterizer = {};
+  rasterizer.sType                                  = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterizer.depthClampEnable                       = VK_FALSE;
+  rasterizer.rasterizerDiscardEnable                = VK_FALSE;
+  rasterizer.polygonMode                            = VK_POLYGON_MODE_FILL;
+  rasterizer.lineWidth                              = 1.0f;
+  rasterizer.cullMode                               = description.cullMode;
+  rasterizer.frontFace                              = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  rasterizer.depthBiasEnable                        = VK_FALSE;
+
+  VkPipelineMultisampleStateCreateInfo multisampling = {};
+  multisampling.sType                                = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisampling.sampleShadingEnable                  = description.sampleShadingEnable ? VK_TRUE : VK_FALSE;
+  multisampling.rasterizationSamples                 = description.samples;
+  multisampling.minSampleShading                     = description.minSampleShading;
+  multisampling.pSampleMask                          = nullptr;
+  multisampling.alphaToCoverageEnable                = VK_FALSE;
+  multisampling.alphaToOneEnable                     = VK_FALSE;
+
+  VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+  depthStencil.sType                                 = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depthStencil.depthTestEnable                       = description.depthTestEnable ? VK_TRUE : VK_FALSE;
+  depthStencil.depthWriteEnable                      = description.depthWriteEnable ? VK_TRUE : VK_FALSE;
+  depthStencil.depthCompareOp                        = description.depthCompareOp;
+  depthStencil.depthBoundsTestEnable                 = VK_FALSE;
+  depthStencil.minDepthBounds                        = 0.0f;
+  depthStencil.maxDepthBounds                        = 1.0f;
+  depthStencil.stencilTestEnable                     = VK_FALSE;
+
+  VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+  colorBlendAttachment.colorWriteMask                      = description.colorWriteEnable
+                                                            ? VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                                                  VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+                                                            : 0;
+  colorBlendAttachment.blendEnable = VK_FALSE;
+
+  VkPipelineColorBlendStateCreateInfo colorBlending = {};
+  colorBlending.sType                               = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  colorBlending.logicOpEnable                       = VK_FALSE;
+  colorBlending.attachmentCount                     = description.colorAttachments;
+  colorBlending.pAttachments                        = &colorBlendAttachment;
+
+  VkGraphicsPipelineCreateInfo pipelineInfo = {};
+  pipelineInfo.sType                        = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineInfo.stageCount                   = static_cast<uint32_t>(shaderStages.size());
+  pipelineInfo.pStages                      = shaderStages.data();
+  pipelineInfo.pVertexInputState            = &vertexInputInfo;
+  pipelineInfo.pInputAssemblyState          = &inputAssembly;
+  pipelineInfo.pViewportState               = &viewportState;
+  pipelineInfo.pRasterizationState          = &rasterizer;
+  pipelineInfo.pMultisampleState            = &multisampling;
+  pipelineInfo.pDepthStencilState           = &depthStencil;
+  pipelineInfo.pColorBlendState             = &colorBlending;
+  pipelineInfo.pDynamicState                = &dynamicState;
+  pipelineInfo.layout                       = description.layout;
+  pipelineInfo.renderPass                   = description.renderPass;
+  pipelineInfo.subpass                      = description.subpass;
+  pipelineInfo.basePipelineHandle           = VK_NULL_HANDLE;
+
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  VkResult   result   = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+
+  for (auto& stage : shaderStages) {
+    vkDestroyShaderModule(device, stage.module, nullptr);
+  }
+
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create graphics pipeline!");
+  }
+  return pipeline;
+}
+
+/**
+ * @brief Build a compute pipeline on the calling thread, these are cheap enough to
+ * not need a worker
+ *
+ * @param computeShaderCode
+ * @param layout
+ * @return VkPipeline
+ */
+VkPipeline PipelineCompiler::compile_compute(const std::vector<char>& computeShaderCode, VkPipelineLayout layout)
+{
+  Factory::Shader shader;
+
+  VkComputePipelineCreateInfo pipelineInfo = {};
+  pipelineInfo.sType                       = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType                 = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage                 = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module                = shader.create_shader_module(device, computeShaderCode);
+  pipelineInfo.stage.pName                 = "main";
+  pipelineInfo.layout                      = layout;
+
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  VkResult   result   = vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+
+  vkDestroyShaderModule(device, pipelineInfo.stage.module, nullptr);
+
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create compute pipeline!");
+  }
+  return pipeline;
+}
+
+/**
+ * @brief Seed the pipeline cache from disk, the driver ignores data written by an
+ * incompatible device or driver version
+ */
+void PipelineCompiler::load_cache()
+{
+  std::vector<char> initialData;
+
+  if (!cachePath.empty()) {
+    std::ifstream file(cachePath, std::ios::ate | std::ios::binary);
+    if (file.is_open()) {
+      initialData.resize(static_cast<size_t>(file.tellg()));
+      file.seekg(0);
+      file.read(initialData.data(), initialData.size());
+    }
+  }
+
+  VkPipelineCacheCreateInfo cacheInfo = {};
+  cacheInfo.sType                     = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize           = initialData.size();
+  cacheInfo.pInitialData              = initialData.empty() ? nullptr : initialData.data();
+
+  if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create pipeline cache!");
+  }
+}
+
+/**
+ * @brief
+ */
+void PipelineCompiler::save_cache()
+{
+  if (cachePath.empty() || pipelineCache == VK_NULL_HANDLE) {
+    return;
+  }
+
+  size_t dataSize = 0;
+  if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+    return;
+  }
+
+  std::vector<char> data(dataSize);
+  if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()) != VK_SUCCESS) {
+    return;
+  }
+
+  std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+  file.write(data.data(), dataSize);
+}
+
+}}  // namespace Rake::Graphics
@@ -0,0 +1,93 @@
+#if !defined(VULKANPIPELINES_H)
+#define VULKANPIPELINES_H
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define VK_NO_PROTOTYPES
+#define VK_USE_PLATFORM_XCB_KHR
+#include <vulkan/vulkan.h>
+
+#include "skeleton/threadpool.h"
+
+namespace Rake { namespace Graphics {
+
+/**
+ * @brief Everything needed to build a graphics pipeline. It is owned by value so a
+ * worker thread can keep compiling after the caller has moved on.
+ *
+ * Viewport and scissor are always dynamic state so the pipeline survives swap chain
+ * resizes.
+ */
+struct GraphicsPipelineDescription {
+  std::vector<char> vertexShaderCode;
+  std::vector<char> fragmentShaderCode;
+
+  std::vector<VkVertexInputBindingDescription>   bindingDescriptions;
+  std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+
+  VkSampleCountFlagBits samples             = VK_SAMPLE_COUNT_1_BIT;
+  bool                  sampleShadingEnable = false;
+  float                 minSampleShading    = 0.0f;
+  VkCullModeFlags       cullMode            = VK_CULL_MODE_BACK_BIT;
+  bool                  depthTestEnable     = true;
+  bool                  depthWriteEnable    = true;
+  VkCompareOp           depthCompareOp      = VK_COMPARE_OP_LESS;
+  bool                  colorWriteEnable    = true;
+  uint32_t              colorAttachments    = 1;  // Of the subpass, 0 for a depth only pass
+
+  VkPipelineLayout layout     = VK_NULL_HANDLE;
+  VkRenderPass     renderPass = VK_NULL_HANDLE;
+  uint32_t         subpass    = 0;
+};
+
+/**
+ * @brief Result of an asynchronous pipeline request
+ *
+ */
+class PipelineHandle {
+  public:
+  bool       valid() const { return future.valid(); }
+  bool       ready() const;
+  VkPipeline get_or(VkPipeline fallback) const;
+  VkPipeline wait() const;
+
+  private:
+  friend class PipelineCompiler;
+  std::shared_future<VkPipeline> future;
+};
+
+/**
+ * @brief Compiles pipelines on background threads against one shared VkPipelineCache.
+ * The cache is persisted to cachePath when the compiler is destroyed.
+ *
+ */
+class PipelineCompiler {
+  public:
+  PipelineCompiler(VkDevice device, const std::string& cachePath, size_t threadCount = 2);
+  ~PipelineCompiler();
+
+  PipelineCompiler(const PipelineCompiler&) = delete;
+  PipelineCompiler& operator=(const PipelineCompiler&) = delete;
+
+  PipelineHandle request(GraphicsPipelineDescription description);
+  VkPipeline     compile(const GraphicsPipelineDescription& description);
+  VkPipeline     compile_compute(const std::vector<char>& computeShaderCode, VkPipelineLayout layout);
+
+  VkPipelineCache cache() const { return pipelineCache; }
+
+  private:
+  void load_cache();
+  void save_cache();
+
+  VkDevice                          device;
+  VkPipelineCache                   pipelineCache = VK_NULL_HANDLE;
+  std::string                       cachePath;
+  std::unique_ptr<Base::ThreadPool> workers;
+};
+
+}}  // namespace Rake::Graphics
+
+#endif  // VULKANPIPELINES_H
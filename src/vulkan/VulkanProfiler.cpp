@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "VulkanFunctions.h"
+#include "VulkanProfiler.h"
+
+namespace Rake { namespace Graphics {
+
+/**
+ * @brief
+ *
+ * @param device
+ * @param physicalDevice
+ * @param timestampValidBits of the queue family the frames are submitted to, 0 disables the timer
+ * @param frameCount number of frames in flight
+ */
+GpuTimer::GpuTimer(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t timestampValidBits, uint32_t frameCount)
+    : device(device)
+    , written(frameCount, false)
+{
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+  nanosecondsPerTick = properties.limits.timestampPeriod;
+  timestampMask      = timestampValidBits >= 64 ? ~0ull : (1ull << timestampValidBits) - 1;
+
+  if (timestampValidBits == 0) {
+    return;
+  }
+
+  VkQueryPoolCreateInfo poolInfo = {};
+  poolInfo.sType                 = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  poolInfo.queryType             = VK_QUERY_TYPE_TIMESTAMP;
+  poolInfo.queryCount            = frameCount * 2;
+
+  if (vkCreateQueryPool(device, &poolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create timestamp query pool!");
+  }
+}
+
+/**
+ * @brief
+ */
+GpuTimer::~GpuTimer()
+{
+  if (queryPool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(device, queryPool, nullptr);
+  }
+}
+
+/**
+ * @brief Reset the frame's queries and write the start timestamp, must be outside a render pass
+ *
+ * @param commandBuffer
+ * @param frame
+ */
+void GpuTimer::begin(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+  if (!supported()) {
+    return;
+  }
+  vkCmdResetQueryPool(commandBuffer, queryPool, frame * 2, 2);
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, frame * 2);
+}
+
+/**
+ * @brief Write the end timestamp once every earlier command has finished
+ *
+ * @param commandBuffer
+ * @param frame
+ */
+void GpuTimer::end(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+  if (!supported()) {
+    return;
+  }
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, frame * 2 + 1);
+  written[frame] = true;
+}
+
+/**
+ * @brief Read the duration of the last submission recorded for this frame slot
+ *
+ * @param frame
+ * @param milliseconds
+ * @return false when nothing was recorded yet or the results are not available
+ */
+bool GpuTimer::collect(uint32_t frame, double& milliseconds)
+{
+  if (!supported() || !written[frame]) {
+    return false;
+  }
+
+  uint64_t timestamps[2];
+  VkResult result = vkGetQueryPoolResults(device,
+                                          queryPool,
+                                          frame * 2,
+                                          2,
+                                          sizeof(timestamps),
+                                          timestamps,
+                                          sizeof(uint64_t),
+                                          VK_QUERY_RESULT_64_BIT);
+  if (result != VK_SUCCESS) {
+    return false;
+  }
+
+  uint64_t ticks = ((timestamps[1] & timestampMask) - (timestamps[0] & timestampMask)) & timestampMask;
+  milliseconds   = ticks * nanosecondsPerTick / 1.0e6;
+  return true;
+}
+
+/**
+ * @brief
+ *
+ * @param highest tier to measure first
+ * @param targetMilliseconds GPU frame time a tier has to meet
+ * @param warmupFrames skipped after each change of tier
+ * @param measuredFrames whose median decides
+ */
+QualityTuner::QualityTuner(QualityTier highest,
+                           double      targetMilliseconds,
+                           uint32_t    warmupFrames,
+                           uint32_t    measuredFrames)
+    : current(highest)
+    , target(targetMilliseconds)
+    , warmupFrames(warmupFrames)
+    , measuredFrames(std::max(measuredFrames, 1u))
+{
+  samples.reserve(this->measuredFrames);
+}
+
+/**
+ * @brief Feed the GPU time of one frame drawn at tier()
+ *
+ * @param gpuMilliseconds
+ * @return true when the tier changed and the next frames should use the new tier()
+ */
+bool QualityTuner::add(double gpuMilliseconds)
+{
+  if (finished) {
+    return false;
+  }
+  if (skipped < warmupFrames) {
+    skipped++;
+    return false;
+  }
+
+  samples.push_back(gpuMilliseconds);
+  if (samples.size() < measuredFrames) {
+    return false;
+  }
+
+  std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+  lastMedian = samples[samples.size() / 2];
+  samples.clear();
+  skipped = 0;
+
+  if (lastMedian <= target || current == QualityTier::Low) {
+    finished = true;
+    return false;
+  }
+  current = static_cast<QualityTier>(static_cast<uint32_t>(current) - 1);
+  return true;
+}
+
+/**
+ * @brief
+ *
+ * @param targetMilliseconds GPU frame time to hold
+ * @param minScale
+ * @param maxScale
+ * @param initialScale
+ */
+ResolutionController::ResolutionController(double targetMilliseconds,
+                                           float  minScale,
+                                           float  maxScale,
+                                           float  initialScale)
+    : target(targetMilliseconds)
+    , minScale(minScale)
+    , maxScale(maxScale)
+    , current(std::clamp(initialScale, minScale, maxScale))
+{
+}
+
+/**
+ * @brief Feed the GPU time of one frame
+ *
+ * @param gpuMilliseconds
+ * @return scale for the next frame
+ */
+float ResolutionController::add(double gpuMilliseconds)
+{
+  const uint32_t adjustInterval = 8;  // Timings arrive a couple of frames late
+  const double   smoothing      = 0.2;
+  const double   deadband       = 0.05;
+  const double   maxStep        = 0.1;
+
+  smoothed = frames == 0 ? gpuMilliseconds : smoothed + smoothing * (gpuMilliseconds - smoothed);
+  frames++;
+  if (frames % adjustInterval != 0 || smoothed <= 0.0) {
+    return current;
+  }
+
+  double ratio = target / smoothed;
+  if (std::abs(ratio - 1.0) < deadband) {
+    return current;
+  }
+  double step = std::clamp(std::sqrt(ratio), 1.0 - maxStep, 1.0 + maxStep);
+  current     = std::clamp(static_cast<float>(current * step), minScale, maxScale);
+  return current;
+}
+
+}}  // namespace Rake::Graphics
@@ -0,0 +1,118 @@
+#if !defined(VULKANPROFILER_H)
+#define VULKANPROFILER_H
+
+#include <cstdint>
+#include <vector>
+
+#define VK_NO_PROTOTYPES
+#define VK_USE_PLATFORM_XCB_KHR
+#include <vulkan/vulkan.h>
+
+#include "VulkanSettings.h"
+
+namespace Rake { namespace Graphics {
+
+/**
+ * @brief CPU and GPU cost of the most recently completed frame
+ */
+struct FrameTimings {
+  double cpuMilliseconds = 0.0;  // update, record and submit on the render thread
+  double gpuMilliseconds = 0.0;  // first to last command of the frame, 0 without timestamps
+};
+
+/**
+ * @brief Memory behind one multisampled attachment. A lazily allocated one is only backed
+ * as far as the device needs, committed says how far that is so far.
+ */
+struct AttachmentMemory {
+  const char*  name      = "";
+  VkDeviceSize size      = 0;  // Of the allocation
+  VkDeviceSize committed = 0;
+  bool         transient = false;  // Contents never leave the render pass
+  bool         lazy      = false;  // Lazily allocated memory, the device had it
+};
+
+/**
+ * @brief Timestamp queries bracketing each frame in flight
+ *
+ * A frame's result is read back with collect() once its fence has signaled, right
+ * before the slot is recorded again, so it never stalls.
+ */
+class GpuTimer {
+  public:
+  GpuTimer(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t timestampValidBits, uint32_t frameCount);
+  ~GpuTimer();
+
+  GpuTimer(const GpuTimer&) = delete;
+  GpuTimer& operator=(const GpuTimer&) = delete;
+
+  void begin(VkCommandBuffer commandBuffer, uint32_t frame);
+  void end(VkCommandBuffer commandBuffer, uint32_t frame);
+  bool collect(uint32_t frame, double& milliseconds);
+
+  bool supported() const { return queryPool != VK_NULL_HANDLE; }
+
+  private:
+  VkDevice          device;
+  VkQueryPool       queryPool = VK_NULL_HANDLE;
+  double            nanosecondsPerTick;
+  uint64_t          timestampMask;
+  std::vector<bool> written;
+};
+
+/**
+ * @brief Picks the highest quality tier whose GPU frame time meets a target. Starting at
+ * the highest tier allowed it measures a few frames per tier and steps down until one
+ * fits; the lowest tier stays when none does.
+ *
+ * The first frames of a tier are skipped, they still report timings of the one before.
+ */
+class QualityTuner {
+  public:
+  QualityTuner(QualityTier highest, double targetMilliseconds, uint32_t warmupFrames = 8, uint32_t measuredFrames = 24);
+
+  bool add(double gpuMilliseconds);
+
+  QualityTier tier() const { return current; }
+  bool        done() const { return finished; }
+  double      median() const { return lastMedian; }  // Of the tier measured last
+
+  private:
+  QualityTier         current;
+  double              target;
+  uint32_t            warmupFrames;
+  uint32_t            measuredFrames;
+  uint32_t            skipped    = 0;
+  double              lastMedian = 0.0;
+  bool                finished   = false;
+  std::vector<double> samples;
+};
+
+/**
+ * @brief Render target scale that holds the GPU frame time at a target. The time is
+ * smoothed and every few frames the scale moves by the square root of how far it is off,
+ * since the pixel count grows with the square of the scale, but never by more than a
+ * tenth at once. Within a few percent of the target the scale stays put so the image
+ * does not pump.
+ */
+class ResolutionController {
+  public:
+  ResolutionController(double targetMilliseconds, float minScale, float maxScale, float initialScale);
+
+  float add(double gpuMilliseconds);
+
+  float  scale() const { return current; }
+  double smoothed_milliseconds() const { return smoothed; }
+
+  private:
+  double   target;
+  float    minScale;
+  float    maxScale;
+  float    current;
+  double   smoothed = 0.0;
+  uint32_t frames   = 0;
+};
+
+}}  // namespace Rake::Graphics
+
+#endif  // VULKANPROFILER_H
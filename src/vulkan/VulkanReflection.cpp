@@ -0,0 +1,593 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "VulkanReflection.h"
+
+namespace Rake { namespace Graphics {
+
+namespace {
+
+// The handful of SPIR-V enumerants we care about, see the SPIR-V specification 3.x
+namespace Spv {
+constexpr uint32_t Magic = 0x07230203;
+
+enum Op : uint32_t {
+  OpEntryPoint       = 15,
+  OpTypeInt          = 21,
+  OpTypeFloat        = 22,
+  OpTypeVector       = 23,
+  OpTypeMatrix       = 24,
+  OpTypeImage        = 25,
+  OpTypeSampler      = 26,
+  OpTypeSampledImage = 27,
+  OpTypeArray        = 28,
+  OpTypeRuntimeArray = 29,
+  OpTypeStruct       = 30,
+  OpTypePointer      = 32,
+  OpConstant         = 43,
+  OpSpecConstant     = 50,
+  OpVariable         = 59,
+  OpDecorate         = 71,
+  OpMemberDecorate   = 72,
+};
+
+enum Decoration : uint32_t {
+  Block         = 2,
+  BufferBlock   = 3,
+  ArrayStride   = 6,
+  BuiltIn       = 11,
+  Location      = 30,
+  Binding       = 33,
+  DescriptorSet = 34,
+  Offset        = 35,
+};
+
+enum StorageClass : uint32_t {
+  UniformConstant = 0,
+  Input           = 1,
+  Uniform         = 2,
+  PushConstant    = 9,
+  StorageBuffer   = 12,
+};
+
+enum Dim : uint32_t {
+  DimBuffer      = 5,
+  DimSubpassData = 6,
+};
+}  // namespace Spv
+
+/**
+ * @brief Everything we remember about a single SPIR-V result id
+ */
+struct SpvId {
+  uint32_t              opcode = 0;
+  std::vector<uint32_t> words;  // the defining instruction, including the opcode word
+
+  uint32_t              set         = 0;
+  uint32_t              binding     = 0;
+  uint32_t              location    = 0;
+  uint32_t              arrayStride = 0;
+  bool                  hasBinding  = false;
+  bool                  hasLocation = false;
+  bool                  builtIn     = false;
+  bool                  bufferBlock = false;
+  std::vector<uint32_t> memberOffsets;
+};
+
+/**
+ * @brief Walks the id table produced by ShaderReflection::reflect
+ */
+class SpvModule {
+  public:
+  explicit SpvModule(const std::vector<char>& code)
+  {
+    if (code.size() < 5 * sizeof(uint32_t) || code.size() % sizeof(uint32_t) != 0) {
+      throw std::runtime_error("Invalid SPIR-V module!");
+    }
+
+    words.resize(code.size() / sizeof(uint32_t));
+    std::memcpy(words.data(), code.data(), code.size());
+    if (words[0] != Spv::Magic) {
+      throw std::runtime_error("Invalid SPIR-V module!");
+    }
+
+    ids.resize(words[3]);
+
+    for (size_t i = 5; i < words.size();) {
+      uint32_t opcode    = words[i] & 0xffff;
+      uint32_t wordCount = words[i] >> 16;
+      if (wordCount == 0 || i + wordCount > words.size()) {
+        throw std::runtime_error("Invalid SPIR-V module!");
+      }
+      parse(opcode, &words[i], wordCount);
+      i += wordCount;
+    }
+  }
+
+  SpvId&       id(uint32_t index) { return ids.at(index); }
+  const SpvId& id(uint32_t index) const { return ids.at(index); }
+
+  const std::vector<SpvId>& all() const { return ids; }
+  VkShaderStageFlags        stages() const { return stageFlags; }
+
+  /**
+   * @brief Value of an integer constant, used for array lengths
+   */
+  uint32_t constant(uint32_t index) const
+  {
+    const auto& constant = id(index);
+    if (constant.opcode != Spv::OpConstant && constant.opcode != Spv::OpSpecConstant) {
+      throw std::runtime_error("Unsupported SPIR-V array length!");
+    }
+    return constant.words[3];
+  }
+
+  /**
+   * @brief Size in bytes of a type using the std140/std430 rules glslc emits offsets for
+   */
+  uint32_t size_of(uint32_t index) const
+  {
+    const auto& type = id(index);
+    switch (type.opcode) {
+      case Spv::OpTypeInt:
+      case Spv::OpTypeFloat:
+        return type.words[2] / 8;
+      case Spv::OpTypeVector:
+        return type.words[3] * size_of(type.words[2]);
+      case Spv::OpTypeMatrix: {
+        const auto& column     = id(type.words[2]);
+        uint32_t    components = column.words[3] == 3 ? 4 : column.words[3];
+        return type.words[3] * components * size_of(column.words[2]);
+      }
+      case Spv::OpTypeArray: {
+        uint32_t stride = type.arrayStride != 0 ? type.arrayStride : size_of(type.words[2]);
+        return constant(type.words[3]) * stride;
+      }
+      case Spv::OpTypeStruct: {
+        uint32_t size = 0;
+        for (size_t member = 0; member < type.memberOffsets.size() && member + 2 < type.words.size(); member++) {
+          size = std::max(size, type.memberOffsets[member] + size_of(type.words[member + 2]));
+        }
+        return size;
+      }
+      default:
+        return 0;
+    }
+  }
+
+  /**
+   * @brief Vertex attribute format of a scalar or vector type
+   */
+  VkFormat format_of(uint32_t index) const
+  {
+    const auto&  type       = id(index);
+    const SpvId* scalar     = &type;
+    uint32_t     components = 1;
+    if (type.opcode == Spv::OpTypeVector) {
+      components = type.words[3];
+      scalar     = &id(type.words[2]);
+    }
+
+    if (scalar->words.size() < 3 || scalar->words[2] != 32 || components < 1 || components > 4) {
+      return VK_FORMAT_UNDEFINED;
+    }
+
+    static const VkFormat floats[] = {
+        VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT};
+    static const VkFormat sints[] = {
+        VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT};
+    static const VkFormat uints[] = {
+        VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT};
+
+    if (scalar->opcode == Spv::OpTypeFloat) {
+      return floats[components - 1];
+    }
+    if (scalar->opcode == Spv::OpTypeInt) {
+      return scalar->words[3] != 0 ? sints[components - 1] : uints[components - 1];
+    }
+    return VK_FORMAT_UNDEFINED;
+  }
+
+  private:
+  void parse(uint32_t opcode, const uint32_t* instruction, uint32_t wordCount)
+  {
+    switch (opcode) {
+      case Spv::OpEntryPoint:
+        stageFlags |= stage_of(instruction[1]);
+        break;
+      case Spv::OpTypeInt:
+      case Spv::OpTypeFloat:
+      case Spv::OpTypeVector:
+      case Spv::OpTypeMatrix:
+      case Spv::OpTypeImage:
+      case Spv::OpTypeSampler:
+      case Spv::OpTypeSampledImage:
+      case Spv::OpTypeArray:
+      case Spv::OpTypeRuntimeArray:
+      case Spv::OpTypeStruct:
+      case Spv::OpTypePointer:
+        define(instruction[1], opcode, instruction, wordCount);
+        break;
+      case Spv::OpConstant:
+      case Spv::OpSpecConstant:
+      case Spv::OpVariable:
+        define(instruction[2], opcode, instruction, wordCount);
+        break;
+      case Spv::OpDecorate:
+        decorate(id(instruction[1]), instruction[2], wordCount > 3 ? instruction[3] : 0);
+        break;
+      case Spv::OpMemberDecorate:
+        if (instruction[3] == Spv::Offset && wordCount > 4) {
+          auto& type = id(instruction[1]);
+          if (type.memberOffsets.size() <= instruction[2]) {
+            type.memberOffsets.resize(instruction[2] + 1, 0);
+          }
+          type.memberOffsets[instruction[2]] = instruction[4];
+        } else if (instruction[3] == Spv::BuiltIn) {
+          id(instruction[1]).builtIn = true;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  void define(uint32_t index, uint32_t opcode, const uint32_t* instruction, uint32_t wordCount)
+  {
+    auto& entry  = id(index);
+    entry.opcode = opcode;
+    entry.words.assign(instruction, instruction + wordCount);
+  }
+
+  static void decorate(SpvId& entry, uint32_t decoration, uint32_t value)
+  {
+    switch (decoration) {
+      case Spv::DescriptorSet:
+        entry.set = value;
+        break;
+      case Spv::Binding:
+        entry.binding    = value;
+        entry.hasBinding = true;
+        break;
+      case Spv::Location:
+        entry.location    = value;
+        entry.hasLocation = true;
+        break;
+      case Spv::ArrayStride:
+        entry.arrayStride = value;
+        break;
+      case Spv::BuiltIn:
+        entry.builtIn = true;
+        break;
+      case Spv::BufferBlock:
+        entry.bufferBlock = true;
+        break;
+      default:
+        break;
+    }
+  }
+
+  static VkShaderStageFlags stage_of(uint32_t executionModel)
+  {
+    switch (executionModel) {
+      case 0:
+        return VK_SHADER_STAGE_VERTEX_BIT;
+      case 1:
+        return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+      case 2:
+        return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+      case 3:
+        return VK_SHADER_STAGE_GEOMETRY_BIT;
+      case 4:
+        return VK_SHADER_STAGE_FRAGMENT_BIT;
+      case 5:
+        return VK_SHADER_STAGE_COMPUTE_BIT;
+      default:
+        return 0;
+    }
+  }
+
+  std::vector<uint32_t> words;
+  std::vector<SpvId>    ids;
+  VkShaderStageFlags    stageFlags = 0;
+};
+
+/**
+ * @brief Descriptor type of the (array stripped) type a resource variable points at
+ */
+VkDescriptorType descriptor_type_of(const SpvModule& module, const SpvId& type, uint32_t storageClass)
+{
+  switch (type.opcode) {
+    case Spv::OpTypeStruct:
+      if (storageClass == Spv::StorageBuffer || type.bufferBlock) {
+        return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      }
+      return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    case Spv::OpTypeSampler:
+      return VK_DESCRIPTOR_TYPE_SAMPLER;
+    case Spv::OpTypeSampledImage:
+      if (module.id(type.words[2]).words[3] == Spv::DimBuffer) {
+        return VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+      }
+      return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    case Spv::OpTypeImage: {
+      uint32_t dim     = type.words[3];
+      bool     sampled = type.words[7] == 1;
+      if (dim == Spv::DimSubpassData) {
+        return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+      }
+      if (dim == Spv::DimBuffer) {
+        return sampled ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
+      }
+      return sampled ? VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    }
+    default:
+      throw std::runtime_error("Unsupported SPIR-V resource type!");
+  }
+}
+
+}  // namespace
+
+/**
+ * @brief
+ *
+ * @param code SPIR-V words as read by Utility::read_file
+ */
+ShaderReflection::ShaderReflection(const std::vector<char>& code)
+{
+  reflect(code);
+}
+
+/**
+ * @brief Add the interface of a module. Bindings shared between modules are merged,
+ * their stage flags combined.
+ *
+ * Vertex inputs only carry location and format, offsets and bindings are left at zero
+ * since they depend on the CPU side vertex layout.
+ *
+ * @param code
+ */
+void ShaderReflection::reflect(const std::vector<char>& code)
+{
+  SpvModule          module(code);
+  VkShaderStageFlags stage = module.stages();
+
+  ShaderReflection reflected;
+  reflected.stageFlags = stage;
+
+  for (const auto& variable : module.all()) {
+    if (variable.opcode != Spv::OpVariable) {
+      continue;
+    }
+
+    uint32_t    storageClass = variable.words[3];
+    const auto& pointer      = module.id(variable.words[1]);
+    uint32_t    typeIndex    = pointer.words[3];
+
+    switch (storageClass) {
+      case Spv::UniformConstant:
+      case Spv::Uniform:
+      case Spv::StorageBuffer: {
+        if (!variable.hasBinding) {
+          break;
+        }
+
+        uint32_t count = 1;
+        while (module.id(typeIndex).opcode == Spv::OpTypeArray ||
+               module.id(typeIndex).opcode == Spv::OpTypeRuntimeArray) {
+          const auto& array = module.id(typeIndex);
+          // Runtime arrays are sized when the layout is created, report them as empty.
+          count     = array.opcode == Spv::OpTypeArray ? count * module.constant(array.words[3]) : 0;
+          typeIndex = array.words[2];
+        }
+
+        VkDescriptorSetLayoutBinding binding = {};
+        binding.binding                      = variable.binding;
+        binding.descriptorType               = descriptor_type_of(module, module.id(typeIndex), storageClass);
+        binding.descriptorCount              = count;
+        binding.stageFlags                   = stage;
+        binding.pImmutableSamplers           = nullptr;
+
+        reflected.sets[variable.set][variable.binding] = binding;
+        break;
+      }
+      case Spv::PushConstant: {
+        const auto& block = module.id(typeIndex);
+        if (block.memberOffsets.empty()) {
+          break;
+        }
+
+        uint32_t offset = *std::min_element(block.memberOffsets.begin(), block.memberOffsets.end());
+
+        VkPushConstantRange range = {};
+        range.stageFlags          = stage;
+        range.offset              = offset;
+        range.size                = module.size_of(typeIndex) - offset;
+        reflected.pushConstants.push_back(range);
+        break;
+      }
+      case Spv::Input: {
+        if (stage != VK_SHADER_STAGE_VERTEX_BIT || variable.builtIn || !variable.hasLocation) {
+          break;
+        }
+
+        // Matrices take one location per column.
+        const auto& type     = module.id(typeIndex);
+        uint32_t    columns  = type.opcode == Spv::OpTypeMatrix ? type.words[3] : 1;
+        uint32_t    vecIndex = type.opcode == Spv::OpTypeMatrix ? type.words[2] : typeIndex;
+
+        for (uint32_t column = 0; column < columns; column++) {
+          VkVertexInputAttributeDescription attribute = {};
+          attribute.location                          = variable.location + column;
+          attribute.binding                           = 0;
+          attribute.format                            = module.format_of(vecIndex);
+          attribute.offset                            = 0;
+          reflected.inputs.push_back(attribute);
+        }
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  std::sort(reflected.inputs.begin(),
+            reflected.inputs.end(),
+            [](const VkVertexInputAttributeDescription& a, const VkVertexInputAttributeDescription& b) {
+              return a.location < b.location;
+            });
+
+  merge(reflected);
+}
+
+/**
+ * @brief Combine the interface of another stage in to this one
+ *
+ * @param other
+ */
+void ShaderReflection::merge(const ShaderReflection& other)
+{
+  stageFlags |= other.stageFlags;
+
+  for (const auto& [set, bindings] : other.sets) {
+    for (const auto& [index, binding] : bindings) {
+      auto& bindingMap = sets[set];
+      auto  existing   = bindingMap.find(index);
+      if (existing == bindingMap.end()) {
+        bindingMap[index] = binding;
+        continue;
+      }
+      if (existing->second.descriptorType != binding.descriptorType) {
+        throw std::runtime_error("Shader stages disagree on a descriptor binding type!");
+      }
+      existing->second.stageFlags |= binding.stageFlags;
+      existing->second.descriptorCount = std::max(existing->second.descriptorCount, binding.descriptorCount);
+    }
+  }
+
+  for (const auto& range : other.pushConstants) {
+    auto existing = std::find_if(pushConstants.begin(), pushConstants.end(), [&range](const VkPushConstantRange& r) {
+      return r.offset == range.offset && r.size == range.size;
+    });
+    if (existing != pushConstants.end()) {
+      existing->stageFlags |= range.stageFlags;
+    } else {
+      pushConstants.push_back(range);
+    }
+  }
+
+  if (!other.inputs.empty()) {
+    inputs = other.inputs;
+  }
+}
+
+/**
+ * @brief
+ * @return the descriptor set numbers used by the shaders, in ascending order
+ */
+std::vector<uint32_t> ShaderReflection::set_indices() const
+{
+  std::vector<uint32_t> indices;
+  for (const auto& set : sets) {
+    indices.push_back(set.first);
+  }
+  return indices;
+}
+
+/**
+ * @brief Bindings of a descriptor set ordered by binding number, empty when the set is unused
+ *
+ * @param set
+ * @return std::vector<VkDescriptorSetLayoutBinding>
+ */
+std::vector<VkDescriptorSetLayoutBinding> ShaderReflection::set_bindings(uint32_t set) const
+{
+  std::vector<VkDescriptorSetLayoutBinding> bindings;
+
+  auto found = sets.find(set);
+  if (found != sets.end()) {
+    for (const auto& binding : found->second) {
+      bindings.push_back(binding.second);
+    }
+  }
+  return bindings;
+}
+
+/**
+ * @brief
+ * @return std::vector<VkPushConstantRange>
+ */
+std::vector<VkPushConstantRange> ShaderReflection::push_constant_ranges() const
+{
+  return pushConstants;
+}
+
+/**
+ * @brief Stage flags vkCmdPushConstants needs to update a byte range, every range that
+ * overlaps it contributes its stages
+ *
+ * @param offset
+ * @param size
+ * @return 0 when no stage declares those bytes
+ */
+VkShaderStageFlags ShaderReflection::push_constant_stages(uint32_t offset, uint32_t size) const
+{
+  VkShaderStageFlags stages = 0;
+  for (const auto& range : pushConstants) {
+    if (range.offset < offset + size && offset < range.offset + range.size) {
+      stages |= range.stageFlags;
+    }
+  }
+  return stages;
+}
+
+/**
+ * @brief Pool sizes needed to allocate setCount copies of every descriptor set
+ *
+ * @param setCount
+ * @return std::vector<VkDescriptorPoolSize>
+ */
+std::vector<VkDescriptorPoolSize> ShaderReflection::pool_sizes(uint32_t setCount) const
+{
+  std::map<VkDescriptorType, uint32_t> counts;
+  for (const auto& set : sets) {
+    for (const auto& binding : set.second) {
+      counts[binding.second.descriptorType] += binding.second.descriptorCount * setCount;
+    }
+  }
+
+  std::vector<VkDescriptorPoolSize> poolSizes;
+  for (const auto& [type, count] : counts) {
+    if (count == 0) {
+      continue;
+    }
+    VkDescriptorPoolSize poolSize = {};
+    poolSize.type                 = type;
+    poolSize.descriptorCount      = count;
+    poolSizes.push_back(poolSize);
+  }
+  return poolSizes;
+}
+
+/**
+ * @brief Check that a CPU side vertex layout provides every input the vertex shader reads
+ *
+ * @param attributes
+ * @param count
+ * @return true when every reflected location is present with the same format
+ */
+bool ShaderReflection::vertex_inputs_match(const VkVertexInputAttributeDescription* attributes, size_t count) const
+{
+  for (const auto& input : inputs) {
+    auto found = std::find_if(attributes, attributes + count, [&input](const VkVertexInputAttributeDescription& a) {
+      return a.location == input.location;
+    });
+    if (found == attributes + count || found->format != input.format) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}}  // namespace Rake::Graphics
@@ -0,0 +1,52 @@
+#if !defined(VULKANREFLECTION_H)
+#define VULKANREFLECTION_H
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#define VK_NO_PROTOTYPES
+#define VK_USE_PLATFORM_XCB_KHR
+#include <vulkan/vulkan.h>
+
+namespace Rake { namespace Graphics {
+
+/**
+ * @brief Interface of one or more SPIR-V modules: descriptor bindings grouped by set,
+ * push constant ranges and the vertex stage input locations
+ *
+ * Only the subset of SPIR-V emitted by glslc for this project is understood, unknown
+ * instructions are skipped.
+ */
+class ShaderReflection {
+  public:
+  ShaderReflection() = default;
+  explicit ShaderReflection(const std::vector<char>& code);
+
+  void reflect(const std::vector<char>& code);
+  void merge(const ShaderReflection& other);
+
+  VkShaderStageFlags stages() const { return stageFlags; }
+
+  std::vector<uint32_t>                     set_indices() const;
+  std::vector<VkDescriptorSetLayoutBinding> set_bindings(uint32_t set) const;
+  std::vector<VkPushConstantRange>          push_constant_ranges() const;
+  VkShaderStageFlags                        push_constant_stages(uint32_t offset, uint32_t size) const;
+  std::vector<VkDescriptorPoolSize>         pool_sizes(uint32_t setCount) const;
+
+  const std::vector<VkVertexInputAttributeDescription>& vertex_inputs() const { return inputs; }
+
+  bool vertex_inputs_match(const VkVertexInputAttributeDescription* attributes, size_t count) const;
+
+  private:
+  using BindingMap = std::map<uint32_t, VkDescriptorSetLayoutBinding>;
+
+  VkShaderStageFlags                             stageFlags = 0;
+  std::map<uint32_t, BindingMap>                 sets;
+  std::vector<VkPushConstantRange>               pushConstants;
+  std::vector<VkVertexInputAttributeDescription> inputs;
+};
+
+}}  // namespace Rake::Graphics
+
+#endif  // VULKANREFLECTION_H
@@ -0,0 +1,736 @@
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+
+#include "VulkanFunctions.h"
+#include "VulkanRenderGraph.h"
+
+namespace Rake { namespace Graphics {
+
+namespace {
+/**
+ * @brief Layout, stages and access masks one use of an image needs
+ */
+struct UseInfo {
+  VkImageLayout        layout;
+  VkPipelineStageFlags stages;
+  VkAccessFlags        readAccess;
+  VkAccessFlags        writeAccess;
+};
+
+UseInfo use_info(ImageUse use, PassType type, VkImageAspectFlags aspect)
+{
+  const VkPipelineStageFlags shaderStages = type == PassType::Compute ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+                                                                      : VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                                                            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  const VkPipelineStageFlags depthStages =
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+  switch (use) {
+    case ImageUse::ColorAttachment:
+      return {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+              VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+              VK_ACCESS_COLOR_ATTACHMENT_READ_BIT,
+              VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT};
+    case ImageUse::DepthAttachment:
+      return {VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+              depthStages,
+              VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+              VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT};
+    case ImageUse::DepthReadOnly:
+      return {
+          VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, 0};
+    case ImageUse::Resolve:
+      return {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+              VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+              0,
+              VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT};
+    case ImageUse::Sampled:
+      return {(aspect & VK_IMAGE_ASPECT_DEPTH_BIT) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                                                   : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+              shaderStages,
+              VK_ACCESS_SHADER_READ_BIT,
+              0};
+    case ImageUse::Storage:
+      return {VK_IMAGE_LAYOUT_GENERAL, shaderStages, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT};
+    case ImageUse::TransferSource:
+      return {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, 0};
+    case ImageUse::TransferDestination:
+      return {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_ACCESS_TRANSFER_WRITE_BIT};
+  }
+  throw std::runtime_error("Unknown render graph image use!");
+}
+
+bool is_attachment(ImageUse use)
+{
+  return use == ImageUse::ColorAttachment || use == ImageUse::DepthAttachment || use == ImageUse::DepthReadOnly ||
+         use == ImageUse::Resolve;
+}
+
+bool is_transfer(ImageUse use)
+{
+  return use == ImageUse::TransferSource || use == ImageUse::TransferDestination;
+}
+
+/**
+ * @brief Where an image stands after the passes scheduled so far
+ */
+struct ImageState {
+  VkImageLayout        layout        = VK_IMAGE_LAYOUT_UNDEFINED;
+  VkPipelineStageFlags writeStages   = 0;  // Of the last write, zero before the first one
+  VkAccessFlags        writeAccess   = 0;
+  VkPipelineStageFlags readStages    = 0;  // Reads since the last write
+  VkPipelineStageFlags visibleStages = 0;  // Stages the last write has been made visible to
+};
+}  // namespace
+
+/**
+ * @brief
+ *
+ * @param resource any version of an image, the pass must not have produced it
+ * @param use
+ * @return this builder
+ */
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::read(ResourceId resource, ImageUse use)
+{
+  if (resource >= graph.versions.size()) {
+    throw std::runtime_error("Render graph read of an unknown resource!");
+  }
+  const Version& version = graph.versions[resource];
+  const Image&   image   = graph.images[version.image];
+  const Pass&    owner   = graph.passes[pass];
+
+  if (use == ImageUse::Resolve || use == ImageUse::TransferDestination) {
+    throw std::runtime_error("Render graph pass " + owner.name + " reads " + image.info.name + " through a write use!");
+  }
+  if (version.producer == pass) {
+    throw std::runtime_error("Render graph pass " + owner.name + " reads its own output " + image.info.name + "!");
+  }
+  if (version.producer == noPass && !(image.info.imported && image.info.initialLayout != VK_IMAGE_LAYOUT_UNDEFINED)) {
+    throw std::runtime_error("Render graph pass " + owner.name + " reads " + image.info.name +
+                             " before anything wrote it!");
+  }
+
+  Access& access = graph.access_of(pass, version.image, use);
+  if (access.write && access.before != resource) {
+    throw std::runtime_error("Render graph pass " + owner.name + " reads and writes different versions of " +
+                             image.info.name + "!");
+  }
+  access.read   = true;
+  access.before = resource;
+  if (!access.write) {
+    access.after = resource;
+  }
+
+  auto& readers = graph.versions[resource].readers;
+  if (std::find(readers.begin(), readers.end(), pass) == readers.end()) {
+    readers.push_back(pass);
+  }
+  graph.compiled = false;
+  return *this;
+}
+
+/**
+ * @brief
+ *
+ * @param resource latest version of an image
+ * @param use
+ * @param clear clear an attachment the pass does not read instead of discarding it
+ * @return the version the pass leaves behind
+ */
+ResourceId RenderGraph::PassBuilder::write(ResourceId resource, ImageUse use, bool clear)
+{
+  if (resource >= graph.versions.size()) {
+    throw std::runtime_error("Render graph write of an unknown resource!");
+  }
+  uint32_t    imageIndex = graph.versions[resource].image;
+  Image&      image      = graph.images[imageIndex];
+  const Pass& owner      = graph.passes[pass];
+
+  if (use == ImageUse::DepthReadOnly || use == ImageUse::Sampled || use == ImageUse::TransferSource) {
+    throw std::runtime_error("Render graph pass " + owner.name + " writes " + image.info.name + " through a read use!");
+  }
+  if (image.latest != resource) {
+    throw std::runtime_error("Render graph pass " + owner.name + " writes an outdated version of " + image.info.name +
+                             "!");
+  }
+
+  Access& access = graph.access_of(pass, imageIndex, use);
+  if (access.write) {
+    throw std::runtime_error("Render graph pass " + owner.name + " writes " + image.info.name + " twice!");
+  }
+  if (access.read && access.before != resource) {
+    throw std::runtime_error("Render graph pass " + owner.name + " reads and writes different versions of " +
+                             image.info.name + "!");
+  }
+
+  ResourceId written = static_cast<ResourceId>(graph.versions.size());
+  graph.versions.push_back({imageIndex, pass, {}});
+  image.latest = written;
+
+  access.write  = true;
+  access.clear  = clear;
+  access.before = resource;
+  access.after  = written;
+
+  graph.compiled = false;
+  return written;
+}
+
+/**
+ * @brief Keep the pass even when no other pass reads what it writes
+ * @return this builder
+ */
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::side_effects()
+{
+  graph.passes[pass].sideEffects = true;
+  graph.compiled                 = false;
+  return *this;
+}
+
+/**
+ * @brief
+ * @param info
+ * @return the image's first version, a transient image has no contents until a pass writes it
+ */
+ResourceId RenderGraph::add_image(const ImageInfo& info)
+{
+  ResourceId resource = static_cast<ResourceId>(versions.size());
+  versions.push_back({static_cast<uint32_t>(images.size()), noPass, {}});
+  images.push_back({info, resource, resource});
+  compiled = false;
+  return resource;
+}
+
+/**
+ * @brief Memory requirements of a transient image, for images created after the graph
+ * was first compiled. compile() again to alias it.
+ *
+ * @param resource any version of the image
+ * @param memory
+ */
+void RenderGraph::set_memory(ResourceId resource, const VkMemoryRequirements& memory)
+{
+  Image& image = images[versions.at(resource).image];
+  if (image.info.imported) {
+    throw std::runtime_error("Render graph image " + image.info.name + " is imported, its memory is not the graph's!");
+  }
+  image.info.memory = memory;
+  compiled          = false;
+}
+
+/**
+ * @brief
+ *
+ * @param name used in errors
+ * @param type only graphics passes use attachments, only graphics and compute passes
+ * sample and store, and transfer passes wait for nothing but the transfer stage
+ * @return builder declaring what the pass reads and writes
+ */
+RenderGraph::PassBuilder RenderGraph::add_pass(const std::string& name, PassType type)
+{
+  PassId pass = static_cast<PassId>(passes.size());
+  passes.push_back({name, type, false, false, {}});
+  compiled = false;
+  return PassBuilder(*this, pass);
+}
+
+/**
+ * @brief The access of a pass to an image, a pass uses each image one way
+ */
+RenderGraph::Access& RenderGraph::access_of(PassId pass, uint32_t image, ImageUse use)
+{
+  Pass& owner = passes[pass];
+  if (is_attachment(use) && owner.type != PassType::Graphics) {
+    throw std::runtime_error("Render graph pass " + owner.name + " uses an attachment outside a graphics pass!");
+  }
+  if (!is_transfer(use) && !is_attachment(use) && owner.type == PassType::Transfer) {
+    throw std::runtime_error("Render graph pass " + owner.name + " uses " + images[image].info.name +
+                             " from a shader in a transfer pass!");
+  }
+  for (auto& access : owner.accesses) {
+    if (access.image == image) {
+      if (access.use != use) {
+        throw std::runtime_error("Render graph pass " + owner.name + " uses " + images[image].info.name +
+                                 " in two ways!");
+      }
+      return access;
+    }
+  }
+  owner.accesses.push_back({image, use, false, false, false, 0, 0, {}});
+  return owner.accesses.back();
+}
+
+/**
+ * @brief Cull, order, alias memory and place barriers. Throws on dependency cycles.
+ */
+void RenderGraph::compile()
+{
+  schedule.clear();
+  steps.clear();
+  blocks.clear();
+  for (auto& image : images) {
+    image.block = ~0u;
+  }
+
+  cull();
+  sort();
+
+  std::vector<uint32_t> firstStep(images.size(), ~0u);
+  std::vector<uint32_t> lastStep(images.size(), ~0u);
+  for (uint32_t step = 0; step < schedule.size(); step++) {
+    for (const auto& access : passes[schedule[step]].accesses) {
+      firstStep[access.image] = std::min(firstStep[access.image], step);
+      lastStep[access.image]  = step;
+    }
+  }
+  alias_memory(firstStep, lastStep);
+  place_barriers();
+  compiled = true;
+}
+
+/**
+ * @brief Keep the passes that produce the final contents of imported images, have side
+ * effects, or produce something a kept pass reads
+ */
+void RenderGraph::cull()
+{
+  std::vector<PassId> pending;
+  for (PassId pass = 0; pass < passes.size(); pass++) {
+    passes[pass].alive = passes[pass].sideEffects;
+    if (passes[pass].sideEffects) {
+      pending.push_back(pass);
+    }
+  }
+  for (const auto& image : images) {
+    PassId producer = versions[image.latest].producer;
+    if (image.info.imported && producer != noPass && !passes[producer].alive) {
+      passes[producer].alive = true;
+      pending.push_back(producer);
+    }
+  }
+
+  while (!pending.empty()) {
+    PassId pass = pending.back();
+    pending.pop_back();
+    for (const auto& access : passes[pass].accesses) {
+      PassId producer = versions[access.before].producer;
+      if (access.read && producer != noPass && !passes[producer].alive) {
+        passes[producer].alive = true;
+        pending.push_back(producer);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Topological order of the kept passes. A pass follows the producer of every
+ * version it reads or overwrites, and every reader of a version it overwrites. Ties go
+ * to the pass declared first.
+ */
+void RenderGraph::sort()
+{
+  std::vector<std::vector<PassId>> successors(passes.size());
+  std::vector<uint32_t>            predecessors(passes.size(), 0);
+
+  auto add_edge = [&](PassId from, PassId to) {
+    if (from != noPass && from != to && passes[from].alive) {
+      successors[from].push_back(to);
+      predecessors[to]++;
+    }
+  };
+
+  uint32_t aliveCount = 0;
+  for (PassId pass = 0; pass < passes.size(); pass++) {
+    if (!passes[pass].alive) {
+      continue;
+    }
+    aliveCount++;
+    for (const auto& access : passes[pass].accesses) {
+      add_edge(versions[access.before].producer, pass);
+      if (access.write) {
+        for (PassId reader : versions[access.before].readers) {
+          add_edge(reader, pass);
+        }
+      }
+    }
+  }
+
+  std::priority_queue<PassId, std::vector<PassId>, std::greater<PassId>> ready;
+  for (PassId pass = 0; pass < passes.size(); pass++) {
+    if (passes[pass].alive && predecessors[pass] == 0) {
+      ready.push(pass);
+    }
+  }
+  while (!ready.empty()) {
+    PassId pass = ready.top();
+    ready.pop();
+    schedule.push_back(pass);
+    for (PassId next : successors[pass]) {
+      if (--predecessors[next] == 0) {
+        ready.push(next);
+      }
+    }
+  }
+
+  if (schedule.size() != aliveCount) {
+    throw std::runtime_error("Render graph has a dependency cycle!");
+  }
+}
+
+/**
+ * @brief Share memory between transient images whose lifetimes, the steps from their
+ * first to their last use, do not overlap. Largest images are placed first, each in the
+ * first block whose memory types and occupants allow it.
+ */
+void RenderGraph::alias_memory(std::vector<uint32_t>& firstStep, std::vector<uint32_t>& lastStep)
+{
+  std::vector<uint32_t> candidates;
+  for (uint32_t image = 0; image < images.size(); image++) {
+    if (!images[image].info.imported && images[image].info.memory.size > 0 && firstStep[image] != ~0u) {
+      candidates.push_back(image);
+    }
+  }
+  std::stable_sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) {
+    return images[a].info.memory.size > images[b].info.memory.size;
+  });
+
+  for (uint32_t image : candidates) {
+    const VkMemoryRequirements& memory = images[image].info.memory;
+
+    uint32_t block = 0;
+    for (; block < blocks.size(); block++) {
+      if ((blocks[block].memoryTypeBits & memory.memoryTypeBits) == 0) {
+        continue;
+      }
+      bool overlaps = false;
+      for (ResourceId other : blocks[block].images) {
+        uint32_t otherImage = versions[other].image;
+        overlaps = overlaps || !(lastStep[otherImage] < firstStep[image] || lastStep[image] < firstStep[otherImage]);
+      }
+      if (!overlaps) {
+        break;
+      }
+    }
+    if (block == blocks.size()) {
+      blocks.emplace_back();
+    }
+
+    blocks[block].size           = std::max(blocks[block].size, memory.size);
+    blocks[block].alignment      = std::max(blocks[block].alignment, memory.alignment);
+    blocks[block].memoryTypeBits = blocks[block].memoryTypeBits & memory.memoryTypeBits;
+    blocks[block].images.push_back(images[image].first);
+    images[image].block = block;
+  }
+
+  for (auto& block : blocks) {
+    std::sort(block.images.begin(), block.images.end(), [&](ResourceId a, ResourceId b) {
+      return firstStep[versions[a].image] < firstStep[versions[b].image];
+    });
+  }
+}
+
+/**
+ * @brief Walk the schedule tracking each image's layout and pending accesses, and give
+ * every pass one barrier batch covering all of its hazards. Also fills in the attachment
+ * ops, an attachment is loaded when the pass reads it and stored when a later pass or
+ * the owner of an imported image does.
+ */
+void RenderGraph::place_barriers()
+{
+  std::vector<uint32_t> position(passes.size(), ~0u);
+  for (uint32_t step = 0; step < schedule.size(); step++) {
+    position[schedule[step]] = step;
+  }
+
+  std::vector<uint32_t> lastStep(images.size(), ~0u);
+  for (uint32_t step = 0; step < schedule.size(); step++) {
+    for (const auto& access : passes[schedule[step]].accesses) {
+      lastStep[access.image] = step;
+    }
+  }
+
+  std::vector<ImageState> states(images.size());
+  std::vector<bool>       touched(images.size(), false);
+  for (uint32_t image = 0; image < images.size(); image++) {
+    if (images[image].info.imported) {
+      // Waiting on the stages that acquire the image chains the first barrier to the wait.
+      states[image].layout      = images[image].info.initialLayout;
+      states[image].writeStages = images[image].info.initialStages;
+    }
+  }
+
+  for (uint32_t stepIndex = 0; stepIndex < schedule.size(); stepIndex++) {
+    Pass& pass = passes[schedule[stepIndex]];
+    Step  step;
+    step.pass = schedule[stepIndex];
+
+    for (auto& access : pass.accesses) {
+      const Image& image = images[access.image];
+      ImageState&  state = states[access.image];
+
+      // An aliased image starts where the previous occupant of its memory left off.
+      if (!touched[access.image] && image.block != ~0u) {
+        const auto& occupants = blocks[image.block].images;
+        auto        self      = std::find_if(occupants.begin(), occupants.end(), [&](ResourceId resource) {
+          return versions[resource].image == access.image;
+        });
+        if (self != occupants.begin()) {
+          const ImageState& previous = states[versions[*(self - 1)].image];
+          state.writeStages          = previous.writeStages;
+          state.writeAccess          = previous.writeAccess;
+          state.readStages           = previous.readStages;
+        }
+      }
+      touched[access.image] = true;
+
+      UseInfo       info       = use_info(access.use, pass.type, image.info.aspect);
+      bool          attachment = is_attachment(access.use);
+      VkAccessFlags reads      = access.read || access.use == ImageUse::DepthAttachment ? info.readAccess : 0;
+      VkAccessFlags writes     = access.write ? info.writeAccess : 0;
+
+      VkPipelineStageFlags srcStages = 0;
+      VkAccessFlags        srcAccess = 0;
+      bool                 hazard    = false;
+      if (state.writeStages != 0 && (writes != 0 || (info.stages & ~state.visibleStages) != 0)) {
+        srcStages |= state.writeStages;  // Read or write after write
+        srcAccess |= state.writeAccess;
+        hazard = true;
+      }
+      if (writes != 0 && state.readStages != 0) {
+        srcStages |= state.readStages;  // Write after read, execution only
+        hazard = true;
+      }
+
+      // Render passes change the layout of their attachments themselves, unless a barrier
+      // is needed anyway.
+      bool transition = state.layout != info.layout && (!attachment || hazard);
+      if (transition) {
+        srcStages |= state.readStages;
+      }
+
+      if (hazard || transition) {
+        if (srcStages == 0) {
+          srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;  // Nothing to wait for but the layout change
+        }
+        VkImageLayout current = access.read ? state.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+        step.barriers.push_back({access.image,
+                                 transition ? current : state.layout,
+                                 transition ? info.layout : state.layout,
+                                 srcAccess,
+                                 reads | writes});
+        step.srcStages |= srcStages;
+        step.dstStages |= info.stages;
+        if (transition) {
+          state.layout = info.layout;
+        }
+        state.visibleStages |= info.stages;
+      }
+
+      if (attachment) {
+        ResourceId result     = access.after;
+        bool       storedLate = image.info.imported && image.latest == result;
+        for (PassId reader : versions[result].readers) {
+          storedLate = storedLate || (passes[reader].alive && position[reader] > stepIndex);
+        }
+
+        access.ops.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        if (access.read) {
+          access.ops.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        } else if (access.clear) {
+          access.ops.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        }
+        access.ops.storeOp       = storedLate ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        access.ops.initialLayout = access.read ? state.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+        access.ops.finalLayout   = info.layout;
+        if (image.info.imported && lastStep[access.image] == stepIndex &&
+            image.info.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED) {
+          access.ops.finalLayout = image.info.finalLayout;
+        }
+        state.layout = access.ops.finalLayout;
+      }
+
+      if (access.write) {
+        state.writeStages   = info.stages;
+        state.writeAccess   = info.writeAccess;
+        state.readStages    = 0;
+        state.visibleStages = 0;
+      } else {
+        state.readStages |= info.stages;
+      }
+    }
+    steps.push_back(std::move(step));
+  }
+
+  Step last;
+  for (uint32_t image = 0; image < images.size(); image++) {
+    const ImageInfo& info = images[image].info;
+    if (info.imported && touched[image] && info.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED &&
+        states[image].layout != info.finalLayout) {
+      last.barriers.push_back({image, states[image].layout, info.finalLayout, states[image].writeAccess, 0});
+      last.srcStages |= states[image].writeStages | states[image].readStages;
+      last.dstStages |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    }
+  }
+  if (!last.barriers.empty()) {
+    if (last.srcStages == 0) {
+      last.srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    }
+    steps.push_back(std::move(last));
+  }
+}
+
+/**
+ * @brief Image behind a resource for execute(), every version of an image shares it
+ */
+void RenderGraph::bind(ResourceId resource, VkImage image)
+{
+  images[versions.at(resource).image].handle = image;
+}
+
+/**
+ * @brief Record each pass in order, preceded by its barrier batch
+ *
+ * @param commandBuffer
+ * @param recordPass records the commands of one pass, graphics passes begin and end their render pass
+ */
+void RenderGraph::execute(VkCommandBuffer commandBuffer, const std::function<void(PassId)>& recordPass) const
+{
+  if (!compiled) {
+    throw std::runtime_error("Render graph executed before it was compiled!");
+  }
+
+  std::vector<VkImageMemoryBarrier> barriers;
+  for (const auto& step : steps) {
+    if (!step.barriers.empty()) {
+      barriers.clear();
+      for (const auto& barrier : step.barriers) {
+        const Image& image = images[barrier.image];
+        if (image.handle == VK_NULL_HANDLE) {
+          throw std::runtime_error("Render graph image " + image.info.name + " is not bound!");
+        }
+
+        VkImageMemoryBarrier imageBarrier = {};
+        imageBarrier.sType                = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageBarrier.srcAccessMask        = barrier.srcAccess;
+        imageBarrier.dstAccessMask        = barrier.dstAccess;
+        imageBarrier.oldLayout            = barrier.oldLayout;
+        imageBarrier.newLayout            = barrier.newLayout;
+        imageBarrier.srcQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.image                = image.handle;
+        imageBarrier.subresourceRange     = {image.info.aspect, 0, image.info.mipLevels, 0, 1};
+        barriers.push_back(imageBarrier);
+      }
+      vkCmdPipelineBarrier(commandBuffer,
+                           step.srcStages,
+                           step.dstStages,
+                           0,
+                           0,
+                           nullptr,
+                           0,
+                           nullptr,
+                           static_cast<uint32_t>(barriers.size()),
+                           barriers.data());
+    }
+    if (step.pass != noPass) {
+      recordPass(step.pass);
+    }
+  }
+}
+
+/**
+ * @brief
+ * @param pass
+ * @return whether compile() dropped the pass
+ */
+bool RenderGraph::culled(PassId pass) const
+{
+  return !passes.at(pass).alive;
+}
+
+/**
+ * @brief Ops and layouts for the render pass of a graphics pass
+ *
+ * @param pass
+ * @param resource any version of an image the pass uses as an attachment
+ * @return
+ */
+AttachmentOps RenderGraph::attachment(PassId pass, ResourceId resource) const
+{
+  if (!compiled) {
+    throw std::runtime_error("Render graph queried before it was compiled!");
+  }
+  uint32_t image = versions.at(resource).image;
+  for (const auto& access : passes.at(pass).accesses) {
+    if (access.image == image && is_attachment(access.use)) {
+      return access.ops;
+    }
+  }
+  throw std::runtime_error("Render graph pass " + passes[pass].name + " has no attachment " + images[image].info.name +
+                           "!");
+}
+
+/**
+ * @brief Whether the contents of an image never leave the render passes that use it:
+ * only attachments touch it, none loads or stores it. Tiled GPUs keep such an image in
+ * tile memory, so it can be transient and lazily allocated.
+ *
+ * @param resource any version of the image
+ * @return
+ */
+bool RenderGraph::memoryless(ResourceId resource) const
+{
+  if (!compiled) {
+    throw std::runtime_error("Render graph queried before it was compiled!");
+  }
+  uint32_t image = versions.at(resource).image;
+  if (images[image].info.imported) {
+    return false;
+  }
+  for (PassId pass : schedule) {
+    for (const auto& access : passes[pass].accesses) {
+      if (access.image == image && (!is_attachment(access.use) || access.ops.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD ||
+                                    access.ops.storeOp == VK_ATTACHMENT_STORE_OP_STORE)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief
+ * @return image barriers recorded per frame
+ */
+uint32_t RenderGraph::barrier_count() const
+{
+  uint32_t count = 0;
+  for (const auto& step : steps) {
+    count += static_cast<uint32_t>(step.barriers.size());
+  }
+  return count;
+}
+
+/**
+ * @brief
+ * @return vkCmdPipelineBarrier calls per frame
+ */
+uint32_t RenderGraph::barrier_batches() const
+{
+  return static_cast<uint32_t>(
+      std::count_if(steps.begin(), steps.end(), [](const Step& step) { return !step.barriers.empty(); }));
+}
+
+/**
+ * @brief
+ * @param resource
+ * @return index into memory_blocks(), ~0u when the image does not alias
+ */
+uint32_t RenderGraph::memory_block(ResourceId resource) const
+{
+  return images[versions.at(resource).image].block;
+}
+
+}}  // namespace Rake::Graphics
@@ -0,0 +1,191 @@
+#if !defined(VULKANRENDERGRAPH_H)
+#define VULKANRENDERGRAPH_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#define VK_NO_PROTOTYPES
+#define VK_USE_PLATFORM_XCB_KHR
+#include <vulkan/vulkan.h>
+
+namespace Rake { namespace Graphics {
+
+using PassId     = uint32_t;
+using ResourceId = uint32_t;  // One version of an image, every write makes a new one
+
+/**
+ * @brief How a pass touches an image, decides the layout, stages and access of the use
+ */
+enum class ImageUse {
+  ColorAttachment,
+  DepthAttachment,  // Depth tested and written
+  DepthReadOnly,    // Depth tested only
+  Resolve,          // Multisample resolve target
+  Sampled,
+  Storage,
+  TransferSource,
+  TransferDestination,
+};
+
+/**
+ * @brief Where a pass does its work, decides the stages of its shader and transfer uses
+ */
+enum class PassType {
+  Graphics,  // Render pass, shaders read in the vertex and fragment stages
+  Compute,
+  Transfer,  // Copies, blits and clears only
+};
+
+/**
+ * @brief An image of the graph. Transient images live within one frame, imported ones
+ * are owned elsewhere and keep their contents across frames.
+ */
+struct ImageInfo {
+  std::string          name;
+  VkImageAspectFlags   aspect        = VK_IMAGE_ASPECT_COLOR_BIT;
+  uint32_t             mipLevels     = 1;
+  bool                 imported      = false;
+  VkImageLayout        initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;  // Of an imported image when the frame starts
+  VkPipelineStageFlags initialStages = 0;  // Of an imported image, the semaphore wait stages it is acquired at
+  VkImageLayout        finalLayout   = VK_IMAGE_LAYOUT_UNDEFINED;  // Of an imported image when the frame ends
+  VkMemoryRequirements memory        = {};  // Of a transient image, a zero size keeps it out of aliasing
+};
+
+/**
+ * @brief Load and store ops and layouts of one attachment of a render pass
+ */
+struct AttachmentOps {
+  VkAttachmentLoadOp  loadOp        = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  VkAttachmentStoreOp storeOp       = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  VkImageLayout       initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  VkImageLayout       finalLayout   = VK_IMAGE_LAYOUT_UNDEFINED;
+};
+
+/**
+ * @brief Memory shared by transient images whose lifetimes do not overlap
+ */
+struct MemoryBlock {
+  VkDeviceSize            size           = 0;
+  VkDeviceSize            alignment      = 1;
+  uint32_t                memoryTypeBits = ~0u;
+  std::vector<ResourceId> images;  // In the order they use the block
+};
+
+/**
+ * @brief Frame described as passes that read and write images. compile() drops passes
+ * whose results nobody uses, orders the rest by their dependencies, and works out one
+ * batched barrier per pass, the load and store ops of attachments, and which transient
+ * images can share memory. None of that touches the device, so it runs anywhere.
+ *
+ * Graphics passes begin their own render passes; the layout changes of their attachments
+ * happen there, with the layouts from attachment(), and barriers only cover the memory
+ * dependencies. Every other use gets its layout from a barrier.
+ *
+ * execute() records the barriers and calls back into the owner for each pass.
+ */
+class RenderGraph {
+  public:
+  static constexpr PassId noPass = ~0u;
+
+  class PassBuilder {
+    public:
+    PassBuilder& read(ResourceId resource, ImageUse use);
+    ResourceId   write(ResourceId resource, ImageUse use, bool clear = false);
+    PassBuilder& side_effects();  // Writes state outside the graph, never culled
+
+    PassId id() const { return pass; }
+
+    private:
+    friend class RenderGraph;
+    PassBuilder(RenderGraph& graph, PassId pass) : graph(graph), pass(pass) {}
+
+    RenderGraph& graph;
+    PassId       pass;
+  };
+
+  ResourceId  add_image(const ImageInfo& info);
+  void        set_memory(ResourceId resource, const VkMemoryRequirements& memory);
+  PassBuilder add_pass(const std::string& name, PassType type = PassType::Graphics);
+  void        compile();
+
+  void bind(ResourceId resource, VkImage image);
+  void execute(VkCommandBuffer commandBuffer, const std::function<void(PassId)>& recordPass) const;
+
+  const std::vector<PassId>&      order() const { return schedule; }
+  bool                            culled(PassId pass) const;
+  AttachmentOps                   attachment(PassId pass, ResourceId resource) const;
+  bool                            memoryless(ResourceId resource) const;
+  uint32_t                        barrier_count() const;
+  uint32_t                        barrier_batches() const;
+  const std::vector<MemoryBlock>& memory_blocks() const { return blocks; }
+  uint32_t                        memory_block(ResourceId resource) const;
+
+  private:
+  struct Access {
+    uint32_t      image;
+    ImageUse      use;
+    bool          read    = false;
+    bool          write   = false;
+    bool          clear   = false;
+    ResourceId    before  = 0;  // Version the pass finds
+    ResourceId    after   = 0;  // Version the pass leaves, before when it only reads
+    AttachmentOps ops;
+  };
+
+  struct Pass {
+    std::string         name;
+    PassType            type;
+    bool                sideEffects = false;
+    bool                alive       = false;
+    std::vector<Access> accesses;
+  };
+
+  struct Version {
+    uint32_t            image;
+    PassId              producer = noPass;
+    std::vector<PassId> readers;
+  };
+
+  struct Image {
+    ImageInfo  info;
+    ResourceId first;  // Version add_image() returned
+    ResourceId latest;
+    VkImage    handle = VK_NULL_HANDLE;
+    uint32_t   block  = ~0u;
+  };
+
+  struct Barrier {
+    uint32_t      image;
+    VkImageLayout oldLayout;
+    VkImageLayout newLayout;
+    VkAccessFlags srcAccess;
+    VkAccessFlags dstAccess;
+  };
+
+  struct Step {
+    PassId               pass      = noPass;  // noPass for the final layout changes of imported images
+    VkPipelineStageFlags srcStages = 0;
+    VkPipelineStageFlags dstStages = 0;
+    std::vector<Barrier> barriers;
+  };
+
+  Access& access_of(PassId pass, uint32_t image, ImageUse use);
+  void    cull();
+  void    sort();
+  void    alias_memory(std::vector<uint32_t>& firstStep, std::vector<uint32_t>& lastStep);
+  void    place_barriers();
+
+  std::vector<Pass>        passes;
+  std::vector<Version>     versions;
+  std::vector<Image>       images;
+  std::vector<PassId>      schedule;
+  std::vector<Step>        steps;
+  std::vector<MemoryBlock> blocks;
+  bool                     compiled = false;
+};
+
+}}  // namespace Rake::Graphics
+
+#endif  // VULKANRENDERGRAPH_H
@@ -0,0 +1,362 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "VulkanFunctions.h"
+#include "VulkanResidency.h"
+
+namespace Rake { namespace Graphics {
+
+/**
+ * @brief
+ *
+ * @param device
+ * @param commandPool of the queue's family, only used from the calling thread
+ * @param queue
+ * @param table to give each texture a slot in, or nullptr to bind views directly
+ * @param createImage device local, with transfer source and destination usage
+ * @param createBuffer
+ * @param framesInFlight that may still sample a texture after it moved
+ * @param budget bytes of level data to keep resident
+ */
+TexturePool::TexturePool(VkDevice              device,
+                         VkCommandPool         commandPool,
+                         VkQueue               queue,
+                         BindlessTextureTable* table,
+                         CreateImage           createImage,
+                         CreateBuffer          createBuffer,
+                         uint32_t              framesInFlight,
+                         uint64_t              budget)
+    : device(device)
+    , commandPool(commandPool)
+    , queue(queue)
+    , table(table)
+    , createImage(std::move(createImage))
+    , createBuffer(std::move(createBuffer))
+    , framesInFlight(framesInFlight)
+    , residency(budget)
+{
+  // Views only hold resident levels, so one sampler reaches all of them
+  VkSamplerCreateInfo samplerInfo     = {};
+  samplerInfo.sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter               = VK_FILTER_LINEAR;
+  samplerInfo.minFilter               = VK_FILTER_LINEAR;
+  samplerInfo.addressModeU            = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.addressModeV            = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.addressModeW            = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.anisotropyEnable        = VK_TRUE;
+  samplerInfo.maxAnisotropy           = 16;
+  samplerInfo.borderColor             = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+  samplerInfo.unnormalizedCoordinates = VK_FALSE;
+  samplerInfo.compareEnable           = VK_FALSE;
+  samplerInfo.compareOp               = VK_COMPARE_OP_ALWAYS;
+  samplerInfo.mipmapMode              = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  samplerInfo.mipLodBias              = 0.0f;
+  samplerInfo.minLod                  = 0.0f;
+  samplerInfo.maxLod                  = VK_LOD_CLAMP_NONE;
+  if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create texture pool sampler!");
+  }
+}
+
+/**
+ * @brief Waits for the moves in flight, the device must be done with every frame
+ */
+TexturePool::~TexturePool()
+{
+  for (auto& texture : textures) {
+    Transfer& transfer = texture.transfer;
+    if (transfer.fence != VK_NULL_HANDLE) {
+      vkWaitForFences(device, 1, &transfer.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+      vkFreeCommandBuffers(device, commandPool, 1, &transfer.commands);
+      vkDestroyFence(device, transfer.fence, nullptr);
+      vkDestroyBuffer(device, transfer.staging, nullptr);
+      vkFreeMemory(device, transfer.stagingMemory, nullptr);
+      release(transfer.target);
+    }
+    release(texture.current);
+  }
+  for (auto& allocation : retired) {
+    release(allocation.allocation);
+  }
+  vkDestroySampler(device, textureSampler, nullptr);
+}
+
+/**
+ * @brief Take a texture in to the pool, its tail is uploaded before this returns
+ *
+ * @param texture a complete mip chain
+ * @return uint32_t index of the texture in the pool
+ */
+uint32_t TexturePool::add(std::unique_ptr<Texture::MappedTexture> texture)
+{
+  const auto& levels = texture->levels();
+  if (levels.size() != Texture::mip_level_count(levels[0].width, levels[0].height)) {
+    throw std::runtime_error("Pooled textures need every mip level!");
+  }
+
+  uint32_t tail  = TextureStreamer::tail_level(levels);
+  uint32_t index = residency.add(levels, tail);
+  textures.push_back(PooledTexture());
+  textures.back().file = std::move(texture);
+
+  submit_transfer(textures.back(), tail);
+  vkWaitForFences(device, 1, &textures.back().transfer.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+  complete_transfer(index);
+  return index;
+}
+
+/**
+ * @brief Call once a frame, before the frame's draws are recorded. Releases images no
+ * frame in flight samples, switches textures whose move completed and starts the moves
+ * for the uses noted since the last call.
+ *
+ * @return true when a texture has a new view, sets that bind views directly need updating
+ */
+bool TexturePool::update()
+{
+  frame++;
+
+  auto released = std::remove_if(retired.begin(), retired.end(), [this](Retired& allocation) {
+    if (allocation.frame + framesInFlight > frame) {
+      return false;
+    }
+    release(allocation.allocation);
+    return true;
+  });
+  retired.erase(released, retired.end());
+
+  bool changed = false;
+  for (uint32_t texture = 0; texture < textures.size(); texture++) {
+    VkFence fence = textures[texture].transfer.fence;
+    if (fence != VK_NULL_HANDLE && vkGetFenceStatus(device, fence) == VK_SUCCESS) {
+      complete_transfer(texture);
+      changed = true;
+    }
+  }
+
+  for (const auto& change : residency.plan()) {
+    submit_transfer(textures[change.texture], change.level);
+  }
+  return changed;
+}
+
+/**
+ * @brief Start moving a texture to an image holding the file's levels from level down.
+ * Levels the current image holds are copied from it, the others from the file.
+ *
+ * @param texture without a move in flight
+ * @param level
+ */
+void TexturePool::submit_transfer(PooledTexture& texture, uint32_t level)
+{
+  const auto&    levels     = texture.file->levels();
+  const uint32_t levelCount = static_cast<uint32_t>(levels.size());
+  const VkFormat format     = static_cast<VkFormat>(texture.file->format());
+  Allocation&    current    = texture.current;
+  Transfer&      transfer   = texture.transfer;
+
+  transfer.target.level = level;
+  createImage(levels[level].width,
+              levels[level].height,
+              levelCount - level,
+              format,
+              transfer.target.image,
+              transfer.target.memory);
+
+  // Levels are stored back to back from the largest, so the ones to upload are one range
+  const uint32_t kept  = current.image != VK_NULL_HANDLE ? std::max(current.level, level) : levelCount;
+  const size_t   begin = levels[level].offset;
+  const size_t   end   = kept < levelCount ? levels[kept].offset : texture.file->data_size();
+  if (end > begin) {
+    createBuffer(end - begin,
+                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 transfer.staging,
+                 transfer.stagingMemory);
+    void* data;
+    vkMapMemory(device, transfer.stagingMemory, 0, end - begin, 0, &data);
+    std::memcpy(data, texture.file->data() + begin, end - begin);
+    vkUnmapMemory(device, transfer.stagingMemory);
+  }
+
+  VkCommandBufferAllocateInfo allocInfo = {};
+  allocInfo.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool                 = commandPool;
+  allocInfo.commandBufferCount          = 1;
+  vkAllocateCommandBuffers(device, &allocInfo, &transfer.commands);
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(transfer.commands, &beginInfo);
+
+  std::vector<VkImageMemoryBarrier> barriers(kept < levelCount ? 2 : 1);
+  for (auto& barrier : barriers) {
+    barrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  }
+  barriers[0].srcAccessMask    = 0;
+  barriers[0].dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barriers[0].oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED;
+  barriers[0].newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barriers[0].image            = transfer.target.image;
+  barriers[0].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount - level, 0, 1};
+  if (kept < levelCount) {
+    barriers[1].srcAccessMask    = 0;
+    barriers[1].dstAccessMask    = VK_ACCESS_TRANSFER_READ_BIT;
+    barriers[1].oldLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[1].newLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barriers[1].image            = current.image;
+    barriers[1].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, kept - current.level, levelCount - kept, 0, 1};
+  }
+
+  // Earlier frames may still sample the current image
+  vkCmdPipelineBarrier(transfer.commands,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       0,
+                       0,
+                       nullptr,
+                       0,
+                       nullptr,
+                       static_cast<uint32_t>(barriers.size()),
+                       barriers.data());
+
+  std::vector<VkBufferImageCopy> uploads;
+  for (uint32_t source = level; source < kept; source++) {
+    VkBufferImageCopy region               = {};
+    region.bufferOffset                    = levels[source].offset - begin;
+    region.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel       = source - level;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount     = 1;
+    region.imageOffset                     = {0, 0, 0};
+    region.imageExtent                     = {levels[source].width, levels[source].height, 1};
+    uploads.push_back(region);
+  }
+  if (!uploads.empty()) {
+    vkCmdCopyBufferToImage(transfer.commands,
+                           transfer.staging,
+                           transfer.target.image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           static_cast<uint32_t>(uploads.size()),
+                           uploads.data());
+  }
+
+  std::vector<VkImageCopy> copies;
+  for (uint32_t source = kept; source < levelCount; source++) {
+    VkImageCopy region    = {};
+    region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, source - current.level, 0, 1};
+    region.srcOffset      = {0, 0, 0};
+    region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, source - level, 0, 1};
+    region.dstOffset      = {0, 0, 0};
+    region.extent         = {levels[source].width, levels[source].height, 1};
+    copies.push_back(region);
+  }
+  if (!copies.empty()) {
+    vkCmdCopyImage(transfer.commands,
+                   current.image,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   transfer.target.image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   static_cast<uint32_t>(copies.size()),
+                   copies.data());
+  }
+
+  // Both images are sampled by later frames, the current one until the move completed
+  for (auto& barrier : barriers) {
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout     = barrier.newLayout;
+    barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  }
+  barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(transfer.commands,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       0,
+                       0,
+                       nullptr,
+                       0,
+                       nullptr,
+                       static_cast<uint32_t>(barriers.size()),
+                       barriers.data());
+  vkEndCommandBuffer(transfer.commands);
+
+  VkFenceCreateInfo fenceInfo = {};
+  fenceInfo.sType             = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  if (vkCreateFence(device, &fenceInfo, nullptr, &transfer.fence) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create texture pool fence!");
+  }
+
+  VkSubmitInfo submitInfo       = {};
+  submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers    = &transfer.commands;
+  if (vkQueueSubmit(queue, 1, &submitInfo, transfer.fence) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to submit texture pool transfer!");
+  }
+}
+
+/**
+ * @brief Switch a texture to the image its completed move filled, the old image is
+ * retired until the frames that may sample it are done
+ *
+ * @param texture
+ */
+void TexturePool::complete_transfer(uint32_t texture)
+{
+  PooledTexture& pooled   = textures[texture];
+  Transfer&      transfer = pooled.transfer;
+
+  vkFreeCommandBuffers(device, commandPool, 1, &transfer.commands);
+  vkDestroyFence(device, transfer.fence, nullptr);
+  vkDestroyBuffer(device, transfer.staging, nullptr);
+  vkFreeMemory(device, transfer.stagingMemory, nullptr);
+
+  const uint32_t        levelCount = static_cast<uint32_t>(pooled.file->levels().size());
+  VkImageViewCreateInfo viewInfo   = {};
+  viewInfo.sType                   = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image                   = transfer.target.image;
+  viewInfo.viewType                = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format                  = static_cast<VkFormat>(pooled.file->format());
+  viewInfo.subresourceRange        = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount - transfer.target.level, 0, 1};
+  if (vkCreateImageView(device, &viewInfo, nullptr, &transfer.target.view) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create texture pool image view!");
+  }
+  if (table) {
+    transfer.target.slot =
+        table->add(textureSampler, transfer.target.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  }
+
+  if (pooled.current.image != VK_NULL_HANDLE) {
+    retired.push_back({pooled.current, frame});
+  }
+  pooled.current = transfer.target;
+  transfer       = Transfer();
+  residency.complete(texture);
+}
+
+/**
+ * @brief Destroy an image, its view and its slot when it has them
+ *
+ * @param allocation
+ */
+void TexturePool::release(Allocation& allocation)
+{
+  if (allocation.view != VK_NULL_HANDLE) {
+    if (table) {
+      table->remove(allocation.slot);
+    }
+    vkDestroyImageView(device, allocation.view, nullptr);
+  }
+  vkDestroyImage(device, allocation.image, nullptr);
+  vkFreeMemory(device, allocation.memory, nullptr);
+  allocation = Allocation();
+}
+
+}}  // namespace Rake::Graphics
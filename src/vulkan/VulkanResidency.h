@@ -0,0 +1,111 @@
+#if !defined(VULKANRESIDENCY_H)
+#define VULKANRESIDENCY_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#define VK_NO_PROTOTYPES
+#define VK_USE_PLATFORM_XCB_KHR
+#include <vulkan/vulkan.h>
+
+#include "VulkanDescriptors.h"
+#include "VulkanStreaming.h"
+#include "texture/residency.h"
+#include "texture/texturefile.h"
+
+namespace Rake { namespace Graphics {
+
+/**
+ * @brief Mapped textures whose resident levels a Texture::ResidencyManager decides. Each
+ * texture's image holds exactly its resident levels, from the most detailed one down to
+ * 1x1, so dropping levels frees memory and sampling needs no clamp.
+ *
+ * Moving a texture to another level allocates an image of the new size, copies the levels
+ * both have on the GPU and uploads the ones it gains straight from the file. Draws switch
+ * to the new image once the copy completed, through a new bindless slot or view, and the
+ * old one is released when the frames that may still sample it are done.
+ */
+class TexturePool {
+  public:
+  using CreateBuffer = TextureStreamer::CreateBuffer;
+  using CreateImage  = std::function<void(uint32_t, uint32_t, uint32_t, VkFormat, VkImage&, VkDeviceMemory&)>;
+
+  TexturePool(VkDevice              device,
+              VkCommandPool         commandPool,
+              VkQueue               queue,
+              BindlessTextureTable* table,
+              CreateImage           createImage,
+              CreateBuffer          createBuffer,
+              uint32_t              framesInFlight,
+              uint64_t              budget);
+  ~TexturePool();
+
+  TexturePool(const TexturePool&) = delete;
+  TexturePool& operator=(const TexturePool&) = delete;
+
+  uint32_t add(std::unique_ptr<Texture::MappedTexture> texture);
+  void     use(uint32_t texture, uint32_t level) { residency.use(texture, level); }
+  bool     update();
+  void     set_budget(uint64_t bytes) { residency.set_budget(bytes); }
+
+  uint32_t    size() const { return static_cast<uint32_t>(textures.size()); }
+  uint64_t    frame_count() const { return frame; }
+  VkSampler   sampler() const { return textureSampler; }
+  VkImageView view(uint32_t texture) const { return textures[texture].current.view; }
+  uint32_t    slot(uint32_t texture) const { return textures[texture].current.slot; }
+  uint32_t    resident_level(uint32_t texture) const { return textures[texture].current.level; }
+  const std::vector<Texture::MipLevel>& levels(uint32_t texture) const { return textures[texture].file->levels(); }
+  const Texture::ResidencyStats&        stats() const { return residency.stats(); }
+
+  private:
+  struct Allocation {
+    VkImage        image  = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkImageView    view   = VK_NULL_HANDLE;
+    uint32_t       slot   = 0;
+    uint32_t       level  = 0;  // Level of the file the image's level 0 holds
+  };
+
+  struct Transfer {
+    Allocation      target;
+    VkBuffer        staging       = VK_NULL_HANDLE;
+    VkDeviceMemory  stagingMemory = VK_NULL_HANDLE;
+    VkCommandBuffer commands      = VK_NULL_HANDLE;
+    VkFence         fence         = VK_NULL_HANDLE;
+  };
+
+  struct PooledTexture {
+    std::unique_ptr<Texture::MappedTexture> file;
+    Allocation                              current;
+    Transfer                                transfer;  // Its fence is null when no move is in flight
+  };
+
+  struct Retired {
+    Allocation allocation;
+    uint64_t   frame;  // update() it was retired in
+  };
+
+  void submit_transfer(PooledTexture& texture, uint32_t level);
+  void complete_transfer(uint32_t texture);
+  void release(Allocation& allocation);
+
+  VkDevice              device;
+  VkCommandPool         commandPool;
+  VkQueue               queue;
+  BindlessTextureTable* table;
+  CreateImage           createImage;
+  CreateBuffer          createBuffer;
+  uint32_t              framesInFlight;
+  VkSampler             textureSampler = VK_NULL_HANDLE;
+
+  Texture::ResidencyManager  residency;
+  std::vector<PooledTexture> textures;
+  std::vector<Retired>       retired;
+  uint64_t                   frame = 0;
+};
+
+}}  // namespace Rake::Graphics
+
+#endif  // VULKANRESIDENCY_H
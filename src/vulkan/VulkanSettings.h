@@ -0,0 +1,93 @@
+#if !defined(VULKANSETTINGS_H)
+#define VULKANSETTINGS_H
+
+#include <cstdint>
+
+namespace Rake { namespace Graphics {
+
+/**
+ * @brief Antialiasing quality, each tier costs more fill rate than the one below
+ */
+enum class QualityTier : uint32_t {
+  Low,     // 2x MSAA
+  Medium,  // 4x MSAA
+  High,    // 4x MSAA, half the samples shaded
+  Ultra,   // 8x MSAA, half the samples shaded
+};
+
+constexpr uint32_t qualityTierCount = 4;
+
+/**
+ * @brief Multisampling of a quality tier, before it is clamped to what the device supports
+ */
+struct TierMultisampling {
+  uint32_t samples;
+  float    minSampleShading;  // 0 shades once per pixel
+};
+
+inline TierMultisampling tier_multisampling(QualityTier tier)
+{
+  static const TierMultisampling tiers[qualityTierCount] = {{2, 0.0f}, {4, 0.0f}, {4, 0.5f}, {8, 0.5f}};
+  return tiers[static_cast<uint32_t>(tier)];
+}
+
+inline const char* quality_tier_name(QualityTier tier)
+{
+  static const char* names[qualityTierCount] = {"low", "medium", "high", "ultra"};
+  return names[static_cast<uint32_t>(tier)];
+}
+
+/**
+ * @brief Block compression of baked textures, from 4 bytes a texel down to 1 or half of one
+ */
+enum class TextureCompression : uint32_t {
+  None,  // RGBA8
+  Bc1,   // Opaque, half a byte a texel
+  Bc3,   // A byte a texel
+  Bc7,   // A byte a texel, less banding than BC3
+};
+
+constexpr uint32_t textureCompressionCount = 4;
+
+inline const char* texture_compression_name(TextureCompression compression)
+{
+  static const char* names[textureCompressionCount] = {"none", "bc1", "bc3", "bc7"};
+  return names[static_cast<uint32_t>(compression)];
+}
+
+/**
+ * @brief Renderer options chosen before init_vulkan(), features the device lacks fall
+ * back silently
+ */
+struct Settings {
+  bool     bindlessTextures = true;   // Global texture array through VK_EXT_descriptor_indexing
+  bool     gpuCulling       = true;   // Frustum cull in a compute pass and draw indirect
+  bool     cpuCulling       = true;   // SIMD frustum cull on the CPU when GPU culling is unavailable
+  bool     validateCulling  = false;  // Count the expected survivors on the CPU as well
+  uint32_t instanceCount    = 1;      // Copies of the model drawn on a grid
+  uint32_t lodCount         = 4;      // Detail levels generated for the model, 1 draws it at full detail
+  float    lodPixelError    = 1.0f;   // Largest error in pixels a distant instance may be drawn with
+  bool     clusterCulling   = true;   // Cull the meshlets of visible instances in compute, needs draw count
+  bool     occlusionCulling = true;   // Two phase Hi-Z occlusion culling on top of GPU culling, needs MSAA
+  bool     depthPrepass     = false;  // Depth only subpass before shading, the colour pass tests for equality
+  bool     lazyAttachments  = true;   // Transient MSAA attachments in lazily allocated memory where possible
+  bool     bakedMipmaps     = true;   // Upload texture mip chains filtered on the CPU, baked next to the image
+  bool     computeMipmaps   = true;   // Downsample unbaked textures in compute, blit without storage image support
+  bool     streamTextures   = true;   // Upload the mip tail of baked textures at startup, stream larger levels in
+  bool     texturePool      = false;  // Evict top levels of baked textures to stay under budget, stream them back
+  uint32_t textureBudget    = 0;      // MB the texture pool keeps resident, 0 takes half of the free device memory
+  uint32_t textureCount     = 1;      // Copies of the model's texture in the pool, instances take them in turn
+
+  TextureCompression textureCompression = TextureCompression::Bc7;  // Of baked textures, BC3 stands in for BC7
+
+  QualityTier quality         = QualityTier::Medium;  // MSAA and sample shading, the tier auto-tuning starts from
+  double      qualityTargetMs = 0.0;  // Step quality down at startup until the GPU frame time meets it, 0 keeps it
+
+  float  renderScale        = 1.0f;  // Of the internal render target per axis, below 1 it is upscaled to the swapchain
+  float  minRenderScale     = 0.5f;  // Lowest scale dynamic resolution goes down to
+  double resolutionTargetMs = 0.0;   // Scale the render target every few frames to meet this GPU frame time, 0 keeps it
+};
+
+}}  // namespace Rake::Graphics
+
+#endif  // VULKANSETTINGS_H
@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "VulkanFunctions.h"
+#include "VulkanStreaming.h"
+
+namespace Rake { namespace Graphics {
+
+/**
+ * @brief Uploads the mip tail and queues reads of the other levels, most detailed last
+ *
+ * @param device
+ * @param commandPool of the queue's family, only used from the calling thread
+ * @param queue
+ * @param image with every level of the texture, in the undefined layout
+ * @param texture a complete mip chain
+ * @param createBuffer
+ * @param threadCount reading levels from the file
+ */
+TextureStreamer::TextureStreamer(VkDevice                                device,
+                                 VkCommandPool                           commandPool,
+                                 VkQueue                                 queue,
+                                 VkImage                                 image,
+                                 std::unique_ptr<Texture::MappedTexture> texture,
+                                 CreateBuffer                            createBuffer,
+                                 size_t                                  threadCount)
+    : device(device)
+    , commandPool(commandPool)
+    , queue(queue)
+    , image(image)
+    , texture(std::move(texture))
+    , loaders(threadCount)
+{
+  const auto& levels = this->texture->levels();
+  createBuffer(this->texture->data_size(),
+               VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               stagingBuffer,
+               stagingBufferMemory);
+  void* data;
+  vkMapMemory(device, stagingBufferMemory, 0, this->texture->data_size(), 0, &data);
+  staging = static_cast<uint8_t*>(data);
+
+  // The tail is the end of the level data, one copy and one upload
+  const uint32_t tail       = tail_level(levels);
+  const size_t   tailOffset = levels[tail].offset;
+  std::memcpy(staging + tailOffset, this->texture->data() + tailOffset, this->texture->data_size() - tailOffset);
+  residentLevel = static_cast<uint32_t>(levels.size());
+  submit_upload(tail, residentLevel, true);
+  complete_upload(true);
+
+  loads.resize(tail);
+  for (uint32_t level = tail; level-- > 0;) {
+    loads[level] = loaders.submit([this, level]() {
+      const Texture::MipLevel& mip = this->texture->levels()[level];
+      std::memcpy(staging + mip.offset, this->texture->data() + mip.offset, mip.size);
+    });
+  }
+}
+
+/**
+ * @brief Waits for reads and the upload in flight
+ */
+TextureStreamer::~TextureStreamer()
+{
+  for (auto& load : loads) {
+    if (load.valid()) {
+      load.wait();
+    }
+  }
+  if (uploadFence != VK_NULL_HANDLE) {
+    vkWaitForFences(device, 1, &uploadFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+    vkFreeCommandBuffers(device, commandPool, 1, &uploadCommands);
+    vkDestroyFence(device, uploadFence, nullptr);
+  }
+  if (stagingBuffer != VK_NULL_HANDLE) {
+    vkUnmapMemory(device, stagingBufferMemory);
+    vkDestroyBuffer(device, stagingBuffer, nullptr);
+    vkFreeMemory(device, stagingBufferMemory, nullptr);
+  }
+}
+
+/**
+ * @brief Call once a frame. Completes the upload in flight when the device is done with
+ * it, then uploads the levels read since, down to the first one still being read.
+ */
+void TextureStreamer::update()
+{
+  complete_upload(false);
+  if (uploadFence == VK_NULL_HANDLE && residentLevel > 0) {
+    uint32_t first = residentLevel;
+    while (first > 0 && loads[first - 1].wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+      loads[--first].get();  // Rethrows a failed read
+    }
+    if (first < residentLevel) {
+      submit_upload(first, residentLevel, false);
+    }
+  }
+}
+
+/**
+ * @brief Make every level resident, blocking until the reads and uploads are done
+ */
+void TextureStreamer::finish()
+{
+  complete_upload(true);
+  if (residentLevel > 0) {
+    for (uint32_t level = 0; level < residentLevel; level++) {
+      loads[level].get();
+    }
+    submit_upload(0, residentLevel, false);
+    complete_upload(true);
+  }
+}
+
+/**
+ * @brief The first level small enough to upload before the first frame
+ *
+ * @param levels
+ * @return uint32_t
+ */
+uint32_t TextureStreamer::tail_level(const std::vector<Texture::MipLevel>& levels)
+{
+  for (uint32_t level = 0; level < levels.size(); level++) {
+    if (std::max(levels[level].width, levels[level].height) <= tailSize) {
+      return level;
+    }
+  }
+  return static_cast<uint32_t>(levels.size()) - 1;
+}
+
+/**
+ * @brief Copy levels [first, end) from staging. The first upload also takes every level
+ * out of the undefined layout, later ones only touch their own levels, which no sampler
+ * reaches until they are resident.
+ *
+ * @param first
+ * @param end
+ * @param whole the image is still in the undefined layout
+ */
+void TextureStreamer::submit_upload(uint32_t first, uint32_t end, bool whole)
+{
+  const auto&    levels     = texture->levels();
+  const uint32_t levelCount = static_cast<uint32_t>(levels.size());
+
+  VkCommandBufferAllocateInfo allocInfo = {};
+  allocInfo.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool                 = commandPool;
+  allocInfo.commandBufferCount          = 1;
+  vkAllocateCommandBuffers(device, &allocInfo, &uploadCommands);
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(uploadCommands, &beginInfo);
+
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType                = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask        = 0;
+  barrier.dstAccessMask        = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.oldLayout            = whole ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.newLayout            = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image                = image;
+  barrier.subresourceRange     = whole ? VkImageSubresourceRange{VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1}
+                                       : VkImageSubresourceRange{VK_IMAGE_ASPECT_COLOR_BIT, first, end - first, 0, 1};
+
+  // Earlier frames may still sample the image, a level is only written after they are done
+  vkCmdPipelineBarrier(uploadCommands,
+                       whole ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       0,
+                       0,
+                       nullptr,
+                       0,
+                       nullptr,
+                       1,
+                       &barrier);
+
+  std::vector<VkBufferImageCopy> regions;
+  for (uint32_t level = first; level < end; level++) {
+    VkBufferImageCopy region               = {};
+    region.bufferOffset                    = levels[level].offset;
+    region.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel       = level;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount     = 1;
+    region.imageOffset                     = {0, 0, 0};
+    region.imageExtent                     = {levels[level].width, levels[level].height, 1};
+    regions.push_back(region);
+  }
+  vkCmdCopyBufferToImage(uploadCommands,
+                         stagingBuffer,
+                         image,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         static_cast<uint32_t>(regions.size()),
+                         regions.data());
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  vkCmdPipelineBarrier(uploadCommands,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       0,
+                       0,
+                       nullptr,
+                       0,
+                       nullptr,
+                       1,
+                       &barrier);
+  vkEndCommandBuffer(uploadCommands);
+
+  VkFenceCreateInfo fenceInfo = {};
+  fenceInfo.sType             = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  if (vkCreateFence(device, &fenceInfo, nullptr, &uploadFence) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create texture upload fence!");
+  }
+
+  VkSubmitInfo submitInfo       = {};
+  submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers    = &uploadCommands;
+  if (vkQueueSubmit(queue, 1, &submitInfo, uploadFence) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to submit texture upload!");
+  }
+  uploadFirst = first;
+}
+
+/**
+ * @brief Make the levels of the upload in flight resident once it completed. Staging is
+ * released with the last one.
+ *
+ * @param wait for the upload instead of checking on it
+ * @return true when levels became resident
+ */
+bool TextureStreamer::complete_upload(bool wait)
+{
+  if (uploadFence == VK_NULL_HANDLE) {
+    return false;
+  }
+  if (wait) {
+    vkWaitForFences(device, 1, &uploadFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+  } else if (vkGetFenceStatus(device, uploadFence) != VK_SUCCESS) {
+    return false;
+  }
+
+  vkFreeCommandBuffers(device, commandPool, 1, &uploadCommands);
+  vkDestroyFence(device, uploadFence, nullptr);
+  uploadCommands = VK_NULL_HANDLE;
+  uploadFence    = VK_NULL_HANDLE;
+  residentLevel  = uploadFirst;
+
+  if (residentLevel == 0) {
+    vkUnmapMemory(device, stagingBufferMemory);
+    vkDestroyBuffer(device, stagingBuffer, nullptr);
+    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    stagingBuffer       = VK_NULL_HANDLE;
+    stagingBufferMemory = VK_NULL_HANDLE;
+    staging             = nullptr;
+  }
+  return true;
+}
+
+}}  // namespace Rake::Graphics
@@ -0,0 +1,78 @@
+#if !defined(VULKANSTREAMING_H)
+#define VULKANSTREAMING_H
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+
+#define VK_NO_PROTOTYPES
+#define VK_USE_PLATFORM_XCB_KHR
+#include <vulkan/vulkan.h>
+
+#include "skeleton/threadpool.h"
+#include "texture/texturefile.h"
+
+namespace Rake { namespace Graphics {
+
+/**
+ * @brief Streams the levels of a mapped texture in to an image, smallest first. The mip
+ * tail is uploaded before the constructor returns, larger levels are read from the file
+ * on background threads and uploaded once a frame as they arrive.
+ *
+ * Levels become resident from the tail up, resident_level() is the most detailed one a
+ * sampler may reach. Every level of the image stays in the shader read only layout
+ * outside of its own upload, so samplers only need their minLod clamped.
+ */
+class TextureStreamer {
+  public:
+  using CreateBuffer =
+      std::function<void(VkDeviceSize, VkBufferUsageFlags, VkMemoryPropertyFlags, VkBuffer&, VkDeviceMemory&)>;
+
+  TextureStreamer(VkDevice                                device,
+                  VkCommandPool                           commandPool,
+                  VkQueue                                 queue,
+                  VkImage                                 image,
+                  std::unique_ptr<Texture::MappedTexture> texture,
+                  CreateBuffer                            createBuffer,
+                  size_t                                  threadCount = 2);
+  ~TextureStreamer();
+
+  TextureStreamer(const TextureStreamer&) = delete;
+  TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+  void     update();
+  void     finish();
+  uint32_t resident_level() const { return residentLevel; }
+  bool     finished() const { return residentLevel == 0 && uploadFence == VK_NULL_HANDLE; }
+
+  static uint32_t tail_level(const std::vector<Texture::MipLevel>& levels);
+
+  private:
+  static constexpr uint32_t tailSize = 128;  // Largest axis of the levels uploaded up front
+
+  void submit_upload(uint32_t first, uint32_t end, bool whole);
+  bool complete_upload(bool wait);
+
+  VkDevice                                device;
+  VkCommandPool                           commandPool;
+  VkQueue                                 queue;
+  VkImage                                 image;
+  std::unique_ptr<Texture::MappedTexture> texture;
+
+  VkBuffer       stagingBuffer       = VK_NULL_HANDLE;
+  VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
+  uint8_t*       staging             = nullptr;  // Same layout as the file's level data
+
+  uint32_t                       residentLevel  = 0;
+  uint32_t                       uploadFirst    = 0;  // Most detailed level of the upload in flight
+  VkCommandBuffer                uploadCommands = VK_NULL_HANDLE;
+  VkFence                        uploadFence    = VK_NULL_HANDLE;
+  std::vector<std::future<void>> loads;  // By level, for the levels above the tail until they are uploaded
+  Base::ThreadPool               loaders;
+};
+
+}}  // namespace Rake::Graphics
+
+#endif  // VULKANSTREAMING_H
@@ -59,6 +59,84 @@ void Utility::load_model(Object::Model& model)
       model.indices.push_back(uniqueVertices[vertex]);
     }
   }
+
+  model.bounds = compute_bounds(model.verticies);
+  model.lods   = {Scene::Lod{0, static_cast<uint32_t>(model.indices.size()), 0.0f}};
+}
+
+/**
+ * @brief Append simplified copies of the mesh to its index buffer, each about half the
+ * triangles of the one before. The vertex buffer is shared by every level.
+ *
+ * @param model loaded with load_model(), lods is replaced
+ * @param levelCount levels wanted including the full detail one, fewer when the mesh
+ * stops simplifying
+ */
+void Utility::build_lods(Object::Model& model, uint32_t levelCount)
+{
+  if (model.lods.empty()) {
+    return;
+  }
+
+  model.indices.resize(model.lods[0].indexCount);
+
+  Scene::PositionStream positions;
+  positions.data   = &model.verticies.data()->pos.x;
+  positions.count  = model.verticies.size();
+  positions.stride = sizeof(Object::Vertex);
+  model.lods       = Scene::build_lod_chain(positions, model.indices, levelCount);
+  model.meshlets.clear();
+}
+
+/**
+ * @brief Split every LOD in to meshlets of at most 64 vertices and 124 triangles. Only the
+ * order of the triangles within each LOD changes, so draws of whole LODs still work.
+ *
+ * @param model loaded with load_model(), after build_lods() when it is used
+ */
+void Utility::build_meshlets(Object::Model& model)
+{
+  Scene::PositionStream positions;
+  positions.data   = &model.verticies.data()->pos.x;
+  positions.count  = model.verticies.size();
+  positions.stride = sizeof(Object::Vertex);
+
+  model.meshlets.clear();
+  for (auto& lod : model.lods) {
+    auto meshlets    = Scene::build_meshlets(positions, model.indices, lod.firstIndex, lod.indexCount);
+    lod.firstMeshlet = static_cast<uint32_t>(model.meshlets.size());
+    lod.meshletCount = static_cast<uint32_t>(meshlets.size());
+    model.meshlets.insert(model.meshlets.end(), meshlets.begin(), meshlets.end());
+  }
+}
+
+/**
+ * @brief Box around the vertices and a sphere around the box centre
+ *
+ * @param vertices
+ * @return Object::Bounds, empty at the origin without vertices
+ */
+Object::Bounds Utility::compute_bounds(const std::vector<Object::Vertex>& vertices)
+{
+  Object::Bounds bounds;
+  if (vertices.empty()) {
+    return bounds;
+  }
+
+  bounds.minimum = vertices[0].pos;
+  bounds.maximum = vertices[0].pos;
+  for (const auto& vertex : vertices) {
+    bounds.minimum = glm::min(bounds.minimum, vertex.pos);
+    bounds.maximum = glm::max(bounds.maximum, vertex.pos);
+  }
+
+  glm::vec3 center = 0.5f * (bounds.minimum + bounds.maximum);
+  float     radius = 0.0f;
+  for (const auto& vertex : vertices) {
+    radius = std::max(radius, glm::length(vertex.pos - center));
+  }
+  bounds.sphere = glm::vec4(center, radius);
+  return bounds;
 }
 
 /**
@@ -361,6 +439,25 @@ uint32_t Helper::find_memory_type(VkPhysicalDevice&      physicalDevice,
   throw std::runtime_error("Failed to suitable memory type!");
 }
 
+/**
+ * @brief
+ * @param typeFilter
+ * @param properties
+ * @return whether find_memory_type() would find a type
+ */
+bool Helper::has_memory_type(VkPhysicalDevice& physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties)
+{
+  VkPhysicalDeviceMemoryProperties memProperties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+      return true;
+    }
+  }
+  return false;
+}
+
 /**
  * @brief
  * @return
@@ -393,4 +490,104 @@ VkSampleCountFlagBits Helper::get_max_usable_sample_count(VkPhysicalDevice& phys
   }
   return VK_SAMPLE_COUNT_1_BIT;
 }
+
+/**
+ * @brief
+ *
+ * @param physicalDevice
+ * @param extensionName
+ * @return true when the device offers the extension
+ */
+bool Helper::supports_device_extension(VkPhysicalDevice& physicalDevice, const char* extensionName)
+{
+  uint32_t extensionCount = 0;
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+  return std::any_of(availableExtensions.begin(), availableExtensions.end(), [extensionName](const auto& extension) {
+    return std::string(extension.extensionName) == extensionName;
+  });
+}
+
+/**
+ * @brief Bytes of the largest device local heap still free for this process
+ *
+ * @param physicalDevice
+ * @param memoryBudget VK_EXT_memory_budget is enabled, without it the whole heap counts as free
+ * @return VkDeviceSize
+ */
+VkDeviceSize Helper::get_device_local_budget(VkPhysicalDevice& physicalDevice, bool memoryBudget)
+{
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {};
+  budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+  VkPhysicalDeviceMemoryProperties2 properties = {};
+  properties.sType                             = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+  properties.pNext                             = memoryBudget ? &budget : nullptr;
+  vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties);
+
+  VkDeviceSize largest = 0;
+  VkDeviceSize free    = 0;
+  for (uint32_t heap = 0; heap < properties.memoryProperties.memoryHeapCount; heap++) {
+    const VkMemoryHeap& memoryHeap = properties.memoryProperties.memoryHeaps[heap];
+    if ((memoryHeap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && memoryHeap.size > largest) {
+      largest = memoryHeap.size;
+      free    = memoryBudget ? budget.heapBudget[heap] - std::min(budget.heapUsage[heap], budget.heapBudget[heap])
+                             : memoryHeap.size;
+    }
+  }
+  return free;
+}
+
+/**
+ * @brief Number of slots a BindlessTextureTable may have on this device
+ *
+ * @param physicalDevice
+ * @return 0 when VK_EXT_descriptor_indexing or one of the features it needs is missing
+ */
+uint32_t Helper::get_bindless_texture_capacity(VkPhysicalDevice& physicalDevice)
+{
+  const uint32_t maxTextures = 4096;
+
+  VkPhysicalDeviceProperties deviceProperties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+  if (deviceProperties.apiVersion < VK_API_VERSION_1_1) {
+    return 0;
+  }
+
+  if (!supports_device_extension(physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+    return 0;
+  }
+
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+  indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+  VkPhysicalDeviceFeatures2 features = {};
+  features.sType                     = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features.pNext                     = &indexingFeatures;
+  vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+  if (!features.features.shaderSampledImageArrayDynamicIndexing || !indexingFeatures.runtimeDescriptorArray ||
+      !indexingFeatures.descriptorBindingPartiallyBound ||
+      !indexingFeatures.descriptorBindingSampledImageUpdateAfterBind ||
+      !indexingFeatures.shaderSampledImageArrayNonUniformIndexing) {
+    return 0;
+  }
+
+  VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+  indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+  VkPhysicalDeviceProperties2 properties = {};
+  properties.sType                       = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties.pNext                       = &indexingProperties;
+  vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+  // Combined image samplers count against both the sampler and the sampled image limits.
+  return std::min({maxTextures,
+                   indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+                   indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                   indexingProperties.maxDescriptorSetUpdateAfterBindSamplers,
+                   indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages});
+}
 }}  // namespace Rake::Graphics
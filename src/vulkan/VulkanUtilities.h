@@ -20,6 +20,7 @@ class Helper {
                                                   VkQueue&                  presentQueue,
                                                   VkQueue&                  graphicsQueue);
   uint32_t find_memory_type(VkPhysicalDevice& physicalDevice, uint32_t& typeFilter, VkMemoryPropertyFlags& properties);
+  bool     has_memory_type(VkPhysicalDevice& physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
   VkFormat find_supported_format(VkPhysicalDevice&            device,
                                  const std::vector<VkFormat>& candidates,
                                  const VkImageTiling&         tiling,
@@ -27,11 +28,17 @@ class Helper {
   VkFormat find_depth_format(VkPhysicalDevice& physicalDevice);
   bool     has_stencil_component(VkFormat& format);
   VkSampleCountFlagBits get_max_usable_sample_count(VkPhysicalDevice& physicalDevice);
+  uint32_t              get_bindless_texture_capacity(VkPhysicalDevice& physicalDevice);
+  bool                  supports_device_extension(VkPhysicalDevice& physicalDevice, const char* extensionName);
+  VkDeviceSize          get_device_local_budget(VkPhysicalDevice& physicalDevice, bool memoryBudget);
 };
 
 class Utility {
   public:
   void                     load_model(Object::Model& model);
+  static Object::Bounds    compute_bounds(const std::vector<Object::Vertex>& vertices);
+  static void              build_lods(Object::Model& model, uint32_t levelCount);
+  static void              build_meshlets(Object::Model& model);
   static std::vector<char> read_file(const std::string& filename);
 };
 
@@ -0,0 +1,273 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "check.h"
+#include "skeleton/simd.h"
+#include "skeleton/threadpool.h"
+#include "texture/blockcompress.h"
+#include "texture/mipchain.h"
+
+using Rake::Texture::BlockEncoder;
+using Rake::Texture::BlockFormat;
+using Rake::Texture::MipChain;
+using Rake::Texture::MipLevel;
+
+namespace {
+
+using Block = uint8_t[16][4];  // Decoded texels of a block, row by row
+
+/**
+ * @brief Colour half of a BC1 or BC3 block, as the D3D and Vulkan specs decode it with
+ * bit replicated endpoints
+ *
+ * @param opaque BC3 colour, which always uses four colours and leaves alpha alone
+ */
+void decode_colour(const uint8_t* block, Block& texels, bool opaque)
+{
+  uint16_t c0      = static_cast<uint16_t>(block[0] | block[1] << 8);
+  uint16_t c1      = static_cast<uint16_t>(block[2] | block[3] << 8);
+  uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | uint32_t(block[7]) << 24;
+
+  int  palette[4][4];
+  auto expand = [](uint16_t colour, int* out) {
+    int r  = colour >> 11 & 31;
+    int g  = colour >> 5 & 63;
+    int b  = colour & 31;
+    out[0] = r << 3 | r >> 2;
+    out[1] = g << 2 | g >> 4;
+    out[2] = b << 3 | b >> 2;
+    out[3] = 255;
+  };
+  expand(c0, palette[0]);
+  expand(c1, palette[1]);
+
+  bool four = opaque || c0 > c1;
+  for (int c = 0; c < 3; c++) {
+    palette[2][c] = four ? (2 * palette[0][c] + palette[1][c]) / 3 : (palette[0][c] + palette[1][c]) / 2;
+    palette[3][c] = four ? (palette[0][c] + 2 * palette[1][c]) / 3 : 0;
+  }
+  palette[2][3] = 255;
+  palette[3][3] = four ? 255 : 0;
+
+  for (int i = 0; i < 16; i++) {
+    int entry = indices >> (2 * i) & 3;
+    for (int c = 0; c < (opaque ? 3 : 4); c++) {
+      texels[i][c] = static_cast<uint8_t>(palette[entry][c]);
+    }
+  }
+}
+
+void decode_alpha(const uint8_t* block, Block& texels)
+{
+  int palette[8] = {block[0], block[1]};
+  if (palette[0] > palette[1]) {
+    for (int k = 2; k < 8; k++) {
+      palette[k] = ((8 - k) * palette[0] + (k - 1) * palette[1]) / 7;
+    }
+  } else {
+    for (int k = 2; k < 6; k++) {
+      palette[k] = ((6 - k) * palette[0] + (k - 1) * palette[1]) / 5;
+    }
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+
+  uint64_t indices = 0;
+  for (int i = 0; i < 6; i++) {
+    indices |= uint64_t(block[2 + i]) << (8 * i);
+  }
+  for (int i = 0; i < 16; i++) {
+    texels[i][3] = static_cast<uint8_t>(palette[indices >> (3 * i) & 7]);
+  }
+}
+
+uint32_t read_bits(const uint8_t* block, uint32_t& position, uint32_t count)
+{
+  uint32_t value = 0;
+  for (uint32_t i = 0; i < count; i++, position++) {
+    value |= uint32_t(block[position / 8] >> (position % 8) & 1) << i;
+  }
+  return value;
+}
+
+/**
+ * @brief BC7 mode 6 only, the one mode the encoder writes
+ */
+void decode_bc7(const uint8_t* block, Block& texels)
+{
+  static const int weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+  uint32_t position = 0;
+  CHECK(read_bits(block, position, 7) == 1 << 6);
+
+  int endpoints[2][4];
+  for (int c = 0; c < 4; c++) {
+    endpoints[0][c] = static_cast<int>(read_bits(block, position, 7));
+    endpoints[1][c] = static_cast<int>(read_bits(block, position, 7));
+  }
+  for (auto& endpoint : endpoints) {
+    int pBit = static_cast<int>(read_bits(block, position, 1));
+    for (int& channel : endpoint) {
+      channel = channel << 1 | pBit;
+    }
+  }
+
+  for (int i = 0; i < 16; i++) {
+    int weight = weights[read_bits(block, position, i == 0 ? 3 : 4)];
+    for (int c = 0; c < 4; c++) {
+      texels[i][c] = static_cast<uint8_t>(((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6);
+    }
+  }
+  CHECK(position == 128);
+}
+
+void decode_block(BlockFormat format, const uint8_t* block, Block& texels)
+{
+  switch (format) {
+    case BlockFormat::Bc1:
+      decode_colour(block, texels, false);
+      break;
+    case BlockFormat::Bc3:
+      decode_alpha(block, texels);
+      decode_colour(block + 8, texels, true);
+      break;
+    case BlockFormat::Bc7:
+      decode_bc7(block, texels);
+      break;
+  }
+}
+
+/**
+ * @brief Root mean square error of a decoded level against its texels. BC1 is opaque,
+ * so only its colour is compared and every texel must decode with full alpha.
+ */
+double decode_error(BlockFormat format, const MipLevel& level, const uint8_t* texels, const uint8_t* blocks)
+{
+  uint32_t blocksWide = (level.width + 3) / 4;
+  uint32_t blocksHigh = (level.height + 3) / 4;
+  int      channels   = format == BlockFormat::Bc1 ? 3 : 4;
+
+  double squares = 0.0;
+  for (uint32_t by = 0; by < blocksHigh; by++) {
+    for (uint32_t bx = 0; bx < blocksWide; bx++) {
+      Block decoded;
+      decode_block(format, blocks + (size_t(by) * blocksWide + bx) * block_size(format), decoded);
+      for (uint32_t i = 0; i < 16; i++) {
+        uint32_t x = bx * 4 + i % 4;
+        uint32_t y = by * 4 + i / 4;
+        if (x >= level.width || y >= level.height) {
+          continue;
+        }
+        const uint8_t* texel = texels + (size_t(y) * level.width + x) * 4;
+        for (int c = 0; c < channels; c++) {
+          double difference = decoded[i][c] - texel[c];
+          squares += difference * difference;
+        }
+        CHECK(format != BlockFormat::Bc1 || decoded[i][3] == 255);
+      }
+    }
+  }
+  return std::sqrt(squares / (double(level.width) * level.height * channels));
+}
+
+/**
+ * @brief Smooth gradients with noise on top and an alpha ramp, odd sized so edge blocks
+ * are partly outside the image
+ */
+MipChain gradient_chain(uint32_t width, uint32_t height)
+{
+  std::mt19937         random(width * height);
+  std::vector<uint8_t> texels(size_t(width) * height * 4);
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      uint8_t* texel = &texels[(size_t(y) * width + x) * 4];
+      texel[0]       = static_cast<uint8_t>(std::min(255.0, 128 + 100 * std::sin(x * 0.02) + random() % 20));
+      texel[1]       = static_cast<uint8_t>(std::min(255.0, 128 + 100 * std::cos(y * 0.03) + random() % 20));
+      texel[2]       = static_cast<uint8_t>((x + y) % 256);
+      texel[3]       = static_cast<uint8_t>((x * 3 + y) % 256);
+    }
+  }
+  return Rake::Texture::MipBuilder(Rake::Base::SimdLevel::Scalar)
+      .build(texels.data(), width, height, Rake::Texture::ColorSpace::Srgb);
+}
+
+/**
+ * @brief The two largest levels of every format decode close to their texels, the bounds
+ * sit a little above what the encoder reaches on this image. Smaller levels are decoded
+ * too, so their bitstreams are checked, but the ramps wrap within a block there.
+ */
+void decode_error_bounds()
+{
+  struct Bound {
+    BlockFormat format;
+    double      rmse;
+  };
+  const Bound    bounds[]      = {{BlockFormat::Bc1, 4.5}, {BlockFormat::Bc3, 4.0}, {BlockFormat::Bc7, 4.0}};
+  const uint32_t boundedLevels = 2;
+
+  MipChain     chain = gradient_chain(517, 263);
+  BlockEncoder encoder(Rake::Base::SimdLevel::Scalar);
+  for (const auto& bound : bounds) {
+    MipChain blocks = encoder.encode(chain, bound.format);
+    CHECK(blocks.level_count() == chain.level_count());
+    for (uint32_t level = 0; level < chain.level_count(); level++) {
+      const MipLevel& mip = blocks.levels[level];
+      CHECK(mip.width == chain.levels[level].width && mip.height == chain.levels[level].height);
+      CHECK(mip.size == block_level_size(bound.format, mip.width, mip.height));
+      double error = decode_error(bound.format, mip, chain.level_data(level), blocks.level_data(level));
+      CHECK(level >= boundedLevels || error <= bound.rmse);
+    }
+  }
+}
+
+/**
+ * @brief A block of one colour decodes to nearly that colour in every format
+ */
+void solid_block()
+{
+  std::vector<uint8_t> texels(4 * 4 * 4);
+  for (size_t i = 0; i < texels.size(); i += 4) {
+    texels[i]     = 200;
+    texels[i + 1] = 100;
+    texels[i + 2] = 30;
+    texels[i + 3] = 77;
+  }
+  MipChain chain = Rake::Texture::MipBuilder(Rake::Base::SimdLevel::Scalar)
+                       .build(texels.data(), 4, 4, Rake::Texture::ColorSpace::Srgb);
+
+  for (auto format : {BlockFormat::Bc1, BlockFormat::Bc3, BlockFormat::Bc7}) {
+    MipChain blocks = BlockEncoder(Rake::Base::SimdLevel::Scalar).encode(chain, format);
+    CHECK(decode_error(format, blocks.levels[0], chain.level_data(0), blocks.level_data(0)) <= 2.5);
+  }
+}
+
+/**
+ * @brief Every SIMD level, on the calling thread and on a pool, writes the scalar blocks
+ */
+void matches_scalar()
+{
+  Rake::Base::ThreadPool pool(4);
+  MipChain               chain = gradient_chain(301, 77);
+  for (auto format : {BlockFormat::Bc1, BlockFormat::Bc3, BlockFormat::Bc7}) {
+    MipChain reference = BlockEncoder(Rake::Base::SimdLevel::Scalar).encode(chain, format);
+    for (auto level : Rake::Base::simd_levels()) {
+      for (auto workers : {static_cast<Rake::Base::ThreadPool*>(nullptr), &pool}) {
+        CHECK(BlockEncoder(level, workers).encode(chain, format).data == reference.data);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+int main()
+{
+  Rake::Test::Suite suite;
+  suite.run("decode error bounds", decode_error_bounds);
+  suite.run("solid block", solid_block);
+  suite.run("matches scalar", matches_scalar);
+  return suite.result();
+}
@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "check.h"
+#include "scene/bvh.h"
+#include "skeleton/threadpool.h"
+
+using Rake::Scene::Aabb;
+using Rake::Scene::Bvh;
+
+namespace {
+
+using Planes = std::array<glm::vec4, 6>;
+
+// A 100 unit box around the origin with one face tilted, inward normals
+const Planes planes = {glm::vec4(1.0f, 0.0f, 0.0f, 50.0f),
+                       glm::vec4(-1.0f, 0.0f, 0.0f, 50.0f),
+                       glm::vec4(0.0f, 1.0f, 0.0f, 50.0f),
+                       glm::vec4(0.0f, -1.0f, 0.0f, 50.0f),
+                       glm::vec4(0.0f, 0.0f, 1.0f, 50.0f),
+                       glm::vec4(glm::normalize(glm::vec3(0.3f, 0.2f, -1.0f)), 40.0f)};
+
+/**
+ * @brief Small triangles scattered through a 200 unit box
+ */
+struct Soup {
+  std::vector<glm::vec3> vertices;
+  std::vector<Aabb>      boxes;
+
+  explicit Soup(size_t count)
+  {
+    std::mt19937                          random(static_cast<uint32_t>(count));
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> offset(-3.0f, 3.0f);
+
+    for (size_t i = 0; i < count; i++) {
+      glm::vec3 center(position(random), position(random), position(random));
+      Aabb      box;
+      for (int corner = 0; corner < 3; corner++) {
+        vertices.push_back(center + glm::vec3(offset(random), offset(random), offset(random)));
+        box.grow(vertices.back());
+      }
+      boxes.push_back(box);
+    }
+  }
+
+  bool intersect(const glm::vec3& origin, const glm::vec3& direction, uint32_t triangle, float& distance) const
+  {
+    return Bvh::intersect_triangle(
+        origin, direction, vertices[3 * triangle], vertices[3 * triangle + 1], vertices[3 * triangle + 2], distance);
+  }
+};
+
+bool outside(const Aabb& box)
+{
+  for (const auto& plane : planes) {
+    glm::vec3 farthest(plane.x >= 0.0f ? box.maximum.x : box.minimum.x,
+                       plane.y >= 0.0f ? box.maximum.y : box.minimum.y,
+                       plane.z >= 0.0f ? box.maximum.z : box.minimum.z);
+    if (glm::dot(glm::vec3(plane), farthest) + plane.w < 0.0f) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief The query may return primitives outside the frustum with their leaf, but never
+ * misses one inside it and returns each primitive once
+ */
+void check_query(const Bvh& bvh, const std::vector<Aabb>& boxes)
+{
+  std::vector<uint32_t> visible;
+  bvh.query_frustum(planes, visible);
+  std::sort(visible.begin(), visible.end());
+  CHECK(std::adjacent_find(visible.begin(), visible.end()) == visible.end());
+  CHECK(visible.empty() || visible.back() < boxes.size());
+
+  for (uint32_t i = 0; i < boxes.size(); i++) {
+    if (!outside(boxes[i])) {
+      CHECK(std::binary_search(visible.begin(), visible.end(), i));
+    }
+  }
+}
+
+void raycast_matches_brute_force()
+{
+  Soup soup(5000);
+  Bvh  bvh;
+  bvh.build(soup.boxes);
+
+  std::mt19937                          random(1);
+  std::uniform_real_distribution<float> position(-120.0f, 120.0f);
+  uint32_t                              hits = 0;
+  for (int ray = 0; ray < 2000; ray++) {
+    glm::vec3 origin(position(random), position(random), position(random));
+    glm::vec3 direction = glm::vec3(position(random), position(random), position(random)) - origin;
+
+    float    distance = std::numeric_limits<float>::max();
+    uint32_t closest  = UINT32_MAX;
+    for (uint32_t triangle = 0; triangle < soup.boxes.size(); triangle++) {
+      closest = soup.intersect(origin, direction, triangle, distance) ? triangle : closest;
+    }
+
+    auto hit = bvh.raycast(origin, direction, std::numeric_limits<float>::max(), [&](uint32_t triangle, float& t) {
+      return soup.intersect(origin, direction, triangle, t);
+    });
+    CHECK(hit.primitive == closest);
+    CHECK(closest == UINT32_MAX || hit.distance == distance);
+    hits += closest != UINT32_MAX ? 1 : 0;
+  }
+  CHECK(hits > 100);  // Enough rays hit for the comparison to mean something
+}
+
+void raycast_max_distance()
+{
+  Soup soup(1000);
+  Bvh  bvh;
+  bvh.build(soup.boxes);
+
+  // Aimed at the middle of a triangle, so something is hit
+  glm::vec3 origin(-150.0f, 0.0f, 0.0f);
+  glm::vec3 direction = (soup.vertices[0] + soup.vertices[1] + soup.vertices[2]) / 3.0f - origin;
+  auto      intersect = [&](uint32_t triangle, float& t) { return soup.intersect(origin, direction, triangle, t); };
+
+  auto hit = bvh.raycast(origin, direction, std::numeric_limits<float>::max(), intersect);
+  CHECK(hit.primitive != UINT32_MAX);
+  CHECK(bvh.raycast(origin, direction, hit.distance * 0.99f, intersect).primitive == UINT32_MAX);
+}
+
+void frustum_query()
+{
+  for (size_t count : {1, 3, 4, 5, 100, 20000}) {
+    Soup soup(count);
+    Bvh  bvh;
+    bvh.build(soup.boxes);
+    check_query(bvh, soup.boxes);
+  }
+}
+
+void empty()
+{
+  Bvh bvh;
+  bvh.build({});
+  CHECK(bvh.empty());
+
+  std::vector<uint32_t> visible = {1, 2, 3};
+  bvh.query_frustum(planes, visible);
+  CHECK(visible.empty());
+  CHECK(bvh.raycast(glm::vec3(0.0f), glm::vec3(1.0f), 1.0f, [](uint32_t, float&) { return true; }).primitive ==
+        UINT32_MAX);
+}
+
+/**
+ * @brief Subtrees built as pool tasks come out the same as a serial build
+ */
+void pool_build()
+{
+  Rake::Base::ThreadPool pool(4);
+  for (size_t count : {1, 100, 5000, 200000}) {
+    Soup soup(count);
+    Bvh  serial;
+    Bvh  parallel;
+    serial.build(soup.boxes);
+    parallel.build(soup.boxes, &pool);
+
+    CHECK(serial.node_count() == parallel.node_count());
+    CHECK(serial.sah_cost() == parallel.sah_cost());
+
+    std::vector<uint32_t> serialVisible;
+    std::vector<uint32_t> parallelVisible;
+    serial.query_frustum(planes, serialVisible);
+    parallel.query_frustum(planes, parallelVisible);
+    CHECK(serialVisible == parallelVisible);
+  }
+}
+
+void refit()
+{
+  Soup soup(5000);
+  Bvh  bvh;
+  bvh.build(soup.boxes);
+
+  for (auto& box : soup.boxes) {
+    box.minimum.z += 30.0f;
+    box.maximum.z += 30.0f;
+  }
+  bvh.refit(soup.boxes);
+
+  check_query(bvh, soup.boxes);
+  CHECK(bvh.bounds().maximum.z <= 133.0f);
+  CHECK(bvh.bounds().minimum.z >= -73.0f);
+}
+
+}  // namespace
+
+int main()
+{
+  Rake::Test::Suite suite;
+  suite.run("raycast matches brute force", raycast_matches_brute_force);
+  suite.run("raycast max distance", raycast_max_distance);
+  suite.run("frustum query", frustum_query);
+  suite.run("empty", empty);
+  suite.run("pool build", pool_build);
+  suite.run("refit", refit);
+  return suite.result();
+}
@@ -0,0 +1,68 @@
+#if !defined(CHECK_H)
+#define CHECK_H
+
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace Rake { namespace Test {
+
+/**
+ * @brief Thrown by a failed check, ends the test case it is in
+ */
+class Failure : public std::runtime_error {
+  public:
+  using std::runtime_error::runtime_error;
+};
+
+inline void check(bool passed, const char* expression, const char* file, int line)
+{
+  if (!passed) {
+    throw Failure(std::string(file) + ":" + std::to_string(line) + ": " + expression);
+  }
+}
+
+template <typename F>
+void check_throws(F&& body, const char* expression, const char* file, int line)
+{
+  try {
+    body();
+  } catch (const Failure&) {
+    throw;
+  } catch (const std::exception&) {
+    return;
+  }
+  throw Failure(std::string(file) + ":" + std::to_string(line) + ": " + expression + " did not throw");
+}
+
+/**
+ * @brief Runs test cases one after another, a case that fails or throws does not stop
+ * the others
+ */
+class Suite {
+  public:
+  void run(const std::string& name, const std::function<void()>& test)
+  {
+    try {
+      test();
+      std::cout << "ok      " << name << "\n";
+    } catch (const std::exception& error) {
+      failures++;
+      std::cout << "FAILED  " << name << "\n        " << error.what() << "\n";
+    }
+  }
+
+  int result() const { return failures == 0 ? 0 : 1; }  // Exit code for meson's test()
+
+  private:
+  int failures = 0;
+};
+
+}}  // namespace Rake::Test
+
+#define CHECK(expression) Rake::Test::check((expression), #expression, __FILE__, __LINE__)
+#define CHECK_THROWS(expression) \
+  Rake::Test::check_throws([&]() { expression; }, #expression, __FILE__, __LINE__)
+
+#endif  // CHECK_H
@@ -0,0 +1,141 @@
+#include <array>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "check.h"
+#include "scene/frustumculler.h"
+#include "skeleton/simd.h"
+
+using Rake::Base::SimdLevel;
+using Rake::Scene::FrustumCuller;
+
+namespace {
+
+using Planes = std::array<glm::vec4, 6>;
+
+// A 100 unit box around the origin with one face tilted, inward normals
+const Planes planes = {glm::vec4(1.0f, 0.0f, 0.0f, 50.0f),
+                       glm::vec4(-1.0f, 0.0f, 0.0f, 50.0f),
+                       glm::vec4(0.0f, 1.0f, 0.0f, 50.0f),
+                       glm::vec4(0.0f, -1.0f, 0.0f, 50.0f),
+                       glm::vec4(0.0f, 0.0f, 1.0f, 50.0f),
+                       glm::vec4(glm::normalize(glm::vec3(0.3f, 0.2f, -1.0f)), 40.0f)};
+
+std::vector<glm::vec4> random_spheres(size_t count)
+{
+  std::mt19937                          random(static_cast<uint32_t>(count));
+  std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+  std::uniform_real_distribution<float> size(0.5f, 10.0f);
+
+  std::vector<glm::vec4> spheres(count);
+  for (auto& sphere : spheres) {
+    sphere = glm::vec4(position(random), position(random), position(random), size(random));
+  }
+  return spheres;
+}
+
+/**
+ * @brief Spheres not fully outside a plane, tested one by one in the culler's summation order
+ */
+std::vector<uint32_t> expected_visible(const std::vector<glm::vec4>& spheres)
+{
+  std::vector<uint32_t> visible;
+  for (size_t i = 0; i < spheres.size(); i++) {
+    bool inside = true;
+    for (const auto& plane : planes) {
+      float distance = plane.x * spheres[i].x + plane.y * spheres[i].y + plane.z * spheres[i].z + plane.w;
+      inside         = inside && distance >= -spheres[i].w;
+    }
+    if (inside) {
+      visible.push_back(static_cast<uint32_t>(i));
+    }
+  }
+  return visible;
+}
+
+std::vector<uint32_t> cull(SimdLevel level, const std::vector<glm::vec4>& spheres)
+{
+  FrustumCuller culler(level);
+  culler.resize(spheres.size());
+  for (size_t i = 0; i < spheres.size(); i++) {
+    culler.set_sphere(i, glm::vec3(spheres[i]), spheres[i].w);
+  }
+  size_t count = culler.cull(planes);
+  return std::vector<uint32_t>(culler.visible(), culler.visible() + count);
+}
+
+/**
+ * @brief Counts that leave every SIMD width a scalar tail, or nothing but a tail
+ */
+void matches_plane_test()
+{
+  for (size_t count : {0, 1, 3, 7, 9, 17, 1003, 100000}) {
+    std::vector<glm::vec4> spheres  = random_spheres(count);
+    std::vector<uint32_t>  expected = expected_visible(spheres);
+    for (auto level : Rake::Base::simd_levels()) {
+      CHECK(cull(level, spheres) == expected);
+    }
+  }
+}
+
+/**
+ * @brief A sphere touching a plane from outside is kept, one a little further is culled
+ */
+void touching_spheres()
+{
+  std::vector<glm::vec4> spheres = {glm::vec4(-52.0f, 0.0f, 0.0f, 2.0f),
+                                    glm::vec4(-52.5f, 0.0f, 0.0f, 2.0f),
+                                    glm::vec4(0.0f, 53.0f, 0.0f, 3.0f),
+                                    glm::vec4(0.0f, 0.0f, -54.0f, 3.0f)};
+  for (int copy = 0; copy < 3; copy++) {  // Fills a whole AVX2 block and leaves a tail
+    spheres.insert(spheres.end(), spheres.begin(), spheres.begin() + 4);
+  }
+
+  for (auto level : Rake::Base::simd_levels()) {
+    std::vector<uint32_t> visible = cull(level, spheres);
+    CHECK(visible.size() == 8);
+    for (auto index : visible) {
+      CHECK(index % 4 == 0 || index % 4 == 2);
+    }
+  }
+}
+
+/**
+ * @brief Culling again after moving spheres and shrinking the set uses the new spheres only
+ */
+void reuse()
+{
+  std::vector<glm::vec4> spheres = random_spheres(1000);
+  for (auto level : Rake::Base::simd_levels()) {
+    FrustumCuller culler(level);
+    culler.resize(spheres.size());
+    for (size_t i = 0; i < spheres.size(); i++) {
+      culler.set_sphere(i, glm::vec3(spheres[i]), spheres[i].w);
+    }
+    culler.cull(planes);
+
+    culler.resize(10);
+    for (size_t i = 0; i < 10; i++) {
+      culler.set_sphere(i, glm::vec3(i % 2 == 0 ? 0.0f : 500.0f), 1.0f);
+    }
+    size_t visible = culler.cull(planes);
+    CHECK(visible == 5);
+    for (size_t i = 0; i < visible; i++) {
+      CHECK(culler.visible()[i] == 2 * i);
+    }
+  }
+}
+
+}  // namespace
+
+int main()
+{
+  Rake::Test::Suite suite;
+  suite.run("matches plane test", matches_plane_test);
+  suite.run("touching spheres", touching_spheres);
+  suite.run("reuse", reuse);
+  return suite.result();
+}
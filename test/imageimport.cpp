@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "skeleton/simd.h"
+#include "skeleton/threadpool.h"
+#include "texture/imageimport.h"
+
+using Rake::Texture::ImageImporter;
+using Rake::Texture::ImportedImage;
+using Rake::Texture::StagingRing;
+
+namespace {
+
+bool aligned(const StagingRing::Allocation& allocation)
+{
+  return allocation.offset % StagingRing::alignment == 0;
+}
+
+/**
+ * @brief Ranges follow each other front to back at aligned offsets, and the ring starts
+ * over once it is empty
+ */
+void ring_order()
+{
+  std::vector<uint8_t> memory(1000);
+  StagingRing          ring(memory.data(), memory.size());
+
+  auto first  = ring.acquire(100);
+  auto second = ring.acquire(1);
+  auto third  = ring.acquire(100);
+  CHECK(first.offset == 0 && second.offset == 112 && third.offset == 128);
+  CHECK(aligned(first) && aligned(second) && aligned(third));
+  CHECK(ring.data(second) == memory.data() + 112);
+
+  ring.release(first);
+  ring.release(second);
+  ring.release(third);
+  CHECK(ring.acquire(1000).offset == 0);  // The whole ring once it is empty
+}
+
+/**
+ * @brief A range that doesn't fit after the head goes to the front once the ranges there
+ * are released
+ */
+void ring_wraparound()
+{
+  std::vector<uint8_t> memory(400);
+  StagingRing          ring(memory.data(), memory.size());
+
+  auto first  = ring.acquire(150);
+  auto second = ring.acquire(150);
+  ring.release(first);
+
+  auto wrapped = ring.acquire(150);
+  CHECK(second.offset == 160 && wrapped.offset == 0);
+  ring.release(second);
+  ring.release(wrapped);
+}
+
+/**
+ * @brief A range released before an older one is only reused once the older one is
+ * released too. acquire() waits for that on another thread.
+ */
+void ring_out_of_order_release()
+{
+  std::vector<uint8_t> memory(400);
+  StagingRing          ring(memory.data(), memory.size());
+
+  auto first  = ring.acquire(100);
+  auto second = ring.acquire(100);
+  auto third  = ring.acquire(100);
+  ring.release(second);
+
+  std::atomic<bool>       acquired(false);
+  StagingRing::Allocation waited;
+  std::thread             waiter([&]() {
+    waited   = ring.acquire(150);
+    acquired = true;
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  bool early = acquired;  // The space second left can't be used while first is live
+  ring.release(first);
+  waiter.join();
+
+  CHECK(!early);
+  CHECK(waited.offset == 0);
+  CHECK(waited.offset + waited.size <= third.offset);
+  ring.release(third);
+  ring.release(waited);
+}
+
+void ring_misuse()
+{
+  std::vector<uint8_t> memory(400);
+  StagingRing          ring(memory.data(), memory.size());
+
+  CHECK_THROWS(ring.acquire(401));
+  auto allocation = ring.acquire(100);
+  CHECK_THROWS(ring.release({16, 100}));
+  ring.release(allocation);
+  CHECK_THROWS(ring.release(allocation));
+}
+
+/**
+ * @brief Counts that leave every SIMD width a scalar tail, nothing past the last texel is
+ * written
+ */
+void expand_rgb()
+{
+  std::mt19937 random(3);
+  for (size_t count : {0, 1, 2, 3, 5, 7, 9, 11, 17, 100, 1001}) {
+    std::vector<uint8_t> rgb(count * 3);
+    for (auto& channel : rgb) {
+      channel = static_cast<uint8_t>(random());
+    }
+
+    for (auto level : Rake::Base::simd_levels()) {
+      std::vector<uint8_t> rgba(count * 4 + 64, 7);
+      Rake::Texture::expand_rgb(rgb.data(), rgba.data(), count, level);
+      for (size_t i = 0; i < count; i++) {
+        CHECK(rgba[4 * i] == rgb[3 * i] && rgba[4 * i + 1] == rgb[3 * i + 1] && rgba[4 * i + 2] == rgb[3 * i + 2]);
+        CHECK(rgba[4 * i + 3] == 255);
+      }
+      CHECK(std::all_of(rgba.begin() + count * 4, rgba.end(), [](uint8_t byte) { return byte == 7; }));
+    }
+  }
+}
+
+/**
+ * @brief A binary PPM or PGM in the working directory and the RGBA8 texels it decodes to
+ */
+struct TestImage {
+  std::string          path;
+  uint32_t             width;
+  uint32_t             height;
+  std::vector<uint8_t> rgba;
+
+  TestImage(const std::string& name, uint32_t imageWidth, uint32_t imageHeight, uint32_t channels)
+      : path(name), width(imageWidth), height(imageHeight)
+  {
+    std::mt19937         random(imageWidth * imageHeight);
+    std::vector<uint8_t> texels(size_t(width) * height * channels);
+    for (auto& channel : texels) {
+      channel = static_cast<uint8_t>(random());
+    }
+    for (size_t i = 0; i < size_t(width) * height; i++) {
+      for (uint32_t c = 0; c < 3; c++) {
+        rgba.push_back(texels[i * channels + (channels == 3 ? c : 0)]);
+      }
+      rgba.push_back(255);
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    file << (channels == 3 ? "P6\n" : "P5\n") << width << " " << height << "\n255\n";
+    file.write(reinterpret_cast<const char*>(texels.data()), static_cast<std::streamsize>(texels.size()));
+  }
+  ~TestImage() { std::remove(path.c_str()); }
+};
+
+/**
+ * @brief Images decode to the texels they hold whether the importer has workers or not.
+ * The ring holds one of each image, so workers wait for the caller's releases.
+ */
+void import_images()
+{
+  const TestImage colour("imageimport_test_colour.ppm", 301, 77, 3);
+  const TestImage grey("imageimport_test_grey.pgm", 64, 129, 1);
+
+  uint32_t width, height;
+  CHECK(ImageImporter::image_size(colour.path, width, height) && width == 301 && height == 77);
+  CHECK(!ImageImporter::image_size("imageimport_test_missing.png", width, height));
+
+  std::vector<uint8_t> memory(colour.rgba.size() + grey.rgba.size());
+  StagingRing          ring(memory.data(), memory.size());
+
+  Rake::Base::ThreadPool pool(3);
+  for (auto workers : {static_cast<Rake::Base::ThreadPool*>(nullptr), &pool}) {
+    for (auto level : Rake::Base::simd_levels()) {
+      ImageImporter importer(ring, workers, level);
+      for (int copy = 0; copy < 10; copy++) {
+        importer.submit(colour.path);
+        importer.submit(grey.path);
+      }
+      CHECK(importer.pending() == 20);
+
+      while (importer.pending() > 0) {
+        ImportedImage    image    = importer.next();
+        const TestImage& expected = image.path == colour.path ? colour : grey;
+        CHECK(image.path == expected.path);
+        CHECK(image.width == expected.width && image.height == expected.height);
+        CHECK(aligned(image.texels) && image.texels.size == expected.rgba.size());
+        CHECK(std::equal(expected.rgba.begin(), expected.rgba.end(), ring.data(image.texels)));
+        ring.release(image.texels);
+      }
+    }
+  }
+}
+
+void import_errors()
+{
+  std::vector<uint8_t> memory(1024);
+  StagingRing          ring(memory.data(), memory.size());
+
+  Rake::Base::ThreadPool pool(2);
+  for (auto workers : {static_cast<Rake::Base::ThreadPool*>(nullptr), &pool}) {
+    ImageImporter importer(ring, workers);
+    CHECK_THROWS(importer.next());
+
+    importer.submit("imageimport_test_missing.png");
+    CHECK_THROWS(importer.next());
+    CHECK(importer.pending() == 0);
+  }
+}
+
+}  // namespace
+
+int main()
+{
+  Rake::Test::Suite suite;
+  suite.run("ring order", ring_order);
+  suite.run("ring wraparound", ring_wraparound);
+  suite.run("ring out of order release", ring_out_of_order_release);
+  suite.run("ring misuse", ring_misuse);
+  suite.run("expand rgb", expand_rgb);
+  suite.run("import images", import_images);
+  suite.run("import errors", import_errors);
+  return suite.result();
+}
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "check.h"
+#include "skeleton/simd.h"
+#include "skeleton/threadpool.h"
+#include "texture/mipchain.h"
+
+using Rake::Base::SimdLevel;
+using Rake::Texture::ColorSpace;
+using Rake::Texture::MipBuilder;
+using Rake::Texture::MipChain;
+
+namespace {
+
+void level_sizes()
+{
+  std::vector<uint8_t> texels(size_t(37) * 20 * 4);
+  MipChain             chain = MipBuilder().build(texels.data(), 37, 20, ColorSpace::Linear);
+
+  CHECK(chain.level_count() == Rake::Texture::mip_level_count(37, 20));
+  CHECK(chain.level_count() == 6);
+  size_t offset = 0;
+  for (uint32_t level = 0; level < chain.level_count(); level++) {
+    const auto& mip = chain.levels[level];
+    CHECK(mip.width == std::max(37u >> level, 1u) && mip.height == std::max(20u >> level, 1u));
+    CHECK(mip.offset == offset && mip.size == size_t(mip.width) * mip.height * 4);
+    offset += mip.size;
+  }
+  CHECK(chain.data.size() == offset);
+}
+
+/**
+ * @brief Black and white average to the sRGB encoding of half the light, not to 128.
+ * Alpha is linear.
+ */
+void srgb_average()
+{
+  std::vector<uint8_t> texels(4 * 4 * 4);
+  for (size_t i = 0; i < texels.size(); i += 4) {
+    uint8_t value = (i / 4) % 2 == 0 ? 0 : 255;
+    texels[i]     = value;
+    texels[i + 1] = value;
+    texels[i + 2] = value;
+    texels[i + 3] = value;
+  }
+
+  MipChain srgb   = MipBuilder(SimdLevel::Scalar).build(texels.data(), 4, 4, ColorSpace::Srgb);
+  MipChain linear = MipBuilder(SimdLevel::Scalar).build(texels.data(), 4, 4, ColorSpace::Linear);
+  CHECK(srgb.level_data(1)[0] == 188 && srgb.level_data(1)[3] == 128);
+  CHECK(linear.level_data(1)[0] == 128 && linear.level_data(1)[3] == 128);
+}
+
+/**
+ * @brief Sizes that halve exactly, that don't, and single rows and columns, on every SIMD
+ * level with and without a pool
+ */
+void matches_scalar()
+{
+  const std::pair<uint32_t, uint32_t> sizes[] = {{256, 256}, {37, 20}, {1, 9}, {100, 3}, {513, 255}, {1024, 512}};
+
+  Rake::Base::ThreadPool pool(4);
+  std::mt19937           random(3);
+  for (const auto& size : sizes) {
+    std::vector<uint8_t> texels(size_t(size.first) * size.second * 4);
+    for (auto& texel : texels) {
+      texel = static_cast<uint8_t>(random());
+    }
+
+    for (auto space : {ColorSpace::Linear, ColorSpace::Srgb}) {
+      MipChain reference = MipBuilder(SimdLevel::Scalar).build(texels.data(), size.first, size.second, space);
+      for (auto level : Rake::Base::simd_levels()) {
+        for (auto workers : {static_cast<Rake::Base::ThreadPool*>(nullptr), &pool}) {
+          MipChain chain = MipBuilder(level, workers).build(texels.data(), size.first, size.second, space);
+          CHECK(chain.data == reference.data);
+        }
+      }
+    }
+  }
+}
+
+}  // namespace
+
+int main()
+{
+  Rake::Test::Suite suite;
+  suite.run("level sizes", level_sizes);
+  suite.run("sRGB average", srgb_average);
+  suite.run("matches scalar", matches_scalar);
+  return suite.result();
+}
@@ -0,0 +1,431 @@
+#include <cstdint>
+#include <vector>
+
+#include "check.h"
+#include "vulkan/VulkanFunctions.h"
+#include "vulkan/VulkanRenderGraph.h"
+
+using Rake::Graphics::AttachmentOps;
+using Rake::Graphics::ImageInfo;
+using Rake::Graphics::ImageUse;
+using Rake::Graphics::PassId;
+using Rake::Graphics::PassType;
+using Rake::Graphics::RenderGraph;
+using Rake::Graphics::ResourceId;
+
+namespace {
+
+/**
+ * @brief One vkCmdPipelineBarrier call of RenderGraph::execute()
+ */
+struct Batch {
+  uint32_t                          passesBefore;  // Passes recorded before the call
+  VkPipelineStageFlags              srcStages;
+  VkPipelineStageFlags              dstStages;
+  std::vector<VkImageMemoryBarrier> barriers;
+};
+
+std::vector<Batch> batches;
+uint32_t           passesRecorded = 0;
+
+void VKAPI_PTR record_barrier(VkCommandBuffer,
+                              VkPipelineStageFlags srcStages,
+                              VkPipelineStageFlags dstStages,
+                              VkDependencyFlags,
+                              uint32_t,
+                              const VkMemoryBarrier*,
+                              uint32_t,
+                              const VkBufferMemoryBarrier*,
+                              uint32_t                    barrierCount,
+                              const VkImageMemoryBarrier* barriers)
+{
+  batches.push_back({passesRecorded, srcStages, dstStages, {barriers, barriers + barrierCount}});
+}
+
+VkImage handle(ResourceId resource)
+{
+  return reinterpret_cast<VkImage>(static_cast<uintptr_t>(resource) + 1);
+}
+
+/**
+ * @brief Bind every image to a made up handle and record the frame
+ *
+ * @param images first versions of the graph's images
+ * @return the passes in the order they were recorded
+ */
+std::vector<PassId> execute(RenderGraph& graph, const std::vector<ResourceId>& images)
+{
+  vkCmdPipelineBarrier = record_barrier;
+  batches.clear();
+  passesRecorded = 0;
+
+  for (ResourceId image : images) {
+    graph.bind(image, handle(image));
+  }
+  std::vector<PassId> recorded;
+  graph.execute(VK_NULL_HANDLE, [&](PassId pass) {
+    recorded.push_back(pass);
+    passesRecorded++;
+  });
+  return recorded;
+}
+
+const VkImageMemoryBarrier* find_barrier(const Batch& batch, ResourceId image)
+{
+  for (const auto& barrier : batch.barriers) {
+    if (barrier.image == handle(image)) {
+      return &barrier;
+    }
+  }
+  return nullptr;
+}
+
+ImageInfo transient(const char* name, VkDeviceSize size = 0, VkDeviceSize alignment = 1, uint32_t typeBits = ~0u)
+{
+  ImageInfo info;
+  info.name                  = name;
+  info.memory.size           = size;
+  info.memory.alignment      = alignment;
+  info.memory.memoryTypeBits = typeBits;
+  return info;
+}
+
+ImageInfo swapchain()
+{
+  ImageInfo info;
+  info.name        = "swapchain";
+  info.imported    = true;
+  info.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  return info;
+}
+
+/**
+ * @brief Passes are kept for the final contents of imported images, their side effects,
+ * or for feeding a kept pass, and dropped otherwise along with whatever feeds only them
+ */
+void culling()
+{
+  RenderGraph graph;
+  ResourceId  present = graph.add_image(swapchain());
+  ResourceId  scene   = graph.add_image(transient("scene"));
+  ResourceId  unused  = graph.add_image(transient("unused"));
+  ResourceId  debug   = graph.add_image(transient("debug"));
+
+  auto       draw  = graph.add_pass("draw", PassType::Compute);
+  ResourceId drawn = draw.write(scene, ImageUse::Storage);
+
+  auto blit = graph.add_pass("blit", PassType::Transfer);
+  blit.read(drawn, ImageUse::TransferSource);
+  blit.write(present, ImageUse::TransferDestination);
+
+  auto       feed = graph.add_pass("feed", PassType::Compute);
+  ResourceId fed  = feed.write(unused, ImageUse::Storage);
+
+  auto view = graph.add_pass("debug view");
+  view.read(fed, ImageUse::Sampled);
+  view.write(debug, ImageUse::ColorAttachment, true);
+
+  auto readback = graph.add_pass("readback", PassType::Compute);
+  readback.read(drawn, ImageUse::Sampled).side_effects();
+
+  graph.compile();
+
+  CHECK(!graph.culled(draw.id()));
+  CHECK(!graph.culled(blit.id()));
+  CHECK(graph.culled(feed.id()));
+  CHECK(graph.culled(view.id()));
+  CHECK(!graph.culled(readback.id()));
+  CHECK((graph.order() == std::vector<PassId>{draw.id(), blit.id(), readback.id()}));
+}
+
+/**
+ * @brief Passes follow what they read and the readers of what they overwrite, whatever
+ * order they were declared in, and ties keep the declaration order
+ */
+void ordering()
+{
+  RenderGraph graph;
+  ResourceId  present = graph.add_image(swapchain());
+  ResourceId  hdr     = graph.add_image(transient("hdr"));
+  ResourceId  bloom   = graph.add_image(transient("bloom"));
+  ResourceId  first   = graph.add_image(transient("first"));
+  ResourceId  second  = graph.add_image(transient("second"));
+
+  auto tonemap  = graph.add_pass("tone map");
+  auto lighting = graph.add_pass("lighting");
+  auto overlay  = graph.add_pass("overlay");
+  auto blur     = graph.add_pass("blur", PassType::Compute);
+
+  ResourceId lit = lighting.write(hdr, ImageUse::ColorAttachment, true);
+  ResourceId hud = overlay.write(lit, ImageUse::ColorAttachment);  // Must wait for blur to read lit
+  blur.read(lit, ImageUse::Sampled);
+  ResourceId blurred = blur.write(bloom, ImageUse::Storage);
+  tonemap.read(hud, ImageUse::Sampled).read(blurred, ImageUse::Sampled);
+  tonemap.write(present, ImageUse::ColorAttachment);
+
+  auto independentA = graph.add_pass("independent a", PassType::Compute);
+  auto independentB = graph.add_pass("independent b", PassType::Compute);
+  independentB.write(second, ImageUse::Storage);
+  independentB.side_effects();
+  independentA.write(first, ImageUse::Storage);
+  independentA.side_effects();
+
+  graph.compile();
+
+  std::vector<PassId> expected = {
+      lighting.id(), blur.id(), overlay.id(), tonemap.id(), independentA.id(), independentB.id()};
+  CHECK(graph.order() == expected);
+
+  std::vector<PassId> recorded = execute(graph, {present, hdr, bloom, first, second});
+  CHECK(recorded == graph.order());
+}
+
+void cycle_detection()
+{
+  RenderGraph graph;
+  ResourceId  x = graph.add_image(transient("x"));
+  ResourceId  y = graph.add_image(transient("y"));
+
+  auto       a  = graph.add_pass("a", PassType::Compute);
+  ResourceId x1 = a.write(x, ImageUse::Storage);
+  auto       b  = graph.add_pass("b", PassType::Compute);
+  b.read(x1, ImageUse::Sampled);
+  ResourceId y1 = b.write(y, ImageUse::Storage);
+  a.read(y1, ImageUse::Sampled).side_effects();
+
+  CHECK_THROWS(graph.compile());
+  CHECK_THROWS(execute(graph, {x, y}));
+}
+
+/**
+ * @brief Render pass into a compute pass into a transfer pass into presentation: one
+ * batch per pass that has hazards, with the stages, layouts and access of both sides
+ */
+void barriers()
+{
+  RenderGraph graph;
+  ImageInfo   presentInfo   = swapchain();
+  presentInfo.initialStages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+  ResourceId present = graph.add_image(presentInfo);
+  ResourceId scene   = graph.add_image(transient("scene"));
+  ResourceId hdr     = graph.add_image(transient("hdr"));
+
+  auto       draw  = graph.add_pass("draw");
+  ResourceId drawn = draw.write(scene, ImageUse::ColorAttachment, true);
+
+  auto post = graph.add_pass("post", PassType::Compute);
+  post.read(drawn, ImageUse::Sampled);
+  ResourceId processed = post.write(hdr, ImageUse::Storage);
+
+  auto blit = graph.add_pass("blit", PassType::Transfer);
+  blit.read(processed, ImageUse::TransferSource);
+  blit.write(present, ImageUse::TransferDestination);
+
+  graph.compile();
+  execute(graph, {present, scene, hdr});
+
+  CHECK(graph.barrier_batches() == 3);
+  CHECK(graph.barrier_count() == 5);
+  CHECK(batches.size() == 3);
+
+  // The render pass takes the scene from undefined itself, nothing precedes it.
+  const Batch& toCompute = batches[0];
+  CHECK(toCompute.passesBefore == 1);
+  CHECK(toCompute.srcStages == (VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT));
+  CHECK(toCompute.dstStages == VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+  CHECK(toCompute.barriers.size() == 2);
+
+  const VkImageMemoryBarrier* sampled = find_barrier(toCompute, scene);
+  CHECK(sampled != nullptr);
+  CHECK(sampled->oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+  CHECK(sampled->newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  CHECK(sampled->srcAccessMask == VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+  CHECK(sampled->dstAccessMask == VK_ACCESS_SHADER_READ_BIT);
+
+  const VkImageMemoryBarrier* storage = find_barrier(toCompute, hdr);
+  CHECK(storage != nullptr);
+  CHECK(storage->oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+  CHECK(storage->newLayout == VK_IMAGE_LAYOUT_GENERAL);
+  CHECK(storage->srcAccessMask == 0);
+  CHECK(storage->dstAccessMask == VK_ACCESS_SHADER_WRITE_BIT);
+
+  // The transfer pass waits in the transfer stage only, and on the acquire semaphore's stage.
+  const Batch& toTransfer = batches[1];
+  CHECK(toTransfer.passesBefore == 2);
+  CHECK(toTransfer.srcStages == (VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT));
+  CHECK(toTransfer.dstStages == VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+  const VkImageMemoryBarrier* source = find_barrier(toTransfer, hdr);
+  CHECK(source != nullptr);
+  CHECK(source->oldLayout == VK_IMAGE_LAYOUT_GENERAL);
+  CHECK(source->newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+  CHECK(source->srcAccessMask == VK_ACCESS_SHADER_WRITE_BIT);
+  CHECK(source->dstAccessMask == VK_ACCESS_TRANSFER_READ_BIT);
+
+  const VkImageMemoryBarrier* destination = find_barrier(toTransfer, present);
+  CHECK(destination != nullptr);
+  CHECK(destination->oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+  CHECK(destination->newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  CHECK(destination->dstAccessMask == VK_ACCESS_TRANSFER_WRITE_BIT);
+
+  const Batch& toPresent = batches[2];
+  CHECK(toPresent.passesBefore == 3);
+  CHECK(toPresent.srcStages == VK_PIPELINE_STAGE_TRANSFER_BIT);
+  CHECK(toPresent.dstStages == VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+  CHECK(toPresent.barriers.size() == 1);
+  CHECK(toPresent.barriers[0].oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  CHECK(toPresent.barriers[0].newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+  CHECK(toPresent.barriers[0].srcAccessMask == VK_ACCESS_TRANSFER_WRITE_BIT);
+}
+
+/**
+ * @brief Attachments are cleared or loaded as declared, stored only when something reads
+ * them later, and an imported image ends in its final layout
+ */
+void load_store_ops()
+{
+  RenderGraph graph;
+  ResourceId  present = graph.add_image(swapchain());
+  ResourceId  color   = graph.add_image(transient("color"));
+  ResourceId  scratch = graph.add_image(transient("scratch"));
+
+  auto       early  = graph.add_pass("early");
+  ResourceId first  = early.write(color, ImageUse::ColorAttachment, true);
+  ResourceId unread = early.write(scratch, ImageUse::ColorAttachment, true);
+
+  auto late = graph.add_pass("late");
+  late.read(first, ImageUse::ColorAttachment);
+  late.write(first, ImageUse::ColorAttachment);
+  late.write(present, ImageUse::Resolve);
+
+  CHECK_THROWS(graph.attachment(early.id(), color));
+  graph.compile();
+
+  AttachmentOps cleared = graph.attachment(early.id(), color);
+  CHECK(cleared.loadOp == VK_ATTACHMENT_LOAD_OP_CLEAR);
+  CHECK(cleared.storeOp == VK_ATTACHMENT_STORE_OP_STORE);
+  CHECK(cleared.initialLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+  CHECK(cleared.finalLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+  AttachmentOps discarded = graph.attachment(early.id(), unread);
+  CHECK(discarded.loadOp == VK_ATTACHMENT_LOAD_OP_CLEAR);
+  CHECK(discarded.storeOp == VK_ATTACHMENT_STORE_OP_DONT_CARE);
+
+  AttachmentOps loaded = graph.attachment(late.id(), color);
+  CHECK(loaded.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD);
+  CHECK(loaded.storeOp == VK_ATTACHMENT_STORE_OP_DONT_CARE);
+  CHECK(loaded.initialLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+  AttachmentOps resolved = graph.attachment(late.id(), present);
+  CHECK(resolved.loadOp == VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+  CHECK(resolved.storeOp == VK_ATTACHMENT_STORE_OP_STORE);
+  CHECK(resolved.finalLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+  CHECK(graph.memoryless(scratch));
+  CHECK(!graph.memoryless(color));
+  CHECK(!graph.memoryless(present));
+  CHECK_THROWS(graph.attachment(early.id(), present));
+}
+
+/**
+ * @brief Transient images share a block when their lifetimes and memory types allow,
+ * and an image inherits the pending accesses of the block's previous occupant
+ */
+void aliasing()
+{
+  RenderGraph graph;
+  ResourceId  a       = graph.add_image(transient("a", 100, 16, 0x3));
+  ResourceId  b       = graph.add_image(transient("b", 300, 256, 0x1));
+  ResourceId  c       = graph.add_image(transient("c", 200, 64, 0x3));
+  ResourceId  d       = graph.add_image(transient("d", 50, 1, 0x2));
+  ResourceId  nothing = graph.add_image(transient("no memory"));
+
+  // Lifetimes in steps: a 0-1, b 1-2, c 2-3, d 3, no memory 0-3
+  auto p0 = graph.add_pass("p0", PassType::Compute);
+  auto p1 = graph.add_pass("p1", PassType::Compute);
+  auto p2 = graph.add_pass("p2", PassType::Compute);
+  auto p3 = graph.add_pass("p3", PassType::Compute);
+
+  ResourceId a1 = p0.write(a, ImageUse::Storage);
+  ResourceId n1 = p0.write(nothing, ImageUse::Storage);
+  p1.read(a1, ImageUse::Sampled);
+  ResourceId b1 = p1.write(b, ImageUse::Storage);
+  p2.read(b1, ImageUse::Sampled);
+  ResourceId c1 = p2.write(c, ImageUse::Storage);
+  p3.read(c1, ImageUse::Sampled).read(n1, ImageUse::Sampled);
+  p3.write(d, ImageUse::Storage);
+  p3.side_effects();
+
+  graph.compile();
+
+  const auto& blocks = graph.memory_blocks();
+  CHECK(blocks.size() == 3);
+  CHECK(graph.memory_block(b) == 0);
+  CHECK(graph.memory_block(a) == 1);
+  CHECK(graph.memory_block(c) == 1);
+  CHECK(graph.memory_block(d) == 2);
+  CHECK(graph.memory_block(nothing) == ~0u);
+
+  CHECK(blocks[1].size == 200);
+  CHECK(blocks[1].alignment == 64);
+  CHECK(blocks[1].memoryTypeBits == 0x3);
+  CHECK((blocks[1].images == std::vector<ResourceId>{a, c}));
+  CHECK(blocks[2].memoryTypeBits == 0x2);
+
+  // c waits for a's write as well as its reads before it may write the shared memory.
+  execute(graph, {a, b, c, d, nothing});
+  const VkImageMemoryBarrier* reuse = nullptr;
+  for (const auto& batch : batches) {
+    if (batch.passesBefore == 2) {
+      reuse = find_barrier(batch, c);
+    }
+  }
+  CHECK(reuse != nullptr);
+  CHECK(reuse->oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+  CHECK(reuse->srcAccessMask == VK_ACCESS_SHADER_WRITE_BIT);
+
+  graph.set_memory(nothing, {400, 1, 0x3});
+  graph.compile();
+  CHECK(graph.memory_block(nothing) != ~0u);
+}
+
+/**
+ * @brief Attachments belong to graphics passes, shader uses to graphics and compute passes
+ */
+void pass_types()
+{
+  RenderGraph graph;
+  ResourceId  present = graph.add_image(swapchain());
+  ResourceId  image   = graph.add_image(transient("image"));
+
+  auto compute = graph.add_pass("compute", PassType::Compute);
+  CHECK_THROWS(compute.write(image, ImageUse::ColorAttachment));
+  ResourceId written = compute.write(image, ImageUse::Storage);
+
+  auto transfer = graph.add_pass("transfer", PassType::Transfer);
+  CHECK_THROWS(transfer.read(written, ImageUse::Sampled));
+  CHECK_THROWS(transfer.write(present, ImageUse::Storage));
+  CHECK_THROWS(transfer.write(present, ImageUse::ColorAttachment));
+  transfer.read(written, ImageUse::TransferSource);
+  transfer.write(present, ImageUse::TransferDestination);
+
+  CHECK_THROWS(graph.set_memory(present, {1, 1, 1}));
+  graph.compile();
+  CHECK(graph.order().size() == 2);
+}
+
+}  // namespace
+
+int main()
+{
+  Rake::Test::Suite suite;
+  suite.run("culling", culling);
+  suite.run("ordering", ordering);
+  suite.run("cycle detection", cycle_detection);
+  suite.run("barriers", barriers);
+  suite.run("load and store ops", load_store_ops);
+  suite.run("aliasing", aliasing);
+  suite.run("pass types", pass_types);
+  return suite.result();
+}
@@ -0,0 +1,194 @@
+#include <cstdint>
+#include <vector>
+
+#include "check.h"
+#include "texture/mipchain.h"
+#include "texture/residency.h"
+
+using Rake::Texture::MipLevel;
+using Rake::Texture::ResidencyChange;
+using Rake::Texture::ResidencyManager;
+
+namespace {
+
+const uint32_t tailLevel = 3;  // 128x128 and below
+
+/**
+ * @brief Levels of a 1024x1024 texture with a byte a texel, 0 to 10
+ */
+std::vector<MipLevel> square_levels()
+{
+  std::vector<MipLevel> levels;
+  size_t                offset = 0;
+  for (uint32_t size = 1024; size > 0; size /= 2) {
+    levels.push_back({size, size, offset, size_t(size) * size});
+    offset += levels.back().size;
+  }
+  return levels;
+}
+
+const std::vector<MipLevel> levels = square_levels();
+
+uint64_t bytes_from(uint32_t level)
+{
+  uint64_t bytes = 0;
+  for (uint32_t i = level; i < levels.size(); i++) {
+    bytes += levels[i].size;
+  }
+  return bytes;
+}
+
+const uint64_t tailBytes = bytes_from(tailLevel);
+
+/**
+ * @brief Plan a frame that uses textures at level 0, complete every change and check the
+ * manager counts exactly the bytes of the levels it made resident
+ */
+std::vector<ResidencyChange> frame(ResidencyManager& manager, const std::vector<uint32_t>& used)
+{
+  for (auto texture : used) {
+    manager.use(texture, 0);
+  }
+  std::vector<ResidencyChange> changes = manager.plan();
+  for (const auto& change : changes) {
+    CHECK(manager.resident_level(change.texture) == change.level);
+    manager.complete(change.texture);
+  }
+
+  uint64_t resident = 0;
+  for (uint32_t texture = 0; texture < manager.stats().textureCount; texture++) {
+    resident += bytes_from(manager.resident_level(texture));
+  }
+  CHECK(manager.stats().residentBytes == resident);
+  return changes;
+}
+
+ResidencyManager manager_with(uint32_t textureCount, uint64_t budget)
+{
+  ResidencyManager manager(budget);
+  for (uint32_t texture = 0; texture < textureCount; texture++) {
+    CHECK(manager.add(levels, tailLevel) == texture);
+  }
+  return manager;
+}
+
+void tails()
+{
+  ResidencyManager manager = manager_with(4, 0);
+  CHECK(manager.stats().residentBytes == 4 * tailBytes);  // Over a budget of 0
+  CHECK(manager.resident_level(2) == tailLevel);
+  CHECK_THROWS(manager.add(levels, static_cast<uint32_t>(levels.size())));
+
+  // Nothing to drop below the tails, nothing streamed over the budget
+  CHECK(frame(manager, {0, 1}).empty());
+  CHECK(manager.stats().evictedLevels == 0 && manager.stats().streamedLevels == 0);
+}
+
+void streams_used_textures()
+{
+  ResidencyManager manager = manager_with(4, 4 * tailBytes + 2 * (bytes_from(0) - tailBytes));
+
+  auto changes = frame(manager, {0, 2});
+  CHECK(changes.size() == 2);
+  CHECK(manager.resident_level(0) == 0 && manager.resident_level(2) == 0);
+  CHECK(manager.resident_level(1) == tailLevel && manager.resident_level(3) == tailLevel);
+  CHECK(manager.stats().streamedLevels == 2 * tailLevel);
+  CHECK(manager.stats().residentBytes <= manager.stats().budget);
+
+  CHECK(frame(manager, {0, 2}).empty());  // Already resident
+}
+
+/**
+ * @brief Room for two of three textures at full detail besides the tails, each frame's
+ * texture takes its levels from the least recently used one
+ */
+void evicts_least_recently_used()
+{
+  ResidencyManager manager = manager_with(3, 3 * tailBytes + 2 * (bytes_from(0) - tailBytes));
+
+  frame(manager, {0});
+  frame(manager, {1});
+  frame(manager, {2});
+  CHECK(manager.resident_level(0) == tailLevel);
+  CHECK(manager.resident_level(1) == 0 && manager.resident_level(2) == 0);
+  CHECK(manager.stats().evictedLevels == tailLevel);
+  CHECK(manager.stats().residentBytes <= manager.stats().budget);
+
+  frame(manager, {0});
+  CHECK(manager.resident_level(1) == tailLevel);
+  CHECK(manager.resident_level(0) == 0 && manager.resident_level(2) == 0);
+}
+
+/**
+ * @brief Without room for both at full detail, two textures share what there is a level
+ * at a time rather than one getting everything
+ */
+void coarse_levels_first()
+{
+  ResidencyManager manager = manager_with(2, 2 * bytes_from(1) + levels[0].size - 1);
+
+  frame(manager, {0, 1});
+  CHECK(manager.resident_level(0) == 1 && manager.resident_level(1) == 1);
+}
+
+/**
+ * @brief A texture whose change is in flight keeps its level until complete()
+ */
+void pending_changes()
+{
+  ResidencyManager manager = manager_with(2, 2 * tailBytes + bytes_from(0) - tailBytes);
+
+  manager.use(0, 0);
+  CHECK(manager.plan().size() == 1);
+
+  // Texture 1 needs texture 0's levels, which are still being copied
+  manager.use(1, 0);
+  CHECK(manager.plan().empty());
+  CHECK(manager.resident_level(0) == 0 && manager.resident_level(1) == tailLevel);
+
+  manager.complete(0);
+  auto changes = frame(manager, {1});
+  CHECK(changes.size() == 2);
+  CHECK(manager.resident_level(0) == tailLevel && manager.resident_level(1) == 0);
+}
+
+/**
+ * @brief A budget below what the frame asked for drops the largest levels, as few as it
+ * takes, and never a tail
+ */
+void shrinking_budget()
+{
+  ResidencyManager manager = manager_with(3, UINT64_MAX);
+  frame(manager, {0, 1, 2});
+  CHECK(manager.stats().residentBytes == 3 * bytes_from(0));
+
+  manager.set_budget(3 * bytes_from(0) - 1);
+  frame(manager, {0, 1, 2});
+  uint32_t dropped = 0;
+  for (uint32_t texture = 0; texture < 3; texture++) {
+    CHECK(manager.resident_level(texture) <= 1);
+    dropped += manager.resident_level(texture);
+  }
+  CHECK(dropped == 1);  // One level 0 was enough
+
+  manager.set_budget(0);
+  frame(manager, {0, 1, 2});
+  for (uint32_t texture = 0; texture < 3; texture++) {
+    CHECK(manager.resident_level(texture) == tailLevel);
+  }
+  CHECK(manager.stats().residentBytes == 3 * tailBytes);
+}
+
+}  // namespace
+
+int main()
+{
+  Rake::Test::Suite suite;
+  suite.run("tails", tails);
+  suite.run("streams used textures", streams_used_textures);
+  suite.run("evicts least recently used", evicts_least_recently_used);
+  suite.run("coarse levels first", coarse_levels_first);
+  suite.run("pending changes", pending_changes);
+  suite.run("shrinking budget", shrinking_budget);
+  return suite.result();
+}
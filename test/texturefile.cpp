@@ -0,0 +1,145 @@
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#define VK_NO_PROTOTYPES
+#include <vulkan/vulkan.h>
+
+#include "check.h"
+#include "skeleton/simd.h"
+#include "texture/mipchain.h"
+#include "texture/texturefile.h"
+
+using Rake::Texture::ColorSpace;
+using Rake::Texture::MappedTexture;
+using Rake::Texture::TextureFile;
+
+namespace {
+
+// Where the on disk layout puts the index, and the size of each of its entries
+const uint64_t indexOffset = 32;
+const uint64_t levelSize   = 16;
+
+/**
+ * @brief A 4x4 RGBA8 texture with its three levels, written to the working directory.
+ * Its levels take 64, 16 and 4 bytes.
+ */
+struct TestFile {
+  std::string path;
+  TextureFile texture;
+
+  explicit TestFile(const std::string& name) : path(name)
+  {
+    std::mt19937         random(4);
+    std::vector<uint8_t> texels(4 * 4 * 4);
+    for (auto& texel : texels) {
+      texel = static_cast<uint8_t>(random());
+    }
+    texture.format = VK_FORMAT_R8G8B8A8_UNORM;
+    texture.space  = ColorSpace::Srgb;
+    texture.mips   = Rake::Texture::MipBuilder(Rake::Base::SimdLevel::Scalar).build(texels.data(), 4, 4, texture.space);
+    Rake::Texture::write_texture_file(path, texture);
+  }
+  ~TestFile() { std::remove(path.c_str()); }
+
+  uint64_t size() const { return indexOffset + levelSize * texture.mips.level_count() + texture.mips.data.size(); }
+
+  /**
+   * @brief Overwrite a little endian field of the file
+   */
+  void patch(uint64_t offset, uint64_t value) const
+  {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(static_cast<std::streamoff>(offset));
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  /**
+   * @brief Point the index at data starting from offset, each level right after the one
+   * before it as the loader expects
+   */
+  void move_levels(uint64_t offset) const
+  {
+    for (uint32_t level = 0; level < texture.mips.level_count(); level++) {
+      patch(indexOffset + levelSize * level, offset + texture.mips.levels[level].offset);
+    }
+  }
+
+  void truncate(uint64_t size) const
+  {
+    std::vector<char> bytes(size);
+    std::ifstream(path, std::ios::binary).read(bytes.data(), static_cast<std::streamsize>(size));
+    std::ofstream(path, std::ios::binary | std::ios::trunc).write(bytes.data(), static_cast<std::streamsize>(size));
+  }
+};
+
+void round_trip()
+{
+  const TestFile file("texturefile_test_round_trip.rtex");
+  CHECK(file.size() == 32 + 16 * 3 + 84);
+
+  TextureFile read = Rake::Texture::read_texture_file(file.path);
+  CHECK(read.format == file.texture.format && read.space == file.texture.space);
+  CHECK(read.mips.level_count() == file.texture.mips.level_count());
+  CHECK(read.mips.data == file.texture.mips.data);
+
+  MappedTexture mapped(file.path);
+  CHECK(mapped.data_size() == 84);
+  CHECK(mapped.levels()[2].offset == 80 && mapped.levels()[2].size == 4);
+}
+
+/**
+ * @brief Offsets the loader must not follow. Each file's index is packed and its sizes
+ * match the extent, only where the data starts is wrong.
+ */
+void crafted_offsets()
+{
+  const TestFile file("texturefile_test_crafted.rtex");
+  const uint64_t dataSize = file.texture.mips.data.size();
+
+  // Ends exactly at 2^64, so offset + size wraps to 0
+  file.move_levels(0 - dataSize);
+  CHECK_THROWS(MappedTexture(file.path));
+
+  // Past the end of the file
+  file.move_levels(file.size() + 1);
+  CHECK_THROWS(MappedTexture(file.path));
+
+  // Over the header and index, which the file is large enough to hold as data
+  file.move_levels(0);
+  CHECK_THROWS(MappedTexture(file.path));
+  file.move_levels(indexOffset);
+  CHECK_THROWS(MappedTexture(file.path));
+
+  // One byte short of the last level
+  file.move_levels(file.size() - dataSize + 1);
+  CHECK_THROWS(MappedTexture(file.path));
+
+  file.move_levels(file.size() - dataSize);
+  CHECK(MappedTexture(file.path).data_size() == dataSize);
+}
+
+void truncated()
+{
+  const TestFile file("texturefile_test_truncated.rtex");
+  file.truncate(file.size() - 1);
+  CHECK_THROWS(MappedTexture(file.path));
+  file.truncate(indexOffset + levelSize);  // Part of the index
+  CHECK_THROWS(MappedTexture(file.path));
+  file.truncate(8);
+  CHECK_THROWS(MappedTexture(file.path));
+}
+
+}  // namespace
+
+int main()
+{
+  Rake::Test::Suite suite;
+  suite.run("round trip", round_trip);
+  suite.run("crafted offsets", crafted_offsets);
+  suite.run("truncated", truncated);
+  return suite.result();
+}
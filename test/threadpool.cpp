@@ -0,0 +1,75 @@
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "skeleton/threadpool.h"
+
+using Rake::Base::ThreadPool;
+
+namespace {
+
+void submit_results()
+{
+  ThreadPool pool(2);
+  auto       sum    = pool.submit([]() { return 40 + 2; });
+  auto       failed = pool.submit([]() -> int { throw std::runtime_error("job"); });
+  CHECK(sum.get() == 42);
+  CHECK_THROWS(failed.get());
+}
+
+/**
+ * @brief Every index is visited once, whatever the chunking
+ */
+void covers_range()
+{
+  ThreadPool pool(3);
+  for (size_t count : {1, 2, 7, 12, 100, 1001}) {
+    for (size_t minChunk : {1, 5, 64}) {
+      std::vector<std::atomic<int>> visits(count);
+      pool.parallel_for(
+          count,
+          [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+              visits[i]++;
+            }
+          },
+          minChunk);
+      for (const auto& visit : visits) {
+        CHECK(visit == 1);
+      }
+    }
+  }
+}
+
+/**
+ * @brief The first chunk throws at once while the others are still running or queued,
+ * parallel_for() only rethrows once they have all finished with the caller's locals
+ */
+void throw_waits_for_chunks()
+{
+  ThreadPool          pool(2);
+  std::atomic<size_t> finished(0);
+  CHECK_THROWS(pool.parallel_for(8, [&](size_t begin, size_t) {
+    if (begin == 0) {
+      throw std::runtime_error("chunk");
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    finished++;
+  }));
+  CHECK(finished == 7);
+}
+
+}  // namespace
+
+int main()
+{
+  Rake::Test::Suite suite;
+  suite.run("submit results", submit_results);
+  suite.run("covers range", covers_range);
+  suite.run("throw waits for chunks", throw_waits_for_chunks);
+  return suite.result();
+}